@@ -0,0 +1,56 @@
+#include <SoftwareSerial.h>
+#include <SimKafi.h>
+
+SoftwareSerial SIM900Serial(14, 12);
+SIMKAFI SimKafi(SIM900Serial);
+
+const int ALARM_PIN = 4;
+
+// Called in turn until one of them picks up.
+const char *const contacts[] = { "+XXxxxxxxxxxx", "+XXxxxxxxxxxx", "+XXxxxxxxxxxx" };
+const uint8_t CONTACT_COUNT = sizeof(contacts) / sizeof(contacts[0]);
+
+uint8_t next = 0;
+bool alarm = false;
+
+void onModemEvent(void *context, const SIMKAFIEvent &event) {
+  if(event.type != SIMKAFI_EVENT_CALL_STATE || event.call->state != SIMKAFI_CALL_RELEASED)
+    return;
+
+  if(event.call->answered) {
+    Serial.print(F("Alarm acknowledged, call lasted "));
+    Serial.print(event.call->duration / 1000);
+    Serial.println(F(" s"));
+
+    alarm = false;
+    return;
+  }
+
+  // Busy, no answer or no network: try the next contact.
+  Serial.print(F("Not answered, cause "));
+  Serial.println(event.call->cause);
+  next = (next + 1) % CONTACT_COUNT;
+}
+
+void setup() {
+  Serial.begin(9600);
+  SIM900Serial.begin(9600);
+  pinMode(ALARM_PIN, INPUT_PULLUP);
+
+  SimKafi.setEventCallback(onModemEvent, nullptr);
+  SimKafi.setCallReports(true);
+}
+
+void loop() {
+  SimKafi.handleSerialEvent();
+  SimKafi.serviceCall();
+
+  if(digitalRead(ALARM_PIN) == LOW)
+    alarm = true;
+
+  // Ring each contact for 30 seconds at most, without blocking the loop.
+  SIMKAFICallState state = SimKafi.call().state;
+  if(alarm && (state == SIMKAFI_CALL_IDLE || state == SIMKAFI_CALL_RELEASED) &&
+    SimKafi.dialUp(contacts[next], 30000) != SIMKAFI_DIAL_RESULT_OK)
+    next = (next + 1) % CONTACT_COUNT;
+}
@@ -0,0 +1,32 @@
+#include <SoftwareSerial.h>
+#include <SimKafi.h>
+
+SoftwareSerial SIM900Serial(14, 12);
+
+// Rates SoftwareSerial handles reliably; the module's current rate is usually one of them.
+const uint32_t rates[] = { 9600, 19200, 38400, 57600 };
+
+bool reconfigureSerial(void *context, uint32_t baud) {
+  SoftwareSerial *serial = (SoftwareSerial*) context;
+
+  serial->end();
+  serial->begin(baud);
+  return true;
+}
+
+void setup() {
+  Serial.begin(9600);
+  SIM900Serial.begin(9600);
+  SIMKAFI SimKafi(SIM900Serial);
+
+  uint32_t baud = SimKafi.upgradeBaudRate(rates, 4, reconfigureSerial, &SIM900Serial, true);
+  if(baud == 0)
+    Serial.println("Something went wrong.");
+  else {
+    Serial.print("Link runs at ");
+    Serial.print(baud);
+    Serial.println(" baud.");
+  }
+}
+
+void loop() { }
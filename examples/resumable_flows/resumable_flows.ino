@@ -0,0 +1,48 @@
+#include <SoftwareSerial.h>
+#include <SimKafi.h>
+
+SoftwareSerial SIM900Serial(14, 12);
+SIMKAFI SimKafi(SIM900Serial);
+
+SIMKAFITask smsTask = {};
+SIMKAFITask monitorTask = {};
+bool smsPending = true;
+
+// Prints the signal every ten seconds, waiting for the link while another flow holds it.
+SIMKAFITaskState monitorSignal(SIMKAFITask &task) {
+  SIMKAFI_TASK_BEGIN(task);
+
+  for(;;) {
+    task.since = millis();
+    SIMKAFI_TASK_WAIT_UNTIL(task, millis() - task.since >= 10000);
+
+    SIMKAFI_TASK_WAIT_UNTIL(task, SimKafi.lockLink(&task));
+    SimKafi.startCommand(F("AT+CSQ"));
+    SIMKAFI_TASK_WAIT_UNTIL(task, SimKafi.pollResponse() != SIMKAFI_POLL_WAITING);
+
+    Serial.println(SimKafi.polledResponse());
+    SimKafi.unlockLink(&task);
+  }
+
+  SIMKAFI_TASK_END(task);
+}
+
+void setup() {
+  Serial.begin(9600);
+  SIM900Serial.begin(9600);
+}
+
+void loop() {
+  // Neither call blocks; each returns as soon as its flow waits for the module.
+  if(smsPending) {
+    SIMKAFITaskState state = SimKafi.sendSMS(smsTask, "+98xxxxxxxxxx", "Hello, world!!");
+
+    if(state != SIMKAFI_TASK_RUNNING) {
+      Serial.println(state == SIMKAFI_TASK_DONE ? "Sent!" : "Not sent.");
+      smsPending = false;
+    }
+  }
+
+  monitorSignal(monitorTask);
+  SimKafi.handleSerialEvent();
+}
@@ -9,4 +9,12 @@ void setupSim(void)
 {
     SIM900Serial.begin(9600);
     // می‌توانید بررسی‌های اولیه را در اینجا انجام دهید.
+
+    // +CMTI indications keep the local SMS counts up to date.
+    SimKafi.sendCNMICommand(2, 1, 0, 0, 0);
+    SimKafi.selectSMSStorage(SIMKAFI_SMS_STORAGE_SM);
+
+    // Make room once the SIM is 80% full by deleting the messages already read.
+    SIMKAFIPurgePolicy purge = { 80, SIMKAFI_PURGE_READ };
+    SimKafi.setSMSPurgePolicy(purge);
 }
\ No newline at end of file
@@ -16,20 +16,21 @@ void setup()
 }
 
 void loop() {
-    // دریافت تعداد SMS‌ها
-    int smsCount = SimKafi.getSMSCount();
-    if (smsCount > 0) {
-        display.show(("SMS Count: " + String(smsCount)).c_str());
+    // +CMTI را پردازش می‌کند؛ شمارش‌ها بدون ارسال فرمان خوانده می‌شوند
+    SimKafi.handleSerialEvent();
+
+    int index = SimKafi.nextUnreadSMS();
+    if (index > 0) {
+        display.show(("Unread SMS: " + String(SimKafi.getUnreadSMSCount())).c_str());
 
-        // خواندن آخرین SMS
         String sender;
         String message;
-        if (SimKafi.readSMS(smsCount, sender, message)) {
+        if (SimKafi.readSMS(index, sender, message)) {
             display.show(("From: " + sender).c_str());
             display.show(("Message: " + message).c_str());
 
-            // حذف آخرین SMS
-            if (SimKafi.deleteSMS(smsCount)) {
+            // حذف SMS خوانده‌شده
+            if (SimKafi.deleteSMS(index)) {
                 display.show("SMS Deleted.");
             } else {
                 display.show("Failed to delete SMS.");
@@ -37,10 +38,7 @@ void loop() {
         } else {
             display.show("Failed to read SMS.");
         }
-    } else {
-        display.show("Failed to get SMS count.");
     }
 
-    // تأخیر برای جلوگیری از اجرای مکرر
-    delay(10000); // تأخیر 10 ثانیه‌ای
-}
\ No newline at end of file
+    delay(100);
+}
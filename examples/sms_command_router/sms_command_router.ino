@@ -0,0 +1,63 @@
+#include <SoftwareSerial.h>
+#include <SimKafi.h>
+#include <SimKafiSMSRouter.h>
+
+SoftwareSerial SIM900Serial(14, 12);
+SIMKAFI SimKafi(SIM900Serial);
+
+const int RELAY_PIN = 5;
+
+// "STATUS"
+void onStatus(void *context, const SIMKAFISMSCommand &command) {
+  Serial.print(F("Status requested by "));
+  Serial.write(command.sender.data, command.sender.length);
+  Serial.println();
+}
+
+// "RELAY1 ON" or "RELAY1 OFF"
+void onRelay(void *context, const SIMKAFISMSCommand &command) {
+  if(command.argCount == 1)
+    digitalWrite(RELAY_PIN, command.args[0].length == 2 ? HIGH : LOW);
+}
+
+// "APN <name>"
+void onAPN(void *context, const SIMKAFISMSCommand &command) {
+  Serial.print(F("New APN: "));
+  Serial.write(command.rest.data, command.rest.length);
+  Serial.println();
+}
+
+void onUnknown(void *context, const SIMKAFISMSCommand &command) {
+  Serial.println(F("Unknown command."));
+}
+
+const SIMKAFISMSRoute routes[] = {
+  SIMKAFI_SMS_ROUTE("STATUS", onStatus),
+  SIMKAFI_SMS_ROUTE("RELAY1", onRelay),
+  SIMKAFI_SMS_ROUTE("APN", onAPN)
+};
+
+// Only these numbers may send commands; national "0..." forms are read as Iranian numbers.
+const char *const owners[] = { "+98xxxxxxxxxx" };
+
+SIMKAFISMSRouter router(routes, sizeof(routes) / sizeof(routes[0]));
+
+void setup() {
+  Serial.begin(9600);
+  SIM900Serial.begin(9600);
+  pinMode(RELAY_PIN, OUTPUT);
+
+  // انتظار برای آماده شدن ماژول
+  delay(2000);
+
+  SimKafi.sendCNMICommand(2, 1, 0, 0, 0);
+  router.setAllowedSenders(owners, 1);
+  router.setHomeCountry("98");
+  router.setFallback(onUnknown);
+  SimKafi.setSMSReceivedCallback(&SIMKAFISMSRouter::receive, &router);
+}
+
+void loop() {
+  if(SIM900Serial.available())
+    SimKafi.handleSerialEvent();
+}
@@ -18,6 +18,7 @@ void setup() {
     SimKafi.setSMSReceivedCallback(onSMSReceived);
     SimKafi.setCallReceivedCallback(onCallReceived);
     SimKafi.setSMSDeliveredCallback(onSMSDelivered);
+    SimKafi.setEventCallback(onModemEvent, &Serial);
 
     Serial.println(
         SimKafi.sendSMS("+98xxxxxxxxxx", "Hello, world!!")
@@ -45,4 +46,26 @@ void onCallReceived() {
 
 void onSMSDelivered() {
     Serial.println("SMS Delivered!");
-}
\ No newline at end of file
+}
+
+// Events without a legacy callback arrive here, along with the context pointer given above.
+void onModemEvent(void* context, const SIMKAFIEvent& event) {
+    Print* out = static_cast<Print*>(context);
+
+    switch(event.type) {
+        case SIMKAFI_EVENT_CALL_ENDED:
+            out->println("Call ended.");
+            break;
+
+        case SIMKAFI_EVENT_GPRS_DETACHED:
+            out->println("GPRS detached.");
+            break;
+
+        case SIMKAFI_EVENT_SOCKET_CLOSED:
+            out->println("Socket closed.");
+            break;
+
+        default:
+            break;
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * 
+ * @file Arduino.h
+ * @brief Minimal Arduino core for building the SIMKAFI library on Linux hosts.
+ *
+ * Provides the timing functions, String, Print and Stream the library relies on, plus a
+ * Serial object bound to the process's standard output. It is only on the include path
+ * of the CMake host build; sketches built by the Arduino IDE use the real core.
+ * 
+ */
+
+#ifndef SIMKAFI_HOST_ARDUINO_H
+#define SIMKAFI_HOST_ARDUINO_H
+
+#include <ctype.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+// Host only: move millis() and micros() forward without sleeping, so a benchmark does not wait out timeouts.
+void advanceClock(unsigned long ms);
+
+// The host has no interrupts to mask.
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+/**
+ * 
+ * @class HardwareSerial
+ * @brief Stand-in for the board's primary serial port, writing to standard output.
+ * 
+ */
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long baud) { (void) baud; }
+    void end() {}
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+
+    size_t write(uint8_t value) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    void flush() override;
+    using Print::write;
+
+    operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,162 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "Print.h"
+
+#include <stdio.h>
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+    size_t n = 0;
+
+    while(size--) {
+        if(this->write(*buffer++) == 0)
+            break;
+        n++;
+    }
+
+    return n;
+}
+
+size_t Print::print(const __FlashStringHelper *str) {
+    return this->write(reinterpret_cast<const char*>(str));
+}
+
+size_t Print::print(const String &str) {
+    return this->write(str.c_str(), str.length());
+}
+
+size_t Print::print(const char str[]) {
+    return this->write(str);
+}
+
+size_t Print::print(char c) {
+    return this->write((uint8_t) c);
+}
+
+size_t Print::print(unsigned char value, int base) {
+    return this->print((unsigned long) value, base);
+}
+
+size_t Print::print(int value, int base) {
+    return this->print((long) value, base);
+}
+
+size_t Print::print(unsigned int value, int base) {
+    return this->print((unsigned long) value, base);
+}
+
+size_t Print::print(long value, int base) {
+    if(base == 0)
+        return this->write((uint8_t) value);
+
+    if(base == DEC && value < 0) {
+        size_t n = this->print('-');
+        return n + this->printNumber(0UL - (unsigned long) value, DEC);
+    }
+
+    return this->printNumber((unsigned long) value, (uint8_t) base);
+}
+
+size_t Print::print(unsigned long value, int base) {
+    if(base == 0)
+        return this->write((uint8_t) value);
+    return this->printNumber(value, (uint8_t) base);
+}
+
+size_t Print::print(double value, int digits) {
+    char buf[64];
+    int length = snprintf(buf, sizeof(buf), "%.*f", digits, value);
+
+    return length > 0 ? this->write(buf, (size_t) length) : 0;
+}
+
+size_t Print::println(const __FlashStringHelper *str) {
+    size_t n = this->print(str);
+    return n + this->println();
+}
+
+size_t Print::println(const String &str) {
+    size_t n = this->print(str);
+    return n + this->println();
+}
+
+size_t Print::println(const char str[]) {
+    size_t n = this->print(str);
+    return n + this->println();
+}
+
+size_t Print::println(char c) {
+    size_t n = this->print(c);
+    return n + this->println();
+}
+
+size_t Print::println(unsigned char value, int base) {
+    size_t n = this->print(value, base);
+    return n + this->println();
+}
+
+size_t Print::println(int value, int base) {
+    size_t n = this->print(value, base);
+    return n + this->println();
+}
+
+size_t Print::println(unsigned int value, int base) {
+    size_t n = this->print(value, base);
+    return n + this->println();
+}
+
+size_t Print::println(long value, int base) {
+    size_t n = this->print(value, base);
+    return n + this->println();
+}
+
+size_t Print::println(unsigned long value, int base) {
+    size_t n = this->print(value, base);
+    return n + this->println();
+}
+
+size_t Print::println(double value, int digits) {
+    size_t n = this->print(value, digits);
+    return n + this->println();
+}
+
+size_t Print::println() {
+    return this->write("\r\n");
+}
+
+size_t Print::printNumber(unsigned long value, uint8_t base) {
+    char buf[8 * sizeof(long) + 1];
+    char *str = &buf[sizeof(buf) - 1];
+    *str = '\0';
+
+    if(base < 2)
+        base = 10;
+
+    do {
+        char digit = (char) (value % base);
+        value /= base;
+        *--str = digit < 10 ? digit + '0' : digit + 'A' - 10;
+    } while(value != 0);
+
+    return this->write(str);
+}
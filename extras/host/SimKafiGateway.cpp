@@ -0,0 +1,313 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "SimKafiGateway.h"
+
+#include <chrono>
+#include <string.h>
+
+enum ModemState {
+    MODEM_STARTING,
+    MODEM_ONLINE,
+    MODEM_OFFLINE
+};
+
+struct SIMKAFIGateway::Modem {
+    SIMKAFIGateway *owner;
+    size_t index;
+    std::string path;
+    unsigned long baud;
+
+    SIMKAFIPosixSerial serial;
+    SIMKAFI simKafi;
+    SIMKAFISPSCQueue<SIMKAFIGatewayJob, SIMKAFI_GATEWAY_MODEM_QUEUE> jobs;
+
+    std::atomic<int> state;
+    std::atomic<uint32_t> queued, sent, failed;
+
+    /// Exponentially weighted failure rate in thousandths.
+    std::atomic<uint32_t> failurePermille;
+
+    std::thread thread;
+
+    Modem(SIMKAFIGateway *owner, size_t index, const char *path, unsigned long baud) :
+        owner(owner), index(index), path(path), baud(baud), simKafi(serial),
+        state(MODEM_STARTING), queued(0), sent(0), failed(0), failurePermille(0) {}
+};
+
+static void copyText(char *destination, size_t size, const char *source, size_t length) {
+    if(length >= size)
+        length = size - 1;
+
+    memcpy(destination, source, length);
+    destination[length] = '\0';
+}
+
+static void idle() {
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+}
+
+SIMKAFIGateway::SIMKAFIGateway() :
+    inbound(new SIMKAFIMPSCQueue<SIMKAFIGatewayJob, 256>()),
+    events(new SIMKAFIMPSCQueue<SIMKAFIGatewayEvent, 1024>()),
+    running(false), nextJobId(1), maxAttempts(2), failurePenalty(4) {}
+
+SIMKAFIGateway::~SIMKAFIGateway() {
+    this->stop();
+}
+
+size_t SIMKAFIGateway::addModem(const char *devicePath, unsigned long baud) {
+    size_t index = this->modems.size();
+    this->modems.emplace_back(new Modem(this, index, devicePath, baud));
+
+    return index;
+}
+
+void SIMKAFIGateway::setSetupHandler(SetupHandler handler) {
+    this->setup = handler;
+}
+
+void SIMKAFIGateway::setMaxAttempts(uint8_t attempts) {
+    this->maxAttempts = attempts > 0 ? attempts : 1;
+}
+
+void SIMKAFIGateway::setFailurePenalty(uint32_t jobs) {
+    this->failurePenalty = jobs;
+}
+
+bool SIMKAFIGateway::start() {
+    if(this->modems.empty() || this->running)
+        return !this->modems.empty();
+
+    this->running = true;
+    for(std::unique_ptr<Modem> &modem : this->modems)
+        modem->thread = std::thread(&SIMKAFIGateway::serve, this, std::ref(*modem));
+
+    this->dispatcher = std::thread(&SIMKAFIGateway::dispatch, this);
+    return true;
+}
+
+void SIMKAFIGateway::stop() {
+    this->running = false;
+
+    if(this->dispatcher.joinable())
+        this->dispatcher.join();
+
+    for(std::unique_ptr<Modem> &modem : this->modems)
+        if(modem->thread.joinable())
+            modem->thread.join();
+}
+
+bool SIMKAFIGateway::submitSMS(const char *number, const char *text, uint32_t *jobId) {
+    SIMKAFIGatewayJob job;
+    job.id = this->nextJobId++;
+    job.attempts = 0;
+    job.lastModem = -1;
+
+    copyText(job.number, sizeof(job.number), number, strlen(number));
+    copyText(job.text, sizeof(job.text), text, strlen(text));
+
+    if(!this->inbound->push(job))
+        return false;
+
+    if(jobId != nullptr)
+        *jobId = job.id;
+    return true;
+}
+
+bool SIMKAFIGateway::poll(SIMKAFIGatewayEvent &event) {
+    return this->events->pop(event);
+}
+
+size_t SIMKAFIGateway::modemCount() const {
+    return this->modems.size();
+}
+
+SIMKAFIGatewayModemStats SIMKAFIGateway::modemStats(size_t index) const {
+    const Modem &modem = *this->modems[index];
+    SIMKAFIGatewayModemStats stats;
+
+    stats.online = modem.state == MODEM_ONLINE;
+    stats.queued = modem.queued;
+    stats.sent = modem.sent;
+    stats.failed = modem.failed;
+    stats.failureRate = modem.failurePermille / 1000.0f;
+
+    return stats;
+}
+
+void SIMKAFIGateway::pushEvent(const SIMKAFIGatewayEvent &event) {
+    // Results must not be lost; wait for the application to drain the queue.
+    while(!this->events->push(event) && this->running)
+        idle();
+}
+
+int SIMKAFIGateway::pickModem(const SIMKAFIGatewayJob &job) const {
+    int best = -1;
+    uint64_t bestScore = 0;
+
+    for(const std::unique_ptr<Modem> &modem : this->modems) {
+        if(modem->state != MODEM_ONLINE ||
+            modem->jobs.size() >= SIMKAFI_GATEWAY_MODEM_QUEUE)
+            continue;
+
+        uint64_t score = (uint64_t) modem->queued * 1000 +
+            (uint64_t) modem->failurePermille * this->failurePenalty;
+
+        // A retry goes elsewhere whenever another modem can take it.
+        if((int) modem->index == job.lastModem)
+            score += (uint64_t) 1 << 40;
+
+        if(best == -1 || score < bestScore) {
+            best = (int) modem->index;
+            bestScore = score;
+        }
+    }
+
+    return best;
+}
+
+void SIMKAFIGateway::dispatch() {
+    SIMKAFIGatewayJob job;
+    bool holding = false;
+
+    while(this->running) {
+        if(!holding && !(holding = this->inbound->pop(job))) {
+            idle();
+            continue;
+        }
+
+        int target = this->pickModem(job);
+        if(target >= 0) {
+            Modem &modem = *this->modems[(size_t) target];
+
+            modem.queued++;
+            if(modem.jobs.push(job)) {
+                holding = false;
+                continue;
+            }
+            modem.queued--;
+        }
+        else {
+            bool anyUsable = false;
+            for(const std::unique_ptr<Modem> &modem : this->modems)
+                anyUsable |= modem->state != MODEM_OFFLINE;
+
+            if(!anyUsable) {
+                SIMKAFIGatewayEvent event;
+                memset(&event, 0, sizeof(event));
+                event.type = SIMKAFI_GATEWAY_SMS_FAILED;
+                event.modem = 0;
+                event.jobId = job.id;
+                copyText(event.number, sizeof(event.number), job.number, strlen(job.number));
+
+                this->pushEvent(event);
+                holding = false;
+                continue;
+            }
+        }
+
+        idle();
+    }
+}
+
+void SIMKAFIGateway::onSMS(void *context, SIMKAFIStringView sender, SIMKAFIStringView message) {
+    Modem *modem = static_cast<Modem*>(context);
+    SIMKAFIGatewayEvent event;
+
+    memset(&event, 0, sizeof(event));
+    event.type = SIMKAFI_GATEWAY_SMS_RECEIVED;
+    event.modem = (uint16_t) modem->index;
+    copyText(event.number, sizeof(event.number), sender.data, sender.length);
+    copyText(event.text, sizeof(event.text), message.data, message.length);
+
+    modem->owner->pushEvent(event);
+}
+
+void SIMKAFIGateway::onEvent(void *context, const SIMKAFIEvent &modemEvent) {
+    Modem *modem = static_cast<Modem*>(context);
+    SIMKAFIGatewayEvent event;
+
+    memset(&event, 0, sizeof(event));
+    event.type = SIMKAFI_GATEWAY_MODEM_EVENT;
+    event.modem = (uint16_t) modem->index;
+    event.modemEvent = modemEvent.type;
+
+    modem->owner->pushEvent(event);
+}
+
+void SIMKAFIGateway::serve(Modem &modem) {
+    SIMKAFIGatewayEvent event;
+    memset(&event, 0, sizeof(event));
+    event.modem = (uint16_t) modem.index;
+
+    bool ready = modem.serial.begin(modem.path.c_str(), modem.baud);
+    if(ready) {
+        modem.simKafi.setSMSReceivedCallback(&SIMKAFIGateway::onSMS, &modem);
+        modem.simKafi.setEventCallback(&SIMKAFIGateway::onEvent, &modem);
+
+        ready = !this->setup || this->setup(modem.simKafi, modem.index);
+    }
+
+    if(!ready) {
+        modem.state = MODEM_OFFLINE;
+        event.type = SIMKAFI_GATEWAY_MODEM_OFFLINE;
+
+        this->pushEvent(event);
+        return;
+    }
+
+    modem.state = MODEM_ONLINE;
+    while(this->running) {
+        SIMKAFIGatewayJob job;
+
+        if(modem.jobs.pop(job)) {
+            job.attempts++;
+            job.lastModem = (int16_t) modem.index;
+
+            bool success = modem.simKafi.sendSMS(job.number, job.text);
+            uint32_t sample = success ? 0 : 1000;
+            modem.failurePermille = (modem.failurePermille * 7 + sample) / 8;
+
+            if(success)
+                modem.sent++;
+            else modem.failed++;
+            modem.queued--;
+
+            if(!success && job.attempts < this->maxAttempts && this->inbound->push(job))
+                continue;
+
+            event.type = success ? SIMKAFI_GATEWAY_SMS_SENT : SIMKAFI_GATEWAY_SMS_FAILED;
+            event.jobId = job.id;
+            copyText(event.number, sizeof(event.number), job.number, strlen(job.number));
+
+            this->pushEvent(event);
+            continue;
+        }
+
+        if(modem.serial.waitReadable(2))
+            modem.simKafi.handleSerialEvent();
+    }
+
+    modem.serial.end();
+}
@@ -0,0 +1,280 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * 
+ * @file SimKafiGateway.h
+ * @brief Multi-modem SMS gateway engine for Linux hosts.
+ * 
+ */
+
+#ifndef SIMKAFI_GATEWAY_H
+#define SIMKAFI_GATEWAY_H
+
+#include <SimKafi.h>
+
+#include "SimKafiPosixSerial.h"
+#include "SimKafiQueue.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Maximum phone number length carried by gateway jobs and events, including the terminator.
+#define SIMKAFI_GATEWAY_NUMBER_SIZE     24
+
+/// Maximum SMS text length carried by gateway jobs and events, including the terminator.
+#define SIMKAFI_GATEWAY_TEXT_SIZE       161
+
+/// Number of jobs each modem may have queued ahead of its I/O thread.
+#define SIMKAFI_GATEWAY_MODEM_QUEUE     64
+
+/**
+ * 
+ * @struct SIMKAFIGatewayJob
+ * @brief An outbound SMS travelling from submitSMS() to a modem thread.
+ * 
+ */
+typedef struct _SIMKAFIGatewayJob {
+    /// Identifier returned by submitSMS() and echoed in the result event.
+    uint32_t id;
+
+    /// Number of send attempts made so far.
+    uint8_t attempts;
+
+    /// Index of the modem that made the last attempt, or -1.
+    int16_t lastModem;
+
+    /// Destination phone number.
+    char number[SIMKAFI_GATEWAY_NUMBER_SIZE];
+
+    /// Message text.
+    char text[SIMKAFI_GATEWAY_TEXT_SIZE];
+} SIMKAFIGatewayJob;
+
+/**
+ * 
+ * @enum SIMKAFIGatewayEventType
+ * @brief The kinds of events reported by SIMKAFIGateway::poll().
+ * 
+ */
+typedef enum _SIMKAFIGatewayEventType {
+    /// An outbound SMS was accepted by a modem.
+    SIMKAFI_GATEWAY_SMS_SENT,
+
+    /// An outbound SMS failed on every attempt.
+    SIMKAFI_GATEWAY_SMS_FAILED,
+
+    /// An SMS was received on one of the modems.
+    SIMKAFI_GATEWAY_SMS_RECEIVED,
+
+    /// A modem reported an unsolicited event; see modemEvent.
+    SIMKAFI_GATEWAY_MODEM_EVENT,
+
+    /// A modem could not be opened or stopped answering and was taken out of rotation.
+    SIMKAFI_GATEWAY_MODEM_OFFLINE
+} SIMKAFIGatewayEventType;
+
+/**
+ * 
+ * @struct SIMKAFIGatewayEvent
+ * @brief A result or unsolicited event travelling from a modem thread to the application.
+ * 
+ */
+typedef struct _SIMKAFIGatewayEvent {
+    /// The kind of event.
+    SIMKAFIGatewayEventType type;
+
+    /// Index of the modem that raised the event.
+    uint16_t modem;
+
+    /// The job identifier, for SMS_SENT and SMS_FAILED.
+    uint32_t jobId;
+
+    /// The modem event, for MODEM_EVENT.
+    SIMKAFIEventType modemEvent;
+
+    /// Destination number (SMS_SENT, SMS_FAILED) or sender (SMS_RECEIVED).
+    char number[SIMKAFI_GATEWAY_NUMBER_SIZE];
+
+    /// Message text for SMS_RECEIVED.
+    char text[SIMKAFI_GATEWAY_TEXT_SIZE];
+} SIMKAFIGatewayEvent;
+
+/**
+ * 
+ * @struct SIMKAFIGatewayModemStats
+ * @brief Snapshot of one modem's load and health as seen by the dispatcher.
+ * 
+ */
+typedef struct _SIMKAFIGatewayModemStats {
+    /// Whether the modem is in rotation.
+    bool online;
+
+    /// Jobs handed to the modem but not finished yet.
+    uint32_t queued;
+
+    /// Messages the modem sent successfully.
+    uint32_t sent;
+
+    /// Send attempts that failed on the modem.
+    uint32_t failed;
+
+    /// Recent failure rate, as an exponentially weighted average in [0, 1].
+    float failureRate;
+} SIMKAFIGatewayModemStats;
+
+/**
+ * 
+ * @class SIMKAFIGateway
+ * @brief Drives several modems, each with its own SIMKAFI instance on its own I/O thread.
+ *
+ * submitSMS() may be called from any thread; jobs pass through a lock-free MPSC queue to a
+ * dispatcher thread, which hands each one to the modem with the lowest load score (queue depth
+ * plus a penalty proportional to the recent failure rate) through that modem's SPSC queue.
+ * Results and received messages come back through a shared MPSC event queue drained by poll().
+ * 
+ */
+class SIMKAFIGateway {
+public:
+    /// Called once on each modem's thread after the device is opened, e.g. to set AT+CNMI.
+    typedef std::function<bool(SIMKAFI &simKafi, size_t modem)> SetupHandler;
+
+    SIMKAFIGateway();
+    ~SIMKAFIGateway();
+
+    SIMKAFIGateway(const SIMKAFIGateway&) = delete;
+    SIMKAFIGateway &operator=(const SIMKAFIGateway&) = delete;
+
+    /**
+     * 
+     * @brief Register a modem. Must be called before start().
+     *
+     * @param devicePath The serial device, e.g. "/dev/ttyUSB0".
+     * @param baud The baud rate of the device.
+     * @return The modem index.
+     * 
+     */
+    size_t addModem(const char *devicePath, unsigned long baud);
+
+    /**
+     * 
+     * @brief Set the per-modem setup step run by each I/O thread before it takes jobs.
+     * 
+     */
+    void setSetupHandler(SetupHandler handler);
+
+    /**
+     * 
+     * @brief Set how many modems a message is tried on before SMS_FAILED is reported.
+     * 
+     */
+    void setMaxAttempts(uint8_t attempts);
+
+    /**
+     * 
+     * @brief Set how many queued jobs a 100% failure rate is worth when scoring modems.
+     * 
+     */
+    void setFailurePenalty(uint32_t jobs);
+
+    /**
+     * 
+     * @brief Start the dispatcher and one I/O thread per modem.
+     *
+     * @return True if at least one modem is registered.
+     * 
+     */
+    bool start();
+
+    /**
+     * 
+     * @brief Stop all threads. Jobs still queued are dropped.
+     * 
+     */
+    void stop();
+
+    /**
+     * 
+     * @brief Queue an outbound SMS. Safe to call from any thread.
+     *
+     * @param number The destination number.
+     * @param text The message text; longer texts are truncated to one SMS.
+     * @param jobId Receives the job identifier, if not null.
+     * @return False if the inbound queue is full.
+     * 
+     */
+    bool submitSMS(const char *number, const char *text, uint32_t *jobId = nullptr);
+
+    /**
+     * 
+     * @brief Take the next event. Call from a single application thread.
+     *
+     * @param event Receives the event.
+     * @return False if no event is pending.
+     * 
+     */
+    bool poll(SIMKAFIGatewayEvent &event);
+
+    /**
+     * 
+     * @brief Get the number of registered modems.
+     * 
+     */
+    size_t modemCount() const;
+
+    /**
+     * 
+     * @brief Get a snapshot of one modem's counters.
+     * 
+     */
+    SIMKAFIGatewayModemStats modemStats(size_t modem) const;
+
+private:
+    struct Modem;
+
+    std::vector<std::unique_ptr<Modem>> modems;
+    std::unique_ptr<SIMKAFIMPSCQueue<SIMKAFIGatewayJob, 256>> inbound;
+    std::unique_ptr<SIMKAFIMPSCQueue<SIMKAFIGatewayEvent, 1024>> events;
+
+    std::thread dispatcher;
+    std::atomic<bool> running;
+    std::atomic<uint32_t> nextJobId;
+
+    SetupHandler setup;
+    uint8_t maxAttempts;
+    uint32_t failurePenalty;
+
+    void dispatch();
+    void serve(Modem &modem);
+    int pickModem(const SIMKAFIGatewayJob &job) const;
+    void pushEvent(const SIMKAFIGatewayEvent &event);
+
+    static void onSMS(void *context, SIMKAFIStringView sender, SIMKAFIStringView message);
+    static void onEvent(void *context, const SIMKAFIEvent &event);
+};
+
+#endif
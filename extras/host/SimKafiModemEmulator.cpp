@@ -0,0 +1,601 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "SimKafiModemEmulator.h"
+
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+static std::string fixedScript(const std::string &response) {
+    return response;
+}
+
+static bool isFinalResultCode(const std::string &line) {
+    return line == "OK" || line == "ERROR" ||
+        line.compare(0, 11, "+CME ERROR:") == 0 ||
+        line.compare(0, 11, "+CMS ERROR:") == 0;
+}
+
+static bool isModuleBaudRate(long baud) {
+    static const long rates[] = {
+        0, 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200, 230400, 460800
+    };
+
+    for(long rate : rates)
+        if(rate == baud)
+            return true;
+
+    return false;
+}
+
+static unsigned long fromSpeed(speed_t speed) {
+    switch(speed) {
+        case B1200:    return 1200;
+        case B2400:    return 2400;
+        case B4800:    return 4800;
+        case B9600:    return 9600;
+        case B19200:   return 19200;
+        case B38400:   return 38400;
+        case B57600:   return 57600;
+        case B115200:  return 115200;
+        case B230400:  return 230400;
+#ifdef B460800
+        case B460800:  return 460800;
+#endif
+#ifdef B921600
+        case B921600:  return 921600;
+#endif
+        default:       return 0;
+    }
+}
+
+static std::vector<std::string> splitLines(const std::string &script) {
+    std::vector<std::string> lines;
+    size_t start = 0;
+
+    while(start <= script.size()) {
+        size_t end = script.find('\n', start);
+        if(end == std::string::npos)
+            end = script.size();
+
+        if(end > start)
+            lines.push_back(script.substr(start, end - start));
+        start = end + 1;
+    }
+
+    return lines;
+}
+
+SIMKAFIModemEmulator::SIMKAFIModemEmulator() :
+    master(-1), slave(-1), wake{-1, -1}, running(false),
+    defaultResponse("OK"), lineCount(0), echo(true), responseDelay(0),
+    baud(9600), wireModel(false), silent(false), pendingBaud(-1),
+    promptLength(0), inPrompt(false), skipLineFeed(false) {}
+
+SIMKAFIModemEmulator::~SIMKAFIModemEmulator() {
+    this->stop();
+}
+
+bool SIMKAFIModemEmulator::start() {
+    char name[128];
+
+    if(this->running)
+        return true;
+    if(openpty(&this->master, &this->slave, name, nullptr, nullptr) != 0)
+        return false;
+
+    // Raw on both ends, so nothing is echoed or translated before the code under
+    // test configures the slave itself.
+    struct termios tty;
+    if(tcgetattr(this->slave, &tty) == 0) {
+        cfmakeraw(&tty);
+        tcsetattr(this->slave, TCSANOW, &tty);
+    }
+
+    if(pipe(this->wake) != 0) {
+        close(this->master);
+        close(this->slave);
+        this->master = this->slave = -1;
+
+        return false;
+    }
+
+    fcntl(this->master, F_SETFD, FD_CLOEXEC);
+    fcntl(this->slave, F_SETFD, FD_CLOEXEC);
+
+    this->path = name;
+    this->running = true;
+    this->worker = std::thread(&SIMKAFIModemEmulator::run, this);
+
+    return true;
+}
+
+void SIMKAFIModemEmulator::stop() {
+    if(this->running) {
+        this->running = false;
+
+        char c = 0;
+        if(write(this->wake[1], &c, 1) < 0) {}
+    }
+
+    if(this->worker.joinable())
+        this->worker.join();
+
+    for(int *fd : { &this->master, &this->slave, &this->wake[0], &this->wake[1] }) {
+        if(*fd >= 0)
+            close(*fd);
+        *fd = -1;
+    }
+}
+
+const char *SIMKAFIModemEmulator::devicePath() const {
+    return this->path.c_str();
+}
+
+void SIMKAFIModemEmulator::on(const std::string &prefix, const std::string &response) {
+    this->on(prefix, std::bind(fixedScript, response));
+}
+
+void SIMKAFIModemEmulator::on(const std::string &prefix, Handler handler) {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->rules.push_back(Rule { prefix, handler, false, nullptr });
+}
+
+void SIMKAFIModemEmulator::onPrompt(const std::string &prefix, const std::string &response) {
+    this->onPrompt(prefix, std::bind(fixedScript, response));
+}
+
+void SIMKAFIModemEmulator::onPrompt(const std::string &prefix, Handler handler) {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->rules.push_back(Rule { prefix, handler, true, nullptr });
+}
+
+void SIMKAFIModemEmulator::onData(const std::string &prefix, Handler ready, Handler handler) {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->rules.push_back(Rule { prefix, handler, true, ready });
+}
+
+void SIMKAFIModemEmulator::setDefaultResponse(const std::string &response) {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->defaultResponse = response;
+}
+
+void SIMKAFIModemEmulator::setEcho(bool echo) {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->echo = echo;
+}
+
+void SIMKAFIModemEmulator::setResponseDelay(unsigned long ms) {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->responseDelay = ms;
+}
+
+void SIMKAFIModemEmulator::setBaudRate(unsigned long baud) {
+    this->baud = baud;
+}
+
+unsigned long SIMKAFIModemEmulator::baudRate() const {
+    return this->baud;
+}
+
+void SIMKAFIModemEmulator::setWireModel(bool enabled) {
+    this->wireModel = enabled;
+}
+
+void SIMKAFIModemEmulator::setSilent(bool silent) {
+    this->silent = silent;
+}
+
+void SIMKAFIModemEmulator::inject(const std::string &script) {
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->pendingInjects.push_back(script);
+    }
+
+    char c = 1;
+    if(this->wake[1] >= 0 && write(this->wake[1], &c, 1) < 0) {}
+}
+
+std::vector<std::string> SIMKAFIModemEmulator::commands() const {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->history;
+}
+
+size_t SIMKAFIModemEmulator::commandLineCount() const {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->lineCount;
+}
+
+void SIMKAFIModemEmulator::clearCommands() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->history.clear();
+    this->lineCount = 0;
+}
+
+void SIMKAFIModemEmulator::run() {
+    char buffer[512];
+
+    while(this->running) {
+        struct pollfd fds[2];
+        fds[0].fd = this->master;
+        fds[0].events = POLLIN;
+        fds[1].fd = this->wake[0];
+        fds[1].events = POLLIN;
+        fds[0].revents = fds[1].revents = 0;
+
+        if(poll(fds, 2, -1) < 0) {
+            if(errno == EINTR)
+                continue;
+            break;
+        }
+
+        if(fds[1].revents & POLLIN) {
+            if(read(this->wake[0], buffer, sizeof(buffer)) < 0) {}
+
+            std::vector<std::string> injects;
+            {
+                std::lock_guard<std::mutex> guard(this->lock);
+                injects.swap(this->pendingInjects);
+            }
+
+            for(const std::string &script : injects)
+                this->emit(script);
+        }
+
+        if(fds[0].revents & POLLIN) {
+            ssize_t count = read(this->master, buffer, sizeof(buffer));
+            if(count > 0)
+                this->receive(buffer, (size_t) count);
+        }
+    }
+}
+
+unsigned long SIMKAFIModemEmulator::hostBaudRate() const {
+    struct termios tty;
+
+    if(this->slave < 0 || tcgetattr(this->slave, &tty) != 0)
+        return 0;
+    return fromSpeed(cfgetospeed(&tty));
+}
+
+void SIMKAFIModemEmulator::pace(size_t length, unsigned long rate) const {
+    // 8N1: a start bit, eight data bits and a stop bit per byte.
+    if(rate > 0)
+        std::this_thread::sleep_for(std::chrono::microseconds(length * 10000000ULL / rate));
+}
+
+void SIMKAFIModemEmulator::receive(const char *data, size_t length) {
+    if(this->silent) {
+        this->line.clear();
+        return;
+    }
+
+    if(this->wireModel) {
+        unsigned long host = this->hostBaudRate();
+        this->pace(length, host);
+
+        if(this->baud != 0 && this->baud != host) {
+            // Framing errors: the module never sees a valid character.
+            this->line.clear();
+            return;
+        }
+    }
+
+    bool echoing;
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        echoing = this->echo;
+    }
+
+    for(size_t i = 0; i < length; i++) {
+        char c = data[i];
+
+        if(this->skipLineFeed) {
+            this->skipLineFeed = false;
+            if(c == '\n')
+                continue;
+        }
+
+        if(this->inPrompt && this->promptLength > 0) {
+            this->payload += c;
+
+            if(this->payload.size() == this->promptLength) {
+                this->inPrompt = false;
+                std::string script = this->promptHandler(this->promptCommand, this->payload);
+
+                this->payload.clear();
+                this->emit(script);
+            }
+
+            continue;
+        }
+
+        if(this->inPrompt) {
+            if(c == 0x1a) {
+                this->inPrompt = false;
+                std::string script = this->promptHandler(this->promptCommand, this->payload);
+
+                this->payload.clear();
+                this->emit(script);
+            }
+            else if(c == 0x1b) {
+                this->inPrompt = false;
+                this->payload.clear();
+                this->emit("OK");
+            }
+            else if(c == '\r') {
+                this->payload += '\n';
+                this->skipLineFeed = true;
+                this->writeRaw("\r\n> ", 4);
+            }
+            else {
+                this->payload += c;
+                if(echoing)
+                    this->writeRaw(&c, 1);
+            }
+
+            continue;
+        }
+
+        if(echoing)
+            this->writeRaw(&c, 1);
+
+        if(c == '\r' || c == '\n') {
+            // The module echoes the whole "\r\n" terminator before it answers.
+            if(c == '\r' && i + 1 < length && data[i + 1] == '\n') {
+                if(echoing)
+                    this->writeRaw(&data[++i], 1);
+            }
+            else this->skipLineFeed = c == '\r';
+
+            std::string commandLine;
+            commandLine.swap(this->line);
+
+            if(commandLine.size() >= 2 &&
+                (commandLine[0] == 'A' || commandLine[0] == 'a') &&
+                (commandLine[1] == 'T' || commandLine[1] == 't')) {
+                if(this->wireModel && this->baud == 0)
+                    this->baud = this->hostBaudRate();
+
+                this->execute(commandLine);
+
+                std::lock_guard<std::mutex> guard(this->lock);
+                echoing = this->echo;
+            }
+        }
+        else this->line += c;
+    }
+}
+
+bool SIMKAFIModemEmulator::match(const std::string &command, Rule &rule) const {
+    bool found = false;
+    size_t best = 0;
+
+    for(const Rule &candidate : this->rules)
+        if(command.compare(0, candidate.prefix.size(), candidate.prefix) == 0 &&
+            (!found || candidate.prefix.size() >= best)) {
+            rule = candidate;
+            best = candidate.prefix.size();
+            found = true;
+        }
+
+    return found;
+}
+
+void SIMKAFIModemEmulator::execute(const std::string &commandLine) {
+    std::vector<std::string> chain;
+    size_t start = 2;
+    bool quoted = false;
+
+    // A dial command takes the rest of the line; its ';' asks for a voice call.
+    for(size_t i = 2; i <= commandLine.size(); i++)
+        if(i < commandLine.size() && i == start && (commandLine[i] == 'D' || commandLine[i] == 'd')) {
+            chain.push_back("AT" + commandLine.substr(start));
+            break;
+        }
+        else if(i == commandLine.size() || (commandLine[i] == ';' && !quoted)) {
+            chain.push_back("AT" + commandLine.substr(start, i - start));
+            start = i + 1;
+        }
+        else if(commandLine[i] == '"')
+            quoted = !quoted;
+
+    unsigned long delayMs;
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->lineCount++;
+        delayMs = this->responseDelay;
+    }
+
+    if(delayMs > 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+
+    std::string combined;
+    for(size_t i = 0; i < chain.size(); i++) {
+        const std::string &command = chain[i];
+        bool last = i + 1 == chain.size();
+        Rule rule;
+        bool matched;
+        std::string fallback;
+
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            this->history.push_back(command);
+
+            matched = this->match(command, rule);
+            fallback = this->defaultResponse;
+
+            if(command == "ATE0" || command == "ATE1")
+                this->echo = command == "ATE1";
+        }
+
+        if(matched && rule.prompt && rule.ready) {
+            size_t length = strtoul(command.c_str() + command.rfind(',') + 1, nullptr, 10);
+
+            this->emit(combined + rule.ready(command, std::string()));
+            if(length == 0) {
+                this->emit(rule.handler(command, std::string()));
+                return;
+            }
+
+            this->inPrompt = true;
+            this->promptHandler = rule.handler;
+            this->promptCommand = command;
+            this->promptLength = length;
+            this->payload.clear();
+
+            return;
+        }
+
+        if(matched && rule.prompt) {
+            this->emit(combined);
+            this->writeRaw("\r\n> ", 4);
+
+            this->inPrompt = true;
+            this->promptHandler = rule.handler;
+            this->promptCommand = command;
+            this->payload.clear();
+
+            // AT+CIPSEND=<length> reads a fixed number of bytes, binary data included.
+            this->promptLength = command.compare(0, 11, "AT+CIPSEND=") == 0 ?
+                strtoul(command.c_str() + 11, nullptr, 10) : 0;
+
+            return;
+        }
+
+        std::string script = matched ? rule.handler(command, std::string()) : this->builtin(command, fallback);
+        std::vector<std::string> lines = splitLines(script);
+
+        std::string finalCode;
+        for(size_t j = lines.size(); j-- > 0; )
+            if(lines[j][0] != '@') {
+                finalCode = lines[j];
+                break;
+            }
+
+        if(!last && finalCode == "OK") {
+            // Only the last command of a chain reports the final result code.
+            size_t cut = script.rfind("OK");
+            script.erase(cut, 2);
+        }
+
+        combined += script;
+        if(!combined.empty() && combined.back() != '\n')
+            combined += '\n';
+
+        if(isFinalResultCode(finalCode) && finalCode != "OK")
+            break;
+    }
+
+    this->emit(combined);
+
+    // A new rate takes effect once the "OK" has gone out at the old one.
+    if(this->pendingBaud >= 0) {
+        this->baud = (unsigned long) this->pendingBaud;
+        this->pendingBaud = -1;
+    }
+}
+
+std::string SIMKAFIModemEmulator::builtin(const std::string &command, const std::string &fallback) {
+    if(command == "AT+IPR?")
+        return "+IPR: " + std::to_string(this->baud.load()) + "\nOK";
+
+    if(command.compare(0, 7, "AT+IPR=") == 0) {
+        long rate = atol(command.c_str() + 7);
+        if(!isModuleBaudRate(rate))
+            return "ERROR";
+
+        this->pendingBaud = rate;
+        return "OK";
+    }
+
+    return fallback;
+}
+
+void SIMKAFIModemEmulator::emit(const std::string &script) {
+    std::string out;
+    bool inBlock = false;
+
+    // Information text goes out as one block, "\r\n<line>\r\n<line>\r\n", and every
+    // final result code is framed on its own, "\r\nOK\r\n", as the module does.
+    for(const std::string &line : splitLines(script)) {
+        if(line[0] == '@') {
+            this->writeRaw(out.data(), out.size());
+            out.clear();
+            inBlock = false;
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(atol(line.c_str() + 1)));
+            continue;
+        }
+
+        bool final = isFinalResultCode(line);
+        if(final || !inBlock)
+            out += "\r\n";
+
+        out += line;
+        out += "\r\n";
+        inBlock = !final;
+    }
+
+    this->writeRaw(out.data(), out.size());
+}
+
+void SIMKAFIModemEmulator::writeRaw(const char *data, size_t length) {
+    if(this->wireModel) {
+        unsigned long host = this->hostBaudRate();
+        unsigned long rate = this->baud != 0 ? this->baud.load() : host;
+        std::string garbage;
+
+        if(rate != host) {
+            garbage.assign(length, '\xf0');
+            data = garbage.data();
+        }
+
+        // Hand the bytes over in small slices so the reader sees them trickle in.
+        for(size_t offset = 0; offset < length; offset += 16) {
+            size_t slice = length - offset < 16 ? length - offset : 16;
+
+            this->pace(slice, rate);
+            this->writeAll(data + offset, slice);
+        }
+    }
+    else this->writeAll(data, length);
+}
+
+void SIMKAFIModemEmulator::writeAll(const char *data, size_t length) {
+    size_t written = 0;
+
+    while(written < length) {
+        ssize_t count = write(this->master, data + written, length - written);
+        if(count > 0)
+            written += (size_t) count;
+        else if(count < 0 && errno != EINTR && errno != EAGAIN)
+            break;
+    }
+}
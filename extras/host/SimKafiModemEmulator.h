@@ -0,0 +1,252 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * 
+ * @file SimKafiModemEmulator.h
+ * @brief Scripted SIM900/SIM800 modem on a pseudo-terminal, for host tests and benchmarks.
+ * 
+ */
+
+#ifndef SIMKAFI_MODEM_EMULATOR_H
+#define SIMKAFI_MODEM_EMULATOR_H
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * 
+ * @class SIMKAFIModemEmulator
+ * @brief A scripted modem answering AT commands on the master side of a pseudo-terminal.
+ *
+ * The slave side, named by devicePath(), is opened by the code under test exactly like a real
+ * USB-serial adapter. Responses are scripts of lines separated by '\n'; every line is framed
+ * as "\r\n<line>\r\n" on the wire, and a line of the form "@<ms>" pauses for that long, e.g.
+ * "OK\n@200\nCONNECT OK". Chained command lines ("AT+A;+B") are split and answered with a
+ * single final result code, as on the real module.
+ * 
+ */
+class SIMKAFIModemEmulator {
+public:
+    /// Produces the response script for a command and, for prompt commands, the data sent after "> ".
+    typedef std::function<std::string(const std::string &command, const std::string &payload)> Handler;
+
+    SIMKAFIModemEmulator();
+    ~SIMKAFIModemEmulator();
+
+    SIMKAFIModemEmulator(const SIMKAFIModemEmulator&) = delete;
+    SIMKAFIModemEmulator &operator=(const SIMKAFIModemEmulator&) = delete;
+
+    /**
+     * 
+     * @brief Allocate the pseudo-terminal and start answering commands.
+     *
+     * @return True if the pseudo-terminal was created, false otherwise.
+     * 
+     */
+    bool start();
+
+    /**
+     * 
+     * @brief Stop the emulator thread and release the pseudo-terminal.
+     * 
+     */
+    void stop();
+
+    /**
+     * 
+     * @brief Get the path of the slave device to open from the code under test.
+     * 
+     */
+    const char *devicePath() const;
+
+    /**
+     * 
+     * @brief Answer commands starting with a prefix with a fixed script.
+     *
+     * The rule with the longest matching prefix wins; among equal prefixes the latest one does.
+     * 
+     */
+    void on(const std::string &prefix, const std::string &response);
+
+    /**
+     * 
+     * @brief Answer commands starting with a prefix with a script computed by a handler.
+     * 
+     */
+    void on(const std::string &prefix, Handler handler);
+
+    /**
+     * 
+     * @brief Answer a prefix with a "> " prompt, collect data up to Ctrl-Z, then respond.
+     *
+     * Models AT+CMGS, AT+CMGW and AT+CIPSEND. An ESC instead of Ctrl-Z cancels the input.
+     * AT+CIPSEND=<length> takes exactly that many bytes instead, without Ctrl-Z or echo.
+     * 
+     */
+    void onPrompt(const std::string &prefix, const std::string &response);
+    void onPrompt(const std::string &prefix, Handler handler);
+
+    /**
+     * 
+     * @brief Answer a prefix with a ready script, collect a fixed number of bytes, then respond.
+     *
+     * Models AT+FTPPUT=2,<length>: the script from ready (e.g. "+FTPPUT: 2,<length>") is sent
+     * instead of "> ", then exactly <length> bytes, the command's last parameter, are passed to
+     * handler. A length of 0 calls handler right away.
+     * 
+     */
+    void onData(const std::string &prefix, Handler ready, Handler handler);
+
+    /**
+     * 
+     * @brief Set the script used for commands no rule matches ("OK" by default).
+     * 
+     */
+    void setDefaultResponse(const std::string &response);
+
+    /**
+     * 
+     * @brief Turn command echo on or off (ATE1/ATE0 do the same from the wire).
+     * 
+     */
+    void setEcho(bool echo);
+
+    /**
+     * 
+     * @brief Delay every response by a fixed processing time.
+     * 
+     */
+    void setResponseDelay(unsigned long ms);
+
+    /**
+     * 
+     * @brief Set the module's serial rate, as AT+IPR=<baud> does from the wire (0 = autobaud).
+     *
+     * Only observed while the wire model is on. In autobaud mode the first command line locks the
+     * module to the rate the host sent it at.
+     * 
+     */
+    void setBaudRate(unsigned long baud);
+
+    /**
+     * 
+     * @brief Get the module's serial rate, 0 while autobauding.
+     * 
+     */
+    unsigned long baudRate() const;
+
+    /**
+     * 
+     * @brief Model the serial line between host and module.
+     *
+     * When on, the host rate is read from the termios settings of the slave side. Every byte costs
+     * ten bit times in both directions, and bytes sent at a rate other than the module's are lost
+     * (host to module) or arrive as garbage (module to host), like on a real UART.
+     * 
+     */
+    void setWireModel(bool enabled);
+
+    /**
+     * 
+     * @brief Ignore everything received, as a browned-out or hung module does.
+     * 
+     */
+    void setSilent(bool silent);
+
+    /**
+     * 
+     * @brief Send an unsolicited result code script, e.g. "+CMTI: \"SM\",3".
+     * 
+     */
+    void inject(const std::string &script);
+
+    /**
+     * 
+     * @brief Get a copy of every command line received so far, after chain splitting.
+     * 
+     */
+    std::vector<std::string> commands() const;
+
+    /**
+     * 
+     * @brief Get the number of command lines received so far (one per round trip).
+     * 
+     */
+    size_t commandLineCount() const;
+
+    /**
+     * 
+     * @brief Forget the received command history.
+     * 
+     */
+    void clearCommands();
+
+private:
+    struct Rule {
+        std::string prefix;
+        Handler handler;
+        bool prompt;
+        Handler ready;
+    };
+
+    int master, slave, wake[2];
+    std::string path;
+    std::thread worker;
+    std::atomic<bool> running;
+
+    mutable std::mutex lock;
+    std::vector<Rule> rules;
+    std::vector<std::string> history;
+    std::vector<std::string> pendingInjects;
+    std::string defaultResponse;
+    size_t lineCount;
+    bool echo;
+    unsigned long responseDelay;
+    std::atomic<unsigned long> baud;
+    std::atomic<bool> wireModel;
+    std::atomic<bool> silent;
+    long pendingBaud;
+
+    std::string line, payload, promptCommand;
+    Handler promptHandler;
+    size_t promptLength;
+    bool inPrompt, skipLineFeed;
+
+    void run();
+    void receive(const char *data, size_t length);
+    void execute(const std::string &commandLine);
+    bool match(const std::string &command, Rule &rule) const;
+    std::string builtin(const std::string &command, const std::string &fallback);
+    unsigned long hostBaudRate() const;
+    void pace(size_t length, unsigned long rate) const;
+    void emit(const std::string &script);
+    void writeRaw(const char *data, size_t length);
+    void writeAll(const char *data, size_t length);
+};
+
+#endif
@@ -0,0 +1,224 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "SimKafiPosixSerial.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+static speed_t toSpeed(unsigned long baud) {
+    switch(baud) {
+        case 1200:    return B1200;
+        case 2400:    return B2400;
+        case 4800:    return B4800;
+        case 9600:    return B9600;
+        case 19200:   return B19200;
+        case 38400:   return B38400;
+        case 57600:   return B57600;
+        case 115200:  return B115200;
+        case 230400:  return B230400;
+#ifdef B460800
+        case 460800:  return B460800;
+#endif
+#ifdef B921600
+        case 921600:  return B921600;
+#endif
+        default:      return B0;
+    }
+}
+
+SIMKAFIPosixSerial::SIMKAFIPosixSerial() :
+    fd(-1), baud(0), idleWait(1), rxHead(0), rxTail(0) {}
+
+SIMKAFIPosixSerial::~SIMKAFIPosixSerial() {
+    this->end();
+}
+
+bool SIMKAFIPosixSerial::isSupportedBaudRate(unsigned long baud) {
+    return toSpeed(baud) != B0;
+}
+
+bool SIMKAFIPosixSerial::begin(const char *path, unsigned long baud) {
+    this->end();
+
+    this->fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if(this->fd < 0)
+        return false;
+
+    struct termios tty;
+    if(tcgetattr(this->fd, &tty) != 0) {
+        this->end();
+        return false;
+    }
+
+    cfmakeraw(&tty);
+    tty.c_cflag |= CLOCAL | CREAD;
+    tty.c_cflag &= ~(CSTOPB | CRTSCTS);
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 0;
+
+    if(tcsetattr(this->fd, TCSANOW, &tty) != 0 || !this->setBaudRate(baud)) {
+        this->end();
+        return false;
+    }
+
+    tcflush(this->fd, TCIOFLUSH);
+    return true;
+}
+
+void SIMKAFIPosixSerial::end() {
+    if(this->fd >= 0)
+        close(this->fd);
+
+    this->fd = -1;
+    this->rxHead = this->rxTail = 0;
+}
+
+bool SIMKAFIPosixSerial::setBaudRate(unsigned long baud) {
+    speed_t speed = toSpeed(baud);
+    struct termios tty;
+
+    if(this->fd < 0 || speed == B0 || tcgetattr(this->fd, &tty) != 0)
+        return false;
+
+    cfsetispeed(&tty, speed);
+    cfsetospeed(&tty, speed);
+    if(tcsetattr(this->fd, TCSADRAIN, &tty) != 0)
+        return false;
+
+    this->baud = baud;
+    return true;
+}
+
+unsigned long SIMKAFIPosixSerial::baudRate() const {
+    return this->baud;
+}
+
+int SIMKAFIPosixSerial::fileDescriptor() const {
+    return this->fd;
+}
+
+void SIMKAFIPosixSerial::setIdleWait(unsigned long ms) {
+    this->idleWait = ms;
+}
+
+bool SIMKAFIPosixSerial::fill(int timeout) {
+    if(this->fd < 0)
+        return false;
+
+    if(this->rxHead == this->rxTail)
+        this->rxHead = this->rxTail = 0;
+    if(this->rxTail == sizeof(this->rxBuffer))
+        return true;
+
+    struct pollfd pfd;
+    pfd.fd = this->fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    int ready;
+    do {
+        ready = poll(&pfd, 1, timeout);
+    } while(ready < 0 && errno == EINTR);
+
+    if(ready <= 0 || (pfd.revents & POLLIN) == 0)
+        return false;
+
+    ssize_t count = ::read(
+        this->fd,
+        this->rxBuffer + this->rxTail,
+        sizeof(this->rxBuffer) - this->rxTail
+    );
+    if(count <= 0)
+        return false;
+
+    this->rxTail += (size_t) count;
+    return true;
+}
+
+bool SIMKAFIPosixSerial::waitReadable(unsigned long timeout) {
+    if(this->rxHead != this->rxTail)
+        return true;
+
+    return this->fill((int) timeout);
+}
+
+int SIMKAFIPosixSerial::available() {
+    if(this->rxHead == this->rxTail)
+        this->fill((int) this->idleWait);
+    else this->fill(0);
+
+    return (int) (this->rxTail - this->rxHead);
+}
+
+int SIMKAFIPosixSerial::read() {
+    if(this->rxHead == this->rxTail && !this->fill(0))
+        return -1;
+
+    return this->rxBuffer[this->rxHead++];
+}
+
+int SIMKAFIPosixSerial::peek() {
+    if(this->rxHead == this->rxTail && !this->fill(0))
+        return -1;
+
+    return this->rxBuffer[this->rxHead];
+}
+
+size_t SIMKAFIPosixSerial::write(uint8_t value) {
+    return this->write(&value, 1);
+}
+
+size_t SIMKAFIPosixSerial::write(const uint8_t *buffer, size_t size) {
+    size_t written = 0;
+
+    while(this->fd >= 0 && written < size) {
+        ssize_t count = ::write(this->fd, buffer + written, size - written);
+
+        if(count > 0) {
+            written += (size_t) count;
+            continue;
+        }
+
+        if(count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            break;
+
+        struct pollfd pfd;
+        pfd.fd = this->fd;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+
+        if(poll(&pfd, 1, 1000) <= 0)
+            break;
+    }
+
+    return written;
+}
+
+void SIMKAFIPosixSerial::flush() {
+    if(this->fd >= 0)
+        tcdrain(this->fd);
+}
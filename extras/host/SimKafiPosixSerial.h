@@ -0,0 +1,155 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * 
+ * @file SimKafiPosixSerial.h
+ * @brief termios-backed Stream for driving a SIMKAFI module from a Linux host.
+ * 
+ */
+
+#ifndef SIMKAFI_POSIX_SERIAL_H
+#define SIMKAFI_POSIX_SERIAL_H
+
+#include <Arduino.h>
+
+/**
+ * 
+ * @class SIMKAFIPosixSerial
+ * @brief A Stream over a serial device such as /dev/ttyUSB0 or a pseudo-terminal.
+ *
+ * The device is opened in raw, non-blocking mode. Reads go through a small internal buffer
+ * refilled with poll(), so available() never blocks for longer than the configured idle wait.
+ * 
+ */
+class SIMKAFIPosixSerial : public Stream {
+private:
+    /// The file descriptor of the open device, or -1.
+    int fd;
+
+    /// The baud rate the device is configured for.
+    unsigned long baud;
+
+    /// How long available() may wait in poll() when the buffer is empty.
+    unsigned long idleWait;
+
+    /// Bytes read from the device but not yet consumed.
+    uint8_t rxBuffer[256];
+    size_t rxHead, rxTail;
+
+    /// Read whatever the device has into rxBuffer, waiting at most timeout milliseconds.
+    bool fill(int timeout);
+
+public:
+    SIMKAFIPosixSerial();
+    ~SIMKAFIPosixSerial();
+
+    SIMKAFIPosixSerial(const SIMKAFIPosixSerial&) = delete;
+    SIMKAFIPosixSerial &operator=(const SIMKAFIPosixSerial&) = delete;
+
+    /**
+     * 
+     * @brief Open and configure a serial device.
+     *
+     * @param path The device path, e.g. "/dev/ttyUSB0".
+     * @param baud The baud rate to configure (8N1, no flow control).
+     * @return True if the device was opened and configured, false otherwise.
+     * 
+     */
+    bool begin(const char *path, unsigned long baud);
+
+    /**
+     * 
+     * @brief Close the device.
+     * 
+     */
+    void end();
+
+    /**
+     * 
+     * @brief Change the baud rate of the open device.
+     *
+     * @param baud The new baud rate.
+     * @return True if the rate is supported and was applied, false otherwise.
+     * 
+     */
+    bool setBaudRate(unsigned long baud);
+
+    /**
+     * 
+     * @brief Get the currently configured baud rate.
+     * 
+     */
+    unsigned long baudRate() const;
+
+    /**
+     * 
+     * @brief Check whether a termios speed constant exists for a baud rate.
+     * 
+     */
+    static bool isSupportedBaudRate(unsigned long baud);
+
+    /**
+     * 
+     * @brief Get the underlying file descriptor, e.g. to add it to an epoll set.
+     *
+     * @return The file descriptor, or -1 if the device is not open.
+     * 
+     */
+    int fileDescriptor() const;
+
+    /**
+     * 
+     * @brief Wait until at least one byte can be read.
+     *
+     * @param timeout The maximum time to wait, in milliseconds.
+     * @return True if data is available, false on timeout or error.
+     * 
+     */
+    bool waitReadable(unsigned long timeout);
+
+    /**
+     * 
+     * @brief Set how long available() waits for data when nothing is buffered.
+     *
+     * Arduino-style code polls available() in a tight loop. A short wait (1 ms by default)
+     * keeps such loops from pinning a CPU core; 0 makes available() purely non-blocking.
+     *
+     * @param ms The wait in milliseconds.
+     * 
+     */
+    void setIdleWait(unsigned long ms);
+
+    int available() override;
+    int read() override;
+    int peek() override;
+
+    size_t write(uint8_t value) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    void flush() override;
+    using Print::write;
+
+    operator bool() const { return this->fd >= 0; }
+};
+
+#endif
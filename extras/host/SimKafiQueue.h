@@ -0,0 +1,178 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * 
+ * @file SimKafiQueue.h
+ * @brief Bounded lock-free queues used to move jobs and events between gateway threads.
+ * 
+ */
+
+#ifndef SIMKAFI_QUEUE_H
+#define SIMKAFI_QUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * 
+ * @class SIMKAFISPSCQueue
+ * @brief Wait-free ring buffer for exactly one producer thread and one consumer thread.
+ *
+ * @tparam T A copyable element type.
+ * @tparam Capacity The number of slots; must be a power of two.
+ * 
+ */
+template<class T, size_t Capacity>
+class SIMKAFISPSCQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+        "SIMKAFISPSCQueue capacity must be a power of two");
+
+private:
+    T items[Capacity];
+
+    /// Next slot to read; written only by the consumer.
+    alignas(64) std::atomic<size_t> head;
+
+    /// Next slot to write; written only by the producer.
+    alignas(64) std::atomic<size_t> tail;
+
+public:
+    SIMKAFISPSCQueue() : head(0), tail(0) {}
+
+    /// Append an item. Producer thread only. Returns false if the queue is full.
+    bool push(const T &item) {
+        size_t t = this->tail.load(std::memory_order_relaxed);
+        if(t - this->head.load(std::memory_order_acquire) == Capacity)
+            return false;
+
+        this->items[t & (Capacity - 1)] = item;
+        this->tail.store(t + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /// Remove the oldest item. Consumer thread only. Returns false if the queue is empty.
+    bool pop(T &item) {
+        size_t h = this->head.load(std::memory_order_relaxed);
+        if(h == this->tail.load(std::memory_order_acquire))
+            return false;
+
+        item = this->items[h & (Capacity - 1)];
+        this->head.store(h + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /// Approximate number of queued items; exact when called from either end.
+    size_t size() const {
+        return this->tail.load(std::memory_order_acquire) -
+            this->head.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t capacity() { return Capacity; }
+};
+
+/**
+ * 
+ * @class SIMKAFIMPSCQueue
+ * @brief Bounded lock-free queue for any number of producers and one consumer.
+ *
+ * Each slot carries a sequence number, so producers claim slots with a single
+ * compare-and-swap and never wait on each other's copies.
+ *
+ * @tparam T A copyable element type.
+ * @tparam Capacity The number of slots; must be a power of two.
+ * 
+ */
+template<class T, size_t Capacity>
+class SIMKAFIMPSCQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+        "SIMKAFIMPSCQueue capacity must be a power of two");
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+
+    Cell cells[Capacity];
+
+    /// Next position to claim; shared by producers.
+    alignas(64) std::atomic<size_t> enqueuePosition;
+
+    /// Next position to read; owned by the consumer.
+    alignas(64) size_t dequeuePosition;
+
+public:
+    SIMKAFIMPSCQueue() : enqueuePosition(0), dequeuePosition(0) {
+        for(size_t i = 0; i < Capacity; i++)
+            this->cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    /// Append an item. Safe from any thread. Returns false if the queue is full.
+    bool push(const T &item) {
+        size_t position = this->enqueuePosition.load(std::memory_order_relaxed);
+        Cell *cell;
+
+        while(true) {
+            cell = &this->cells[position & (Capacity - 1)];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+
+            if(difference == 0) {
+                if(this->enqueuePosition.compare_exchange_weak(
+                    position, position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if(difference < 0)
+                return false;
+            else position = this->enqueuePosition.load(std::memory_order_relaxed);
+        }
+
+        cell->item = item;
+        cell->sequence.store(position + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /// Remove the oldest item. Consumer thread only. Returns false if the queue is empty.
+    bool pop(T &item) {
+        Cell *cell = &this->cells[this->dequeuePosition & (Capacity - 1)];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+
+        if((intptr_t) sequence - (intptr_t) (this->dequeuePosition + 1) < 0)
+            return false;
+
+        item = cell->item;
+        cell->sequence.store(this->dequeuePosition + Capacity, std::memory_order_release);
+        this->dequeuePosition++;
+
+        return true;
+    }
+
+    static constexpr size_t capacity() { return Capacity; }
+};
+
+#endif
@@ -0,0 +1,91 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "SimKafiSessionFile.h"
+
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+class StringPrint : public Print {
+public:
+    std::string value;
+
+    size_t write(uint8_t c) override {
+        this->value += (char) c;
+        return 1;
+    }
+};
+
+}
+
+bool SIMKAFISaveSession(const SIMKAFIRecorder &recorder, const char *path, const std::string &comment) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if(!file)
+        return false;
+
+    StringPrint text;
+    recorder.dump(text);
+
+    // Comments go right after the format header written by dump().
+    size_t header = text.value.find('\n');
+    header = header == std::string::npos ? text.value.size() : header + 1;
+    file.write(text.value.data(), (std::streamsize) header);
+
+    std::istringstream lines(comment);
+    std::string line;
+    while(std::getline(lines, line))
+        file << "# " << line << "\n";
+
+    file.write(text.value.data() + header, (std::streamsize) (text.value.size() - header));
+    return (bool) file.flush();
+}
+
+bool SIMKAFILoadSession(const char *path, std::vector<SIMKAFIWireRecord> &records,
+    std::vector<std::string> *comments) {
+    std::ifstream file(path, std::ios::binary);
+    if(!file)
+        return false;
+
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    std::string text = contents.str();
+
+    if(comments != nullptr) {
+        std::istringstream lines(text);
+        std::string line;
+
+        while(std::getline(lines, line))
+            if(line.compare(0, 2, "# ") == 0) {
+                if(!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                comments->push_back(line.substr(2));
+            }
+    }
+
+    records.resize(text.size() / 2 + 1);
+    records.resize(SIMKAFIRecorder::parse(text.c_str(), records.data(), records.size()));
+
+    return true;
+}
@@ -0,0 +1,64 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * 
+ * @file SimKafiSessionFile.h
+ * @brief Saving and loading SIMKAFIRecorder sessions as files on the host.
+ * 
+ */
+
+#ifndef SIMKAFI_SESSION_FILE_H
+#define SIMKAFI_SESSION_FILE_H
+
+#include <SimKafiRecorder.h>
+
+#include <string>
+#include <vector>
+
+/**
+ * 
+ * @brief Write a recorder's log to a file, in the text form of SIMKAFIRecorder::dump().
+ *
+ * @param recorder The recorder to save.
+ * @param path The file to create or overwrite.
+ * @param comment Optional text written as "# " comment lines after the header.
+ * @return True if the file was written.
+ * 
+ */
+bool SIMKAFISaveSession(const SIMKAFIRecorder &recorder, const char *path, const std::string &comment = "");
+
+/**
+ * 
+ * @brief Read a session file written by SIMKAFISaveSession() or dumped over Serial.
+ *
+ * @param path The file to read.
+ * @param records Receives the records.
+ * @param comments If not null, receives the "# " comment lines without their prefix.
+ * @return True if the file could be read.
+ * 
+ */
+bool SIMKAFILoadSession(const char *path, std::vector<SIMKAFIWireRecord> &records,
+    std::vector<std::string> *comments = nullptr);
+
+#endif
@@ -0,0 +1,184 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "Arduino.h"
+
+int Stream::timedRead() {
+    this->_startMillis = millis();
+
+    do {
+        int c = this->read();
+        if(c >= 0)
+            return c;
+
+        yield();
+    } while(millis() - this->_startMillis < this->_timeout);
+
+    return -1;
+}
+
+int Stream::timedPeek() {
+    this->_startMillis = millis();
+
+    do {
+        int c = this->peek();
+        if(c >= 0)
+            return c;
+
+        yield();
+    } while(millis() - this->_startMillis < this->_timeout);
+
+    return -1;
+}
+
+int Stream::peekNextDigit() {
+    while(true) {
+        int c = this->timedPeek();
+
+        if(c < 0 || c == '-' || (c >= '0' && c <= '9'))
+            return c;
+        this->read();
+    }
+}
+
+bool Stream::find(const char *target) {
+    return this->find(target, strlen(target));
+}
+
+bool Stream::find(const char *target, size_t length) {
+    if(length == 0)
+        return true;
+
+    size_t index = 0;
+    int c;
+
+    while((c = this->timedRead()) > 0) {
+        if(c == target[index]) {
+            if(++index >= length)
+                return true;
+        }
+        else index = c == target[0] ? 1 : 0;
+    }
+
+    return false;
+}
+
+bool Stream::findUntil(const char *target, const char *terminator) {
+    size_t targetLength = strlen(target), terminatorLength = strlen(terminator);
+    size_t index = 0, terminatorIndex = 0;
+    int c;
+
+    if(targetLength == 0)
+        return true;
+
+    while((c = this->timedRead()) > 0) {
+        if(c == target[index]) {
+            if(++index >= targetLength)
+                return true;
+        }
+        else index = c == target[0] ? 1 : 0;
+
+        if(terminatorLength > 0 && c == terminator[terminatorIndex]) {
+            if(++terminatorIndex >= terminatorLength)
+                return false;
+        }
+        else terminatorIndex = 0;
+    }
+
+    return false;
+}
+
+long Stream::parseInt() {
+    bool negative = false;
+    long value = 0;
+    int c = this->peekNextDigit();
+
+    if(c < 0)
+        return 0;
+
+    do {
+        if(c == '-')
+            negative = true;
+        else if(c >= '0' && c <= '9')
+            value = value * 10 + c - '0';
+
+        this->read();
+        c = this->timedPeek();
+    } while((c >= '0' && c <= '9') || (c == '-' && value == 0 && !negative));
+
+    return negative ? -value : value;
+}
+
+size_t Stream::readBytes(char *buffer, size_t length) {
+    size_t count = 0;
+
+    while(count < length) {
+        int c = this->timedRead();
+        if(c < 0)
+            break;
+
+        *buffer++ = (char) c;
+        count++;
+    }
+
+    return count;
+}
+
+size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length) {
+    size_t index = 0;
+
+    while(index < length) {
+        int c = this->timedRead();
+        if(c < 0 || c == terminator)
+            break;
+
+        *buffer++ = (char) c;
+        index++;
+    }
+
+    return index;
+}
+
+String Stream::readString() {
+    String ret;
+    int c = this->timedRead();
+
+    while(c >= 0) {
+        ret += (char) c;
+        c = this->timedRead();
+    }
+
+    return ret;
+}
+
+String Stream::readStringUntil(char terminator) {
+    String ret;
+    int c = this->timedRead();
+
+    while(c >= 0 && c != terminator) {
+        ret += (char) c;
+        c = this->timedRead();
+    }
+
+    return ret;
+}
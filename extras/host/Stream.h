@@ -0,0 +1,71 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * 
+ * @file Stream.h
+ * @brief Host implementation of the Arduino Stream class.
+ * 
+ */
+
+#ifndef SIMKAFI_HOST_STREAM_H
+#define SIMKAFI_HOST_STREAM_H
+
+#include "Print.h"
+
+class Stream : public Print {
+public:
+    Stream() : _timeout(1000), _startMillis(0) {}
+
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long timeout) { this->_timeout = timeout; }
+    unsigned long getTimeout() const { return this->_timeout; }
+
+    bool find(const char *target);
+    bool find(const char *target, size_t length);
+    bool findUntil(const char *target, const char *terminator);
+
+    long parseInt();
+
+    size_t readBytes(char *buffer, size_t length);
+    size_t readBytes(uint8_t *buffer, size_t length) {
+        return this->readBytes((char*) buffer, length);
+    }
+    size_t readBytesUntil(char terminator, char *buffer, size_t length);
+
+    String readString();
+    String readStringUntil(char terminator);
+
+protected:
+    unsigned long _timeout;
+    unsigned long _startMillis;
+
+    int timedRead();
+    int timedPeek();
+    int peekNextDigit();
+};
+
+#endif
@@ -0,0 +1,631 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "WString.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void formatInteger(char *buf, size_t size, unsigned long value, unsigned char base, bool negative) {
+    char digits[sizeof(unsigned long) * 8 + 2];
+    size_t count = 0;
+
+    if(base < 2)
+        base = 10;
+
+    do {
+        unsigned long digit = value % base;
+        digits[count++] = (char) (digit < 10 ? '0' + digit : 'a' + digit - 10);
+        value /= base;
+    } while(value != 0 && count < sizeof(digits));
+
+    size_t pos = 0;
+    if(negative && pos + 1 < size)
+        buf[pos++] = '-';
+
+    while(count > 0 && pos + 1 < size)
+        buf[pos++] = digits[--count];
+    buf[pos] = '\0';
+}
+
+String::String(const char *cstr) {
+    this->invalidate();
+    if(cstr != nullptr)
+        this->copy(cstr, (unsigned int) strlen(cstr));
+}
+
+String::String(const char *cstr, unsigned int length) {
+    this->invalidate();
+    if(cstr != nullptr)
+        this->copy(cstr, length);
+}
+
+String::String(const String &value) {
+    this->invalidate();
+    *this = value;
+}
+
+String::String(String &&rval) noexcept {
+    this->invalidate();
+    this->move(rval);
+}
+
+String::String(const __FlashStringHelper *str) {
+    this->invalidate();
+    const char *cstr = reinterpret_cast<const char*>(str);
+
+    if(cstr != nullptr)
+        this->copy(cstr, (unsigned int) strlen(cstr));
+}
+
+String::String(char c) {
+    this->invalidate();
+    char buf[2] = { c, '\0' };
+    this->copy(buf, 1);
+}
+
+String::String(unsigned char value, unsigned char base) {
+    this->invalidate();
+    char buf[1 + 8 * sizeof(unsigned char)];
+    formatInteger(buf, sizeof(buf), value, base, false);
+    this->copy(buf, (unsigned int) strlen(buf));
+}
+
+String::String(int value, unsigned char base) {
+    this->invalidate();
+    char buf[2 + 8 * sizeof(int)];
+
+    if(base == 10 && value < 0)
+        formatInteger(buf, sizeof(buf), 0UL - (unsigned long) value, base, true);
+    else formatInteger(buf, sizeof(buf), (unsigned int) value, base, false);
+    this->copy(buf, (unsigned int) strlen(buf));
+}
+
+String::String(unsigned int value, unsigned char base) {
+    this->invalidate();
+    char buf[1 + 8 * sizeof(unsigned int)];
+    formatInteger(buf, sizeof(buf), value, base, false);
+    this->copy(buf, (unsigned int) strlen(buf));
+}
+
+String::String(long value, unsigned char base) {
+    this->invalidate();
+    char buf[2 + 8 * sizeof(long)];
+
+    if(base == 10 && value < 0)
+        formatInteger(buf, sizeof(buf), 0UL - (unsigned long) value, base, true);
+    else formatInteger(buf, sizeof(buf), (unsigned long) value, base, false);
+    this->copy(buf, (unsigned int) strlen(buf));
+}
+
+String::String(unsigned long value, unsigned char base) {
+    this->invalidate();
+    char buf[1 + 8 * sizeof(unsigned long)];
+    formatInteger(buf, sizeof(buf), value, base, false);
+    this->copy(buf, (unsigned int) strlen(buf));
+}
+
+String::String(float value, unsigned char decimalPlaces) {
+    this->invalidate();
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", decimalPlaces, (double) value);
+    this->copy(buf, (unsigned int) strlen(buf));
+}
+
+String::String(double value, unsigned char decimalPlaces) {
+    this->invalidate();
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", decimalPlaces, value);
+    this->copy(buf, (unsigned int) strlen(buf));
+}
+
+String::~String() {
+    free(this->buffer);
+}
+
+void String::invalidate() {
+    this->buffer = nullptr;
+    this->capacity = this->len = 0;
+}
+
+bool String::reserve(unsigned int size) {
+    if(this->buffer != nullptr && this->capacity >= size)
+        return true;
+
+    if(this->changeBuffer(size)) {
+        if(this->len == 0)
+            this->buffer[0] = '\0';
+        return true;
+    }
+
+    return false;
+}
+
+bool String::changeBuffer(unsigned int maxStrLen) {
+    char *newBuffer = (char*) realloc(this->buffer, maxStrLen + 1);
+    if(newBuffer == nullptr)
+        return false;
+
+    this->buffer = newBuffer;
+    this->capacity = maxStrLen;
+    return true;
+}
+
+String &String::copy(const char *cstr, unsigned int length) {
+    if(!this->reserve(length)) {
+        free(this->buffer);
+        this->invalidate();
+        return *this;
+    }
+
+    this->len = length;
+    memmove(this->buffer, cstr, length);
+    this->buffer[length] = '\0';
+
+    return *this;
+}
+
+void String::move(String &rhs) {
+    if(this != &rhs) {
+        free(this->buffer);
+
+        this->buffer = rhs.buffer;
+        this->capacity = rhs.capacity;
+        this->len = rhs.len;
+        rhs.invalidate();
+    }
+}
+
+String &String::operator=(const String &rhs) {
+    if(this == &rhs)
+        return *this;
+
+    if(rhs.buffer != nullptr)
+        this->copy(rhs.buffer, rhs.len);
+    else {
+        free(this->buffer);
+        this->invalidate();
+    }
+
+    return *this;
+}
+
+String &String::operator=(String &&rval) noexcept {
+    this->move(rval);
+    return *this;
+}
+
+String &String::operator=(const char *cstr) {
+    if(cstr != nullptr)
+        this->copy(cstr, (unsigned int) strlen(cstr));
+    else {
+        free(this->buffer);
+        this->invalidate();
+    }
+
+    return *this;
+}
+
+String &String::operator=(const __FlashStringHelper *str) {
+    return *this = reinterpret_cast<const char*>(str);
+}
+
+bool String::concat(const String &s) {
+    return this->concat(s.c_str(), s.len);
+}
+
+bool String::concat(const char *cstr, unsigned int length) {
+    if(cstr == nullptr)
+        return false;
+    if(length == 0)
+        return true;
+
+    unsigned int newLength = this->len + length;
+    if(cstr >= this->c_str() && cstr < this->c_str() + this->len) {
+        // Appending a slice of ourselves: the buffer may move on reserve().
+        unsigned int offset = (unsigned int) (cstr - this->buffer);
+        if(!this->reserve(newLength))
+            return false;
+
+        memmove(this->buffer + this->len, this->buffer + offset, length);
+    }
+    else {
+        if(!this->reserve(newLength))
+            return false;
+
+        memmove(this->buffer + this->len, cstr, length);
+    }
+
+    this->len = newLength;
+    this->buffer[newLength] = '\0';
+    return true;
+}
+
+bool String::concat(const char *cstr) {
+    if(cstr == nullptr)
+        return false;
+    return this->concat(cstr, (unsigned int) strlen(cstr));
+}
+
+bool String::concat(char c) {
+    return this->concat(&c, 1);
+}
+
+bool String::concat(unsigned char value) {
+    return this->concat(String(value));
+}
+
+bool String::concat(int value) {
+    return this->concat(String(value));
+}
+
+bool String::concat(unsigned int value) {
+    return this->concat(String(value));
+}
+
+bool String::concat(long value) {
+    return this->concat(String(value));
+}
+
+bool String::concat(unsigned long value) {
+    return this->concat(String(value));
+}
+
+bool String::concat(float value) {
+    return this->concat(String(value));
+}
+
+bool String::concat(double value) {
+    return this->concat(String(value));
+}
+
+bool String::concat(const __FlashStringHelper *str) {
+    return this->concat(reinterpret_cast<const char*>(str));
+}
+
+StringSumHelper &operator+(const StringSumHelper &lhs, const String &rhs) {
+    StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
+    if(!a.concat(rhs))
+        a.invalidate();
+    return a;
+}
+
+StringSumHelper &operator+(const StringSumHelper &lhs, const char *cstr) {
+    StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
+    if(cstr == nullptr || !a.concat(cstr))
+        a.invalidate();
+    return a;
+}
+
+StringSumHelper &operator+(const StringSumHelper &lhs, char c) {
+    StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
+    if(!a.concat(c))
+        a.invalidate();
+    return a;
+}
+
+StringSumHelper &operator+(const StringSumHelper &lhs, unsigned char value) {
+    StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
+    if(!a.concat(value))
+        a.invalidate();
+    return a;
+}
+
+StringSumHelper &operator+(const StringSumHelper &lhs, int value) {
+    StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
+    if(!a.concat(value))
+        a.invalidate();
+    return a;
+}
+
+StringSumHelper &operator+(const StringSumHelper &lhs, unsigned int value) {
+    StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
+    if(!a.concat(value))
+        a.invalidate();
+    return a;
+}
+
+StringSumHelper &operator+(const StringSumHelper &lhs, long value) {
+    StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
+    if(!a.concat(value))
+        a.invalidate();
+    return a;
+}
+
+StringSumHelper &operator+(const StringSumHelper &lhs, unsigned long value) {
+    StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
+    if(!a.concat(value))
+        a.invalidate();
+    return a;
+}
+
+StringSumHelper &operator+(const StringSumHelper &lhs, float value) {
+    StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
+    if(!a.concat(value))
+        a.invalidate();
+    return a;
+}
+
+StringSumHelper &operator+(const StringSumHelper &lhs, double value) {
+    StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
+    if(!a.concat(value))
+        a.invalidate();
+    return a;
+}
+
+StringSumHelper &operator+(const StringSumHelper &lhs, const __FlashStringHelper *rhs) {
+    StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
+    if(!a.concat(rhs))
+        a.invalidate();
+    return a;
+}
+
+int String::compareTo(const String &s) const {
+    return strcmp(this->c_str(), s.c_str());
+}
+
+bool String::equals(const String &s) const {
+    return this->len == s.len && this->compareTo(s) == 0;
+}
+
+bool String::equals(const char *cstr) const {
+    if(this->len == 0)
+        return cstr == nullptr || *cstr == '\0';
+    if(cstr == nullptr)
+        return false;
+
+    return strcmp(this->buffer, cstr) == 0;
+}
+
+bool String::equalsIgnoreCase(const String &s) const {
+    if(this->len != s.len)
+        return false;
+
+    for(unsigned int i = 0; i < this->len; i++)
+        if(tolower((unsigned char) this->buffer[i]) != tolower((unsigned char) s.buffer[i]))
+            return false;
+
+    return true;
+}
+
+bool String::startsWith(const String &prefix) const {
+    if(this->len < prefix.len)
+        return false;
+    return this->startsWith(prefix, 0);
+}
+
+bool String::startsWith(const String &prefix, unsigned int offset) const {
+    if(offset > this->len || this->len - offset < prefix.len)
+        return false;
+    return strncmp(this->c_str() + offset, prefix.c_str(), prefix.len) == 0;
+}
+
+bool String::endsWith(const String &suffix) const {
+    if(this->len < suffix.len)
+        return false;
+    return strcmp(this->c_str() + this->len - suffix.len, suffix.c_str()) == 0;
+}
+
+char String::charAt(unsigned int index) const {
+    return (*this)[index];
+}
+
+void String::setCharAt(unsigned int index, char c) {
+    if(index < this->len)
+        this->buffer[index] = c;
+}
+
+char String::operator[](unsigned int index) const {
+    if(index >= this->len || this->buffer == nullptr)
+        return 0;
+    return this->buffer[index];
+}
+
+char &String::operator[](unsigned int index) {
+    static char dummy;
+    if(index >= this->len || this->buffer == nullptr) {
+        dummy = 0;
+        return dummy;
+    }
+
+    return this->buffer[index];
+}
+
+void String::getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index) const {
+    if(bufsize == 0 || buf == nullptr)
+        return;
+    if(index >= this->len) {
+        buf[0] = 0;
+        return;
+    }
+
+    unsigned int n = bufsize - 1;
+    if(n > this->len - index)
+        n = this->len - index;
+
+    memcpy(buf, this->buffer + index, n);
+    buf[n] = 0;
+}
+
+void String::toCharArray(char *buf, unsigned int bufsize, unsigned int index) const {
+    this->getBytes(reinterpret_cast<unsigned char*>(buf), bufsize, index);
+}
+
+int String::indexOf(char ch) const {
+    return this->indexOf(ch, 0);
+}
+
+int String::indexOf(char ch, unsigned int fromIndex) const {
+    if(fromIndex >= this->len)
+        return -1;
+
+    const char *found = (const char*) memchr(this->buffer + fromIndex, ch, this->len - fromIndex);
+    return found == nullptr ? -1 : (int) (found - this->buffer);
+}
+
+int String::indexOf(const String &s) const {
+    return this->indexOf(s, 0);
+}
+
+int String::indexOf(const String &s, unsigned int fromIndex) const {
+    if(fromIndex >= this->len)
+        return -1;
+
+    const char *found = strstr(this->buffer + fromIndex, s.c_str());
+    return found == nullptr ? -1 : (int) (found - this->buffer);
+}
+
+int String::lastIndexOf(char ch) const {
+    return this->lastIndexOf(ch, this->len - 1);
+}
+
+int String::lastIndexOf(char ch, unsigned int fromIndex) const {
+    if(this->len == 0)
+        return -1;
+    if(fromIndex >= this->len)
+        fromIndex = this->len - 1;
+
+    for(int i = (int) fromIndex; i >= 0; i--)
+        if(this->buffer[i] == ch)
+            return i;
+
+    return -1;
+}
+
+int String::lastIndexOf(const String &s) const {
+    return this->lastIndexOf(s, this->len - s.len);
+}
+
+int String::lastIndexOf(const String &s, unsigned int fromIndex) const {
+    if(s.len == 0 || this->len == 0 || s.len > this->len)
+        return -1;
+    if(fromIndex >= this->len)
+        fromIndex = this->len - 1;
+
+    int found = -1;
+    for(const char *p = this->buffer; p <= this->buffer + fromIndex; p++) {
+        p = strstr(p, s.buffer);
+        if(p == nullptr || (unsigned int) (p - this->buffer) > fromIndex)
+            break;
+
+        found = (int) (p - this->buffer);
+    }
+
+    return found;
+}
+
+String String::substring(unsigned int left, unsigned int right) const {
+    if(left > right) {
+        unsigned int temp = right;
+        right = left;
+        left = temp;
+    }
+
+    if(left >= this->len)
+        return String();
+    if(right > this->len)
+        right = this->len;
+
+    return String(this->buffer + left, right - left);
+}
+
+void String::replace(char find, char replace) {
+    for(unsigned int i = 0; i < this->len; i++)
+        if(this->buffer[i] == find)
+            this->buffer[i] = replace;
+}
+
+void String::replace(const String &find, const String &replace) {
+    if(this->len == 0 || find.len == 0)
+        return;
+
+    String result;
+    unsigned int start = 0;
+    int found;
+
+    while((found = this->indexOf(find, start)) != -1) {
+        result.concat(this->buffer + start, (unsigned int) found - start);
+        result.concat(replace);
+        start = (unsigned int) found + find.len;
+    }
+
+    result.concat(this->buffer + start, this->len - start);
+    *this = static_cast<String&&>(result);
+}
+
+void String::remove(unsigned int index) {
+    this->remove(index, (unsigned int) -1);
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+    if(index >= this->len)
+        return;
+    if(count > this->len - index)
+        count = this->len - index;
+
+    memmove(this->buffer + index, this->buffer + index + count, this->len - index - count);
+    this->len -= count;
+    this->buffer[this->len] = '\0';
+}
+
+void String::toLowerCase() {
+    for(unsigned int i = 0; i < this->len; i++)
+        this->buffer[i] = (char) tolower((unsigned char) this->buffer[i]);
+}
+
+void String::toUpperCase() {
+    for(unsigned int i = 0; i < this->len; i++)
+        this->buffer[i] = (char) toupper((unsigned char) this->buffer[i]);
+}
+
+void String::trim() {
+    if(this->buffer == nullptr || this->len == 0)
+        return;
+
+    char *begin = this->buffer;
+    while(isspace((unsigned char) *begin))
+        begin++;
+
+    char *end = this->buffer + this->len - 1;
+    while(end >= begin && isspace((unsigned char) *end))
+        end--;
+
+    this->len = (unsigned int) (end + 1 - begin);
+    if(begin > this->buffer)
+        memmove(this->buffer, begin, this->len);
+    this->buffer[this->len] = '\0';
+}
+
+long String::toInt() const {
+    return this->buffer != nullptr ? atol(this->buffer) : 0;
+}
+
+float String::toFloat() const {
+    return (float) this->toDouble();
+}
+
+double String::toDouble() const {
+    return this->buffer != nullptr ? atof(this->buffer) : 0;
+}
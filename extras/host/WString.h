@@ -0,0 +1,179 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * 
+ * @file WString.h
+ * @brief Host implementation of the Arduino String class.
+ *
+ * Mirrors the public surface of the Arduino core's WString.h closely enough to compile
+ * the SIMKAFI library and sketches against it on Linux. Flash strings (F()) are plain
+ * const char pointers on the host.
+ * 
+ */
+
+#ifndef SIMKAFI_HOST_WSTRING_H
+#define SIMKAFI_HOST_WSTRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper*>(string_literal))
+#define PSTR(string_literal) (string_literal)
+#define FPSTR(pstr_pointer) (reinterpret_cast<const __FlashStringHelper*>(pstr_pointer))
+
+class StringSumHelper;
+
+class String {
+public:
+    String(const char *cstr = "");
+    String(const char *cstr, unsigned int length);
+    String(const String &str);
+    String(String &&rval) noexcept;
+    String(const __FlashStringHelper *str);
+    explicit String(char c);
+    explicit String(unsigned char value, unsigned char base = 10);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(float value, unsigned char decimalPlaces = 2);
+    explicit String(double value, unsigned char decimalPlaces = 2);
+    ~String();
+
+    bool reserve(unsigned int size);
+    unsigned int length() const { return this->len; }
+
+    String &operator=(const String &rhs);
+    String &operator=(String &&rval) noexcept;
+    String &operator=(const char *cstr);
+    String &operator=(const __FlashStringHelper *str);
+
+    bool concat(const String &str);
+    bool concat(const char *cstr);
+    bool concat(const char *cstr, unsigned int length);
+    bool concat(char c);
+    bool concat(unsigned char value);
+    bool concat(int value);
+    bool concat(unsigned int value);
+    bool concat(long value);
+    bool concat(unsigned long value);
+    bool concat(float value);
+    bool concat(double value);
+    bool concat(const __FlashStringHelper *str);
+
+    template<class T>
+    String &operator+=(T rhs) {
+        this->concat(rhs);
+        return *this;
+    }
+
+    friend StringSumHelper &operator+(const StringSumHelper &lhs, const String &rhs);
+    friend StringSumHelper &operator+(const StringSumHelper &lhs, const char *cstr);
+    friend StringSumHelper &operator+(const StringSumHelper &lhs, char c);
+    friend StringSumHelper &operator+(const StringSumHelper &lhs, unsigned char value);
+    friend StringSumHelper &operator+(const StringSumHelper &lhs, int value);
+    friend StringSumHelper &operator+(const StringSumHelper &lhs, unsigned int value);
+    friend StringSumHelper &operator+(const StringSumHelper &lhs, long value);
+    friend StringSumHelper &operator+(const StringSumHelper &lhs, unsigned long value);
+    friend StringSumHelper &operator+(const StringSumHelper &lhs, float value);
+    friend StringSumHelper &operator+(const StringSumHelper &lhs, double value);
+    friend StringSumHelper &operator+(const StringSumHelper &lhs, const __FlashStringHelper *rhs);
+
+    int compareTo(const String &str) const;
+    bool equals(const String &str) const;
+    bool equals(const char *cstr) const;
+    bool equalsIgnoreCase(const String &str) const;
+    bool operator==(const String &rhs) const { return this->equals(rhs); }
+    bool operator==(const char *cstr) const { return this->equals(cstr); }
+    bool operator!=(const String &rhs) const { return !this->equals(rhs); }
+    bool operator!=(const char *cstr) const { return !this->equals(cstr); }
+    bool operator<(const String &rhs) const { return this->compareTo(rhs) < 0; }
+    bool operator>(const String &rhs) const { return this->compareTo(rhs) > 0; }
+    bool startsWith(const String &prefix) const;
+    bool startsWith(const String &prefix, unsigned int offset) const;
+    bool endsWith(const String &suffix) const;
+
+    char charAt(unsigned int index) const;
+    void setCharAt(unsigned int index, char c);
+    char operator[](unsigned int index) const;
+    char &operator[](unsigned int index);
+    void getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index = 0) const;
+    void toCharArray(char *buf, unsigned int bufsize, unsigned int index = 0) const;
+    const char *c_str() const { return this->buffer != nullptr ? this->buffer : ""; }
+    char *begin() { return this->buffer; }
+    char *end() { return this->buffer + this->len; }
+    const char *begin() const { return this->c_str(); }
+    const char *end() const { return this->c_str() + this->len; }
+
+    int indexOf(char ch) const;
+    int indexOf(char ch, unsigned int fromIndex) const;
+    int indexOf(const String &str) const;
+    int indexOf(const String &str, unsigned int fromIndex) const;
+    int lastIndexOf(char ch) const;
+    int lastIndexOf(char ch, unsigned int fromIndex) const;
+    int lastIndexOf(const String &str) const;
+    int lastIndexOf(const String &str, unsigned int fromIndex) const;
+    String substring(unsigned int beginIndex) const { return this->substring(beginIndex, this->len); }
+    String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+    void replace(char find, char replace);
+    void replace(const String &find, const String &replace);
+    void remove(unsigned int index);
+    void remove(unsigned int index, unsigned int count);
+    void toLowerCase();
+    void toUpperCase();
+    void trim();
+
+    long toInt() const;
+    float toFloat() const;
+    double toDouble() const;
+
+protected:
+    char *buffer;
+    unsigned int capacity;
+    unsigned int len;
+
+    void invalidate();
+    bool changeBuffer(unsigned int maxStrLen);
+    String &copy(const char *cstr, unsigned int length);
+    void move(String &rhs);
+};
+
+class StringSumHelper : public String {
+public:
+    StringSumHelper(const String &s) : String(s) {}
+    StringSumHelper(const char *p) : String(p) {}
+    StringSumHelper(const __FlashStringHelper *p) : String(p) {}
+    StringSumHelper(char c) : String(c) {}
+    StringSumHelper(unsigned char value) : String(value) {}
+    StringSumHelper(int value) : String(value) {}
+    StringSumHelper(unsigned int value) : String(value) {}
+    StringSumHelper(long value) : String(value) {}
+    StringSumHelper(unsigned long value) : String(value) {}
+    StringSumHelper(float value) : String(value) {}
+    StringSumHelper(double value) : String(value) {}
+};
+
+#endif
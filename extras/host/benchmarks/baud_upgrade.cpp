@@ -0,0 +1,122 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Measures what a baud rate upgrade buys on a wire-modelled link: the emulator starts at
+ * 9600 baud, a 50-message AT+CMGL listing is timed, the link is upgraded with
+ * SIMKAFI::upgradeBaudRate() and the listing is timed again.
+ *
+ * Usage: baud_upgrade [start-baud=9600] [messages=50]
+ *
+ * Pass 0 as the start rate to begin with the module in autobaud mode.
+ */
+
+#include <SimKafi.h>
+#include <SimKafiModemEmulator.h>
+#include <SimKafiPosixSerial.h>
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+static const uint32_t hostRates[] = { 9600, 19200, 38400, 57600, 115200, 230400, 460800 };
+
+static bool reconfigure(void *context, uint32_t baud) {
+    return static_cast<SIMKAFIPosixSerial*>(context)->setBaudRate(baud);
+}
+
+static std::string listing(int messages) {
+    std::string script;
+
+    for(int i = 1; i <= messages; i++) {
+        script += "+CMGL: " + std::to_string(i) + ",\"REC READ\",\"+15550100" +
+            std::to_string(i % 10) + "\",\"\",\"23/10/01,12:00:00+00\"\n";
+        script += "Meter 42 reading " + std::to_string(1000 + i) +
+            " kWh, status nominal, next report in 15 minutes.\n";
+    }
+
+    return script + "OK";
+}
+
+// Time from sending the command until the final "OK" has been read.
+static double timeListing(SIMKAFIPosixSerial &serial, size_t &bytes) {
+    auto start = std::chrono::steady_clock::now();
+    std::string received;
+
+    serial.print("AT+CMGL=\"ALL\"\r\n");
+    while(received.size() < 6 || received.compare(received.size() - 6, 6, "\r\nOK\r\n") != 0) {
+        if(!serial.waitReadable(5000))
+            break;
+
+        while(serial.available() > 0)
+            received += (char) serial.read();
+    }
+
+    bytes = received.size();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv) {
+    unsigned long startBaud = argc > 1 ? strtoul(argv[1], nullptr, 10) : 9600;
+    int messages = argc > 2 ? atoi(argv[2]) : 50;
+
+    SIMKAFIModemEmulator modem;
+    modem.setBaudRate(startBaud);
+    modem.setWireModel(true);
+    modem.on("AT+CMGL", listing(messages));
+
+    SIMKAFIPosixSerial serial;
+    if(!modem.start() || !serial.begin(modem.devicePath(), 9600)) {
+        fprintf(stderr, "cannot start the emulated modem\n");
+        return 1;
+    }
+
+    SIMKAFI simKafi(serial);
+    size_t bytes;
+
+    if(simKafi.detectBaudRate(hostRates, sizeof(hostRates) / sizeof(hostRates[0]), reconfigure, &serial) == 0) {
+        fprintf(stderr, "no answer from the module\n");
+        return 1;
+    }
+
+    double before = timeListing(serial, bytes);
+    printf("%-8lu baud: %zu bytes listed in %8.1f ms\n", serial.baudRate(), bytes, before);
+
+    auto start = std::chrono::steady_clock::now();
+    uint32_t upgraded = simKafi.upgradeBaudRate(hostRates, sizeof(hostRates) / sizeof(hostRates[0]),
+        reconfigure, &serial, true);
+    double negotiation = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    if(upgraded == 0 || upgraded != modem.baudRate()) {
+        fprintf(stderr, "upgrade failed: host %lu, module %lu\n", serial.baudRate(), modem.baudRate());
+        return 1;
+    }
+
+    double after = timeListing(serial, bytes);
+    printf("%-8u baud: %zu bytes listed in %8.1f ms\n", upgraded, bytes, after);
+    printf("negotiation took %.1f ms, listing is %.1fx faster\n", negotiation, before / after);
+
+    return 0;
+}
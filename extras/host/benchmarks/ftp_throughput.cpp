@@ -0,0 +1,212 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+/*
+ * Times FTP uploads and downloads through SIMKAFI::ftpUpload() and ftpDownload() against an
+ * emulated module whose FTP client stores the file in memory, on a wire-modelled link. Both
+ * transfers are also resumed halfway, and the program exits non-zero if a file arrives
+ * different from what was sent.
+ *
+ * Usage: ftp_throughput [bytes=16384] [baud=115200]
+ */
+
+#include <SimKafi.h>
+#include <SimKafiModemEmulator.h>
+#include <SimKafiPosixSerial.h>
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+// The module's side: one remote file, the AT+FTPREST position and the read cursor.
+struct FTPServer {
+    std::string file;
+    size_t rest = 0;
+    size_t cursor = 0;
+    bool append = false;
+};
+
+struct Transfer {
+    const std::string *data;
+    size_t position;
+    unsigned long chunks;
+};
+
+static size_t produce(void *context, uint8_t *buffer, size_t size) {
+    Transfer &transfer = *static_cast<Transfer*>(context);
+    size_t length = std::min(size, transfer.data->size() - transfer.position);
+
+    memcpy(buffer, transfer.data->data() + transfer.position, length);
+    transfer.position += length;
+    return length;
+}
+
+static bool consume(void *context, const uint8_t *data, size_t length) {
+    static_cast<std::string*>(context)->append((const char*) data, length);
+    return true;
+}
+
+static void progress(void *context, uint32_t) {
+    static_cast<Transfer*>(context)->chunks++;
+}
+
+static int failures = 0;
+
+static void expect(bool condition, const char *what) {
+    if(!condition) {
+        fprintf(stderr, "[FAIL] %s\n", what);
+        failures++;
+    }
+}
+
+static double since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void report(const char *what, size_t bytes, double ms, unsigned long baud) {
+    double rate = bytes / (ms / 1000.0);
+    printf("%-16s %7zu bytes in %8.1f ms  %8.0f B/s  %5.1f%% of the wire\n", what, bytes, ms, rate,
+        100.0 * rate / (baud / 10.0));
+}
+
+int main(int argc, char **argv) {
+    size_t bytes = argc > 1 ? strtoul(argv[1], nullptr, 10) : 16384;
+    unsigned long baud = argc > 2 ? strtoul(argv[2], nullptr, 10) : 115200;
+
+    // Letters only: the emulator frames response text by lines.
+    std::string original;
+    for(size_t i = 0; i < bytes; i++)
+        original += (char) ('A' + (i * 7) % 26);
+
+    FTPServer server;
+    bool bearerOpen = false;
+
+    SIMKAFIModemEmulator modem;
+    modem.setBaudRate(baud);
+    modem.setWireModel(true);
+    modem.on("AT+SAPBR=2,1", [&](const std::string&, const std::string&) {
+        return std::string(bearerOpen ? "+SAPBR: 1,1,\"10.64.12.7\"\nOK" : "+SAPBR: 1,3,\"0.0.0.0\"\nOK");
+    });
+    modem.on("AT+SAPBR=1,1", [&](const std::string&, const std::string&) { bearerOpen = true; return std::string("OK"); });
+    modem.on("AT+FTPPUTOPT=", [&](const std::string &command, const std::string&) {
+        server.append = command.find("APPE") != std::string::npos;
+        return std::string("OK");
+    });
+    modem.on("AT+FTPPUT=1", [&](const std::string&, const std::string&) {
+        if(!server.append)
+            server.file.clear();
+        return std::string("OK\n+FTPPUT: 1,1,1360");
+    });
+    modem.onData("AT+FTPPUT=2,", [](const std::string &command, const std::string&) {
+        return "+FTPPUT: 2," + command.substr(command.rfind(',') + 1);
+    }, [&](const std::string&, const std::string &payload) {
+        server.file += payload;
+        return std::string(payload.empty() ? "OK\n+FTPPUT: 1,0" : "OK\n+FTPPUT: 1,1,1360");
+    });
+    modem.on("AT+FTPREST=", [&](const std::string &command, const std::string&) {
+        server.rest = strtoul(command.c_str() + 11, nullptr, 10);
+        return std::string("OK");
+    });
+    modem.on("AT+FTPGET=1", [&](const std::string&, const std::string&) {
+        server.cursor = std::min(server.rest, server.file.size());
+        return std::string("OK\n+FTPGET: 1,1");
+    });
+    modem.on("AT+FTPGET=2,", [&](const std::string &command, const std::string&) {
+        size_t length = std::min((size_t) strtoul(command.c_str() + 12, nullptr, 10), server.file.size() - server.cursor);
+        if(length == 0)
+            return std::string("+FTPGET: 2,0\nOK");
+
+        std::string script = "+FTPGET: 2," + std::to_string(length) + "\n" + server.file.substr(server.cursor, length) + "\nOK";
+        server.cursor += length;
+
+        // The end of the file is announced right behind the last chunk.
+        if(server.cursor == server.file.size())
+            script += "\n+FTPGET: 1,0";
+        return script;
+    });
+
+    SIMKAFIPosixSerial serial;
+    if(!modem.start() || !serial.begin(modem.devicePath(), baud)) {
+        fprintf(stderr, "cannot start the emulated modem\n");
+        return 1;
+    }
+
+    SIMKAFI simKafi(serial);
+    SIMKAFIAPN apn;
+    apn.apn = "internet";
+    simKafi.connectAPN(apn);
+
+    SIMKAFIFTPServer login;
+    login.host = "ftp.example.com";
+    login.port = 21;
+    login.username = "meter";
+    login.password = "secret";
+
+    printf("chunk size %d bytes, %lu baud\n", SIMKAFI_FTP_CHUNK, baud);
+
+    Transfer upload = { &original, 0, 0 };
+    simKafi.setFTPProgressCallback(&progress, &upload);
+
+    auto start = std::chrono::steady_clock::now();
+    SIMKAFIFTPResult result = simKafi.ftpUpload(login, "/logs/", "day.log", &produce, &upload);
+    report("upload", result.transferred, since(start), baud);
+
+    expect(bearerOpen, "bearer opened");
+    expect(result.complete && server.file == original, "uploaded file");
+    expect(upload.chunks == (bytes + SIMKAFI_FTP_CHUNK - 1) / SIMKAFI_FTP_CHUNK, "upload progress");
+
+    std::string downloaded;
+    Transfer download = { &downloaded, 0, 0 };
+    simKafi.setFTPProgressCallback(&progress, &download);
+
+    start = std::chrono::steady_clock::now();
+    result = simKafi.ftpDownload(login, "/logs/", "day.log", &consume, &downloaded);
+    report("download", result.transferred, since(start), baud);
+
+    expect(result.complete && downloaded == original, "downloaded file");
+    expect(download.chunks == (bytes + SIMKAFI_FTP_CHUNK - 1) / SIMKAFI_FTP_CHUNK, "download progress");
+
+    // Resume both directions from the middle of the file.
+    uint32_t half = (uint32_t) (bytes / 2);
+    server.file.resize(half);
+
+    Transfer rest = { &original, half, 0 };
+    simKafi.setFTPProgressCallback(nullptr, nullptr);
+
+    start = std::chrono::steady_clock::now();
+    result = simKafi.ftpUpload(login, "/logs/", "day.log", &produce, &rest, half);
+    report("resumed upload", result.transferred, since(start), baud);
+    expect(result.complete && server.file == original, "resumed upload");
+
+    downloaded.clear();
+    start = std::chrono::steady_clock::now();
+    result = simKafi.ftpDownload(login, "/logs/", "day.log", &consume, &downloaded, half);
+    report("resumed download", result.transferred, since(start), baud);
+    expect(result.complete && downloaded == original.substr(half), "resumed download");
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Aggregate SMS throughput of SIMKAFIGateway against N emulated modems, each on its
+ * own pseudo-terminal.
+ *
+ * Usage: gateway_throughput [modems=8] [messages=64] [submit-latency-ms=2000]
+ */
+
+#include <SimKafiGateway.h>
+#include <SimKafiModemEmulator.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+int main(int argc, char **argv) {
+    size_t modemCount = argc > 1 ? (size_t) atoi(argv[1]) : 8;
+    size_t messageCount = argc > 2 ? (size_t) atoi(argv[2]) : 64;
+    unsigned long submitLatency = argc > 3 ? (unsigned long) atol(argv[3]) : 2000;
+
+    std::vector<std::unique_ptr<SIMKAFIModemEmulator>> emulators;
+    SIMKAFIGateway gateway;
+    std::atomic<unsigned> reference(0);
+
+    for(size_t i = 0; i < modemCount; i++) {
+        SIMKAFIModemEmulator *modem = new SIMKAFIModemEmulator();
+        emulators.emplace_back(modem);
+
+        // The network takes a while to accept each message, as a real cell does.
+        modem->onPrompt("AT+CMGS=", [&reference, submitLatency](const std::string&, const std::string&) {
+            return "@" + std::to_string(submitLatency) +
+                "\n+CMGS: " + std::to_string(++reference % 256) + "\nOK";
+        });
+
+        if(!modem->start()) {
+            perror("openpty");
+            return 1;
+        }
+
+        gateway.addModem(modem->devicePath(), 115200);
+    }
+
+    gateway.start();
+    auto begin = std::chrono::steady_clock::now();
+
+    for(size_t i = 0; i < messageCount; i++) {
+        std::string number = "+1555000" + std::to_string(1000 + i);
+        while(!gateway.submitSMS(number.c_str(), "Gateway throughput benchmark"))
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    size_t sent = 0, failed = 0;
+    while(sent + failed < messageCount) {
+        SIMKAFIGatewayEvent event;
+
+        if(!gateway.poll(event)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        if(event.type == SIMKAFI_GATEWAY_SMS_SENT)
+            sent++;
+        else if(event.type == SIMKAFI_GATEWAY_SMS_FAILED)
+            failed++;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    gateway.stop();
+
+    printf("modems:      %zu\n", modemCount);
+    printf("messages:    %zu (%zu sent, %zu failed)\n", messageCount, sent, failed);
+    printf("elapsed:     %.2f s\n", seconds);
+    printf("throughput:  %.2f messages/s aggregate, %.3f messages/s per modem\n",
+        sent / seconds, sent / seconds / modemCount);
+
+    for(size_t i = 0; i < gateway.modemCount(); i++) {
+        SIMKAFIGatewayModemStats stats = gateway.modemStats(i);
+        printf("  modem %2zu: sent %3u failed %3u failure-rate %.2f\n",
+            i, stats.sent, stats.failed, stats.failureRate);
+    }
+
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Records a fixed SIMKAFI scenario against the modem emulator, or replays a recorded
+ * session in place of the modem and checks that the library behaves identically.
+ *
+ * Usage: replay_session record <file>
+ *        replay_session replay <file> [time-scale-percent=100]
+ *
+ * A recording stores the scenario's results as an "expect" comment; a replay fails if
+ * its results differ or if the library writes anything other than the recorded bytes.
+ */
+
+#include <SimKafi.h>
+#include <SimKafiModemEmulator.h>
+#include <SimKafiPosixSerial.h>
+#include <SimKafiRecorder.h>
+#include <SimKafiSessionFile.h>
+
+#include <chrono>
+#include <functional>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+struct Inbox {
+    std::string sms;
+
+    static void onSMS(void *context, SIMKAFIStringView sender, SIMKAFIStringView message) {
+        std::string &sms = static_cast<Inbox*>(context)->sms;
+
+        sms.assign(sender.data, sender.length);
+        sms += ':';
+        sms.append(message.data, message.length);
+        while(!sms.empty() && (sms.back() == '\r' || sms.back() == '\n'))
+            sms.pop_back();
+    }
+};
+
+static std::string scenario(Stream &stream, const std::function<void()> &deliverSMS) {
+    SIMKAFI simKafi(stream);
+    Inbox inbox;
+    simKafi.setSMSReceivedCallback(&Inbox::onSMS, &inbox);
+
+    std::string result;
+    result += "handshake=" + std::to_string(simKafi.handshake());
+    result += " rssi=" + std::to_string(simKafi.signal().rssi);
+    result += " operator=" + std::string(simKafi.networkOperator().name.c_str());
+    result += " smsCount=" + std::to_string(simKafi.getSMSCount());
+
+    deliverSMS();
+
+    unsigned long start = millis();
+    while(!stream.available() && millis() - start < 3000)
+        delay(1);
+
+    simKafi.handleSerialEvent();
+    result += " sms=" + inbox.sms;
+
+    return result;
+}
+
+static int record(const char *path) {
+    SIMKAFIModemEmulator modem;
+    modem.setResponseDelay(20);
+    modem.on("AT+CSQ", "+CSQ: 17,0\nOK");
+    modem.on("AT+COPS?", "+COPS: 0,0,\"Example Net\"\nOK");
+    modem.on("AT+CPMS?", "+CPMS: \"SM\",2,30,\"SM\",2,30,\"SM\",2,30\nOK");
+    modem.on("AT+CMGR=2", "+CMGR: \"REC UNREAD\",\"+15557654321\",\"\",\"24/01/02,08:30:00+00\"\nReplay me\nOK");
+
+    SIMKAFIPosixSerial serial;
+    if(!modem.start() || !serial.begin(modem.devicePath(), 115200)) {
+        perror("emulator");
+        return 1;
+    }
+
+    static SIMKAFIWireRecord buffer[16384];
+    SIMKAFIRecorder recorder(serial, buffer, sizeof(buffer) / sizeof(buffer[0]));
+
+    std::string result = scenario(recorder, [&modem]() {
+        modem.inject("+CMTI: \"SM\",2");
+    });
+
+    if(!SIMKAFISaveSession(recorder, path, "expect " + result)) {
+        perror(path);
+        return 1;
+    }
+
+    printf("recorded %zu bytes (%u dropped): %s\n", recorder.size(), recorder.dropped(), result.c_str());
+    return recorder.dropped() == 0 ? 0 : 1;
+}
+
+static int replay(const char *path, uint16_t timeScale) {
+    std::vector<SIMKAFIWireRecord> records;
+    std::vector<std::string> comments;
+
+    if(!SIMKAFILoadSession(path, records, &comments)) {
+        perror(path);
+        return 1;
+    }
+
+    std::string expected;
+    for(const std::string &comment : comments)
+        if(comment.compare(0, 7, "expect ") == 0)
+            expected = comment.substr(7);
+
+    SIMKAFIReplay session(records.data(), records.size(), timeScale);
+    auto begin = std::chrono::steady_clock::now();
+
+    std::string result = scenario(session, []() {});
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    printf("replayed %zu bytes at %u%% timing in %.3f s\n", records.size(), timeScale, seconds);
+    printf("result:     %s\n", result.c_str());
+    printf("expected:   %s\n", expected.c_str());
+    printf("mismatches: %u, extra writes: %u, finished: %s\n",
+        session.mismatches(), session.extraWrites(), session.finished() ? "yes" : "no");
+
+    return result == expected && session.mismatches() == 0 && session.extraWrites() == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    if(argc >= 3 && !strcmp(argv[1], "record"))
+        return record(argv[2]);
+    if(argc >= 3 && !strcmp(argv[1], "replay"))
+        return replay(argv[2], argc > 3 ? (uint16_t) atoi(argv[3]) : 100);
+
+    fprintf(stderr, "usage: %s record <file>\n       %s replay <file> [time-scale-percent]\n", argv[0], argv[0]);
+    return 2;
+}
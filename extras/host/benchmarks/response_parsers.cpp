@@ -0,0 +1,354 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Times every response parser of the library against a corpus of SIM900/SIM800 answers, well
+ * formed, malformed and truncated, and checks each result against its golden value. The answers
+ * come from an in-memory Stream, so what is measured is the library's own work per call: sending
+ * the command, reading and splitting the response, and parsing it. Waits the library would
+ * sit out (the idle gap after a URC, the timeout of an answer that never ends) are skipped by
+ * moving the host clock forward from the idle callback.
+ *
+ * Built twice: response_parsers with Arduino Strings and response_parsers_noheap with
+ * SIMKAFI_NO_HEAP. Exits non-zero if any parse differs from its golden value.
+ *
+ * The private queryResult() and rawQueryOnLine() are measured through the public methods built
+ * on them: signal(), networkOperator() and cardNumber() for the first, imei() and softwareRelease()
+ * for the second.
+ *
+ * Usage: response_parsers [iterations=20000]
+ */
+
+#include <SimKafi.h>
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *pointer, size_t size);
+extern "C" void __libc_free(void *pointer);
+
+static bool counting = false;
+static unsigned long allocations = 0;
+
+extern "C" void *malloc(size_t size) {
+    if(counting)
+        allocations++;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+    if(counting)
+        allocations++;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *pointer, size_t size) {
+    if(counting)
+        allocations++;
+    return __libc_realloc(pointer, size);
+}
+
+extern "C" void free(void *pointer) {
+    __libc_free(pointer);
+}
+
+// A captured answer to every command line starting with command.
+struct Capture {
+    const char *command;
+    const char *response;
+};
+
+/*
+ * A module that answers from captures: it echoes each command line as a module with ATE1 does,
+ * then hands out the capture for it, or "OK" if there is none. Nothing is allocated.
+ */
+class CaptureStream : public Stream {
+private:
+    const Capture *captures = nullptr;
+    size_t captureCount = 0;
+
+    char line[128];
+    size_t lineLength = 0;
+
+    // The echo, then the capture, are read out in turn.
+    const char *echo = nullptr, *answer = nullptr;
+    size_t echoLength = 0, answerLength = 0;
+
+    void answerLine() {
+        this->echo = this->line;
+        this->echoLength = this->lineLength;
+        this->answer = "\r\nOK\r\n";
+
+        for(size_t i = 0; i < this->captureCount; i++)
+            if(!strncmp(this->line, this->captures[i].command, strlen(this->captures[i].command))) {
+                this->answer = this->captures[i].response;
+                break;
+            }
+
+        this->answerLength = strlen(this->answer);
+        this->lineLength = 0;
+    }
+
+public:
+    void load(const Capture *captures, size_t count) {
+        this->captures = captures;
+        this->captureCount = count;
+        this->echoLength = this->answerLength = this->lineLength = 0;
+    }
+
+    // Bytes the module sends on its own, such as a URC.
+    void inject(const char *bytes) {
+        this->echoLength = 0;
+        this->answer = bytes;
+        this->answerLength = strlen(bytes);
+    }
+
+    int available() override {
+        return (int) (this->echoLength + this->answerLength);
+    }
+
+    int read() override {
+        if(this->echoLength > 0) {
+            this->echoLength--;
+            return (uint8_t) *this->echo++;
+        }
+        if(this->answerLength > 0) {
+            this->answerLength--;
+            return (uint8_t) *this->answer++;
+        }
+
+        return -1;
+    }
+
+    int peek() override {
+        return this->echoLength > 0 ? (uint8_t) *this->echo :
+            this->answerLength > 0 ? (uint8_t) *this->answer : -1;
+    }
+
+    size_t write(uint8_t value) override {
+        if(this->lineLength < sizeof(this->line))
+            this->line[this->lineLength++] = (char) value;
+        if(value == '\n')
+            this->answerLine();
+        return 1;
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override {
+        for(size_t i = 0; i < size; i++)
+            this->write(buffer[i]);
+        return size;
+    }
+
+    void flush() override {}
+    using Print::write;
+};
+
+// What the callbacks saw during a handleSerialEvent() case.
+struct Observed {
+    char sender[SIMKAFI_TEXT_SIZE];
+    char message[64];
+    int rings, callsEnded, detaches;
+};
+
+static Observed observed;
+
+static void onSMS(void *context, SIMKAFIStringView sender, SIMKAFIStringView message) {
+    Observed &seen = *static_cast<Observed*>(context);
+    snprintf(seen.sender, sizeof(seen.sender), "%.*s", (int) sender.length, sender.data);
+    snprintf(seen.message, sizeof(seen.message), "%.*s", (int) message.length, message.data);
+}
+
+static void onEvent(void *context, const SIMKAFIEvent &event) {
+    Observed &seen = *static_cast<Observed*>(context);
+    if(event.type == SIMKAFI_EVENT_CALL_RECEIVED)
+        seen.rings++;
+    else if(event.type == SIMKAFI_EVENT_CALL_ENDED)
+        seen.callsEnded++;
+    else if(event.type == SIMKAFI_EVENT_GPRS_DETACHED)
+        seen.detaches++;
+}
+
+// Whatever the library waits for, the wait is over at once.
+static void skipWait(void *context, uint16_t budgetMs) {
+    (void) context;
+    advanceClock(budgetMs);
+}
+
+static bool same(const SIMKAFIText &text, const char *expected) {
+    return !strcmp(text.c_str(), expected);
+}
+
+struct Case {
+    const char *parser;
+    const char *capture;
+    Capture answers[2];
+    const char *urc;
+    bool (*run)(SIMKAFI &simKafi);
+};
+
+static const Case corpus[] = {
+    { "signal", "csq", {
+        { "AT+CSQ", "\r\n+CSQ: 21,0\r\n\r\nOK\r\n" } }, nullptr,
+        [](SIMKAFI &s) { SIMKAFISignal v = s.signal(); return v.rssi == 21 && v.bit_error_rate == 0; } },
+    { "signal", "not-known", {
+        { "AT+CSQ", "\r\n+CSQ: 99,99\r\n\r\nOK\r\n" } }, nullptr,
+        [](SIMKAFI &s) { SIMKAFISignal v = s.signal(); return v.rssi == 99 && v.bit_error_rate == 99; } },
+    { "signal", "truncated", {
+        { "AT+CSQ", "\r\n+CSQ: 2\r\n\r\nOK\r\n" } }, nullptr,
+        [](SIMKAFI &s) { SIMKAFISignal v = s.signal(); return v.rssi == 0 && v.bit_error_rate == 0; } },
+    { "signal", "error", {
+        { "AT+CSQ", "\r\nERROR\r\n" } }, nullptr,
+        [](SIMKAFI &s) { SIMKAFISignal v = s.signal(); return v.rssi == 0 && v.bit_error_rate == 0; } },
+
+    { "rawQueryOnLine", "gsn", {
+        { "AT+GSN", "\r\n861234567890123\r\n\r\nOK\r\n" } }, nullptr,
+        [](SIMKAFI &s) { return same(s.imei(), "861234567890123"); } },
+    { "rawQueryOnLine", "gmr", {
+        { "AT+GMR", "\r\nRevision:1418B05SIM800L24\r\n\r\nOK\r\n" } }, nullptr,
+        [](SIMKAFI &s) { return same(s.softwareRelease(), "1418B05SIM800L24"); } },
+
+    { "networkOperator", "cops", {
+        { "AT+COPS?", "\r\n+COPS: 0,0,\"Example Net\"\r\n\r\nOK\r\n" } }, nullptr,
+        [](SIMKAFI &s) { SIMKAFIOperator v = s.networkOperator();
+            return v.mode == 0 && v.format == 0 && same(v.name, "Example Net"); } },
+    { "networkOperator", "unregistered", {
+        { "AT+COPS?", "\r\n+COPS: 0\r\n\r\nOK\r\n" } }, nullptr,
+        [](SIMKAFI &s) { SIMKAFIOperator v = s.networkOperator(); return v.mode == 0 && same(v.name, ""); } },
+
+#if SIMKAFI_ENABLE_RTC
+    { "rtc", "cclk", {
+        { "AT+CCLK?", "\r\n+CCLK: \"23/10/01,12:34:56+32\"\r\n\r\nOK\r\n" } }, nullptr,
+        [](SIMKAFI &s) { bool synced = s.syncRtc(); SIMKAFIRTC v = s.rtc();
+            return synced && v.year == 23 && v.month == 10 && v.day == 1 && v.hour == 12 &&
+                v.minute == 34 && v.gmt == 32; } },
+    { "rtc", "truncated", {
+        { "AT+CCLK?", "\r\n+CCLK: \"23/10/01,12:3\r\n\r\nOK\r\n" } }, nullptr,
+        [](SIMKAFI &s) { return !s.syncRtc(); } },
+#endif
+
+#if SIMKAFI_ENABLE_PHONEBOOK
+    { "retrievePhonebook", "cpbr", {
+        { "AT+CPBR=1", "\r\n+CPBR: 1,\"+15551234567\",145,\"Alice\"\r\n\r\nOK\r\n" } }, nullptr,
+        [](SIMKAFI &s) { SIMKAFICardAccount v = s.retrievePhonebook(1);
+            return same(v.number, "+15551234567") && v.numberType == 145 && same(v.name, "Alice"); } },
+    { "phonebookCapacity", "cpbs", {
+        { "AT+CPBS?", "\r\n+CPBS: \"SM\",12,250\r\n\r\nOK\r\n" } }, nullptr,
+        [](SIMKAFI &s) { SIMKAFIPhonebookCapacity v = s.phonebookCapacity();
+            return same(v.memoryType, "SM") && v.used == 12 && v.max == 250; } },
+#endif
+
+    { "cardNumber", "cnum", {
+        { "AT+CNUM", "\r\n+CNUM: \"\",\"+15551234567\",145,7,4\r\n\r\nOK\r\n" } }, nullptr,
+        [](SIMKAFI &s) { SIMKAFICardAccount v = s.cardNumber();
+            return same(v.name, "") && same(v.number, "+15551234567") && v.type == 145 && v.speed == 7; } },
+    { "cardNumber", "no-number", {
+        { "AT+CNUM", "\r\nOK\r\n" } }, nullptr,
+        [](SIMKAFI &s) { return same(s.cardNumber().name, ""); } },
+
+#if SIMKAFI_ENABLE_SMS
+    { "readSMS", "cmgr", {
+        { "AT+CMGR=3", "\r\n+CMGR: \"REC UNREAD\",\"+15551234567\",\"\",\"23/10/01,10:00:00+00\"\r\n"
+            "Meter 42 reading 1234\r\n\r\nOK\r\n" } }, nullptr,
+        [](SIMKAFI &s) { char sender[SIMKAFI_TEXT_SIZE], message[64];
+            return s.readSMS(3, sender, sizeof(sender), message, sizeof(message)) &&
+                !strcmp(sender, "+15551234567") && !strcmp(message, "Meter 42 reading 1234"); } },
+    { "readSMS", "empty-slot", {
+        { "AT+CMGR=3", "\r\nOK\r\n" } }, nullptr,
+        [](SIMKAFI &s) { char sender[SIMKAFI_TEXT_SIZE], message[64];
+            return !s.readSMS(3, sender, sizeof(sender), message, sizeof(message)); } },
+    { "readSMS", "no-final-code", {
+        { "AT+CMGR=3", "\r\n+CMGR: \"REC UNREAD\",\"+15551234567\",\"\",\"23/10/01,10:00:00+00\"\r\nMeter 4" } },
+        nullptr,
+        [](SIMKAFI &s) { char sender[SIMKAFI_TEXT_SIZE], message[64];
+            return !s.readSMS(3, sender, sizeof(sender), message, sizeof(message)); } },
+
+    { "getSMSCount", "cpms+cmgl", {
+        { "AT+CPMS?", "\r\n+CPMS: \"SM\",2,30,\"SM\",2,30,\"SM\",2,30\r\n\r\nOK\r\n" },
+        { "AT+CMGL=", "\r\n+CMGL: 1,\"REC UNREAD\",\"+15550000001\",\"\",\"23/10/01,09:00:00+00\"\r\nFirst\r\n"
+            "+CMGL: 2,\"REC READ\",\"+15550000002\",\"\",\"23/10/01,09:30:00+00\"\r\nSecond\r\n\r\nOK\r\n" } }, nullptr,
+        [](SIMKAFI &s) { return s.syncSMSStorage() && s.getSMSCount() == 2 && s.getUnreadSMSCount() == 1; } },
+    { "getSMSCount", "bad-storage", {
+        { "AT+CPMS?", "\r\n+CPMS: \"S\r\n\r\nOK\r\n" } }, nullptr,
+        [](SIMKAFI &s) { return !s.syncSMSStorage() && s.getSMSCount() == -1; } },
+
+    { "handleSerialEvent", "cmti", {
+        { "AT+CMGR=3", "\r\n+CMGR: \"REC UNREAD\",\"+15551234567\",\"\",\"23/10/01,10:00:00+00\"\r\n"
+            "Valve open\r\n\r\nOK\r\n" } }, "\r\n+CMTI: \"SM\",3\r\n",
+        [](SIMKAFI &s) { observed = Observed(); s.handleSerialEvent();
+            return !strcmp(observed.sender, "+15551234567") && !strcmp(observed.message, "Valve open"); } },
+#endif
+    { "handleSerialEvent", "urc-burst", {}, "\r\nRING\r\n\r\nNO CARRIER\r\n\r\n+PDP: DEACT\r\n",
+        [](SIMKAFI &s) { observed = Observed(); s.handleSerialEvent();
+            return observed.rings == 1 && observed.callsEnded == 1 && observed.detaches == 1; } },
+};
+
+int main(int argc, char **argv) {
+    long iterations = argc > 1 ? atol(argv[1]) : 20000;
+    int failures = 0;
+
+    CaptureStream stream;
+    SIMKAFI simKafi(stream);
+
+    // Line noise in the malformed captures must not send the library off to resync.
+    simKafi.setWatchdog(false);
+    simKafi.setIdleCallback(&skipWait, nullptr, 60000);
+#if SIMKAFI_ENABLE_SMS
+    simKafi.setSMSReceivedCallback(&onSMS, &observed);
+#endif
+    simKafi.setEventCallback(&onEvent, &observed);
+
+    printf("%-18s %-14s %10s %12s  %s\n", "parser", "capture", "ns/parse", "allocs/parse", "golden");
+
+    for(const Case &entry : corpus) {
+        size_t answers = entry.answers[1].command != nullptr ? 2 : entry.answers[0].command != nullptr ? 1 : 0;
+        stream.load(entry.answers, answers);
+
+        if(entry.urc != nullptr)
+            stream.inject(entry.urc);
+        bool golden = entry.run(simKafi);
+
+        allocations = 0;
+        auto start = std::chrono::steady_clock::now();
+        counting = true;
+
+        for(long i = 0; i < iterations; i++) {
+            if(entry.urc != nullptr)
+                stream.inject(entry.urc);
+            entry.run(simKafi);
+        }
+
+        counting = false;
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        printf("%-18s %-14s %10.0f %12.2f  %s\n", entry.parser, entry.capture, ns / iterations,
+            (double) allocations / iterations, golden ? "ok" : "MISMATCH");
+        if(!golden)
+            failures++;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,209 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Shows what SIMKAFIBufferedStream buys on a link with a SoftwareSerial-sized receive buffer.
+ * A thread stands in for the RX interrupt and keeps at most 64 bytes, as SoftwareSerial does;
+ * the sketch loop is busy for a few milliseconds between polls. A wire-modelled AT+CMGL
+ * listing is read once straight from that buffer and once through a ring buffer that a
+ * stand-in for a timer interrupt drains every millisecond while the sketch is busy.
+ *
+ * Usage: rx_overflow [busy-ms=10] [messages=50] [baud=115200] [ring=1024]
+ */
+
+#include <SimKafi.h>
+#include <SimKafiBufferedStream.h>
+#include <SimKafiModemEmulator.h>
+#include <SimKafiPosixSerial.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * A receive buffer of SoftwareSerial's size, filled by a thread in the background the way the
+ * pin-change interrupt fills SoftwareSerial's; bytes that find it full are lost.
+ */
+class SoftwareSerialModel : public Stream {
+private:
+    SIMKAFIPosixSerial &port;
+    uint8_t fifo[64];
+    size_t head = 0, count = 0;
+    uint32_t lostCount = 0;
+
+    std::mutex lock;
+    std::atomic<bool> running;
+    std::thread receiver;
+
+    void receive() {
+        while(this->running) {
+            if(this->port.available() <= 0)
+                continue;
+
+            uint8_t value = (uint8_t) this->port.read();
+            std::lock_guard<std::mutex> guard(this->lock);
+
+            if(this->count < sizeof(this->fifo))
+                this->fifo[(this->head + this->count++) % sizeof(this->fifo)] = value;
+            else
+                this->lostCount++;
+        }
+    }
+
+public:
+    explicit SoftwareSerialModel(SIMKAFIPosixSerial &port) : port(port), running(true) {
+        this->receiver = std::thread(&SoftwareSerialModel::receive, this);
+    }
+
+    ~SoftwareSerialModel() {
+        this->running = false;
+        this->receiver.join();
+    }
+
+    uint32_t lost() {
+        std::lock_guard<std::mutex> guard(this->lock);
+        return this->lostCount;
+    }
+
+    int available() override {
+        std::lock_guard<std::mutex> guard(this->lock);
+        return (int) this->count;
+    }
+
+    int read() override {
+        std::lock_guard<std::mutex> guard(this->lock);
+        if(this->count == 0)
+            return -1;
+
+        uint8_t value = this->fifo[this->head];
+        this->head = (this->head + 1) % sizeof(this->fifo);
+        this->count--;
+        return value;
+    }
+
+    int peek() override {
+        std::lock_guard<std::mutex> guard(this->lock);
+        return this->count == 0 ? -1 : this->fifo[this->head];
+    }
+
+    size_t write(uint8_t value) override { return this->port.write(value); }
+    size_t write(const uint8_t *buffer, size_t size) override { return this->port.write(buffer, size); }
+    void flush() override { this->port.flush(); }
+    using Print::write;
+};
+
+static std::string message(int index) {
+    return "+CMGL: " + std::to_string(index) + ",\"REC READ\",\"+15550100" + std::to_string(index % 10) +
+        "\",\"\",\"23/10/01,12:00:00+00\"\r\nMeter 42 reading " + std::to_string(1000 + index) +
+        " kWh, status nominal, next report in 15 minutes.";
+}
+
+static std::string listing(int messages) {
+    std::string script;
+
+    for(int i = 1; i <= messages; i++) {
+        std::string text = message(i);
+        script += text.replace(text.find("\r\n"), 2, "\n") + "\n";
+    }
+
+    return script + "OK";
+}
+
+// The rest of the sketch: busy for busyMs, with a timer interrupt draining the ring every millisecond.
+static void work(SIMKAFIBufferedStream *link, unsigned long busyMs) {
+    unsigned long start = millis();
+
+    while(millis() - start < busyMs) {
+        delay(1);
+        if(link != nullptr)
+            link->drain();
+    }
+}
+
+static void run(const char *name, Stream &stream, SIMKAFIBufferedStream *link, SoftwareSerialModel &port,
+    unsigned long busyMs, int messages) {
+    SIMKAFI simKafi(stream);
+    if(link != nullptr)
+        simKafi.watchOverflows(*link);
+
+    uint32_t lostBefore = port.lost();
+    auto start = std::chrono::steady_clock::now();
+
+    simKafi.startCommand("AT+CMGL=\"ALL\"");
+    SIMKAFIPoll state;
+    while((state = simKafi.pollResponse()) == SIMKAFI_POLL_WAITING)
+        work(link, busyMs);
+
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    const char *response = simKafi.polledResponse();
+
+    int intact = 0;
+    for(int i = 1; i <= messages; i++)
+        if(strstr(response, message(i).c_str()) != nullptr)
+            intact++;
+
+    printf("%-9s %s, %3d/%d messages intact, %5u bytes lost in the port, %5u dropped by the ring, "
+        "ring peak %4zu, %7.1f ms\n", name, state == SIMKAFI_POLL_ANSWERED ? "answered" : "timed out",
+        intact, messages, (unsigned) (port.lost() - lostBefore), (unsigned) simKafi.rxOverflows(),
+        link != nullptr ? link->highWater() : (size_t) 0, elapsed);
+
+    // Let anything left of a broken listing arrive and go before the next run.
+    delay(200);
+    while(stream.available() > 0)
+        stream.read();
+}
+
+int main(int argc, char **argv) {
+    unsigned long busyMs = argc > 1 ? strtoul(argv[1], nullptr, 10) : 10;
+    int messages = argc > 2 ? atoi(argv[2]) : 50;
+    unsigned long baud = argc > 3 ? strtoul(argv[3], nullptr, 10) : 115200;
+    size_t ringSize = argc > 4 ? strtoul(argv[4], nullptr, 10) : 1024;
+
+    SIMKAFIModemEmulator modem;
+    modem.setBaudRate(baud);
+    modem.setWireModel(true);
+    modem.on("AT+CMGL", listing(messages));
+
+    SIMKAFIPosixSerial serial;
+    if(!modem.start() || !serial.begin(modem.devicePath(), baud)) {
+        fprintf(stderr, "cannot start the emulated modem\n");
+        return 1;
+    }
+
+    SoftwareSerialModel port(serial);
+    std::vector<uint8_t> ring(ringSize);
+    SIMKAFIBufferedStream link(port, ring.data(), ring.size());
+
+    printf("%lu baud, %d messages, sketch busy %lu ms between polls, %zu-byte ring\n",
+        baud, messages, busyMs, ringSize);
+    run("direct", port, nullptr, port, busyMs, messages);
+    run("buffered", link, &link, port, busyMs, messages);
+
+    return 0;
+}
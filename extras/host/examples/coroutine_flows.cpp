@@ -0,0 +1,132 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Two C++20 coroutines on one thread against the modem emulator: one brings GPRS up and
+ * posts a reading, the other sends an SMS and then watches the signal. Both are polled
+ * from the same loop and suspend at every modem wait instead of blocking it.
+ */
+
+#include <SimKafi.h>
+#include <SimKafiModemEmulator.h>
+#include <SimKafiPosixSerial.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#if !SIMKAFI_COROUTINES
+#error "coroutine_flows needs a compiler with C++20 coroutines"
+#endif
+
+static int failures = 0;
+
+static void expect(bool condition, const char *what) {
+    printf("%s %s\n", condition ? "[ OK ]" : "[FAIL]", what);
+    if(!condition)
+        failures++;
+}
+
+static SIMKAFICoroutine postReading(SIMKAFI &simKafi, bool &posted) {
+    SIMKAFITask task = {};
+    SIMKAFIAPN apn;
+    apn.apn = "internet";
+
+    if(co_await SIMKAFIAwait([&] { return simKafi.connectGPRS(task, apn); }) != SIMKAFI_TASK_DONE)
+        co_return;
+
+    SIMKAFIHTTPRequest request;
+    request.method = "POST";
+    request.domain = "example.com";
+    request.resource = "/level";
+    request.data = "level=42";
+    request.port = 80;
+    request.headers = nullptr;
+    request.header_count = 0;
+
+    posted = co_await SIMKAFIAwait([&] { return simKafi.request(task, request); }) == SIMKAFI_TASK_DONE;
+}
+
+static SIMKAFICoroutine notifyAndWatch(SIMKAFI &simKafi, bool &notified, int &readings) {
+    SIMKAFITask task = {};
+    notified = co_await SIMKAFIAwait([&] {
+        return simKafi.sendSMS(task, "+15557654321", "Pump started");
+    }) == SIMKAFI_TASK_DONE;
+
+    while(readings < 3) {
+        co_await SIMKAFIAwait([&] {
+            return simKafi.lockLink(&task) ? SIMKAFI_TASK_DONE : SIMKAFI_TASK_RUNNING;
+        });
+
+        simKafi.startCommand("AT+CSQ");
+        co_await SIMKAFIAwait([&] {
+            return simKafi.pollResponse() == SIMKAFI_POLL_WAITING ? SIMKAFI_TASK_RUNNING : SIMKAFI_TASK_DONE;
+        });
+
+        if(strstr(simKafi.polledResponse(), "+CSQ:") != nullptr)
+            readings++;
+        simKafi.unlockLink(&task);
+    }
+}
+
+int main() {
+    SIMKAFIModemEmulator modem;
+    modem.on("AT+CSQ", "+CSQ: 21,0\nOK");
+    modem.on("AT+CDNSGIP=", "OK\n+CDNSGIP: 1,\"example.com\",\"93.184.216.34\"");
+    modem.on("AT+CIPSTART=", "OK\nCONNECT OK");
+    modem.onPrompt("AT+CMGS=", "+CMGS: 8\nOK");
+    modem.onPrompt("AT+CIPSEND=", "SEND OK");
+    modem.setResponseDelay(20);
+
+    if(!modem.start()) {
+        perror("openpty");
+        return 1;
+    }
+
+    SIMKAFIPosixSerial serial;
+    if(!serial.begin(modem.devicePath(), 115200)) {
+        perror(modem.devicePath());
+        return 1;
+    }
+
+    SIMKAFI simKafi(serial);
+    bool posted = false, notified = false;
+    int readings = 0;
+
+    SIMKAFICoroutine upload = postReading(simKafi, posted);
+    SIMKAFICoroutine watch = notifyAndWatch(simKafi, notified, readings);
+
+    unsigned long loops = 0, start = millis();
+    while((!upload.done() || !watch.done()) && millis() - start < 10000) {
+        upload.poll();
+        watch.poll();
+        loops++;
+    }
+
+    printf("%lu polls for %zu commands in %lu ms\n", loops, modem.commands().size(), millis() - start);
+
+    expect(posted, "GPRS up and reading posted");
+    expect(notified && readings == 3, "SMS sent and signal watched");
+    expect(loops > 10 * modem.commands().size(), "neither coroutine blocked the loop");
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,647 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Drives SIMKAFI over a pseudo-terminal against the scripted modem emulator:
+ * queries, a diagnostics snapshot, the SMS storage mirror, an incoming SMS, a call-ended URC, GPRS bearer
+ * failover and reconnect, DNS caching, a streamed HTTP upload, the local clock, recovery from a module that stops answering,
+ * and a buffered receive link with RTS flow control. Exits
+ * non-zero on any mismatch, so it doubles as a hardware-free check of the POSIX backend.
+ */
+
+#include <SimKafi.h>
+#include <SimKafiBufferedStream.h>
+#include <SimKafiModemEmulator.h>
+#include <SimKafiPosixSerial.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+struct Inbox {
+    std::string sender, message;
+    int callsEnded = 0;
+    int linksRestored = 0;
+    int bearersUp = 0;
+    int bearersDown = 0;
+    std::vector<SIMKAFICallState> callStates;
+    SIMKAFICallEnd callEnd = SIMKAFI_CALL_END_NONE;
+    uint32_t callDuration = 0;
+
+    void onSMS(SIMKAFIStringView from, SIMKAFIStringView body) {
+        this->sender.assign(from.data, from.length);
+        this->message.assign(body.data, body.length);
+    }
+
+    void onEvent(const SIMKAFIEvent &event) {
+        if(event.type == SIMKAFI_EVENT_CALL_ENDED)
+            this->callsEnded++;
+        else if(event.type == SIMKAFI_EVENT_LINK_RESTORED)
+            this->linksRestored++;
+        else if(event.type == SIMKAFI_EVENT_BEARER_UP)
+            this->bearersUp++;
+        else if(event.type == SIMKAFI_EVENT_BEARER_DOWN)
+            this->bearersDown++;
+        else if(event.type == SIMKAFI_EVENT_CALL_STATE) {
+            this->callStates.push_back(event.call->state);
+            this->callEnd = event.call->cause;
+            this->callDuration = event.call->duration;
+        }
+    }
+};
+
+static int failures = 0;
+
+// Stands in for a PWRKEY pulse: the emulated module comes back to life.
+static void powerCycle(void *context) {
+    static_cast<SIMKAFIModemEmulator*>(context)->setSilent(false);
+}
+
+static void expect(bool condition, const char *what) {
+    printf("%s %s\n", condition ? "[ OK ]" : "[FAIL]", what);
+    if(!condition)
+        failures++;
+}
+
+// Makes up a sensor log one buffer at a time, as a sketch reading it from an SD card would.
+static size_t produceLog(void *context, uint8_t *buffer, size_t size) {
+    uint32_t &produced = *static_cast<uint32_t*>(context);
+
+    for(size_t i = 0; i < size; i++)
+        buffer[i] = (uint8_t) ('a' + produced++ % 26);
+    return size;
+}
+
+static void collectSMS(void *context, SIMKAFIStringView /*sender*/, SIMKAFIStringView message) {
+    static_cast<std::vector<std::string>*>(context)->push_back(std::string(message.data, message.length));
+}
+
+// Hands whatever the module reported to the library, as loop() does.
+static void pump(SIMKAFI &simKafi, SIMKAFIPosixSerial &serial) {
+    serial.waitReadable(1000);
+    simKafi.handleSerialEvent();
+}
+
+static bool serviceUntilUp(SIMKAFI &simKafi, unsigned long timeout) {
+    unsigned long start = millis();
+
+    while(!simKafi.isBearerUp() && millis() - start < timeout) {
+        simKafi.serviceBearer();
+        delay(10);
+    }
+
+    return simKafi.isBearerUp();
+}
+
+// Stands in for the button scanning or watchdog feeding a sketch does while the modem is busy.
+static void countIdle(void *context, uint16_t budgetMs) {
+    std::vector<uint16_t> &budgets = *static_cast<std::vector<uint16_t>*>(context);
+    budgets.push_back(budgetMs);
+}
+
+// Stands in for the RTS pin, recording every level it is driven to.
+static void driveRTS(void *context, bool ready) {
+    static_cast<std::vector<bool>*>(context)->push_back(ready);
+}
+
+// Reads the signal whenever the link is free, as a second flow next to whatever else runs.
+static SIMKAFITaskState monitorSignal(SIMKAFI &simKafi, SIMKAFITask &task, int &readings) {
+    SIMKAFI_TASK_BEGIN(task);
+
+    for(;;) {
+        SIMKAFI_TASK_WAIT_UNTIL(task, simKafi.lockLink(&task));
+        simKafi.startCommand("AT+CSQ");
+        SIMKAFI_TASK_WAIT_UNTIL(task, simKafi.pollResponse() != SIMKAFI_POLL_WAITING);
+
+        if(strstr(simKafi.polledResponse(), "+CSQ: 21,0") != nullptr)
+            readings++;
+
+        simKafi.unlockLink(&task);
+        SIMKAFI_TASK_YIELD(task);
+    }
+
+    SIMKAFI_TASK_END(task);
+}
+
+int main() {
+    SIMKAFIModemEmulator modem;
+    modem.on("AT+CSQ", "+CSQ: 21,0\nOK");
+    modem.on("AT+GSN", "861234567890123\nOK");
+    modem.on("AT+CPMS=\"SM\"", "+CPMS: 2,30,2,30,2,30\nOK");
+    modem.on("AT+CPMS?", "+CPMS: \"SM\",2,30,\"SM\",2,30,\"SM\",2,30\nOK");
+    modem.on("AT+CMGL=\"ALL\",1",
+        "+CMGL: 1,\"REC UNREAD\",\"+15550000001\",\"\",\"23/10/01,09:00:00+00\"\nFirst\n"
+        "+CMGL: 2,\"REC READ\",\"+15550000002\",\"\",\"23/10/01,09:30:00+00\"\nSecond\nOK");
+    modem.on("AT+CMGR=3", "+CMGR: \"REC UNREAD\",\"+15551234567\",\"\",\"23/10/01,10:00:00+00\"\nHello gateway\nOK");
+
+    // The module's IP state machine, as far as AT+CIPSTATUS reports it; "bad.apn" is refused.
+    std::string ipState = "IP INITIAL";
+    modem.on("AT+CIPSTATUS", [&](const std::string&, const std::string&) { return "OK\nSTATE: " + ipState; });
+    modem.on("AT+CGATT=1", "OK");
+    modem.on("AT+CSTT=", [&](const std::string &command, const std::string&) -> std::string {
+        if(command.find("bad.apn") != std::string::npos)
+            return "ERROR";
+        ipState = "IP START";
+        return "OK";
+    });
+    modem.on("AT+CIICR", [&](const std::string&, const std::string&) { ipState = "IP GPRSACT"; return std::string("OK"); });
+    modem.on("AT+CIFSR", [&](const std::string&, const std::string&) { ipState = "IP STATUS"; return std::string("10.64.12.7"); });
+    modem.on("AT+CIPSHUT", [&](const std::string&, const std::string&) { ipState = "IP INITIAL"; return std::string("SHUT OK"); });
+    modem.on("AT+CDNSGIP=\"example.com\"", "OK\n+CDNSGIP: 1,\"example.com\",\"93.184.216.34\"");
+    modem.on("AT+CDNSGIP=", "OK\n+CDNSGIP: 0,8");
+    modem.on("AT+CDNSGIP=\"slow.example.com\"", "OK\n@1200\n+CDNSGIP: 1,\"slow.example.com\",\"1.2.3.4\"");
+    modem.on("AT+CDNSGIP=\"lost.example.com\"", "OK");
+    // Both names share an FNV-1a hash.
+    modem.on("AT+CDNSGIP=\"h84337.test\"", "OK\n+CDNSGIP: 1,\"h84337.test\",\"10.0.0.1\"");
+    modem.on("AT+CDNSGIP=\"h1340180.test\"", "OK\n+CDNSGIP: 1,\"h1340180.test\",\"10.0.0.2\"");
+    modem.on("AT+CIPSTART=", "OK\nCONNECT OK");
+
+    modem.on("AT+CREG?", "+CREG: 0,1\nOK");
+    modem.on("AT+CGREG?", "+CGREG: 0,5\nOK");
+    modem.on("AT+COPS?", "+COPS: 0,0,\"Example Net\"\nOK");
+    modem.on("AT+CENG?", "+CENG: 1,1\n"
+        "+CENG: 0,\"0032,45,00,310,26,39,1a2b,10,05,3c4d,1\"\n"
+        "+CENG: 1,\"0024,30,21,0f0e,310,26,3c4d\"\n"
+        "+CENG: 2,\"0051,22,17,0abc,310,26,3c4e\"\n"
+        "+CENG: 3,\"0000,00,00,0000,000,00,0000\"\nOK");
+    modem.on("AT+CCLK?", "+CCLK: \"23/10/01,12:00:00+32\"\nOK");
+    modem.onPrompt("AT+CMGS=", "+CMGS: 8\nOK");
+
+    std::string uploaded;
+    modem.onPrompt("AT+CIPSEND=", [&](const std::string&, const std::string &payload) {
+        uploaded += payload;
+        return std::string("SEND OK");
+    });
+
+    if(!modem.start()) {
+        perror("openpty");
+        return 1;
+    }
+
+    SIMKAFIPosixSerial serial;
+    if(!serial.begin(modem.devicePath(), 115200)) {
+        perror(modem.devicePath());
+        return 1;
+    }
+
+    SIMKAFI simKafi(serial);
+    Inbox inbox;
+    simKafi.setSMSReceivedCallback<Inbox, &Inbox::onSMS>(&inbox);
+    simKafi.setEventCallback<Inbox, &Inbox::onEvent>(&inbox);
+
+    expect(simKafi.handshake(), "handshake");
+    expect(simKafi.signal().rssi == 21, "signal rssi");
+    expect(simKafi.imei().startsWith("861234567890123"), "imei");
+
+    // A slow answer leaves the waits to the idle callback, never more than its budget at a time.
+    std::vector<uint16_t> budgets;
+    modem.setResponseDelay(30);
+    simKafi.setIdleCallback(&countIdle, &budgets, 3);
+    expect(simKafi.signal().rssi == 21 && budgets.size() > 5 &&
+        *std::max_element(budgets.begin(), budgets.end()) <= 3, "idle callback during a wait");
+    simKafi.setIdleCallback(nullptr, nullptr);
+    modem.setResponseDelay(0);
+
+    expect(simKafi.selectSMSStorage(SIMKAFI_SMS_STORAGE_SM), "SMS storage selected");
+    SIMKAFISMSStorageStatus storage = simKafi.smsStorage();
+    expect(storage.valid && storage.used == 2 && storage.unread == 1 && storage.capacity == 30,
+        "SMS storage mirror");
+
+    modem.inject("+CMTI: \"SM\",3");
+    serial.waitReadable(1000);
+    simKafi.handleSerialEvent();
+    expect(inbox.sender == "+15551234567", "SMS sender view");
+    expect(inbox.message.compare(0, 13, "Hello gateway") == 0, "SMS body view");
+
+    size_t sent = modem.commands().size();
+    expect(simKafi.getSMSCount() == 3 && simKafi.getUnreadSMSCount() == 1 &&
+        simKafi.nextUnreadSMS() == 1 && modem.commands().size() == sent, "SMS counts without round trips");
+    expect(simKafi.deleteAllReadSMS() && modem.commands().back() == "AT+CMGD=1,1" &&
+        simKafi.getSMSCount() == 1, "read SMS purged in bulk");
+
+    // A message past the mirrored slots leaves the counts unknown instead of short.
+    modem.on("AT+CPMS?", "+CPMS: \"SM\",3,100,\"SM\",3,100,\"SM\",3,100\nOK");
+    modem.on("AT+CMGL=\"ALL\",1",
+        "+CMGL: 1,\"REC UNREAD\",\"+15550000001\",\"\",\"23/10/01,09:00:00+00\"\nFirst\n"
+        "+CMGL: 70,\"REC READ\",\"+15550000003\",\"\",\"23/10/01,11:00:00+00\"\nThird\nOK");
+    expect(!simKafi.syncSMSStorage() && !simKafi.smsStorage().valid && simKafi.smsStorage().capacity == 100 &&
+        simKafi.getSMSCount() == -1, "SMS above the mirrored slots");
+
+    modem.on("AT+CPMS?", "+CPMS: \"SM\",2,30,\"SM\",2,30,\"SM\",2,30\nOK");
+    modem.on("AT+CMGL=\"ALL\",1",
+        "+CMGL: 1,\"REC UNREAD\",\"+15550000001\",\"\",\"23/10/01,09:00:00+00\"\nFirst\n"
+        "+CMGL: 2,\"REC READ\",\"+15550000002\",\"\",\"23/10/01,09:30:00+00\"\nSecond\nOK");
+
+    // Storage full of unread messages: one purge finds nothing to delete, and it is not tried again.
+    SIMKAFIPurgePolicy purgeWhenFull = { 100, SIMKAFI_PURGE_READ };
+    simKafi.setSMSPurgePolicy(purgeWhenFull);
+    modem.on("AT+CPMS?", "+CPMS: \"SM\",2,2,\"SM\",2,2,\"SM\",2,2\nOK");
+    modem.on("AT+CMGL=\"ALL\",1",
+        "+CMGL: 1,\"REC UNREAD\",\"+15550000001\",\"\",\"23/10/01,09:00:00+00\"\nFirst\n"
+        "+CMGL: 2,\"REC UNREAD\",\"+15550000002\",\"\",\"23/10/01,09:30:00+00\"\nSecond\nOK");
+    modem.clearCommands();
+    bool synced = simKafi.syncSMSStorage() && simKafi.syncSMSStorage();
+    std::vector<std::string> purges = modem.commands();
+    expect(synced && std::count(purges.begin(), purges.end(), "AT+CMGD=1,1") == 1, "futile purge not repeated");
+
+    SIMKAFIPurgePolicy purgeNever = { 0, SIMKAFI_PURGE_READ };
+    simKafi.setSMSPurgePolicy(purgeNever);
+    expect(simKafi.syncSMSStorage() && simKafi.getSMSCount() == 2, "SMS mirror back in range");
+
+    modem.inject("NO CARRIER");
+    serial.waitReadable(1000);
+    simKafi.handleSerialEvent();
+    expect(inbox.callsEnded == 1, "call ended event");
+
+    // The first APN keeps failing, so the bearer comes up on the second one.
+    SIMKAFIAPN profiles[2];
+    profiles[0].apn = "bad.apn";
+    profiles[1].apn = "internet";
+    simKafi.setAPNProfiles(profiles, 2);
+    simKafi.bearerUp();
+
+    expect(serviceUntilUp(simKafi, 15000) && simKafi.activeAPNProfile() == 1 &&
+        !strcmp(simKafi.bearerAddress(), "10.64.12.7") && inbox.bearersUp == 1, "bearer up on the second APN");
+
+    sent = modem.commands().size();
+    expect(simKafi.ipAddress() == "10.64.12.7" && modem.commands().size() == sent, "IP address cached");
+
+    ipState = "PDP DEACT";
+    modem.inject("+PDP: DEACT");
+    serial.waitReadable(1000);
+    simKafi.handleSerialEvent();
+    expect(!simKafi.isBearerUp() && inbox.bearersDown == 1, "bearer down on PDP DEACT");
+
+    // A dropped context is not a failed attempt, so the reconnect starts without a backoff.
+    unsigned long reconnectStart = millis();
+    expect(serviceUntilUp(simKafi, 15000) && millis() - reconnectStart < SIMKAFI_BEARER_BACKOFF_MIN &&
+        inbox.bearersUp == 2, "bearer reconnected");
+
+    // The second lookup of a name is answered from the cache; a failed one is remembered too.
+    char address[16];
+    sent = modem.commands().size();
+    expect(simKafi.resolve("example.com", address, sizeof(address)) && !strcmp(address, "93.184.216.34") &&
+        modem.commands().size() == sent + 1, "DNS lookup");
+    expect(simKafi.resolve("Example.com", address, sizeof(address)) && modem.commands().size() == sent + 1 &&
+        simKafi.dnsStats().hits == 1 && simKafi.dnsStats().misses == 1, "DNS cache hit");
+    expect(!simKafi.resolve("nx.invalid", address, sizeof(address)) &&
+        !simKafi.resolve("nx.invalid", address, sizeof(address)) && modem.commands().size() == sent + 2 &&
+        simKafi.dnsStats().failures == 1, "DNS failure cached");
+    simKafi.flushDNSCache();
+    expect(simKafi.resolve("example.com", address, sizeof(address)) && modem.commands().size() == sent + 3,
+        "DNS cache flushed");
+
+    // The answer is awaited with the DATA_CONNECT timeout; one that never comes is not remembered.
+    SIMKAFITimeoutPolicy dataConnect = simKafi.timeoutPolicy(SIMKAFI_COMMAND_CLASS_DATA_CONNECT);
+    simKafi.setTimeoutPolicy(SIMKAFI_COMMAND_CLASS_DATA_CONNECT, {1500, 1500, 1500, 1});
+    expect(simKafi.resolve("slow.example.com", address, sizeof(address)) && !strcmp(address, "1.2.3.4"),
+        "slow DNS lookup");
+    simKafi.setTimeoutPolicy(SIMKAFI_COMMAND_CLASS_DATA_CONNECT, {200, 200, 200, 1});
+    sent = modem.commands().size();
+    expect(!simKafi.resolve("lost.example.com", address, sizeof(address)) &&
+        !simKafi.resolve("lost.example.com", address, sizeof(address)) && modem.commands().size() == sent + 2,
+        "DNS timeout not cached");
+    expect(simKafi.resolve("h84337.test", address, sizeof(address)) && !strcmp(address, "10.0.0.1") &&
+        simKafi.resolve("h1340180.test", address, sizeof(address)) && !strcmp(address, "10.0.0.2") &&
+        simKafi.resolve("h84337.test", address, sizeof(address)) && !strcmp(address, "10.0.0.1"),
+        "DNS hash collision");
+    simKafi.setTimeoutPolicy(SIMKAFI_COMMAND_CLASS_DATA_CONNECT, dataConnect);
+
+    // The body never exists in one piece; it leaves in AT+CIPSEND chunks as it is produced.
+    SIMKAFIHTTPHeader header;
+    header.key = "Content-Type";
+    header.value = "text/plain";
+
+    SIMKAFIHTTPRequest upload;
+    upload.method = "POST";
+    upload.domain = "example.com";
+    upload.resource = "/log";
+    upload.port = 80;
+    upload.headers = &header;
+    upload.header_count = 1;
+
+    uint32_t produced = 0;
+    modem.clearCommands();
+    SIMKAFIHTTPResponse streamed = simKafi.request(upload, &produceLog, &produced, 1000);
+
+    std::vector<std::string> sends = modem.commands();
+    std::string head = "POST /log HTTP/1.0\r\nHost: example.com\r\nContent-Type: text/plain\r\n"
+        "Content-Length: 1000\r\n\r\n";
+    expect(!sends.empty() && sends[0] == "AT+CIPSTART=\"TCP\",\"93.184.216.34\",80", "connect by address");
+    expect(produced == 1000 && uploaded.size() == head.size() + 1000 && uploaded.compare(0, head.size(), head) == 0 &&
+        uploaded.back() == 'a' + 999 % 26 && sends.size() == 1 + (uploaded.size() + SIMKAFI_CIPSEND_CHUNK - 1) /
+        SIMKAFI_CIPSEND_CHUNK && streamed.status == SIMKAFI_HTTP_STATUS_SENT, "streamed HTTP upload");
+
+    // An SMS and a signal monitor share the link from one poll loop; neither blocks the other.
+    SIMKAFITask smsTask = {}, monitorTask = {};
+    SIMKAFITaskState smsState = SIMKAFI_TASK_RUNNING;
+    int readings = 0;
+    unsigned long loops = 0;
+
+    modem.clearCommands();
+    modem.setResponseDelay(20);
+    for(unsigned long start = millis(); (smsState == SIMKAFI_TASK_RUNNING || readings < 2) &&
+        millis() - start < 5000; loops++) {
+        monitorSignal(simKafi, monitorTask, readings);
+        if(smsState == SIMKAFI_TASK_RUNNING)
+            smsState = simKafi.sendSMS(smsTask, "+15557654321", "Pump started");
+    }
+
+    modem.setResponseDelay(0);
+    sends = modem.commands();
+    size_t submitted = std::find(sends.begin(), sends.end(), "AT+CMGS=\"+15557654321\"") - sends.begin();
+    expect(smsState == SIMKAFI_TASK_DONE && readings >= 2 && submitted < sends.size() &&
+        sends.front() == "AT+CSQ" && sends.back() == "AT+CSQ" && loops > 10 * sends.size(), "interleaved flows");
+
+    // A message arriving mid-flow is fetched once the flow lets go of the link, not typed into its prompt.
+    SIMKAFITask alertTask = {};
+    SIMKAFITaskState alertState = SIMKAFI_TASK_RUNNING;
+    bool fetchedEarly = false;
+    inbox.sender.clear();
+    inbox.message.clear();
+
+    modem.onPrompt("AT+CMGS=", "+CMTI: \"SM\",3\n@50\n+CMGS: 9\nOK");
+    modem.clearCommands();
+    for(unsigned long start = millis(); alertState == SIMKAFI_TASK_RUNNING && millis() - start < 5000; ) {
+        alertState = simKafi.sendSMS(alertTask, "+15557654321", "Pump stopped");
+        simKafi.handleSerialEvent();
+
+        if(alertState == SIMKAFI_TASK_RUNNING)
+            for(const std::string &command : modem.commands())
+                fetchedEarly = fetchedEarly || command.compare(0, 7, "AT+CMGR") == 0;
+    }
+
+    if(inbox.sender.empty())
+        simKafi.handleSerialEvent();
+    modem.onPrompt("AT+CMGS=", "+CMGS: 8\nOK");
+
+    expect(alertState == SIMKAFI_TASK_DONE && !fetchedEarly && inbox.sender == "+15551234567" &&
+        inbox.message.compare(0, 13, "Hello gateway") == 0, "SMS indication waits for the flow");
+
+    // A draft saved after a flash message is stored with the regular parameters again.
+    modem.onPrompt("AT+CMGW=", "+CMGW: 5\nOK");
+    modem.clearCommands();
+    expect(simKafi.sendFlashSMS("+15557654321", "Door open") && simKafi.saveDraft("+15557654321", "Door closed"),
+        "flash message and draft");
+
+    std::vector<std::string> drafted = { "AT+CSMP=49,167,0,240", "AT+CMGS=\"+15557654321\"",
+        "AT+CSMP=17,167,0,0", "AT+CMGW=\"+15557654321\"" };
+    expect(modem.commands() == drafted, "draft after a flash message");
+
+    // The same request again as a flow; each chunk is rendered from the request when it goes out.
+    SIMKAFITask requestTask = {};
+    upload.data = "level=42";
+    uploaded.clear();
+    modem.clearCommands();
+
+    SIMKAFITaskState requestState;
+    while((requestState = simKafi.request(requestTask, upload)) == SIMKAFI_TASK_RUNNING)
+        delay(1);
+
+    head = "POST /log HTTP/1.0\r\nHost: example.com\r\nContent-Type: text/plain\r\n"
+        "Content-Length: 8\r\n\r\nlevel=42";
+    expect(requestState == SIMKAFI_TASK_DONE && uploaded == head && !modem.commands().empty() &&
+        modem.commands()[0] == "AT+CIPSTART=\"TCP\",\"93.184.216.34\",80", "resumable HTTP request");
+
+    // A bulk scan of the inbox lets an urgent hang-up go between two of its messages.
+    modem.on("AT+CMGR=1,1", "+CMGR: \"REC UNREAD\",\"+15550000001\",\"\",\"23/10/01,09:00:00+00\"\nFirst\nOK");
+    modem.on("AT+CMGR=2,1", "+CMGR: \"REC READ\",\"+15550000002\",\"\",\"23/10/01,09:30:00+00\"\nSecond\nOK");
+    expect(simKafi.syncSMSStorage(), "SMS storage mirrored");
+
+    SIMKAFITask scanTask = {}, alarmTask = {}, lateTask = {};
+    scanTask.priority = SIMKAFI_PRIORITY_BULK;
+    alarmTask.priority = SIMKAFI_PRIORITY_URGENT;
+    alarmTask.deadline = 500;
+    lateTask.deadline = 1;
+
+    std::vector<std::string> scanned;
+    modem.clearCommands();
+    modem.setResponseDelay(20);
+
+    SIMKAFITaskState scanState = simKafi.scanSMS(scanTask, &collectSMS, &scanned);
+    SIMKAFITaskState alarmState = simKafi.hangUp(alarmTask);
+    SIMKAFITaskState lateState = simKafi.runCommand(lateTask, "AT");
+    for(unsigned long start = millis(); (scanState == SIMKAFI_TASK_RUNNING || alarmState == SIMKAFI_TASK_RUNNING ||
+        lateState == SIMKAFI_TASK_RUNNING) && millis() - start < 5000; ) {
+        if(scanState == SIMKAFI_TASK_RUNNING)
+            scanState = simKafi.scanSMS(scanTask, &collectSMS, &scanned);
+        if(lateState == SIMKAFI_TASK_RUNNING)
+            lateState = simKafi.runCommand(lateTask, "AT");
+        if(alarmState == SIMKAFI_TASK_RUNNING)
+            alarmState = simKafi.hangUp(alarmTask);
+    }
+
+    modem.setResponseDelay(0);
+    std::vector<std::string> order = { "AT+CMGR=1,1", "ATH", "AT", "AT+CMGR=2,1" };
+    expect(scanState == SIMKAFI_TASK_DONE && alarmState == SIMKAFI_TASK_DONE && lateState == SIMKAFI_TASK_DONE &&
+        scanned.size() == 2 && scanned[0] == "First" && scanned[1] == "Second" && modem.commands() == order,
+        "bulk scan preempted by priority");
+
+    // Behind a busy link, equal priorities go by deadline, and without deadlines by who asked first.
+    SIMKAFITask holder = {}, relaxed = {}, pressing = {}, first = {}, second = {};
+    relaxed.deadline = 2000;
+    pressing.deadline = 200;
+
+    modem.clearCommands();
+    modem.setResponseDelay(20);
+
+    SIMKAFITaskState holderState = simKafi.runCommand(holder, "AT");
+    SIMKAFITaskState relaxedState = simKafi.runCommand(relaxed, "AT+GSN");
+    delay(2);
+    SIMKAFITaskState pressingState = simKafi.runCommand(pressing, "AT+CSQ");
+    SIMKAFITaskState firstState = simKafi.runCommand(first, "AT+CREG?");
+    delay(2);
+    SIMKAFITaskState secondState = simKafi.runCommand(second, "AT+COPS?");
+
+    for(unsigned long start = millis(); millis() - start < 5000 && (holderState == SIMKAFI_TASK_RUNNING ||
+        relaxedState == SIMKAFI_TASK_RUNNING || pressingState == SIMKAFI_TASK_RUNNING ||
+        firstState == SIMKAFI_TASK_RUNNING || secondState == SIMKAFI_TASK_RUNNING); ) {
+        // Polled newest first, so the order below comes from the line, not from the loop.
+        if(secondState == SIMKAFI_TASK_RUNNING)
+            secondState = simKafi.runCommand(second, "AT+COPS?");
+        if(firstState == SIMKAFI_TASK_RUNNING)
+            firstState = simKafi.runCommand(first, "AT+CREG?");
+        if(pressingState == SIMKAFI_TASK_RUNNING)
+            pressingState = simKafi.runCommand(pressing, "AT+CSQ");
+        if(relaxedState == SIMKAFI_TASK_RUNNING)
+            relaxedState = simKafi.runCommand(relaxed, "AT+GSN");
+        if(holderState == SIMKAFI_TASK_RUNNING)
+            holderState = simKafi.runCommand(holder, "AT");
+    }
+
+    modem.setResponseDelay(0);
+    order = { "AT", "AT+CSQ", "AT+GSN", "AT+CREG?", "AT+COPS?" };
+    expect(modem.commands() == order, "earliest deadline first, then first come");
+
+#if SIMKAFI_ENABLE_STATS
+    expect(simKafi.stats().preemptions == 1 && simKafi.stats().deadlineMisses == 1 &&
+        simKafi.stats().urgentWaitMaxMs < 500, "deadline misses counted");
+#endif
+
+    // Everything in one command line, parsed as it arrives.
+    SIMKAFIDiagnostics snapshot;
+    size_t lines = modem.commandLineCount();
+    expect(simKafi.diagnostics(snapshot) && modem.commandLineCount() == lines + 1 &&
+        snapshot.signal.rssi == 21 && snapshot.registration == 1 && snapshot.gprsRegistration == 5 &&
+        !strcmp(snapshot.operatorName, "Example Net") && snapshot.serving.arfcn == 32 &&
+        snapshot.serving.mcc == 310 && snapshot.serving.cellId == 0x1a2b && snapshot.serving.lac == 0x3c4d &&
+        snapshot.neighborCount == 2 && snapshot.neighbors[1].arfcn == 51 && snapshot.neighbors[1].rxLevel == 22 &&
+        snapshot.neighbors[1].cellId == 0x0abc, "diagnostics snapshot");
+    std::vector<std::string> before = modem.commands();
+    expect(simKafi.diagnostics(snapshot) && modem.commands().size() == before.size() + 5 &&
+        modem.commands()[before.size()] == "AT+CSQ", "engineering mode kept");
+
+    // The clock is read from the module once, then kept locally; network reports move it.
+    SIMKAFIRTC now = simKafi.rtc();
+    sent = modem.commands().size();
+    SIMKAFIRTC later = simKafi.rtc();
+    expect(now.year == 23 && now.month == 10 && now.day == 1 && now.hour == 12 && now.gmt == 32 &&
+        later.hour == 12 && modem.commands().size() == sent, "local clock");
+
+    expect(simKafi.setNetworkTime(true) && simKafi.setNetworkTime(true) &&
+        modem.commands().size() == sent + 1 && modem.commands().back() == "AT+CLTS=1", "network time");
+
+    modem.inject("*PSUTTZ: 2024,2,29,23,59,50,\"+32\",0");
+    serial.waitReadable(1000);
+    simKafi.handleSerialEvent();
+    now = simKafi.rtc();
+    expect(now.year == 24 && now.month == 3 && now.day == 1 && now.hour == 7 && now.minute == 59 &&
+        modem.commands().size() == sent + 1, "clock set from the network");
+
+    expect(simKafi.setFlowControl(true) && modem.commands().back() == "AT+IFC=2,2", "flow control");
+
+    // The watchdog notices the silence, resets the module and applies the SMS settings again.
+    expect(simKafi.sendCNMICommand(2, 1, 0, 0, 0), "CNMI");
+    simKafi.setResetCallback(&powerCycle, &modem);
+    modem.setSilent(true);
+
+    for(int i = 0; i < SIMKAFI_WATCHDOG_TIMEOUTS && inbox.linksRestored == 0; i++)
+        simKafi.signal();
+
+    expect(inbox.linksRestored == 1, "link restored event");
+    std::vector<std::string> applied = modem.commands();
+    expect(applied.size() >= 4 && applied[applied.size() - 4] == "AT+CNMI=2,1,0,0,0" &&
+        applied[applied.size() - 3] == "AT+CPMS=\"SM\",\"SM\",\"SM\"" &&
+        applied[applied.size() - 2] == "AT+CLTS=1" && applied.back() == "AT+IFC=2,2",
+        "settings applied again");
+
+    // A listing longer than the ring stops the module through RTS instead of losing bytes.
+    uint8_t ring[64];
+    std::vector<bool> rts;
+    SIMKAFIBufferedStream link(serial, ring, sizeof(ring));
+    link.setFlowControl(&driveRTS, nullptr, &rts);
+
+    SIMKAFI buffered(link);
+    buffered.watchOverflows(link);
+    expect(buffered.selectSMSStorage(SIMKAFI_SMS_STORAGE_SM) && buffered.smsStorage().used == 2 &&
+        buffered.rxOverflows() == 0 && std::count(rts.begin(), rts.end(), false) > 0 && rts.back(),
+        "buffered link with flow control");
+
+    // Without it, what does not fit is dropped and counted.
+    link.setFlowControl(nullptr, nullptr, nullptr);
+    modem.inject(std::string(100, 'x'));
+    serial.waitReadable(1000);
+    delay(20);
+    link.drain();
+    expect(buffered.rxOverflows() > 0 && buffered.rxOverflows() == link.overflows() &&
+        link.highWater() == sizeof(ring) - 1, "receive overflow counted");
+    while(link.read() >= 0)
+        ;
+
+    // An alarm call the callee answers and hangs up: each step arrives as a +CLCC report.
+    expect(simKafi.setCallReports(true) && modem.commands().back() == "AT+CLCC=1", "call reports");
+    inbox.callStates.clear();
+    expect(simKafi.dialUp("+15557654321", 30000) == SIMKAFI_DIAL_RESULT_OK &&
+        modem.commands().back() == "ATD+15557654321;" && simKafi.call().state == SIMKAFI_CALL_DIALING,
+        "dial returns while dialing");
+
+    modem.inject("+CLCC: 1,0,2,0,0,\"+15557654321\",145,\"\"");
+    pump(simKafi, serial);
+    modem.inject("+CLCC: 1,0,3,0,0,\"+15557654321\",145,\"\"");
+    pump(simKafi, serial);
+    modem.inject("+CLCC: 1,0,0,0,0,\"+15557654321\",145,\"\"");
+    pump(simKafi, serial);
+    delay(100);
+    modem.inject("+CLCC: 1,0,6,0,0,\"+15557654321\",145,\"\"\nNO CARRIER");
+    pump(simKafi, serial);
+
+    std::vector<SIMKAFICallState> answered = { SIMKAFI_CALL_DIALING, SIMKAFI_CALL_ALERTING,
+        SIMKAFI_CALL_ACTIVE, SIMKAFI_CALL_RELEASED };
+    expect(inbox.callStates == answered && inbox.callEnd == SIMKAFI_CALL_END_NORMAL &&
+        inbox.callDuration >= 100 && inbox.callDuration < 1000 && simKafi.call().id == 1,
+        "call answered and ended by the callee");
+
+    // A busy callee, whose result code follows the release report.
+    inbox.callStates.clear();
+    simKafi.dialUp("+15557654321");
+    modem.inject("+CLCC: 1,0,2,0,0,\"+15557654321\",145,\"\"\n+CLCC: 1,0,6,0,0,\"+15557654321\",145,\"\"\nBUSY");
+    pump(simKafi, serial);
+    expect(inbox.callStates.back() == SIMKAFI_CALL_RELEASED && inbox.callEnd == SIMKAFI_CALL_END_BUSY &&
+        inbox.callDuration == 0, "busy callee");
+
+    // Nobody answers in time, so serviceCall() hangs up.
+    simKafi.dialUp("+15557654321", 100);
+    modem.inject("+CLCC: 1,0,3,0,0,\"+15557654321\",145,\"\"");
+    pump(simKafi, serial);
+    for(unsigned long start = millis(); simKafi.serviceCall() != SIMKAFI_CALL_RELEASED && millis() - start < 1000; )
+        delay(10);
+    expect(simKafi.call().state == SIMKAFI_CALL_RELEASED && simKafi.call().cause == SIMKAFI_CALL_END_NO_ANSWER &&
+        modem.commands().back() == "ATH", "unanswered call hung up");
+
+    // A dial the module refuses never shows up as a call.
+    modem.on("ATD", "NO CARRIER");
+    inbox.callStates.clear();
+    expect(simKafi.dialUp("+15557654321") == SIMKAFI_DIAL_RESULT_NO_CARRIER && inbox.callStates.empty() &&
+        simKafi.call().cause == SIMKAFI_CALL_END_NO_ANSWER, "refused dial raises no event");
+    modem.on("ATD", "OK");
+
+    // A refused ATH is not sent again on every poll.
+    modem.on("ATH", "ERROR");
+    simKafi.dialUp("+15557654321", 50);
+    modem.clearCommands();
+    for(unsigned long start = millis(); millis() - start < 300; delay(10))
+        simKafi.serviceCall();
+
+    std::vector<std::string> hangUps = modem.commands();
+    modem.on("ATH", "OK");
+    expect(std::count(hangUps.begin(), hangUps.end(), "ATH") == 1 && simKafi.call().state == SIMKAFI_CALL_DIALING &&
+        simKafi.hangUp() && simKafi.call().state == SIMKAFI_CALL_RELEASED, "refused hang-up not hammered");
+
+    // Without the reports the state comes from AT+CLCC; a call gone from the list was missed.
+    modem.on("AT+CLCC=", "OK");
+    expect(simKafi.setCallReports(false), "call reports off");
+    modem.on("AT+CLCC", "+CLCC: 1,1,4,0,0,\"+15551234567\",145,\"\"\nOK");
+    expect(simKafi.refreshCall() && simKafi.call().state == SIMKAFI_CALL_INCOMING && simKafi.call().incoming &&
+        simKafi.call().number == "+15551234567", "incoming call polled");
+    modem.on("AT+CLCC", "OK");
+    expect(simKafi.refreshCall() && simKafi.call().state == SIMKAFI_CALL_RELEASED &&
+        simKafi.call().cause == SIMKAFI_CALL_END_MISSED, "missed call polled");
+
+#if SIMKAFI_ENABLE_STATS
+    simKafi.dumpStats(Serial);
+#endif
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,229 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Runs a send/receive/query cycle of a SIMKAFI_NO_HEAP build against the modem
+ * emulator with the allocator hooked, and fails if the library allocated anything.
+ * Only the main thread is counted; the emulator allocates freely on its own thread.
+ */
+
+#include <SimKafi.h>
+#include <SimKafiModemEmulator.h>
+#include <SimKafiPosixSerial.h>
+#include <SimKafiSMSRouter.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#if !SIMKAFI_NO_HEAP
+#error "zero_heap must be built with SIMKAFI_NO_HEAP=1"
+#endif
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *pointer, size_t size);
+extern "C" void __libc_free(void *pointer);
+
+static thread_local bool counting = false;
+static unsigned long allocations = 0;
+
+extern "C" void *malloc(size_t size) {
+    if(counting)
+        allocations++;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+    if(counting)
+        allocations++;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *pointer, size_t size) {
+    if(counting)
+        allocations++;
+    return __libc_realloc(pointer, size);
+}
+
+extern "C" void free(void *pointer) {
+    __libc_free(pointer);
+}
+
+struct Inbox {
+    char sender[SIMKAFI_TEXT_SIZE];
+    char message[64];
+
+    void onSMS(SIMKAFIStringView from, SIMKAFIStringView body) {
+        snprintf(this->sender, sizeof(this->sender), "%.*s", (int) from.length, from.data);
+        snprintf(this->message, sizeof(this->message), "%.*s", (int) body.length, body.data);
+    }
+};
+
+// What the SMS commands below act on.
+struct Board {
+    long meter, reading;
+    bool relay;
+};
+
+static long number(SIMKAFIStringView view) {
+    long value = 0;
+    for(size_t i = 0; i < view.length && view.data[i] >= '0' && view.data[i] <= '9'; i++)
+        value = value * 10 + (view.data[i] - '0');
+    return value;
+}
+
+// "METER <id> reading <value>"
+static void onMeter(void *context, const SIMKAFISMSCommand &command) {
+    Board &board = *static_cast<Board*>(context);
+    if(command.argCount == 3) {
+        board.meter = number(command.args[0]);
+        board.reading = number(command.args[2]);
+    }
+}
+
+// "RELAY1 ON" or "RELAY1 OFF"
+static void onRelay(void *context, const SIMKAFISMSCommand &command) {
+    static_cast<Board*>(context)->relay = command.argCount == 1 && command.args[0].length == 2;
+}
+
+static const SIMKAFISMSRoute routes[] = {
+    SIMKAFI_SMS_ROUTE("METER", onMeter),
+    SIMKAFI_SMS_ROUTE("RELAY1", onRelay)
+};
+
+static const char *const owners[] = { "+1 (555) 123-4567" };
+
+static int failures = 0;
+
+static void expect(bool condition, const char *what) {
+    // stdio allocates its buffer on first use; that is the harness, not the library.
+    bool wasCounting = counting;
+    counting = false;
+
+    printf("%s %s\n", condition ? "[ OK ]" : "[FAIL]", what);
+    if(!condition)
+        failures++;
+
+    counting = wasCounting;
+}
+
+int main() {
+    SIMKAFIModemEmulator modem;
+    modem.on("AT+CSQ", "+CSQ: 21,0\nOK");
+    modem.on("AT+GSN", "861234567890123\nOK");
+    modem.on("AT+COPS?", "+COPS: 0,0,\"Example Net\"\nOK");
+    modem.on("AT+CREG?", "+CREG: 0,1\nOK");
+    modem.on("AT+CENG?", "+CENG: 1,1\n+CENG: 0,\"0032,45,00,310,26,39,1a2b,10,05,3c4d,1\"\n"
+        "+CENG: 1,\"0024,30,21,0f0e,310,26,3c4d\"\nOK");
+    modem.on("AT+CPMS=\"SM\"", "+CPMS: 0,30,0,30,0,30\nOK");
+    modem.on("AT+CPMS?", "+CPMS: \"SM\",0,30,\"SM\",0,30,\"SM\",0,30\nOK");
+    modem.on("AT+CMGL=\"ALL\"", "+CMGL: 3,\"REC READ\",\"+15551234567\",\"\",\"23/10/01,10:00:00+00\"\n"
+        "Meter 42 reading 1234\nOK");
+    modem.on("AT+CMGR=3", "+CMGR: \"REC UNREAD\",\"+15551234567\",\"\",\"23/10/01,10:00:00+00\"\n"
+        "Meter 42 reading 1234\nOK");
+    modem.onPrompt("AT+CMGS=", "+CMGS: 7\nOK");
+
+    if(!modem.start()) {
+        perror("openpty");
+        return 1;
+    }
+
+    SIMKAFIPosixSerial serial;
+    if(!serial.begin(modem.devicePath(), 115200)) {
+        perror(modem.devicePath());
+        return 1;
+    }
+
+    SIMKAFI simKafi(serial);
+    Inbox inbox;
+    simKafi.setSMSReceivedCallback<Inbox, &Inbox::onSMS>(&inbox);
+
+    counting = true;
+
+    expect(simKafi.handshake(), "handshake");
+    expect(simKafi.signal().rssi == 21, "signal");
+    expect(simKafi.imei().startsWith("861234567890123"), "imei");
+    expect(simKafi.networkOperator().name == "Example Net", "operator name");
+
+    SIMKAFIDiagnostics snapshot;
+    expect(simKafi.diagnostics(snapshot) && snapshot.registration == 1 && snapshot.neighborCount == 1,
+        "diagnostics");
+    expect(simKafi.selectSMSStorage(SIMKAFI_SMS_STORAGE_SM), "SMS storage");
+    expect(simKafi.sendSMS("+15557654321", "Valve closed"), "send SMS");
+
+    SIMKAFITask task = {};
+    SIMKAFITaskState state;
+    while((state = simKafi.sendSMS(task, "+15557654321", "Valve open")) == SIMKAFI_TASK_RUNNING)
+        ;
+    expect(state == SIMKAFI_TASK_DONE, "send SMS as a flow");
+
+    // The emulator's script is built on this thread, so it is left out of the count.
+    counting = false;
+    modem.inject("+CMTI: \"SM\",3");
+    counting = true;
+
+    serial.waitReadable(1000);
+    simKafi.handleSerialEvent();
+    expect(!strcmp(inbox.sender, "+15551234567") && !strncmp(inbox.message, "Meter 42", 8), "receive SMS");
+
+    // Commands by SMS go through the router, checked against the owner's number first.
+    Board board = {};
+    SIMKAFISMSRouter router(routes, sizeof(routes) / sizeof(routes[0]), &board);
+    router.setAllowedSenders(owners, 1);
+    simKafi.setSMSReceivedCallback(&SIMKAFISMSRouter::receive, &router);
+
+    counting = false;
+    modem.inject("+CMTI: \"SM\",3");
+    counting = true;
+
+    serial.waitReadable(1000);
+    simKafi.handleSerialEvent();
+    expect(board.meter == 42 && board.reading == 1234, "SMS command routed");
+
+    SIMKAFIStringView owner = { "+15551234567", 12 }, stranger = { "+15550000000", 12 };
+    SIMKAFIStringView relay = { " relay1  ON\r\n", 13 }, help = { "HELP", 4 };
+    expect(router.dispatch(stranger, relay) == SIMKAFI_ROUTE_REJECTED && !board.relay &&
+        router.dispatch(owner, relay) == SIMKAFI_ROUTE_HANDLED && board.relay &&
+        router.dispatch(owner, help) == SIMKAFI_ROUTE_UNKNOWN && router.rejected() == 1 && router.unknown() == 1,
+        "SMS command router");
+
+    // The whole number counts: a foreign lookalike is turned away, a national form only with the home country.
+    SIMKAFIStringView lookalike = { "+4415551234567", 14 }, national = { "05551234567", 11 };
+    bool nationalUnknown = router.dispatch(national, relay) == SIMKAFI_ROUTE_REJECTED;
+    router.setHomeCountry("1");
+    expect(router.dispatch(lookalike, relay) == SIMKAFI_ROUTE_REJECTED && nationalUnknown &&
+        router.dispatch(national, relay) == SIMKAFI_ROUTE_HANDLED, "SMS sender matched in full");
+
+    char sender[SIMKAFI_TEXT_SIZE], message[64], match[64];
+    expect(simKafi.readSMS(3, sender, sizeof(sender), message, sizeof(message)) &&
+        !strncmp(message, "Meter 42", 8), "read SMS into buffers");
+    expect(simKafi.searchSMS("reading", match, sizeof(match)) && !strncmp(match, "reading 1234", 12), "search SMS");
+    expect(simKafi.getSMSCount() == 1 && simKafi.deleteSMS(3) && simKafi.getSMSCount() == 0, "delete SMS");
+
+    counting = false;
+
+    printf("allocations: %lu\n", allocations);
+    expect(allocations == 0, "no heap allocations");
+
+    return failures == 0 ? 0 : 1;
+}
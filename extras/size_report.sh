@@ -0,0 +1,79 @@
+#!/bin/sh
+#
+# This file is part of the SIMKAFI Arduino Shield library.
+# Copyright (c) 2023 Nathanne Isip
+#
+# Builds the library once per feature configuration (see SimKafi_config.h) and tabulates
+# the .text/.data/.bss of the result, so a footprint regression shows up next to the
+# change that caused it. Save the output and diff it against the next run.
+#
+#   extras/size_report.sh
+#
+# compiles with the host compiler. For the numbers that matter on a board, point it at
+# the target toolchain and core, e.g. for an Uno:
+#
+#   CXX=avr-g++ SIZE=avr-size NM=avr-nm \
+#   TARGET_FLAGS="-mmcu=atmega328p -DF_CPU=16000000L -I<core>/cores/arduino -I<core>/variants/standard" \
+#   extras/size_report.sh
+#
+# The sections are summed over the library's object files before the linker drops unused
+# functions, so they are an upper bound for a sketch. "instance" is sizeof(SIMKAFI), the
+# RAM every SIMKAFI object takes on top of .data and .bss.
+
+set -e
+
+cd "$(dirname "$0")/.."
+
+CXX=${CXX:-c++}
+SIZE=${SIZE:-size}
+NM=${NM:-nm}
+CXXFLAGS=${CXXFLAGS:--Os -std=gnu++17 -ffunction-sections -fdata-sections}
+TARGET_FLAGS=${TARGET_FLAGS:--DSIMKAFI_HOST -Iextras/host}
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+ALL_OFF="-DSIMKAFI_ENABLE_CALL=0 -DSIMKAFI_ENABLE_GPRS=0 -DSIMKAFI_ENABLE_HTTP=0 -DSIMKAFI_ENABLE_FTP=0 -DSIMKAFI_ENABLE_PHONEBOOK=0 -DSIMKAFI_ENABLE_RTC=0 -DSIMKAFI_ENABLE_TASKS=0"
+
+report() {
+    name=$1
+    flags=$2
+    objects="$work/SimKafi.o"
+
+    # shellcheck disable=SC2086
+    $CXX $CXXFLAGS $TARGET_FLAGS -Isrc $flags -c src/SimKafi.cpp -o "$work/SimKafi.o"
+
+    case "$flags" in
+        *SIMKAFI_NO_HEAP=1*)
+            # shellcheck disable=SC2086
+            $CXX $CXXFLAGS $TARGET_FLAGS -Isrc $flags -c src/SimKafiFixedString.cpp -o "$work/SimKafiFixedString.o"
+            objects="$objects $work/SimKafiFixedString.o"
+            ;;
+    esac
+
+    printf '#include <SimKafi.h>\nextern "C" char simkafiInstance[sizeof(SIMKAFI)];\nchar simkafiInstance[sizeof(SIMKAFI)];\n' \
+        > "$work/instance.cpp"
+    # shellcheck disable=SC2086
+    $CXX $CXXFLAGS $TARGET_FLAGS -Isrc $flags -c "$work/instance.cpp" -o "$work/instance.o"
+    instance=$(printf '%d' "0x$($NM -S "$work/instance.o" | awk '$4 == "simkafiInstance" { print $2 }')")
+
+    # shellcheck disable=SC2086
+    $SIZE -t $objects | awk -v name="$name" -v instance="$instance" \
+        '$NF == "(TOTALS)" { printf "%-20s %8d %8d %8d %10d\n", name, $1, $2, $3, instance }'
+}
+
+printf '%-20s %8s %8s %8s %10s\n' configuration .text .data .bss instance
+
+report "full" ""
+report "no-http" "-DSIMKAFI_ENABLE_HTTP=0"
+report "no-ftp" "-DSIMKAFI_ENABLE_FTP=0"
+report "no-gprs" "-DSIMKAFI_ENABLE_GPRS=0 -DSIMKAFI_ENABLE_HTTP=0 -DSIMKAFI_ENABLE_FTP=0"
+report "no-call" "-DSIMKAFI_ENABLE_CALL=0"
+report "no-phonebook" "-DSIMKAFI_ENABLE_PHONEBOOK=0"
+report "no-rtc" "-DSIMKAFI_ENABLE_RTC=0"
+report "no-tasks" "-DSIMKAFI_ENABLE_TASKS=0"
+report "no-sms" "-DSIMKAFI_ENABLE_SMS=0"
+report "sms-only" "$ALL_OFF"
+report "core" "$ALL_OFF -DSIMKAFI_ENABLE_SMS=0"
+report "full no-heap" "-DSIMKAFI_NO_HEAP=1"
+report "sms-only no-heap" "$ALL_OFF -DSIMKAFI_NO_HEAP=1"
@@ -21,291 +21,2863 @@
  * THE SOFTWARE.
  */
 
-#include "simKafi.h"
+#include "SimKafi.h"
+#include "SimKafiBufferedStream.h"
+
+#include <stdio.h>
+
+#if SIMKAFI_NO_HEAP
+// Room kept at the end of a full response for its final result code.
+#define SIMKAFI_RESPONSE_RESERVE 24
+#endif
+
+static const SIMKAFITimeoutPolicy defaultTimeoutPolicies[SIMKAFI_COMMAND_CLASS_COUNT] = {
+    {  200,  1000,  5000, 2 },  // general
+    {  300,  2000, 10000, 2 },  // network
+    {  300,  2000, 10000, 2 },  // sms
+    { 1000,  5000, 20000, 1 },  // call
+    {  300,  2000, 10000, 2 },  // data
+    {  300,  2000, 10000, 2 },  // phonebook
+    {  200,  1000,  5000, 2 },  // clock
+    { 5000, 20000, 60000, 1 },  // sms send
+    { 5000, 30000, 85000, 1 }   // data connect
+};
+
+static bool lineStartsWith(const char *line, size_t length, const char *prefix) {
+    size_t prefixLength = strlen(prefix);
+    return length >= prefixLength && strncmp(line, prefix, prefixLength) == 0;
+}
+
+static bool lineEndsWith(const char *line, size_t length, const char *suffix) {
+    size_t suffixLength = strlen(suffix);
+    return length >= suffixLength &&
+        strncmp(line + length - suffixLength, suffix, suffixLength) == 0;
+}
+
+static bool isCommandLine(const char *line, size_t length) {
+    return length >= 2 && (line[0] == 'A' || line[0] == 'a') &&
+        (line[1] == 'T' || line[1] == 't');
+}
+
+static SIMKAFICommandClass classifyCommand(const char *command) {
+    const char *name = command + 2;
+
+    if(*name == 'D' || *name == 'A' || *name == 'H' ||
+        *name == 'd' || *name == 'a' || *name == 'h')
+        return SIMKAFI_COMMAND_CLASS_CALL;
+    if(*name != '+')
+        return SIMKAFI_COMMAND_CLASS_GENERAL;
+
+    if(!strncmp(name, "+CMGS", 5) || !strncmp(name, "+CMSS", 5))
+        return SIMKAFI_COMMAND_CLASS_SMS_SEND;
+    if(!strncmp(name, "+CMG", 4) || !strncmp(name, "+CNMI", 5) ||
+        !strncmp(name, "+CSMP", 5) || !strncmp(name, "+CPMS", 5) ||
+        !strncmp(name, "+CSCA", 5) || !strncmp(name, "+CSCS", 5))
+        return SIMKAFI_COMMAND_CLASS_SMS;
+    if(!strncmp(name, "+CSQ", 4) || !strncmp(name, "+COPS", 5) ||
+        !strncmp(name, "+CREG", 5) || !strncmp(name, "+CGREG", 6) ||
+        !strncmp(name, "+CENG", 5))
+        return SIMKAFI_COMMAND_CLASS_NETWORK;
+    if(!strncmp(name, "+CGATT", 6) || !strncmp(name, "+CIICR", 6) ||
+        !strncmp(name, "+CIPSTART", 9) || !strncmp(name, "+CIPSHUT", 8) ||
+        !strncmp(name, "+SAPBR", 6) || !strncmp(name, "+FTPPUT", 7) ||
+        !strncmp(name, "+FTPGET", 7))
+        return SIMKAFI_COMMAND_CLASS_DATA_CONNECT;
+    if(!strncmp(name, "+CSTT", 5) || !strncmp(name, "+CIFSR", 6) ||
+        !strncmp(name, "+CIP", 4) || !strncmp(name, "+CDNS", 5) ||
+        !strncmp(name, "+FTP", 4))
+        return SIMKAFI_COMMAND_CLASS_DATA;
+    if(!strncmp(name, "+CPB", 4) || !strncmp(name, "+CNUM", 5))
+        return SIMKAFI_COMMAND_CLASS_PHONEBOOK;
+    if(!strncmp(name, "+CCLK", 5))
+        return SIMKAFI_COMMAND_CLASS_CLOCK;
+    if(!strncmp(name, "+CLCC", 5))
+        return SIMKAFI_COMMAND_CLASS_CALL;
+
+    return SIMKAFI_COMMAND_CLASS_GENERAL;
+}
+
+// Commands that change nothing when they reach the module twice.
+static bool isRepeatable(const char *command) {
+    SIMKAFICommandClass commandClass = classifyCommand(command);
+    const char *name = command + 2;
+
+    if(commandClass == SIMKAFI_COMMAND_CLASS_CALL ||
+        commandClass == SIMKAFI_COMMAND_CLASS_SMS_SEND ||
+        commandClass == SIMKAFI_COMMAND_CLASS_DATA_CONNECT)
+        return false;
+
+    return strncmp(name, "+CMGW", 5) && strncmp(name, "+CIPSEND", 8) &&
+        strncmp(name, "+CPIN=", 6) && strncmp(name, "+CPWD", 5) &&
+        strncmp(name, "+CLCK", 5) && strncmp(name, "+IPR", 4);
+}
+
+static bool isFinalLine(const char *line, size_t length, const char *until, bool dialing) {
+    if(until != nullptr) {
+        if(*until == '\0')
+            return !isCommandLine(line, length);
+        if(lineStartsWith(line, length, until))
+            return true;
+    }
+
+    if((length == 2 && !strncmp(line, "OK", 2)) ||
+        (length == 5 && !strncmp(line, "ERROR", 5)) ||
+        lineStartsWith(line, length, "+CME ERROR:") ||
+        lineStartsWith(line, length, "+CMS ERROR:"))
+        return true;
+
+    return dialing && (
+        (length == 10 && !strncmp(line, "NO CARRIER", 10)) ||
+        (length == 4 && !strncmp(line, "BUSY", 4)) ||
+        (length == 9 && !strncmp(line, "NO ANSWER", 9)) ||
+        (length == 11 && !strncmp(line, "NO DIALTONE", 11)));
+}
+
+// Line noise: a wrong baud rate or a module in reset produces bytes no response contains.
+static bool isGarbage(char c) {
+    uint8_t value = (uint8_t) c;
+    return value >= 0x7f || (value < 0x20 && c != '\r' && c != '\n' && c != '\t');
+}
+
+static bool isUnsolicitedLine(const char *line, size_t length, const char *command) {
+    // A "+NAME: ..." line answering the command itself is part of its response.
+    if(command != nullptr && strlen(command) > 2 && length > 0 && line[0] == '+') {
+        size_t nameLength = strcspn(command + 2, "=?");
+
+        if(nameLength > 1 && length > nameLength &&
+            !strncmp(line, command + 2, nameLength) && line[nameLength] == ':')
+            return false;
+    }
+
+    return lineStartsWith(line, length, "+CMTI:") ||
+        (length == 3 && !strncmp(line, "RDY", 3)) ||
+        lineStartsWith(line, length, "RING") ||
+        lineStartsWith(line, length, "+CDS:") ||
+        lineStartsWith(line, length, "NO CARRIER") ||
+        (length == 4 && !strncmp(line, "BUSY", 4)) ||
+        (length == 9 && !strncmp(line, "NO ANSWER", 9)) ||
+        (length == 11 && !strncmp(line, "NO DIALTONE", 11)) ||
+        lineStartsWith(line, length, "+CLCC:") ||
+        lineStartsWith(line, length, "+PDP: DEACT") ||
+        lineStartsWith(line, length, "+CGATT: 0") ||
+        lineStartsWith(line, length, "*PSUTTZ:") ||
+        lineStartsWith(line, length, "+CTZV:") ||
+        lineStartsWith(line, length, "DST:") ||
+        lineEndsWith(line, length, "CLOSED");
+}
+
+static void clearConfig(SIMKAFIModemConfig &config) {
+    memset(&config, 0, sizeof(config));
+    config.messageFormat = -1;
+    config.engineeringMode = -1;
+    config.smsStorage = -1;
+    config.networkTime = -1;
+    config.flowControl = -1;
+    config.callReports = -1;
+}
+
+#if SIMKAFI_ENABLE_SMS
+static const char *storageName(SIMKAFISMSStorage storage) {
+    static const char *const names[] = { "SM", "ME", "MT" };
+    return names[storage];
+}
+
+static void setSlot(uint8_t *slots, int index, bool set) {
+    uint8_t mask = 1 << ((index - 1) & 7);
+
+    if(set)
+        slots[(index - 1) >> 3] |= mask;
+    else slots[(index - 1) >> 3] &= ~mask;
+}
+
+static bool slotSet(const uint8_t *slots, int index) {
+    return (slots[(index - 1) >> 3] & (1 << ((index - 1) & 7))) != 0;
+}
+
+// Append "<values[0]>,<values[1]>,..." to a command line.
+template<class Command>
+static void appendList(Command &command, const uint8_t *values, uint8_t count) {
+    for(uint8_t i = 0; i < count; i++) {
+        if(i > 0)
+            command += ',';
+        command += values[i];
+    }
+}
+
+// Append "X","X","X" for AT+CPMS, selecting one storage for reading, writing and receiving.
+template<class Command>
+static void appendStorage(Command &command, SIMKAFISMSStorage storage) {
+    for(uint8_t i = 0; i < 3; i++) {
+        command += i > 0 ? ",\"" : "\"";
+        command += storageName(storage);
+        command += '"';
+    }
+}
+#endif
+
+#if SIMKAFI_ENABLE_GPRS
+// Append +CSTT="apn","username","password" to a command line.
+template<class Command>
+static void appendCSTT(Command &command, const SIMKAFIAPN &apn) {
+    command += F("+CSTT=\"");
+    command += apn.apn;
+    command += F("\",\"");
+    command += apn.username;
+    command += F("\",\"");
+    command += apn.password;
+    command += '"';
+}
+#endif
+
+#if SIMKAFI_ENABLE_GPRS
+// The bearer state named on an AT+CIPSTATUS "STATE: " line; connection states mean the bearer is up.
+static SIMKAFIBearerState parseBearerState(const char *name) {
+    if(!strncmp(name, "IP INITIAL", 10))
+        return SIMKAFI_BEARER_IP_INITIAL;
+    if(!strncmp(name, "IP START", 8))
+        return SIMKAFI_BEARER_IP_START;
+    if(!strncmp(name, "IP CONFIG", 9))
+        return SIMKAFI_BEARER_IP_CONFIG;
+    if(!strncmp(name, "IP GPRSACT", 10))
+        return SIMKAFI_BEARER_IP_GPRSACT;
+    if(!strncmp(name, "PDP DEACT", 9))
+        return SIMKAFI_BEARER_PDP_DEACT;
+
+    return SIMKAFI_BEARER_IP_STATUS;
+}
+
+// Parse a dotted IPv4 address of exactly length characters.
+static bool parseAddress(const char *text, size_t length, uint32_t &address) {
+    uint32_t octet = 0;
+    uint8_t dots = 0, digits = 0;
+
+    address = 0;
+    for(size_t i = 0; i <= length; i++) {
+        if(i < length && text[i] >= '0' && text[i] <= '9' && digits < 3) {
+            octet = octet * 10 + (uint32_t) (text[i] - '0');
+            digits++;
+            continue;
+        }
+
+        if(digits == 0 || octet > 255 || (i < length && (text[i] != '.' || ++dots > 3)))
+            return false;
+
+        address = (address << 8) | octet;
+        octet = 0;
+        digits = 0;
+    }
+
+    return dots == 3;
+}
+
+static void formatAddress(uint32_t address, char *text, size_t size) {
+    snprintf(text, size, "%u.%u.%u.%u", (unsigned) (address >> 24) & 0xFF, (unsigned) (address >> 16) & 0xFF,
+        (unsigned) (address >> 8) & 0xFF, (unsigned) address & 0xFF);
+}
+
+#if SIMKAFI_DNS_CACHE_SIZE > 0
+// Host names are case-insensitive.
+static char lowerHostChar(char c) {
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+// FNV-1a over the lower-cased name; 0 is kept for free cache entries.
+static uint32_t hashHost(const char *host) {
+    uint32_t hash = 2166136261UL;
+
+    for(; *host != '\0'; host++)
+        hash = (hash ^ (uint8_t) lowerHostChar(*host)) * 16777619UL;
+
+    return hash != 0 ? hash : 1;
+}
+
+static bool sameHost(const char *a, const char *b) {
+    while(*a != '\0' && lowerHostChar(*a) == lowerHostChar(*b)) {
+        a++;
+        b++;
+    }
+
+    return *a == *b;
+}
+#endif
+#endif
+
+#if SIMKAFI_ENABLE_SMS
+static uint8_t countSlots(const uint8_t *slots) {
+    uint8_t count = 0;
+
+    for(size_t i = 0; i < (SIMKAFI_SMS_SLOTS + 7) / 8; i++)
+        for(uint8_t bits = slots[i]; bits != 0; bits &= bits - 1)
+            count++;
+    return count;
+}
+#endif
+
+// Jacobson/Karels: smoothed is kept in 1/8 ms and deviation in 1/4 ms.
+static void updateEstimate(SIMKAFILatencyEstimate &estimate, unsigned long ms) {
+    if(estimate.smoothed == 0) {
+        estimate.smoothed = (ms > 0 ? ms : 1) << 3;
+        estimate.deviation = ms << 1;
+    }
+    else {
+        long error = (long) ms - (long) (estimate.smoothed >> 3);
+        estimate.smoothed += error;
+
+        if(error < 0)
+            error = -error;
+        estimate.deviation += error - (long) (estimate.deviation >> 2);
+    }
+
+    estimate.backoff = 0;
+}
+
+#if SIMKAFI_ENABLE_STATS
+static void recordLatency(SIMKAFILatencyHistogram &histogram, unsigned long ms) {
+    uint8_t bucket = 0;
+    while(bucket < SIMKAFI_STATS_BUCKETS - 1 && (ms >> bucket) != 0)
+        bucket++;
+
+    histogram.buckets[bucket]++;
+    histogram.count++;
+    histogram.totalMs += ms;
+
+    if(ms > histogram.maxMs)
+        histogram.maxMs = ms > 0xFFFF ? 0xFFFF : (uint16_t) ms;
+}
+
+void SIMKAFI::recordResponse(const Response &response, unsigned long waitStart) {
+    this->statistics.bytesReceived += response.length();
+    this->statistics.waitMs += millis() - waitStart;
+
+    int idx;
+    if((idx = response.lastIndexOf(F("+CME ERROR:"))) != -1) {
+        this->statistics.cmeErrors++;
+        this->statistics.lastErrorCode = (int16_t) response.substring(idx + 11).toInt();
+    }
+    else if((idx = response.lastIndexOf(F("+CMS ERROR:"))) != -1) {
+        this->statistics.cmsErrors++;
+        this->statistics.lastErrorCode = (int16_t) response.substring(idx + 11).toInt();
+    }
+    else if(response.indexOf(F("ERROR")) != -1)
+        this->statistics.errors++;
+}
+
+const SIMKAFIStats &SIMKAFI::stats() const {
+    return this->statistics;
+}
+
+void SIMKAFI::resetStats() {
+    memset(&this->statistics, 0, sizeof(this->statistics));
+    this->statistics.lastErrorCode = -1;
+}
+
+static void printCommandClass(Print &out, uint8_t commandClass) {
+    switch(commandClass) {
+        case SIMKAFI_COMMAND_CLASS_GENERAL:     out.print(F("general")); break;
+        case SIMKAFI_COMMAND_CLASS_NETWORK:     out.print(F("network")); break;
+        case SIMKAFI_COMMAND_CLASS_SMS:         out.print(F("sms")); break;
+        case SIMKAFI_COMMAND_CLASS_CALL:        out.print(F("call")); break;
+        case SIMKAFI_COMMAND_CLASS_DATA:        out.print(F("data")); break;
+        case SIMKAFI_COMMAND_CLASS_PHONEBOOK:   out.print(F("phonebook")); break;
+        case SIMKAFI_COMMAND_CLASS_CLOCK:       out.print(F("clock")); break;
+        case SIMKAFI_COMMAND_CLASS_SMS_SEND:    out.print(F("sms-send")); break;
+        default:                                out.print(F("data-connect")); break;
+    }
+}
+
+void SIMKAFI::dumpStats(Print &out) const {
+    const SIMKAFIStats &s = this->statistics;
+
+    out.print(F("tx=")); out.print(s.bytesSent);
+    out.print(F(" rx=")); out.print(s.bytesReceived);
+    out.print(F(" delay=")); out.print(s.delayMs);
+    out.print(F("ms wait=")); out.print(s.waitMs);
+    out.print(F("ms idle=")); out.print(s.idleMs);
+    out.print(F("ms overruns=")); out.print(s.idleOverruns);
+    out.print(F(" timeouts=")); out.print(s.timeouts);
+    out.print(F(" errors=")); out.print(s.errors);
+    out.print(F(" cme=")); out.print(s.cmeErrors);
+    out.print(F(" cms=")); out.print(s.cmsErrors);
+    out.print(F(" last=")); out.print(s.lastErrorCode);
+    out.print(F(" urcs=")); out.print(s.urcs);
+    out.print(F(" resyncs=")); out.print(s.resyncs);
+    out.print(F(" overflowed=")); out.println(s.overflowedResponses);
+
+#if SIMKAFI_ENABLE_TASKS
+    out.print(F("deadline misses=")); out.print(s.deadlineMisses);
+    out.print(F(" preemptions=")); out.print(s.preemptions);
+    out.print(F(" urgent wait max=")); out.print(s.urgentWaitMaxMs);
+    out.println(F("ms"));
+#endif
+
+    for(uint8_t i = 0; i < SIMKAFI_COMMAND_CLASS_COUNT; i++) {
+        const SIMKAFILatencyHistogram &h = s.latency[i];
+        if(h.count == 0)
+            continue;
+
+        printCommandClass(out, i);
+        out.print(F(" n=")); out.print(h.count);
+        out.print(F(" avg=")); out.print(h.totalMs / h.count);
+        out.print(F("ms max=")); out.print(h.maxMs);
+        out.print(F("ms hist="));
+
+        uint8_t last = SIMKAFI_STATS_BUCKETS - 1;
+        while(last > 0 && h.buckets[last] == 0)
+            last--;
+
+        for(uint8_t b = 0; b <= last; b++) {
+            if(b > 0)
+                out.print(',');
+            out.print(h.buckets[b]);
+        }
+        out.println();
+    }
+}
+#endif
+
+void SIMKAFI::sendCommand(const char *message) {
+    size_t length = strlen(message);
+    bool command = isCommandLine(message, length);
+
+    if(command)
+        this->deferUnsolicited();
+    this->simKafi.println(message);
+
+#if SIMKAFI_ENABLE_STATS
+    this->statistics.bytesSent += length + 2;
+#endif
+
+    // Text typed after a "> " prompt belongs to the command that opened the prompt.
+    if(command) {
+        this->pendingClass = classifyCommand(message);
+        this->pendingSince = millis();
+        this->pendingCommand = true;
+
+        if(message != this->lastCommand.c_str())
+            this->lastCommand = message;
+    }
+}
+
+void SIMKAFI::sendCommand(const __FlashStringHelper *message) {
+    Command command = message;
+    this->sendCommand(command.c_str());
+}
+
+void SIMKAFI::sendMessageText(const char *text) {
+    this->simKafi.print(text);
+    this->simKafi.write(0x1a);
+
+#if SIMKAFI_ENABLE_STATS
+    this->statistics.bytesSent += strlen(text) + 1;
+#endif
+
+    // The module only starts working on the command once the text is complete.
+    this->pendingSince = millis();
+    this->pendingCommand = true;
+}
+
+void SIMKAFI::pause(unsigned long ms) {
+    unsigned long start = millis();
+
+    if(this->idleCallback == nullptr || this->idling)
+        delay(ms);
+    else while(millis() - start < ms)
+        this->idle(ms - (millis() - start));
+
+#if SIMKAFI_ENABLE_STATS
+    this->statistics.delayMs += ms;
+#endif
+}
+
+void SIMKAFI::idle(unsigned long left) {
+    // A wait inside the callback itself only yields, so the callback is never re-entered.
+    if(this->idleCallback == nullptr || this->idling || left == 0) {
+        yield();
+        return;
+    }
+
+    uint16_t budget = left < this->idleBudget ? (uint16_t) left : this->idleBudget;
+#if SIMKAFI_ENABLE_STATS
+    unsigned long start = millis();
+#endif
+
+    this->idling = true;
+    this->idleCallback(this->idleCallbackContext, budget);
+    this->idling = false;
+
+#if SIMKAFI_ENABLE_STATS
+    unsigned long spent = millis() - start;
+    this->statistics.idleMs += spent;
+    if(spent > budget)
+        this->statistics.idleOverruns++;
+#endif
+}
+
+void SIMKAFI::setIdleCallback(SIMKAFIIdleCallback callback, void *context, uint16_t budgetMs) {
+    this->idleCallback = callback;
+    this->idleCallbackContext = context;
+    this->idleBudget = budgetMs;
+}
+
+void SIMKAFI::setTimeoutPolicy(SIMKAFICommandClass commandClass, const SIMKAFITimeoutPolicy &policy) {
+    this->timeoutPolicies[commandClass] = policy;
+}
+
+const SIMKAFITimeoutPolicy &SIMKAFI::timeoutPolicy(SIMKAFICommandClass commandClass) const {
+    return this->timeoutPolicies[commandClass];
+}
+
+uint32_t SIMKAFI::responseTimeout(SIMKAFICommandClass commandClass) const {
+    const SIMKAFITimeoutPolicy &policy = this->timeoutPolicies[commandClass];
+    const SIMKAFILatencyEstimate &estimate = this->latencyEstimates[commandClass];
+
+    uint32_t timeout = estimate.smoothed == 0 ? policy.initialMs :
+        (estimate.smoothed >> 3) + estimate.deviation;
+
+    if(timeout < policy.floorMs)
+        timeout = policy.floorMs;
+    for(uint8_t i = 0; i < estimate.backoff && timeout < policy.ceilingMs; i++)
+        timeout <<= 1;
+
+    return timeout < policy.ceilingMs ? timeout : policy.ceilingMs;
+}
+
+void SIMKAFI::resetLatencyEstimates() {
+    memset(this->latencyEstimates, 0, sizeof(this->latencyEstimates));
+}
+
+void SIMKAFI::settleCommand(bool answered) {
+    SIMKAFILatencyEstimate &estimate = this->latencyEstimates[this->pendingClass];
+
+    if(answered) {
+        this->consecutiveTimeouts = 0;
+        this->garbageBytes = 0;
+    }
+    else if(this->consecutiveTimeouts < 0xFF)
+        this->consecutiveTimeouts++;
+
+    if(answered && this->pendingCommand) {
+        unsigned long latency = millis() - this->pendingSince;
+        updateEstimate(estimate, latency);
+
+#if SIMKAFI_ENABLE_STATS
+        recordLatency(this->statistics.latency[this->pendingClass], latency);
+#endif
+    }
+    else if(!answered) {
+        if(estimate.backoff < 8)
+            estimate.backoff++;
+
+#if SIMKAFI_ENABLE_STATS
+        this->statistics.timeouts++;
+#endif
+    }
+
+    this->pendingCommand = false;
+}
+
+bool SIMKAFI::deferLine(const char *line, size_t length) {
+    while(length > 0 && line[length - 1] == '\r')
+        length--;
+
+#if SIMKAFI_ENABLE_FTP
+    // Transfer status can land between two commands of a transfer; keep it for waitFTPStatus().
+    if(this->takeFTPStatus(line, length))
+        return true;
+#endif
+
+    if(length == 0 || !isUnsolicitedLine(line, length,
+        this->pendingCommand ? this->lastCommand.c_str() : nullptr))
+        return false;
+
+    if(this->deferredLines.length() + length + 2 <= SIMKAFI_DEFERRED_URC_SIZE) {
+        for(size_t i = 0; i < length; i++)
+            this->deferredLines += line[i];
+        this->deferredLines += F("\r\n");
+    }
+
+    return true;
+}
+
+void SIMKAFI::deferUnsolicited() {
+    SIMKAFIString<SIMKAFI_DEFERRED_URC_SIZE> line;
+
+    // Whatever is left is either a URC or the tail of a response nobody waited for.
+    while(this->simKafi.available() > 0) {
+        char c = this->simKafi.read();
+        this->countGarbage(c);
+
+#if SIMKAFI_ENABLE_STATS
+        this->statistics.bytesReceived++;
+#endif
+
+        if(c != '\n') {
+            line += c;
+            continue;
+        }
+
+        this->deferLine(line.c_str(), line.length());
+        line = "";
+    }
+
+    this->deferLine(line.c_str(), line.length());
+}
+
+bool SIMKAFI::collectResponse(Response &response, const char *until, unsigned long timeout) {
+    unsigned long lastByte = millis();
+    size_t lineStart = response.length();
+
+    // The timeout bounds the silence, so long listings that keep arriving are never cut off.
+    while(millis() - lastByte < timeout) {
+        if(this->simKafi.available() <= 0) {
+            this->idle(timeout - (millis() - lastByte));
+            continue;
+        }
+
+        lastByte = millis();
+        if(this->takeResponseByte(response, lineStart, this->simKafi.read(), until))
+            return true;
+    }
+
+    return false;
+}
+
+bool SIMKAFI::takeResponseByte(Response &response, size_t &lineStart, char c, const char *until) {
+    bool prompt = until != nullptr && *until == '>';
+    this->countGarbage(c);
+
+#if SIMKAFI_NO_HEAP
+    // Past the soft limit a line only gets the room a final result code needs, so the
+    // head of a long response survives and its end is still recognized.
+    if(c != '\n' && response.length() >= SIMKAFI_RESPONSE_SIZE - SIMKAFI_RESPONSE_RESERVE &&
+        response.length() - lineStart >= SIMKAFI_RESPONSE_RESERVE)
+        return false;
+#endif
+    response += c;
+
+    if(prompt && c == ' ' && response.length() - lineStart == 2 && response[lineStart] == '>')
+        return true;
+    if(c != '\n')
+        return false;
+
+    const char *line = response.c_str() + lineStart;
+    size_t length = response.length() - lineStart;
+    while(length > 0 && (line[length - 1] == '\r' || line[length - 1] == '\n'))
+        length--;
+
+    if(length > 0 && !prompt && isFinalLine(line, length, until,
+        this->pendingClass == SIMKAFI_COMMAND_CLASS_CALL))
+        return true;
+
+    // Unsolicited lines are handed to handleSerialEvent() later instead of ending up here,
+    // and lines taken by the line handler are not kept either.
+    if(length > 0 && (this->deferLine(line, length) ||
+        (this->lineHandler != nullptr && (this->*lineHandler)(line, length))))
+        response.remove(lineStart);
+#if SIMKAFI_NO_HEAP
+    else if(response.length() > SIMKAFI_RESPONSE_SIZE - SIMKAFI_RESPONSE_RESERVE)
+        response.remove(lineStart);
+#endif
+    lineStart = response.length();
+
+    return false;
+}
+
+SIMKAFI::Response SIMKAFI::readResponse(const char *until) {
+    bool prompt = until != nullptr && *until == '>';
+    uint8_t attempts = this->pendingCommand && isRepeatable(this->lastCommand.c_str()) ?
+        this->timeoutPolicies[this->pendingClass].attempts : 1;
+
+#if SIMKAFI_ENABLE_STATS
+    unsigned long waitStart = millis();
+    uint32_t overflows = this->rxOverflows();
+#endif
+
+    Response response;
+    for(;;) {
+        bool answered = this->collectResponse(response, until, this->responseTimeout(this->pendingClass));
+
+        // A prompt is not an answer; the command is timed once its text has been sent.
+        if(!(answered && prompt))
+            this->settleCommand(answered);
+        // Repeating into a dead link only delays the watchdog.
+        if(answered || attempts <= 1 || this->isLinkSuspect())
+            break;
+
+        attempts--;
+        response = "";
+        this->sendCommand(this->lastCommand);
+    }
+
+#if SIMKAFI_ENABLE_STATS
+    this->recordResponse(response, waitStart);
+    if(this->rxOverflows() != overflows)
+        this->statistics.overflowedResponses++;
+#endif
+
+    this->checkHealth();
+
+    response.trim();
+    return response;
+}
+
+#if SIMKAFI_ENABLE_TASKS
+bool SIMKAFI::lockLink(const void *owner) {
+    if(this->linkOwner != nullptr && this->linkOwner != owner)
+        return false;
+
+    this->linkOwner = owner;
+    return true;
+}
+
+void SIMKAFI::unlockLink(const void *owner) {
+    this->dequeueTask(owner);
+
+    if(this->linkOwner == owner)
+        this->linkOwner = nullptr;
+}
+
+// Whether a gets the link before b: priority first, then the earlier deadline, then the earlier request.
+static bool aheadInLine(const SIMKAFITask &a, const SIMKAFITask &b) {
+    if(a.priority != b.priority)
+        return a.priority > b.priority;
+    if(a.deadline != 0 && b.deadline != 0)
+        return (int32_t) ((a.submitted + a.deadline) - (b.submitted + b.deadline)) < 0;
+    if(a.deadline != 0 || b.deadline != 0)
+        return a.deadline != 0;
+
+    return (int32_t) (a.submitted - b.submitted) < 0;
+}
+
+bool SIMKAFI::lockLink(SIMKAFITask *task) {
+    if(this->linkOwner == task)
+        return true;
+
+    unsigned long now = millis();
+    if(!task->scheduled) {
+        task->scheduled = true;
+        task->submitted = now;
+    }
+    task->asked = now;
+
+    if(!task->queued) {
+        task->queued = true;
+        task->next = this->linkQueue;
+        this->linkQueue = task;
+    }
+
+    if(this->linkOwner != nullptr || this->nextInLine() != task)
+        return false;
+
+    this->dequeueTask(task);
+    this->linkOwner = task;
+
+#if SIMKAFI_ENABLE_STATS
+    if(task->priority >= SIMKAFI_PRIORITY_URGENT && now - task->submitted > this->statistics.urgentWaitMaxMs)
+        this->statistics.urgentWaitMaxMs = (uint32_t) (now - task->submitted);
+#endif
+    return true;
+}
+
+void SIMKAFI::unlockLink(SIMKAFITask *task) {
+    this->unlockLink((const void*) task);
+
+#if SIMKAFI_ENABLE_STATS
+    if(task->scheduled && task->deadline != 0 && millis() - task->submitted > task->deadline)
+        this->statistics.deadlineMisses++;
+#endif
+    task->scheduled = false;
+}
+
+bool SIMKAFI::linkContended(SIMKAFITask *task) {
+    const SIMKAFITask *next = this->nextInLine();
+    return next != nullptr && next->priority > task->priority;
+}
+
+void SIMKAFI::yieldLink(SIMKAFITask *task) {
+    if(this->linkOwner != task)
+        return;
+
+    this->linkOwner = nullptr;
+#if SIMKAFI_ENABLE_STATS
+    this->statistics.preemptions++;
+#endif
+}
+
+SIMKAFITask *SIMKAFI::nextInLine() {
+    SIMKAFITask *best = nullptr;
+    unsigned long now = millis();
+
+    for(SIMKAFITask **link = &this->linkQueue; *link != nullptr; ) {
+        SIMKAFITask *task = *link;
+
+        // A flow nobody polls any more must not hold up the ones behind it.
+        if(now - task->asked > SIMKAFI_LINK_QUEUE_TIMEOUT) {
+            *link = task->next;
+            task->queued = false;
+            continue;
+        }
+
+        // The line is kept newest first, so on a tie the task further back asked earlier.
+        if(best == nullptr || !aheadInLine(*best, *task))
+            best = task;
+        link = &task->next;
+    }
+
+    return best;
+}
+
+void SIMKAFI::dequeueTask(const void *task) {
+    for(SIMKAFITask **link = &this->linkQueue; *link != nullptr; link = &(*link)->next)
+        if(*link == task) {
+            (*link)->queued = false;
+            *link = (*link)->next;
+            return;
+        }
+}
+
+SIMKAFITaskState SIMKAFI::runCommand(SIMKAFITask &task, const char *command) {
+    SIMKAFI_TASK_BEGIN(task);
+    SIMKAFI_TASK_WAIT_UNTIL(task, this->lockLink(&task));
+
+    this->startCommand(command);
+    SIMKAFI_TASK_WAIT_UNTIL(task, this->pollResponse() != SIMKAFI_POLL_WAITING);
+
+    return this->finishTask(task, this->polledSuccess() ? SIMKAFI_TASK_DONE : SIMKAFI_TASK_FAILED);
+    SIMKAFI_TASK_END(task);
+}
+
+void SIMKAFI::startCommand(const char *command, const char *until) {
+    this->sendCommand(command);
+    this->armPoll(until);
+}
+
+void SIMKAFI::startCommand(const __FlashStringHelper *command, const char *until) {
+    this->sendCommand(command);
+    this->armPoll(until);
+}
+
+void SIMKAFI::armPoll(const char *until) {
+    this->polledLines = "";
+    this->polledLineStart = 0;
+    this->polledUntil = until;
+    this->polledByte = millis();
+    this->polledAttempts = this->pendingCommand && isRepeatable(this->lastCommand.c_str()) ?
+        this->timeoutPolicies[this->pendingClass].attempts : 1;
+    this->polling = true;
+
+#if SIMKAFI_ENABLE_STATS
+    this->polledSince = millis();
+#endif
+}
+
+SIMKAFIPoll SIMKAFI::pollResponse() {
+    if(!this->polling)
+        return SIMKAFI_POLL_IDLE;
+
+    bool answered = false;
+    while(!answered && this->simKafi.available() > 0) {
+        this->polledByte = millis();
+        answered = this->takeResponseByte(this->polledLines, this->polledLineStart,
+            this->simKafi.read(), this->polledUntil);
+    }
+
+    // The same rules as readResponse(), spread over as many calls as the response takes.
+    if(!answered) {
+        if(millis() - this->polledByte < this->responseTimeout(this->pendingClass))
+            return SIMKAFI_POLL_WAITING;
+
+        this->settleCommand(false);
+        if(this->polledAttempts > 1 && !this->isLinkSuspect()) {
+            this->polledAttempts--;
+            this->polledLines = "";
+            this->polledLineStart = 0;
+            this->polledByte = millis();
+            this->sendCommand(this->lastCommand);
+            return SIMKAFI_POLL_WAITING;
+        }
+    }
+    else if(this->polledUntil == nullptr || *this->polledUntil != '>')
+        this->settleCommand(true);
+
+    this->polling = false;
+
+#if SIMKAFI_ENABLE_STATS
+    this->recordResponse(this->polledLines, this->polledSince);
+#endif
+
+    this->checkHealth();
+
+    this->polledLines.trim();
+    return answered ? SIMKAFI_POLL_ANSWERED : SIMKAFI_POLL_TIMEOUT;
+}
+
+const char *SIMKAFI::polledResponse() const {
+    return this->polledLines.c_str();
+}
+
+bool SIMKAFI::polledSuccess() const {
+    return this->polledLines.endsWith(F("OK"));
+}
+
+SIMKAFITaskState SIMKAFI::finishTask(SIMKAFITask &task, SIMKAFITaskState state) {
+    this->unlockLink(&task);
+    task.resume = 0;
+    return state;
+}
+#endif
+
+void SIMKAFI::countGarbage(char c) {
+    if(isGarbage(c) && this->garbageBytes < 0xFFFF)
+        this->garbageBytes++;
+}
+
+bool SIMKAFI::isLinkSuspect() const {
+    return this->watchdogEnabled && !this->recovering && (
+        (SIMKAFI_WATCHDOG_TIMEOUTS > 0 && this->consecutiveTimeouts >= SIMKAFI_WATCHDOG_TIMEOUTS) ||
+        (SIMKAFI_WATCHDOG_GARBAGE > 0 && this->garbageBytes >= SIMKAFI_WATCHDOG_GARBAGE));
+}
+
+void SIMKAFI::checkHealth() {
+    if(this->isLinkSuspect())
+        this->resync();
+}
+
+bool SIMKAFI::resync() {
+    this->recovering = true;
+    this->invalidateConfigCache();
+#if SIMKAFI_ENABLE_SMS
+    this->smsMirrorValid = false;  // Indications may have been lost with the link.
+#endif
+#if SIMKAFI_ENABLE_GPRS
+    this->setBearer(SIMKAFI_BEARER_UNKNOWN);
+    this->bearerDue = millis();
+#endif
+
+    // ESC ends a "> " prompt the module may still sit in; the probes flush the input.
+    this->simKafi.write(0x1b);
+    bool alive = this->probeLink(SIMKAFI_RESYNC_ATTEMPTS);
+
+    if(!alive && this->resetCallback != nullptr) {
+        this->resetCallback(this->resetCallbackContext);
+        alive = this->probeLink(SIMKAFI_RESYNC_BOOT_ATTEMPTS);
+    }
+
+    this->consecutiveTimeouts = 0;
+    this->garbageBytes = 0;
+
+    if(alive) {
+        for(uint8_t i = 0; i < SIMKAFI_COMMAND_CLASS_COUNT; i++)
+            this->latencyEstimates[i].backoff = 0;
+
+#if SIMKAFI_ENABLE_STATS
+        this->statistics.resyncs++;
+#endif
+
+        this->applyConfig();
+        this->dispatchEvent(SIMKAFI_EVENT_LINK_RESTORED, "", 0);
+    }
+
+    this->recovering = false;
+    return alive;
+}
+
+bool SIMKAFI::applyConfig() {
+    const SIMKAFIModemConfig &config = this->desiredConfig;
+    Command command = F("AT");
+    bool applied = true;
+
+    if(config.messageFormat >= 0) {
+        command += F("+CMGF=");
+        command += (int) config.messageFormat;
+        command += ';';
+    }
+
+#if SIMKAFI_ENABLE_SMS
+    if(config.hasCNMI) {
+        command += F("+CNMI=");
+        appendList(command, config.cnmi, 5);
+        command += ';';
+    }
+
+    if(config.hasCSMP) {
+        command += F("+CSMP=");
+        appendList(command, config.csmp, 4);
+        command += ';';
+    }
+#endif
+
+    if(config.characterSet[0] != '\0') {
+        command += F("+CSCS=\"");
+        command += config.characterSet;
+        command += F("\";");
+    }
+
+#if SIMKAFI_ENABLE_SMS
+    if(config.smsStorage >= 0) {
+        command += F("+CPMS=");
+        appendStorage(command, (SIMKAFISMSStorage) config.smsStorage);
+        command += ';';
+    }
+#endif
+
+#if SIMKAFI_ENABLE_RTC
+    if(config.networkTime >= 0) {
+        command += F("+CLTS=");
+        command += (int) config.networkTime;
+        command += ';';
+    }
+#endif
+
+    if(config.flowControl >= 0)
+        command += config.flowControl ? F("+IFC=2,2;") : F("+IFC=0,0;");
+
+#if SIMKAFI_ENABLE_CALL
+    if(config.callReports >= 0)
+        command += config.callReports ? F("+CLCC=1;") : F("+CLCC=0;");
+#endif
+
+    // A freshly booted module rejects SMS settings until the SIM is ready, so keep trying.
+    if(command.length() > 2) {
+        command.remove(command.length() - 1);
+
+        for(uint8_t attempt = 0; ; attempt++) {
+            this->sendCommand(command);
+            if((applied = this->isSuccessCommand()) || attempt + 1 >= SIMKAFI_RESYNC_ATTEMPTS)
+                break;
+
+            this->pause(1000);
+        }
+
+        // The engineering mode is never part of desiredConfig, so it stays unknown.
+        if(applied)
+            this->knownConfig = config;
+    }
+
+#if SIMKAFI_ENABLE_GPRS
+    // A bearer run by the bearer manager is brought back by serviceBearer() instead.
+    if(this->hasAPN && !this->bearerWanted) {
+        command = F("AT+CGATT=1;");
+        appendCSTT(command, this->apn);
+        this->sendCommand(command);
+
+        this->hasAPN = this->isSuccessCommand();
+        applied = applied && this->hasAPN;
+    }
+#endif
+
+    return applied;
+}
+
+void SIMKAFI::invalidateConfigCache() {
+    clearConfig(this->knownConfig);
+}
+
+bool SIMKAFI::ensureMessageFormat(uint8_t format) {
+    if(this->knownConfig.messageFormat == (int8_t) format)
+        return true;
+
+    this->sendCommand("AT+CMGF=" + Command(format));
+    bool applied = this->isSuccessCommand();
+
+    this->knownConfig.messageFormat = applied ? (int8_t) format : -1;
+    if(applied)
+        this->desiredConfig.messageFormat = (int8_t) format;
+
+    return applied;
+}
+
+#if SIMKAFI_ENABLE_SMS
+bool SIMKAFI::ensureCSMP(const uint8_t csmp[4], bool remember) {
+    if(!this->knownConfig.hasCSMP || memcmp(this->knownConfig.csmp, csmp, 4) != 0) {
+        Command command = F("AT+CSMP=");
+        appendList(command, csmp, 4);
+        this->sendCommand(command);
+
+        if(!(this->knownConfig.hasCSMP = this->isSuccessCommand()))
+            return false;
+        memcpy(this->knownConfig.csmp, csmp, 4);
+    }
+
+    if(remember) {
+        memcpy(this->desiredConfig.csmp, csmp, 4);
+        this->desiredConfig.hasCSMP = true;
+    }
+
+    return true;
+}
+
+bool SIMKAFI::ensureCNMI(const uint8_t cnmi[5]) {
+    if(!this->knownConfig.hasCNMI || memcmp(this->knownConfig.cnmi, cnmi, 5) != 0) {
+        Command command = F("AT+CNMI=");
+        appendList(command, cnmi, 5);
+        this->sendCommand(command);
+
+        if(!(this->knownConfig.hasCNMI = this->isSuccessCommand()))
+            return false;
+        memcpy(this->knownConfig.cnmi, cnmi, 5);
+    }
+
+    memcpy(this->desiredConfig.cnmi, cnmi, 5);
+    this->desiredConfig.hasCNMI = true;
+
+    return true;
+}
+#endif
+
+SIMKAFI::Response SIMKAFI::getResponse() {
+    return this->readResponse(nullptr);
+}
+
+SIMKAFI::Response SIMKAFI::readUnsolicited() {
+    Response lines = this->deferredLines;
+    unsigned long lastByte = millis();
+
+    this->deferredLines = "";
+    while(millis() - lastByte < SIMKAFI_URC_IDLE_TIMEOUT) {
+        if(this->simKafi.available() <= 0) {
+            this->idle(SIMKAFI_URC_IDLE_TIMEOUT - (millis() - lastByte));
+            continue;
+        }
+
+        char c = this->simKafi.read();
+        lines += c;
+        lastByte = millis();
+        this->countGarbage(c);
+
+#if SIMKAFI_ENABLE_STATS
+        this->statistics.bytesReceived++;
+#endif
+    }
+
+    return lines;
+}
+
+SIMKAFI::Response SIMKAFI::getReturnedMode() {
+    Response response = this->getResponse();
+    return response.substring(response.lastIndexOf('\n') + 1);
+}
+
+bool SIMKAFI::isSuccessCommand() {
+    return this->getReturnedMode() == F("OK");
+}
+
+SIMKAFI::Response SIMKAFI::rawQueryOnLine(uint16_t line, const char *until) {
+    Response response = this->readResponse(until);
+    Response result;
+
+    uint16_t currentLine = 0;
+    for(int i = 0; i < response.length(); i++)
+        if(currentLine == line && response[i] != '\n' && response[i] != '\r')
+            result += response[i];
+        else if(response[i] == '\n') {
+            currentLine++;
+
+            if(currentLine > line)
+                break;
+        }
+
+    return result;
+}
+
+SIMKAFI::Response SIMKAFI::queryResult() {
+    Response response = this->getResponse();
+    Response result;
+
+    int idx = response.indexOf(": ");
+    if(idx != -1)
+        result = response.substring(
+            idx + 2,
+            response.indexOf('\n', idx)
+        );
+
+    return result;
+}
+
+SIMKAFI::SIMKAFI(Stream& _simKafi):simKafi(_simKafi){
+    memcpy(this->timeoutPolicies, defaultTimeoutPolicies, sizeof(this->timeoutPolicies));
+    this->resetLatencyEstimates();
+
+    clearConfig(this->desiredConfig);
+    clearConfig(this->knownConfig);
+
+#if SIMKAFI_ENABLE_STATS
+    this->resetStats();
+#endif
+}
+
+bool SIMKAFI::handshake() {
+    this->sendCommand(F("AT"));
+    return this->isSuccessCommand();
+}
+
+bool SIMKAFI::probeLink(uint8_t attempts) {
+    while(attempts-- > 0) {
+        // Sending drops leftovers and any garbage received at a wrong rate.
+        this->sendCommand(F("AT"));
+
+        unsigned long start = millis();
+        char previous = 0;
+        bool ok = false;
+
+        while(!ok && millis() - start < SIMKAFI_BAUD_PROBE_TIMEOUT) {
+            if(this->simKafi.available() <= 0) {
+                this->idle(SIMKAFI_BAUD_PROBE_TIMEOUT - (millis() - start));
+                continue;
+            }
+
+            char c = this->simKafi.read();
+            ok = previous == 'O' && c == 'K';
+            previous = c;
+
+#if SIMKAFI_ENABLE_STATS
+            this->statistics.bytesReceived++;
+#endif
+        }
+
+#if SIMKAFI_ENABLE_STATS
+        if(ok)
+            recordLatency(this->statistics.latency[this->pendingClass], millis() - this->pendingSince);
+        else this->statistics.timeouts++;
+
+        this->statistics.waitMs += millis() - start;
+#endif
+
+        this->pendingCommand = false;
+
+        if(ok)
+            return true;
+    }
+
+    return false;
+}
+
+uint32_t SIMKAFI::detectBaudRate(const uint32_t *rates, uint8_t count, SIMKAFIBaudCallback reconfigure, void *context) {
+    for(uint8_t i = 0; i < count; i++)
+        if(reconfigure(context, rates[i]) && this->probeLink(SIMKAFI_BAUD_PROBE_ATTEMPTS))
+            return rates[i];
+
+    return 0;
+}
+
+uint32_t SIMKAFI::upgradeBaudRate(const uint32_t *rates, uint8_t count, SIMKAFIBaudCallback reconfigure,
+    void *context, bool persist) {
+    uint32_t current = this->detectBaudRate(rates, count, reconfigure, context);
+    uint32_t ceiling = 0xFFFFFFFF;
+
+    while(current != 0) {
+        uint32_t next = 0;
+        for(uint8_t i = 0; i < count; i++)
+            if(rates[i] > current && rates[i] < ceiling && rates[i] > next)
+                next = rates[i];
+
+        if(next == 0)
+            break;
+        ceiling = next;
+
+        // The module acknowledges at the old rate and switches right after the "OK".
+        this->sendCommand("AT+IPR=" + Command(next));
+        if(!this->isSuccessCommand())
+            continue;
+
+        if(reconfigure(context, next) && this->probeLink(SIMKAFI_BAUD_PROBE_ATTEMPTS)) {
+            current = next;
+            break;
+        }
+
+        if(!reconfigure(context, current) || !this->probeLink(SIMKAFI_BAUD_PROBE_ATTEMPTS))
+            current = this->detectBaudRate(rates, count, reconfigure, context);
+    }
+
+    if(current != 0 && persist) {
+        this->sendCommand(F("AT&W"));
+        this->isSuccessCommand();
+    }
+
+    return current;
+}
+
+bool SIMKAFI::setFlowControl(bool enabled) {
+    if(this->knownConfig.flowControl != (int8_t) enabled) {
+        this->sendCommand(enabled ? F("AT+IFC=2,2") : F("AT+IFC=0,0"));
+        this->knownConfig.flowControl = -1;
+
+        if(!this->isSuccessCommand())
+            return false;
+        this->knownConfig.flowControl = (int8_t) enabled;
+    }
+
+    this->desiredConfig.flowControl = (int8_t) enabled;
+    return true;
+}
+
+void SIMKAFI::watchOverflows(const SIMKAFIBufferedStream &stream) {
+    this->rxStream = &stream;
+}
+
+uint32_t SIMKAFI::rxOverflows() const {
+    return this->rxStream != nullptr ? this->rxStream->overflows() : 0;
+}
+
+bool SIMKAFI::isCardReady() {
+    this->sendCommand(F("AT+CPIN?"));
+    return this->isSuccessCommand();
+}
+
+bool SIMKAFI::changeCardPin(uint8_t pin) {
+    if(pin > 9999)
+        return false;
+
+    this->sendCommand("AT+CPIN=\"" + Command(pin) + "\"");
+    return this->isSuccessCommand();
+}
+
+SIMKAFISignal SIMKAFI::signal() {
+    SIMKAFISignal signal;
+    signal.rssi = signal.bit_error_rate = 0;
+    this->sendCommand("AT+CSQ");
+
+    Response response = this->queryResult();
+    int delim = response.indexOf(',');
+
+    if(delim == -1)
+        return signal;
+
+    signal.rssi = (uint8_t) response.substring(0, delim).toInt();
+    signal.bit_error_rate = (uint8_t) response.substring(delim + 1).toInt();
+
+    return signal;
+}
+
+// Read the comma-separated fields of a quoted +CENG list; fields whose bit is set in hexFields are hexadecimal.
+static uint8_t parseCellFields(const char *text, size_t length, uint32_t *values, uint8_t count, uint16_t hexFields) {
+    const char *end = text + length;
+    const char *p = (const char*) memchr(text, '"', length);
+    uint8_t field = 0;
+
+    if(p == nullptr)
+        return 0;
+
+    for(p++; p < end && *p != '"' && field < count; field++) {
+        uint8_t base = (hexFields >> field) & 1 ? 16 : 10;
+        uint32_t value = 0;
+
+        for(; p < end && *p != ',' && *p != '"'; p++) {
+            char c = *p >= 'a' ? *p - 'a' + 'A' : *p;
+            uint8_t digit = c >= '0' && c <= '9' ? c - '0' : c >= 'A' && c <= 'F' ? c - 'A' + 10 : base;
+
+            if(digit < base)
+                value = value * base + digit;
+        }
+
+        values[field] = value;
+        if(p < end && *p == ',')
+            p++;
+    }
+
+    return field;
+}
+
+bool SIMKAFI::diagnostics(SIMKAFIDiagnostics &snapshot) {
+    memset(&snapshot, 0, sizeof(snapshot));
+
+    // Mode 1 with neighbor reporting stays set, so only the first snapshot pays for it.
+    bool setMode = this->knownConfig.engineeringMode != 1;
+    Command command = F("AT");
+    if(setMode)
+        command += F("+CENG=1,1;");
+    command += F("+CSQ;+CREG?;+CGREG?;+COPS?;+CENG?");
+
+    this->diagnosticsTarget = &snapshot;
+    this->lineHandler = &SIMKAFI::takeDiagnosticsLine;
+
+    this->sendCommand(command);
+    bool answered = this->isSuccessCommand();
+
+    this->lineHandler = nullptr;
+    this->diagnosticsTarget = nullptr;
+
+    if(setMode)
+        this->knownConfig.engineeringMode = answered ? 1 : -1;
+    return answered;
+}
+
+bool SIMKAFI::takeDiagnosticsLine(const char *line, size_t length) {
+    SIMKAFIDiagnostics &snapshot = *this->diagnosticsTarget;
+    const char *comma = (const char*) memchr(line, ',', length);
+
+    if(lineStartsWith(line, length, "+CSQ: ")) {
+        snapshot.signal.rssi = (uint8_t) atoi(line + 6);
+        snapshot.signal.bit_error_rate = comma != nullptr ? (uint8_t) atoi(comma + 1) : 0;
+    }
+    // +CREG: <n>,<stat>[,<lac>,<ci>]
+    else if(lineStartsWith(line, length, "+CREG: "))
+        snapshot.registration = comma != nullptr ? (uint8_t) atoi(comma + 1) : 0;
+    else if(lineStartsWith(line, length, "+CGREG: "))
+        snapshot.gprsRegistration = comma != nullptr ? (uint8_t) atoi(comma + 1) : 0;
+    else if(lineStartsWith(line, length, "+COPS: ")) {
+        const char *name = (const char*) memchr(line, '"', length);
+        size_t i = 0;
+
+        for(name = name != nullptr ? name + 1 : line + length; name < line + length && *name != '"' &&
+            i + 1 < sizeof(snapshot.operatorName); name++)
+            snapshot.operatorName[i++] = *name;
+        snapshot.operatorName[i] = '\0';
+    }
+    else if(lineStartsWith(line, length, "+CENG: ")) {
+        // +CENG: 0,"<arfcn>,<rxl>,<rxq>,<mcc>,<mnc>,<bsic>,<cellid>,<rla>,<txp>,<lac>,<TA>"
+        // +CENG: 1,"<arfcn>,<rxl>,<bsic>,<cellid>,<mcc>,<mnc>,<lac>"; "+CENG: 1,1" is the mode.
+        uint32_t values[10];
+        int cell = atoi(line + 7);
+
+        if(cell == 0 && parseCellFields(line, length, values, 10, 0x240) == 10) {
+            SIMKAFICell &serving = snapshot.serving;
+            serving.arfcn = (uint16_t) values[0];
+            serving.rxLevel = (uint8_t) values[1];
+            serving.mcc = (uint16_t) values[3];
+            serving.mnc = (uint16_t) values[4];
+            serving.bsic = (uint8_t) values[5];
+            serving.cellId = (uint16_t) values[6];
+            serving.lac = (uint16_t) values[9];
+        }
+        else if(cell > 0 && snapshot.neighborCount < SIMKAFI_NEIGHBOR_CELLS &&
+            parseCellFields(line, length, values, 7, 0x48) == 7 && (values[0] != 0 || values[1] != 0)) {
+            SIMKAFICell &neighbor = snapshot.neighbors[snapshot.neighborCount++];
+            neighbor.arfcn = (uint16_t) values[0];
+            neighbor.rxLevel = (uint8_t) values[1];
+            neighbor.bsic = (uint8_t) values[2];
+            neighbor.cellId = (uint16_t) values[3];
+            neighbor.mcc = (uint16_t) values[4];
+            neighbor.mnc = (uint16_t) values[5];
+            neighbor.lac = (uint16_t) values[6];
+        }
+    }
+    else return false;
+
+    return true;
+}
+
+// void SIMKAFI::close() {
+//     this->simKafi->end();
+// }
+
+#if SIMKAFI_ENABLE_CALL
+SIMKAFIDialResult SIMKAFI::dialUp(const char *number, uint32_t answerTimeout) {
+    Command command = F("ATD");
+    command += number;
+    command += ';';
+    this->sendCommand(command);
+
+    return this->startCall(number, answerTimeout);
+}
+
+#if !SIMKAFI_NO_HEAP
+SIMKAFIDialResult SIMKAFI::dialUp(String number, uint32_t answerTimeout) {
+    return this->dialUp(number.c_str(), answerTimeout);
+}
+#endif
+
+SIMKAFIDialResult SIMKAFI::redialUp() {
+    this->sendCommand(F("ATDL"));
+    return this->startCall(nullptr, 0);
+}
+
+SIMKAFIDialResult SIMKAFI::startCall(const char *number, uint32_t answerTimeout) {
+    SIMKAFIDialResult result = SIMKAFI_DIAL_RESULT_ERROR;
+    Response mode = this->getReturnedMode();
+
+    if(mode == F("NO DIALTONE"))
+        result = SIMKAFI_DIAL_RESULT_NO_DIALTONE;
+    else if(mode == F("BUSY"))
+        result = SIMKAFI_DIAL_RESULT_BUSY;
+    else if(mode == F("NO CARRIER"))
+        result = SIMKAFI_DIAL_RESULT_NO_CARRIER;
+    else if(mode == F("NO ANSWER"))
+        result = SIMKAFI_DIAL_RESULT_NO_ANSWER;
+    else if(mode == F("OK"))
+        result = SIMKAFI_DIAL_RESULT_OK;
+
+    // A refused dial never became a call, so there is nothing to track or release.
+    if(result != SIMKAFI_DIAL_RESULT_OK)
+        return result;
+
+    // ATDL calls the last number dialed, which is still here if the last call went out.
+    SIMKAFIText last;
+    if(number == nullptr && !this->currentCall.incoming)
+        last = this->currentCall.number;
+
+    if(number == nullptr)
+        number = last.c_str();
+    this->beginCall(false, number, strlen(number));
+    this->callAnswerTimeout = answerTimeout;
+    this->setCallState(SIMKAFI_CALL_DIALING, "", 0);
+
+    return result;
+}
+
+SIMKAFIDialResult SIMKAFI::acceptIncomingCall() {
+    this->sendCommand(F("ATA"));
+
+    SIMKAFIDialResult result = SIMKAFI_DIAL_RESULT_ERROR;
+    Response mode = this->getReturnedMode();
+
+    if(mode == F("NO CARRIER"))
+        result = SIMKAFI_DIAL_RESULT_NO_CARRIER;
+    else if(mode == F("OK"))
+        result = SIMKAFI_DIAL_RESULT_OK;
+
+    if(this->callInProgress()) {
+        if(result == SIMKAFI_DIAL_RESULT_OK)
+            this->setCallState(SIMKAFI_CALL_ACTIVE, "", 0);
+        else if(result == SIMKAFI_DIAL_RESULT_NO_CARRIER)
+            this->releaseCall(SIMKAFI_CALL_END_MISSED);
+    }
+
+    return result;
+}
+
+bool SIMKAFI::hangUp() {
+    this->sendCommand(F("ATH"));
+    if(!this->isSuccessCommand())
+        return false;
+
+    this->callHungUp();
+    return true;
+}
+
+#if SIMKAFI_ENABLE_TASKS
+SIMKAFITaskState SIMKAFI::hangUp(SIMKAFITask &task) {
+    SIMKAFI_TASK_BEGIN(task);
+    SIMKAFI_TASK_WAIT_UNTIL(task, this->lockLink(&task));
+
+    this->startCommand(F("ATH"));
+    SIMKAFI_TASK_WAIT_UNTIL(task, this->pollResponse() != SIMKAFI_POLL_WAITING);
+
+    if(!this->polledSuccess())
+        return this->finishTask(task, SIMKAFI_TASK_FAILED);
+
+    this->callHungUp();
+    return this->finishTask(task, SIMKAFI_TASK_DONE);
+    SIMKAFI_TASK_END(task);
+}
+#endif
+
+void SIMKAFI::callHungUp() {
+    // serviceCall() notes NO_ANSWER before it hangs up a call that rang too long.
+    if(this->callInProgress()) {
+        if(this->callEnding == SIMKAFI_CALL_END_NONE)
+            this->callEnding = SIMKAFI_CALL_END_LOCAL;
+        this->releaseCall(SIMKAFI_CALL_END_NONE);
+    }
+}
+
+bool SIMKAFI::setCallReports(bool enabled) {
+    if(this->knownConfig.callReports != (int8_t) enabled) {
+        this->sendCommand(enabled ? F("AT+CLCC=1") : F("AT+CLCC=0"));
+        this->knownConfig.callReports = -1;
+
+        if(!this->isSuccessCommand())
+            return false;
+        this->knownConfig.callReports = (int8_t) enabled;
+    }
+
+    this->desiredConfig.callReports = (int8_t) enabled;
+    return true;
+}
+
+const SIMKAFICall &SIMKAFI::call() {
+    if(this->callInProgress() && this->currentCall.answered)
+        this->currentCall.duration = (uint32_t) (millis() - this->currentCall.answeredAt);
+
+    return this->currentCall;
+}
+
+SIMKAFICallState SIMKAFI::serviceCall() {
+    if(!this->callInProgress())
+        return this->currentCall.state;
+
+    bool overdue = !this->currentCall.incoming && !this->currentCall.answered && this->callAnswerTimeout > 0 &&
+        millis() - this->currentCall.startedAt >= this->callAnswerTimeout;
+
+    // A refused ATH is tried again a poll interval later, and only a few times.
+    if(overdue && this->callHangUps < SIMKAFI_CALL_HANGUP_ATTEMPTS) {
+        if(this->callHangUps == 0 || millis() - this->callPolled >= SIMKAFI_CALL_POLL_INTERVAL) {
+            this->callHangUps++;
+            this->callPolled = millis();
+            this->callEnding = SIMKAFI_CALL_END_NO_ANSWER;
+            this->hangUp();
+        }
+    }
+    else if(this->knownConfig.callReports != 1 &&
+        millis() - this->callPolled >= SIMKAFI_CALL_POLL_INTERVAL) {
+        this->callPolled = millis();
+        this->refreshCall();
+    }
+
+    return this->currentCall.state;
+}
+
+bool SIMKAFI::refreshCall() {
+    this->sendCommand(F("AT+CLCC"));
+
+    Response response = this->getResponse();
+    if(!response.endsWith(F("OK")))
+        return false;
+
+    const char *data = response.c_str();
+    size_t total = response.length(), start = 0;
+    bool listed = false;
+
+    while(start < total) {
+        const char *newline = (const char*) memchr(data + start, '\n', total - start);
+        size_t end = newline != nullptr ? (size_t) (newline - data) : total;
+        size_t length = end - start;
+
+        while(length > 0 && data[start + length - 1] == '\r')
+            length--;
+
+        if(lineStartsWith(data + start, length, "+CLCC:") && this->trackCall(data + start, length))
+            listed = true;
+        start = end + 1;
+    }
+
+    if(this->callReleasing || (!listed && this->callInProgress()))
+        this->releaseCall(SIMKAFI_CALL_END_NONE);
+    return true;
+}
+
+bool SIMKAFI::callInProgress() const {
+    return this->currentCall.state != SIMKAFI_CALL_IDLE &&
+        this->currentCall.state != SIMKAFI_CALL_RELEASED;
+}
+
+void SIMKAFI::beginCall(bool incoming, const char *number, size_t length) {
+    SIMKAFICall &call = this->currentCall;
+
+    call.incoming = incoming;
+    call.id = 0;
+    call.number = "";
+    for(size_t i = 0; i < length; i++)
+        call.number += number[i];
+    call.startedAt = millis();
+    call.answeredAt = 0;
+    call.answered = false;
+    call.duration = 0;
+    call.cause = SIMKAFI_CALL_END_NONE;
+    call.state = SIMKAFI_CALL_IDLE;
+
+    this->callEnding = SIMKAFI_CALL_END_NONE;
+    this->callReleasing = false;
+    this->callAnswerTimeout = 0;
+    this->callPolled = call.startedAt;
+    this->callHangUps = 0;
+}
+
+bool SIMKAFI::trackCall(const char *line, size_t length) {
+    // +CLCC: <id>,<dir>,<stat>,<mode>,<mpty>[,"<number>",<type>]
+    int fields[5] = { 0, 0, 0, 0, 0 };
+    const char *at = line + 6, *stop = line + length;
+
+    for(uint8_t i = 0; i < 5; i++) {
+        while(at < stop && *at == ' ')
+            at++;
+        if(at >= stop || *at < '0' || *at > '9')
+            return false;
+
+        fields[i] = atoi(at);
+        const char *comma = (const char*) memchr(at, ',', stop - at);
+        at = comma != nullptr ? comma + 1 : stop;
+    }
+
+    const char *number = at, *quote;
+    size_t numberLength = 0;
+    if(at < stop && *at == '"' && (quote = (const char*) memchr(at + 1, '"', stop - at - 1)) != nullptr) {
+        number = at + 1;
+        numberLength = (size_t) (quote - number);
+    }
+
+    // Data and fax calls (mode 1 and 2) are not voice calls.
+    uint8_t id = (uint8_t) fields[0];
+    int stat = fields[2];
+    if(fields[3] != 0)
+        return false;
+
+    if(!this->callInProgress()) {
+        if(stat == 6)
+            return false;
+        this->beginCall(fields[1] == 1, number, numberLength);
+    }
+    else if(this->currentCall.id != 0 && this->currentCall.id != id)
+        return false;
+
+    this->currentCall.id = id;
+    if(this->currentCall.number.length() == 0)
+        for(size_t i = 0; i < numberLength; i++)
+            this->currentCall.number += number[i];
+
+    static const SIMKAFICallState states[] = {
+        SIMKAFI_CALL_ACTIVE, SIMKAFI_CALL_HELD, SIMKAFI_CALL_DIALING,
+        SIMKAFI_CALL_ALERTING, SIMKAFI_CALL_INCOMING, SIMKAFI_CALL_WAITING
+    };
+
+    if(stat == 6)
+        this->callReleasing = true;
+    else if(stat >= 0 && stat < 6)
+        this->setCallState(states[stat], line, length);
+    return true;
+}
+
+void SIMKAFI::setCallState(SIMKAFICallState state, const char *line, size_t length) {
+    SIMKAFICall &call = this->currentCall;
+    if(call.state == state)
+        return;
+
+    if(state == SIMKAFI_CALL_ACTIVE && !call.answered) {
+        call.answered = true;
+        call.answeredAt = millis();
+    }
+
+    call.state = state;
+    this->dispatchEvent(SIMKAFI_EVENT_CALL_STATE, line, length);
+}
+
+void SIMKAFI::releaseCall(SIMKAFICallEnd cause) {
+    SIMKAFICall &call = this->currentCall;
+
+    if(cause == SIMKAFI_CALL_END_NONE)
+        cause = this->callEnding;
+    if(cause == SIMKAFI_CALL_END_NONE)
+        cause = call.answered ? SIMKAFI_CALL_END_NORMAL :
+            call.incoming ? SIMKAFI_CALL_END_MISSED : SIMKAFI_CALL_END_NO_CARRIER;
+
+    // The network says NO CARRIER for a connected call the other side hung up, too.
+    if(cause == SIMKAFI_CALL_END_NO_CARRIER && call.answered)
+        cause = SIMKAFI_CALL_END_NORMAL;
+    if(cause == SIMKAFI_CALL_END_NO_CARRIER && call.incoming)
+        cause = SIMKAFI_CALL_END_MISSED;
+
+    call.duration = call.answered ? (uint32_t) (millis() - call.answeredAt) : 0;
+    call.cause = cause;
+
+    this->callEnding = SIMKAFI_CALL_END_NONE;
+    this->callReleasing = false;
+    this->setCallState(SIMKAFI_CALL_RELEASED, "", 0);
+}
+#endif
+
+#if SIMKAFI_ENABLE_SMS
+// Parameters regular messages go out with unless enableDeliveryReports() changed them.
+static const uint8_t defaultCSMP[4] = { 17, 167, 0, 0 };
+static const uint8_t flashCSMP[4] = { 49, 167, 0, 240 };
+
+bool SIMKAFI::restoreCSMP() {
+    const uint8_t *csmp = this->desiredConfig.hasCSMP ? this->desiredConfig.csmp : defaultCSMP;
+    return !this->knownConfig.hasCSMP || memcmp(this->knownConfig.csmp, csmp, 4) == 0 ||
+        this->ensureCSMP(csmp, false);
+}
+
+bool SIMKAFI::sendSMS(const char *number, const char *message) {
+    if(!this->ensureMessageFormat(1) || !this->restoreCSMP())
+        return false;
+
+    return this->submitSMS(number, message);
+}
+
+bool SIMKAFI::submitSMS(const char *number, const char *message) {
+    Command command = F("AT+CMGS=\"");
+    command += number;
+    command += '"';
+
+    this->sendCommand(command);
+    if(!this->readResponse(">").endsWith(">")) {
+        this->simKafi.write(0x1b);
+        return false;
+    }
+
+    this->sendMessageText(message);
+
+    Response response = this->getResponse();
+    return response.endsWith(F("OK")) && response.indexOf(F("+CMGS:")) != -1;
+}
+
+#if !SIMKAFI_NO_HEAP
+bool SIMKAFI::sendSMS(String number, String message) {
+    return this->sendSMS(number.c_str(), message.c_str());
+}
+#endif
+
+#if SIMKAFI_ENABLE_TASKS
+SIMKAFITaskState SIMKAFI::sendSMS(SIMKAFITask &task, const char *number, const char *message) {
+    SIMKAFI_TASK_BEGIN(task);
+    SIMKAFI_TASK_WAIT_UNTIL(task, this->lockLink(&task));
+
+    if(this->knownConfig.messageFormat != 1) {
+        this->startCommand(F("AT+CMGF=1"));
+        SIMKAFI_TASK_WAIT_UNTIL(task, this->pollResponse() != SIMKAFI_POLL_WAITING);
+
+        this->knownConfig.messageFormat = this->polledSuccess() ? 1 : -1;
+        if(!this->polledSuccess())
+            return this->finishTask(task, SIMKAFI_TASK_FAILED);
+        this->desiredConfig.messageFormat = 1;
+    }
+
+    // Undo the flash class left behind by sendFlashSMS(), if any.
+    if(this->knownConfig.hasCSMP && memcmp(this->knownConfig.csmp,
+        this->desiredConfig.hasCSMP ? this->desiredConfig.csmp : defaultCSMP, 4) != 0) {
+        {
+            Command command = F("AT+CSMP=");
+            appendList(command, this->desiredConfig.hasCSMP ? this->desiredConfig.csmp : defaultCSMP, 4);
+            this->startCommand(command.c_str());
+        }
+        SIMKAFI_TASK_WAIT_UNTIL(task, this->pollResponse() != SIMKAFI_POLL_WAITING);
+
+        if(!(this->knownConfig.hasCSMP = this->polledSuccess()))
+            return this->finishTask(task, SIMKAFI_TASK_FAILED);
+        memcpy(this->knownConfig.csmp, this->desiredConfig.hasCSMP ? this->desiredConfig.csmp : defaultCSMP, 4);
+    }
+
+    {
+        Command command = F("AT+CMGS=\"");
+        command += number;
+        command += '"';
+        this->startCommand(command.c_str(), ">");
+    }
+    SIMKAFI_TASK_WAIT_UNTIL(task, this->pollResponse() != SIMKAFI_POLL_WAITING);
+
+    if(!this->polledLines.endsWith(">")) {
+        this->simKafi.write(0x1b);
+        return this->finishTask(task, SIMKAFI_TASK_FAILED);
+    }
+
+    this->sendMessageText(message);
+    this->armPoll(nullptr);
+    SIMKAFI_TASK_WAIT_UNTIL(task, this->pollResponse() != SIMKAFI_POLL_WAITING);
+
+    return this->finishTask(task, this->polledSuccess() && this->polledLines.indexOf(F("+CMGS:")) != -1 ?
+        SIMKAFI_TASK_DONE : SIMKAFI_TASK_FAILED);
+    SIMKAFI_TASK_END(task);
+}
+#endif
+#endif
+
+SIMKAFIOperator SIMKAFI::networkOperator() {
+    SIMKAFIOperator simOperator;
+    simOperator.mode = static_cast<SIMKAFIOperatorMode>(0);
+    simOperator.format = static_cast<SIMKAFIOperatorFormat>(0);
+    simOperator.name = "";
+
+    this->sendCommand(F("AT+COPS?"));
+
+    Response response = this->queryResult();
+    int delim1 = response.indexOf(','),
+        delim2 = response.indexOf(',', delim1 + 1);
+
+    // "+COPS: 0" alone: not registered, so there is no operator to name.
+    simOperator.mode = intToSIMKAFIOperatorMode((uint8_t) response.toInt());
+    if(delim1 == -1 || delim2 == -1)
+        return simOperator;
+
+    simOperator.format = intToSIMKAFIOperatorFormat((uint8_t) response.substring(delim1 + 1, delim2).toInt());
+    simOperator.name = response.substring(delim2 + 2, response.length() - 2);
+
+    return simOperator;
+}
+
+#if SIMKAFI_ENABLE_GPRS
+bool SIMKAFI::connectAPN(SIMKAFIAPN apn) {
+    if(!this->ensureMessageFormat(1))
+        return false;
+
+    this->sendCommand(F("AT+CGATT=1"));
+    if(!this->isSuccessCommand())
+        return false;
+    
+    Command command = F("AT");
+    appendCSTT(command, apn);
+    this->sendCommand(command);
+
+    if((this->hasAPN = this->isSuccessCommand())) {
+        this->apn = apn;
+        this->setBearer(SIMKAFI_BEARER_IP_START);
+    }
+
+    return this->hasAPN;
+}
+
+bool SIMKAFI::enableGPRS() {
+    if(!this->hasAPN)
+        return false;
+
+    this->sendCommand(F("AT+CIICR"));
+    if(!this->isSuccessCommand())
+        return false;
+
+    this->setBearer(SIMKAFI_BEARER_IP_GPRSACT);
+    return true;
+}
+
+#if SIMKAFI_ENABLE_TASKS
+SIMKAFITaskState SIMKAFI::connectGPRS(SIMKAFITask &task, const SIMKAFIAPN &apn) {
+    SIMKAFI_TASK_BEGIN(task);
+    SIMKAFI_TASK_WAIT_UNTIL(task, this->lockLink(&task));
+
+    {
+        Command command = F("AT+CGATT=1;");
+        appendCSTT(command, apn);
+        this->startCommand(command.c_str());
+    }
+    SIMKAFI_TASK_WAIT_UNTIL(task, this->pollResponse() != SIMKAFI_POLL_WAITING);
+
+    if(!(this->hasAPN = this->polledSuccess()))
+        return this->finishTask(task, SIMKAFI_TASK_FAILED);
+
+    this->apn = apn;
+    this->setBearer(SIMKAFI_BEARER_IP_START);
+
+    this->startCommand(F("AT+CIICR"));
+    SIMKAFI_TASK_WAIT_UNTIL(task, this->pollResponse() != SIMKAFI_POLL_WAITING);
+
+    if(!this->polledSuccess())
+        return this->finishTask(task, SIMKAFI_TASK_FAILED);
+
+    this->setBearer(SIMKAFI_BEARER_IP_GPRSACT);
+    return this->finishTask(task, SIMKAFI_TASK_DONE);
+    SIMKAFI_TASK_END(task);
+}
+#endif
+
+void SIMKAFI::setAPNProfiles(const SIMKAFIAPN *profiles, uint8_t count) {
+    this->apnProfiles = profiles;
+    this->apnProfileCount = profiles != nullptr ? count : 0;
+    this->apnProfile = 0;
+    this->profileFailures = 0;
+}
+
+void SIMKAFI::bearerUp() {
+    this->bearerManaged = true;
+    this->bearerWanted = true;
+    this->bearerFailures = 0;
+    this->profileFailures = 0;
+    this->bearerDue = millis();
+}
+
+void SIMKAFI::bearerDown() {
+    this->bearerManaged = true;
+    this->bearerWanted = false;
+    this->bearerDue = millis();
+}
+
+SIMKAFIBearerState SIMKAFI::bearerState() const {
+    return this->bearer;
+}
+
+bool SIMKAFI::isBearerUp() const {
+    return this->bearer == SIMKAFI_BEARER_IP_STATUS && this->bearerIP[0] != '\0';
+}
+
+const char *SIMKAFI::bearerAddress() const {
+    return this->bearerIP;
+}
+
+uint8_t SIMKAFI::activeAPNProfile() const {
+    return this->apnProfile;
+}
+
+const SIMKAFIAPN *SIMKAFI::bearerProfile() const {
+    if(this->apnProfileCount > 0)
+        return &this->apnProfiles[this->apnProfile];
+    return this->apn.apn.length() > 0 ? &this->apn : nullptr;
+}
+
+SIMKAFIBearerState SIMKAFI::serviceBearer() {
+    // A bearer set up with connectAPN() and enableGPRS() alone is left to the application.
+    if(!this->bearerManaged || (long) (millis() - this->bearerDue) < 0)
+        return this->bearer;
+
+    bool stepped = true;
+    if(!this->bearerWanted) {
+        if(this->bearer != SIMKAFI_BEARER_IP_INITIAL)
+            stepped = this->shutBearer();
+    }
+    else if(this->bearerProfile() == nullptr)
+        return this->bearer;
+    else if(this->bearerShut || this->bearer == SIMKAFI_BEARER_PDP_DEACT)
+        stepped = this->shutBearer();
+    else switch(this->bearer) {
+        case SIMKAFI_BEARER_UNKNOWN:
+        case SIMKAFI_BEARER_IP_CONFIG:
+            stepped = this->queryBearer();
+            break;
+
+        case SIMKAFI_BEARER_IP_INITIAL: {
+            Command command = F("AT+CGATT=1;");
+            appendCSTT(command, *this->bearerProfile());
+            this->sendCommand(command);
+
+            if((stepped = this->isSuccessCommand()))
+                this->setBearer(SIMKAFI_BEARER_IP_START);
+            break;
+        }
+
+        case SIMKAFI_BEARER_IP_START:
+            this->sendCommand(F("AT+CIICR"));
+            if((stepped = this->isSuccessCommand()))
+                this->setBearer(SIMKAFI_BEARER_IP_GPRSACT);
+            break;
+
+        default:
+            if(!this->isBearerUp())
+                stepped = this->readBearerAddress();
+            break;
+    }
+
+    if(!stepped)
+        this->failBearer();
+    return this->bearer;
+}
+
+bool SIMKAFI::queryBearer() {
+    this->sendCommand(F("AT+CIPSTATUS"));
+
+    // The state follows the final "OK" on a line of its own.
+    Response response = this->getResponse();
+    if(response.endsWith(F("OK")))
+        response = this->readResponse("STATE:");
+
+    int at = response.indexOf(F("STATE: "));
+    if(at == -1)
+        return false;
+
+    SIMKAFIBearerState state = parseBearerState(response.c_str() + at + 7);
+    this->setBearer(state);
+
+    // Someone else's AT+CIICR is still activating the context; look again later.
+    if(state == SIMKAFI_BEARER_IP_CONFIG)
+        this->bearerDue = millis() + SIMKAFI_BEARER_CONFIG_WAIT;
+    return true;
+}
 
-void SIMKAFI::sendCommand(String message) {
-    this->simKafi.println(message);
+bool SIMKAFI::shutBearer() {
+    this->sendCommand(F("AT+CIPSHUT"));
+    if(!this->readResponse("SHUT OK").endsWith(F("SHUT OK")))
+        return false;
+
+    this->hasAPN = false;
+    this->bearerShut = false;
+    this->setBearer(SIMKAFI_BEARER_IP_INITIAL);
+    return true;
 }
-String SIMKAFI::getResponseForSMS(long timeout) {
-    String response = "";
-    long startTime = millis();
-    
-    while (millis() - startTime < timeout) {
-        while (this->simKafi.available() > 0) {
-            char c = this->simKafi.read();
-            response += c;
-            startTime = millis();  // Reset timeout on receiving new data
+
+bool SIMKAFI::readBearerAddress() {
+    // The address is the whole answer; no final result code follows it.
+    this->sendCommand(F("AT+CIFSR"));
+
+    Response response = this->readResponse("");
+    Response address = response.substring(response.lastIndexOf('\n') + 1);
+    address.trim();
+
+    if(address.length() < 7 || address.length() >= sizeof(this->bearerIP) ||
+        strspn(address.c_str(), "0123456789.") != address.length())
+        return false;
+
+    bool wasUp = this->isBearerUp();
+    memcpy(this->bearerIP, address.c_str(), address.length() + 1);
+    this->bearer = SIMKAFI_BEARER_IP_STATUS;
+    this->bearerFailures = 0;
+    this->profileFailures = 0;
+
+    if(!wasUp)
+        this->dispatchEvent(SIMKAFI_EVENT_BEARER_UP, "", 0);
+    return true;
+}
+
+bool SIMKAFI::resolve(const char *host, char *address, size_t addressSize) {
+    uint32_t resolved;
+    if(parseAddress(host, strlen(host), resolved)) {
+        formatAddress(resolved, address, addressSize);
+        return true;
+    }
+
+#if SIMKAFI_DNS_CACHE_SIZE > 0
+    SIMKAFIDNSEntry *entry = this->findDNSEntry(host);
+
+    if(entry != nullptr) {
+        this->dnsCounters.hits++;
+        resolved = entry->address;
+    }
+    else {
+        // A lookup that timed out says nothing about the name, so only an answer is remembered.
+        if(this->lookupHost(host, resolved))
+            this->storeDNSEntry(host, resolved);
+    }
+#else
+    this->lookupHost(host, resolved);
+#endif
+
+    if(resolved == 0)
+        return false;
+
+    formatAddress(resolved, address, addressSize);
+    return true;
+}
+
+bool SIMKAFI::lookupHost(const char *host, uint32_t &address) {
+    Command command = F("AT+CDNSGIP=\"");
+    command += host;
+    command += '"';
+
+    this->dnsCounters.misses++;
+    this->sendCommand(command);
+
+    // "OK" accepts the lookup; +CDNSGIP: 1,"<host>","<address>"[,"<address>"] follows with the answer.
+    Response response = this->getResponse();
+    bool answered = false;
+    if(response.endsWith(F("OK"))) {
+        // The answer takes seconds over the network, far beyond the learned timeout for the
+        // command itself; a slow one is no sign of a stuck module, so it stays out of the watchdog.
+        response = "";
+        answered = this->collectResponse(response, "+CDNSGIP:", this->responseTimeout(SIMKAFI_COMMAND_CLASS_DATA_CONNECT));
+    }
+
+    address = 0;
+    int at = response.indexOf(F("+CDNSGIP: 1,\""));
+    int hostEnd = at != -1 ? response.indexOf('"', at + 14) : -1;
+    int start = hostEnd != -1 ? response.indexOf('"', hostEnd + 1) : -1;
+    int end = start != -1 ? response.indexOf('"', start + 1) : -1;
+
+    if(end == -1 || !parseAddress(response.c_str() + start + 1, end - start - 1, address)) {
+        address = 0;
+        this->dnsCounters.failures++;
+        return answered;
+    }
+
+    return true;
+}
+
+#if SIMKAFI_DNS_CACHE_SIZE > 0
+SIMKAFIDNSEntry *SIMKAFI::findDNSEntry(const char *host) {
+    uint32_t hostHash = hashHost(host);
+
+    for(uint8_t i = 0; i < SIMKAFI_DNS_CACHE_SIZE; i++) {
+        SIMKAFIDNSEntry &entry = this->dnsCache[i];
+
+        // Two names may share a hash, so the name itself decides.
+        if(entry.hostHash == hostHash && sameHost(entry.host, host)) {
+            if((long) (entry.expires - millis()) > 0)
+                return &entry;
+
+            entry.hostHash = 0;
         }
     }
 
-    response.trim();
-    return response;
+    return nullptr;
 }
-String SIMKAFI::getResponse() {
-    delay(500);
-    
-    if(this->simKafi.available() > 0) {
-        String response = this->simKafi.readString();
-        response.trim();
 
-        return response;
+void SIMKAFI::storeDNSEntry(const char *host, uint32_t address) {
+    size_t length = strlen(host);
+    if(length >= SIMKAFI_DNS_NAME_SIZE)
+        return;
+
+    SIMKAFIDNSEntry *slot = &this->dnsCache[0];
+    unsigned long now = millis();
+
+    for(uint8_t i = 0; i < SIMKAFI_DNS_CACHE_SIZE; i++) {
+        SIMKAFIDNSEntry &entry = this->dnsCache[i];
+
+        if(entry.hostHash == 0 || (long) (entry.expires - now) <= 0) {
+            slot = &entry;
+            break;
+        }
+        if((long) (entry.expires - slot->expires) < 0)
+            slot = &entry;
     }
 
-    return "";
+    slot->hostHash = hashHost(host);
+    memcpy(slot->host, host, length + 1);
+    slot->address = address;
+    slot->expires = now + (address != 0 ? SIMKAFI_DNS_TTL : SIMKAFI_DNS_FAILURE_TTL);
 }
+#endif
 
-String SIMKAFI::getReturnedMode() {
-    String response = this->getResponse();
-    return response.substring(response.lastIndexOf('\n') + 1);
+void SIMKAFI::flushDNSCache() {
+#if SIMKAFI_DNS_CACHE_SIZE > 0
+    memset(this->dnsCache, 0, sizeof(this->dnsCache));
+#endif
 }
 
-bool SIMKAFI::isSuccessCommand() {
-    return this->getReturnedMode() == F("OK");
+const SIMKAFIDNSStats &SIMKAFI::dnsStats() const {
+    return this->dnsCounters;
 }
 
-String SIMKAFI::rawQueryOnLine(uint16_t line) {
-    String response = this->getResponse();
-    String result = "";
+void SIMKAFI::setBearer(SIMKAFIBearerState state) {
+    bool wasUp = this->isBearerUp();
 
-    uint16_t currentLine = 0;
-    for(int i = 0; i < response.length(); i++)
-        if(currentLine == line && response[i] != '\n')
-            result += response[i];
-        else if(response[i] == '\n') {
-            currentLine++;
+    this->bearer = state;
+    if(state != SIMKAFI_BEARER_IP_STATUS)
+        this->bearerIP[0] = '\0';
 
-            if(currentLine > line)
-                break;
-        }
+    if(wasUp && !this->isBearerUp())
+        this->dispatchEvent(SIMKAFI_EVENT_BEARER_DOWN, "", 0);
+}
 
-    return result;
+void SIMKAFI::failBearer() {
+    this->bearerShut = true;
+    if(this->bearerFailures < 0xFF)
+        this->bearerFailures++;
+
+    if(++this->profileFailures >= SIMKAFI_BEARER_PROFILE_ATTEMPTS && this->apnProfileCount > 1) {
+        this->apnProfile = (uint8_t) ((this->apnProfile + 1) % this->apnProfileCount);
+        this->profileFailures = 0;
+    }
+
+    uint32_t backoff = SIMKAFI_BEARER_BACKOFF_MIN;
+    for(uint8_t i = 1; i < this->bearerFailures && backoff < SIMKAFI_BEARER_BACKOFF_MAX; i++)
+        backoff <<= 1;
+
+    this->bearerDue = millis() + (backoff < SIMKAFI_BEARER_BACKOFF_MAX ? backoff : SIMKAFI_BEARER_BACKOFF_MAX);
+}
+#endif
+
+#if SIMKAFI_ENABLE_HTTP
+typedef struct _SIMKAFITextSource {
+    const char *text;
+    size_t left;
+} SIMKAFITextSource;
+
+static size_t readText(void *context, uint8_t *buffer, size_t size) {
+    SIMKAFITextSource *source = static_cast<SIMKAFITextSource*>(context);
+    if(size > source->left)
+        size = source->left;
+
+    memcpy(buffer, source->text, size);
+    source->text += size;
+    source->left -= size;
+    return size;
 }
 
-String SIMKAFI::queryResult() {
-    String response = this->getResponse();
-    String result = F("");
+static size_t readStream(void *context, uint8_t *buffer, size_t size) {
+    return static_cast<Stream*>(context)->readBytes(buffer, size);
+}
 
-    int idx = response.indexOf(": ");
-    if(idx != -1)
-        result = response.substring(
-            idx + 2,
-            response.indexOf('\n', idx)
-        );
+#if SIMKAFI_ENABLE_TASKS
+typedef struct _SIMKAFIRequestWindow {
+    uint32_t offset;
+    uint8_t *out;
+    size_t size;
+    uint32_t total;
+} SIMKAFIRequestWindow;
+
+// Appends a piece of the request, copying the part of it that falls inside the window.
+static void renderPiece(SIMKAFIRequestWindow &window, const char *text, size_t length) {
+    uint32_t start = window.total, end = window.total + length;
+    uint32_t from = start > window.offset ? start : window.offset;
+    uint32_t to = end < window.offset + window.size ? end : window.offset + window.size;
+
+    if(from < to)
+        memcpy(window.out + (from - window.offset), text + (from - start), to - from);
+    window.total = end;
+}
 
-    return result;
+// Copies size bytes of the request as it goes on the wire, starting at offset, and returns its
+// total length; a flow sending it keeps an offset across its waits instead of a buffer.
+static uint32_t renderRequest(const SIMKAFIHTTPRequest &request, uint32_t offset, uint8_t *out, size_t size) {
+    SIMKAFIRequestWindow window = { offset, out, size, 0 };
+    char length[11];
+    snprintf(length, sizeof(length), "%u", (unsigned int) request.data.length());
+
+    const char *head[] = {
+        request.method.c_str(), " ", request.resource.c_str(), " HTTP/1.0\r\nHost: ", request.domain.c_str(), "\r\n"
+    };
+
+    for(uint8_t i = 0; i < sizeof(head) / sizeof(head[0]); i++)
+        renderPiece(window, head[i], strlen(head[i]));
+
+    for(uint16_t i = 0; i < request.header_count; i++) {
+        renderPiece(window, request.headers[i].key.c_str(), request.headers[i].key.length());
+        renderPiece(window, ": ", 2);
+        renderPiece(window, request.headers[i].value.c_str(), request.headers[i].value.length());
+        renderPiece(window, "\r\n", 2);
+    }
+
+    if(request.data.length() > 0) {
+        renderPiece(window, "Content-Length: ", 16);
+        renderPiece(window, length, strlen(length));
+        renderPiece(window, "\r\n", 2);
+    }
+
+    renderPiece(window, "\r\n", 2);
+    renderPiece(window, request.data.c_str(), request.data.length());
+    return window.total;
 }
 
-SIMKAFI::SIMKAFI(Stream& _simKafi):simKafi(_simKafi){}
+static size_t nextChunk(const SIMKAFITask &task) {
+    uint32_t left = task.length - task.offset;
+    return left < SIMKAFI_CIPSEND_CHUNK ? (size_t) left : SIMKAFI_CIPSEND_CHUNK;
+}
+#endif
 
-bool SIMKAFI::handshake() {
-    this->sendCommand(F("AT"));
-    return this->isSuccessCommand();
+SIMKAFIHTTPResponse SIMKAFI::request(SIMKAFIHTTPRequest request) {
+    SIMKAFITextSource body = { request.data.c_str(), request.data.length() };
+    return this->request(request, &readText, &body, body.left);
 }
 
-bool SIMKAFI::isCardReady() {
-    this->sendCommand(F("AT+CPIN?"));
-    return this->isSuccessCommand();
+SIMKAFIHTTPResponse SIMKAFI::request(const SIMKAFIHTTPRequest &request, Stream &body, uint32_t contentLength) {
+    return this->request(request, &readStream, &body, contentLength);
 }
 
-bool SIMKAFI::changeCardPin(uint8_t pin) {
-    if(pin > 9999)
-        return false;
+SIMKAFIHTTPResponse SIMKAFI::request(const SIMKAFIHTTPRequest &request, SIMKAFIHTTPBodySource source,
+    void *context, uint32_t contentLength) {
+    SIMKAFIHTTPResponse response;
+    response.status = SIMKAFI_HTTP_STATUS_FAILED;
 
-    this->sendCommand("AT+CPIN=\"" + String(pin) + "\"");
-    return this->isSuccessCommand();
+    if(!this->openConnection(request))
+        return response;
+
+    // Everything goes out through one chunk buffer; nothing is assembled in a String.
+    uint8_t chunk[SIMKAFI_CIPSEND_CHUNK];
+    size_t used = 0;
+    char length[11];
+    snprintf(length, sizeof(length), "%lu", (unsigned long) contentLength);
+
+    const char *head[] = {
+        request.method.c_str(), " ", request.resource.c_str(), " HTTP/1.0\r\nHost: ", request.domain.c_str(), "\r\n"
+    };
+
+    bool sent = true;
+    for(uint8_t i = 0; sent && i < sizeof(head) / sizeof(head[0]); i++)
+        sent = this->stageChunk(chunk, used, head[i], strlen(head[i]));
+
+    for(uint16_t i = 0; sent && i < request.header_count; i++)
+        sent = this->stageChunk(chunk, used, request.headers[i].key.c_str(), request.headers[i].key.length()) &&
+            this->stageChunk(chunk, used, ": ", 2) &&
+            this->stageChunk(chunk, used, request.headers[i].value.c_str(), request.headers[i].value.length()) &&
+            this->stageChunk(chunk, used, "\r\n", 2);
+
+    if(sent && contentLength > 0)
+        sent = this->stageChunk(chunk, used, "Content-Length: ", 16) &&
+            this->stageChunk(chunk, used, length, strlen(length)) &&
+            this->stageChunk(chunk, used, "\r\n", 2);
+    sent = sent && this->stageChunk(chunk, used, "\r\n", 2);
+
+    for(uint32_t remaining = contentLength; sent && remaining > 0; ) {
+        size_t room = sizeof(chunk) - used;
+        if(room > remaining)
+            room = (size_t) remaining;
+
+        size_t read = source(context, chunk + used, room);
+        if(read == 0 || read > room) {
+            sent = false;
+            break;
+        }
+
+        used += read;
+        remaining -= read;
+
+        if(used == sizeof(chunk)) {
+            sent = this->sendChunk(chunk, used);
+            used = 0;
+        }
+    }
+
+    if(sent && used > 0)
+        sent = this->sendChunk(chunk, used);
+
+    // A body cut short would leave the server waiting for the rest.
+    if(!sent) {
+        this->sendCommand(F("AT+CIPCLOSE"));
+        this->readResponse("CLOSE");
+        return response;
+    }
+
+    response.status = SIMKAFI_HTTP_STATUS_SENT;
+    return response;
 }
 
-SIMKAFISignal SIMKAFI::signal() {
-    SIMKAFISignal signal;
-    signal.rssi = signal.bit_error_rate = 0;
-    this->sendCommand("AT+CSQ");
+#if SIMKAFI_ENABLE_TASKS
+SIMKAFITaskState SIMKAFI::request(SIMKAFITask &task, const SIMKAFIHTTPRequest &request) {
+    SIMKAFI_TASK_BEGIN(task);
+    if(!this->hasAPN && !this->isBearerUp())
+        SIMKAFI_TASK_EXIT(task, SIMKAFI_TASK_FAILED);
+    SIMKAFI_TASK_WAIT_UNTIL(task, this->lockLink(&task));
+
+    {
+        Command command = F("AT+CIPSTART=\"TCP\",\"");
+#if SIMKAFI_DNS_CACHE_SIZE > 0
+        // A lookup would block, so only a cached address is used; the module resolves anything else.
+        SIMKAFIDNSEntry *entry = this->findDNSEntry(request.domain.c_str());
+        if(entry != nullptr && entry->address != 0) {
+            char address[16];
+            formatAddress(entry->address, address, sizeof(address));
+
+            this->dnsCounters.hits++;
+            command += address;
+        }
+        else
+#endif
+        command += request.domain;
+        command += F("\",");
+        command += request.port;
+        this->startCommand(command.c_str());
+    }
+    SIMKAFI_TASK_WAIT_UNTIL(task, this->pollResponse() != SIMKAFI_POLL_WAITING);
 
-    String response = this->queryResult();
-    uint8_t delim = response.indexOf(',');
+    if(!this->polledSuccess())
+        return this->finishTask(task, SIMKAFI_TASK_FAILED);
 
-    if(delim == -1)
-        return signal;
+    // "OK" accepts the command; the connection result follows once the handshake is done.
+    this->armPoll("CONNECT");
+    SIMKAFI_TASK_WAIT_UNTIL(task, this->pollResponse() != SIMKAFI_POLL_WAITING);
 
-    signal.rssi = (uint8_t) response.substring(0, delim).toInt();
-    signal.bit_error_rate = (uint8_t) response.substring(delim + 1).toInt();
+    if(!this->polledLines.endsWith(F("CONNECT OK")))
+        return this->finishTask(task, SIMKAFI_TASK_FAILED);
 
-    return signal;
+    task.offset = 0;
+    task.length = renderRequest(request, 0, nullptr, 0);
+    task.step = 0;
+
+    while(task.offset < task.length) {
+        {
+            Command command = F("AT+CIPSEND=");
+            command += (unsigned int) nextChunk(task);
+            this->startCommand(command.c_str(), ">");
+        }
+        SIMKAFI_TASK_WAIT_UNTIL(task, this->pollResponse() != SIMKAFI_POLL_WAITING);
+
+        if(!this->polledLines.endsWith(">")) {
+            this->simKafi.write(0x1b);
+            task.step = 1;
+            break;
+        }
+
+        // The chunk is rendered when it is sent, so no buffer outlives a wait.
+        {
+            uint8_t chunk[SIMKAFI_CIPSEND_CHUNK];
+            size_t length = nextChunk(task);
+
+            renderRequest(request, task.offset, chunk, length);
+            this->writeChunk(chunk, length);
+            task.offset += length;
+        }
+        this->armPoll("SEND");
+        SIMKAFI_TASK_WAIT_UNTIL(task, this->pollResponse() != SIMKAFI_POLL_WAITING);
+
+        if(!this->polledLines.endsWith(F("SEND OK"))) {
+            task.step = 1;
+            break;
+        }
+    }
+
+    if(task.step == 0)
+        return this->finishTask(task, SIMKAFI_TASK_DONE);
+
+    // A request cut short would leave the server waiting for the rest.
+    this->startCommand(F("AT+CIPCLOSE"), "CLOSE");
+    SIMKAFI_TASK_WAIT_UNTIL(task, this->pollResponse() != SIMKAFI_POLL_WAITING);
+
+    return this->finishTask(task, SIMKAFI_TASK_FAILED);
+    SIMKAFI_TASK_END(task);
 }
+#endif
 
-// void SIMKAFI::close() {
-//     this->simKafi->end();
-// }
+bool SIMKAFI::openConnection(const SIMKAFIHTTPRequest &request) {
+    if(!this->hasAPN && !this->isBearerUp())
+        return false;
 
-SIMKAFIDialResult SIMKAFI::dialUp(String number) {
-    this->sendCommand("ATD+ " + number + ";");
+    // Connecting by address spares the module its own DNS lookup; without one it still gets the name.
+    char address[16];
+    Command command = F("AT+CIPSTART=\"TCP\",\"");
+    if(this->resolve(request.domain.c_str(), address, sizeof(address)))
+        command += address;
+    else command += request.domain;
+    command += F("\",");
+    command += request.port;
+    this->sendCommand(command);
+    
+    // "OK" accepts the command; the connection result follows once the handshake is done.
+    return this->isSuccessCommand() && this->readResponse("CONNECT").endsWith(F("CONNECT OK"));
+}
 
-    SIMKAFIDialResult result = SIMKAFI_DIAL_RESULT_ERROR;
-    String mode = this->getReturnedMode();
+bool SIMKAFI::sendChunk(const uint8_t *data, size_t length) {
+    Command command = F("AT+CIPSEND=");
+    command += (unsigned int) length;
 
-    if(mode == F("NO DIALTONE"))
-        result = SIMKAFI_DIAL_RESULT_NO_DIALTONE;
-    else if(mode == F("BUSY"))
-        result = SIMKAFI_DIAL_RESULT_BUSY;
-    else if(mode == F("NO CARRIER"))
-        result = SIMKAFI_DIAL_RESULT_NO_CARRIER;
-    else if(mode == F("NO ANSWER"))
-        result = SIMKAFI_DIAL_RESULT_NO_ANSWER;
-    else if(mode == F("OK"))
-        result = SIMKAFI_DIAL_RESULT_OK;
+    this->sendCommand(command);
+    if(!this->readResponse(">").endsWith(">")) {
+        this->simKafi.write(0x1b);
+        return false;
+    }
 
-    return result;
+    this->writeChunk(data, length);
+    return this->readResponse("SEND").endsWith(F("SEND OK"));
 }
 
-SIMKAFIDialResult SIMKAFI::redialUp() {
-    this->sendCommand(F("ATDL"));
+void SIMKAFI::writeChunk(const uint8_t *data, size_t length) {
+    // With a length the module takes exactly that many bytes and needs no Ctrl-Z.
+    this->simKafi.write(data, length);
 
-    SIMKAFIDialResult result = SIMKAFI_DIAL_RESULT_ERROR;
-    String mode = this->getReturnedMode();
+#if SIMKAFI_ENABLE_STATS
+    this->statistics.bytesSent += length;
+#endif
 
-    if(mode == F("NO DIALTONE"))
-        result = SIMKAFI_DIAL_RESULT_NO_DIALTONE;
-    else if(mode == F("BUSY"))
-        result = SIMKAFI_DIAL_RESULT_BUSY;
-    else if(mode == F("NO CARRIER"))
-        result = SIMKAFI_DIAL_RESULT_NO_CARRIER;
-    else if(mode == F("NO ANSWER"))
-        result = SIMKAFI_DIAL_RESULT_NO_ANSWER;
-    else if(mode == F("OK"))
-        result = SIMKAFI_DIAL_RESULT_OK;
+    this->pendingSince = millis();
+    this->pendingCommand = true;
+}
+
+bool SIMKAFI::stageChunk(uint8_t *chunk, size_t &used, const char *text, size_t length) {
+    while(length > 0) {
+        size_t take = SIMKAFI_CIPSEND_CHUNK - used;
+        if(take > length)
+            take = length;
+
+        memcpy(chunk + used, text, take);
+        used += take;
+        text += take;
+        length -= take;
+
+        if(used == SIMKAFI_CIPSEND_CHUNK) {
+            if(!this->sendChunk(chunk, used))
+                return false;
+            used = 0;
+        }
+    }
+
+    return true;
+}
+#endif
+
+#if SIMKAFI_ENABLE_FTP
+SIMKAFIFTPResult SIMKAFI::ftpUpload(const SIMKAFIFTPServer &server, const char *path, const char *name,
+    SIMKAFIFTPSource source, void *context, uint32_t offset) {
+    SIMKAFIFTPResult result = { false, 0, 0 };
+    this->ftpReported = -1;
+
+    // A resumed upload appends to what the server already has.
+    if(!this->openFTPSession(server, true, path, name) ||
+        !this->sendFTPText(F("AT+FTPPUTOPT="), offset > 0 ? "APPE" : "STOR"))
+        return result;
+
+    this->sendCommand(F("AT+FTPPUT=1"));
+    if(!this->isSuccessCommand())
+        return result;
+
+    // "+FTPPUT: 1,1,<maximum length>" asks for data, "1,0" confirms the file, anything else is an error.
+    int16_t status = this->waitFTPStatus("+FTPPUT: 1,");
+    uint8_t chunk[SIMKAFI_FTP_CHUNK];
+
+    while(status == 1) {
+        size_t size = this->ftpLimit > 0 && this->ftpLimit < sizeof(chunk) ? this->ftpLimit : sizeof(chunk);
+        size_t length = source(context, chunk, size);
+        if(length > size)
+            break;
+
+        Command command = F("AT+FTPPUT=2,");
+        command += (unsigned int) length;
+        this->sendCommand(command);
+
+        // A zero length closes the file; the server's confirmation follows as "+FTPPUT: 1,0".
+        if(length == 0) {
+            status = this->isSuccessCommand() ? this->waitFTPStatus("+FTPPUT: 1,") : -1;
+            break;
+        }
+
+        if(this->readResponse("+FTPPUT: 2,").indexOf(F("+FTPPUT: 2,")) == -1)
+            break;
+
+        this->simKafi.write(chunk, length);
+
+#if SIMKAFI_ENABLE_STATS
+        this->statistics.bytesSent += length;
+#endif
+
+        this->pendingSince = millis();
+        this->pendingCommand = true;
+
+        if(!this->isSuccessCommand())
+            break;
+
+        result.transferred += length;
+        this->reportFTPProgress(offset + result.transferred);
+
+        status = this->waitFTPStatus("+FTPPUT: 1,");
+    }
+
+    result.complete = status == 0;
+    result.error = status > 1 ? (uint8_t) status : 0;
+
+    if(status == 1) {
+        this->sendCommand(F("AT+FTPQUIT"));
+        this->getResponse();
+    }
 
     return result;
 }
 
-SIMKAFIDialResult SIMKAFI::acceptIncomingCall() {
-    this->sendCommand(F("ATA"));
+SIMKAFIFTPResult SIMKAFI::ftpDownload(const SIMKAFIFTPServer &server, const char *path, const char *name,
+    SIMKAFIFTPSink sink, void *context, uint32_t offset) {
+    SIMKAFIFTPResult result = { false, 0, 0 };
+    this->ftpReported = -1;
 
-    SIMKAFIDialResult result = SIMKAFI_DIAL_RESULT_ERROR;
-    String mode = this->getReturnedMode();
+    if(!this->openFTPSession(server, false, path, name))
+        return result;
 
-    if(mode == F("NO CARRIER"))
-        result = SIMKAFI_DIAL_RESULT_NO_CARRIER;
-    else if(mode == F("OK"))
-        result = SIMKAFI_DIAL_RESULT_OK;
+    Command command = F("AT+FTPREST=");
+    command += offset;
+    this->sendCommand(command);
+    if(!this->isSuccessCommand())
+        return result;
+
+    this->sendCommand(F("AT+FTPGET=1"));
+    if(!this->isSuccessCommand())
+        return result;
+
+    // "+FTPGET: 1,1" announces data, "1,0" the end of the file, anything else is an error.
+    int16_t status = this->waitFTPStatus("+FTPGET: 1,");
+    uint8_t chunk[SIMKAFI_FTP_CHUNK];
+
+    while(status == 1) {
+        command = F("AT+FTPGET=2,");
+        command += (unsigned int) sizeof(chunk);
+        this->sendCommand(command);
+
+        // "+FTPGET: 2,<length>" is followed by exactly that many raw bytes, then "OK".
+        Response response = this->readResponse("+FTPGET: 2,");
+        int at = response.indexOf(F("+FTPGET: 2,"));
+        if(at == -1)
+            break;
+
+        size_t length = (size_t) atol(response.c_str() + at + 11);
+        if(length == 0) {
+            // Nothing buffered yet; the next status tells whether more is coming.
+            this->getResponse();
+            status = this->waitFTPStatus("+FTPGET: 1,");
+            continue;
+        }
+
+        if(length > sizeof(chunk) || !this->readData(chunk, length))
+            break;
+        this->getResponse();
+
+        if(!sink(context, chunk, length))
+            break;
+
+        result.transferred += length;
+        this->reportFTPProgress(offset + result.transferred);
+    }
+
+    result.complete = status == 0;
+    result.error = status > 1 ? (uint8_t) status : 0;
+
+    if(status == 1) {
+        this->sendCommand(F("AT+FTPQUIT"));
+        this->getResponse();
+    }
 
     return result;
 }
 
-bool SIMKAFI::hangUp() {
-    this->sendCommand(F("ATH"));
-    return this->isSuccessCommand();
+void SIMKAFI::setFTPProgressCallback(SIMKAFIFTPProgress callback, void *context) {
+    this->ftpProgress = callback;
+    this->ftpProgressContext = context;
 }
 
-bool SIMKAFI::sendSMS(String number, String message) {
-	
-    this->handshake();
-
-    this->sendCommand(F("AT+CMGF=1"));
-    delay(500);
-    this->sendCommand("AT+CMGS=\"" + number + "\"");
-    delay(500);
-    this->sendCommand(message);
-    delay(500);
-    this->simKafi.write(0x1a);
+bool SIMKAFI::openFTPBearer() {
+    this->sendCommand(F("AT+SAPBR=2,1"));
+    if(this->getResponse().indexOf(F("+SAPBR: 1,1")) != -1)
+        return true;
 
-    return this->getReturnedMode().startsWith(">");
-}
+    const SIMKAFIAPN *profile = this->bearerProfile();
+    if(profile == nullptr)
+        return false;
 
-SIMKAFIOperator SIMKAFI::networkOperator() {
-    SIMKAFIOperator simOperator;
-    simOperator.mode = static_cast<SIMKAFIOperatorMode>(0);
-    simOperator.format = static_cast<SIMKAFIOperatorFormat>(0);
-    simOperator.name = "";
+    Command command = F("AT+SAPBR=3,1,\"Contype\",\"GPRS\";+SAPBR=3,1,\"APN\",\"");
+    command += profile->apn;
+    command += '"';
 
-    this->sendCommand(F("AT+COPS?"));
+    if(profile->username.length() > 0) {
+        command += F(";+SAPBR=3,1,\"USER\",\"");
+        command += profile->username;
+        command += '"';
+    }
 
-    String response = this->queryResult();
-    uint8_t delim1 = response.indexOf(','),
-        delim2 = response.indexOf(',', delim1 + 1);
+    if(profile->password.length() > 0) {
+        command += F(";+SAPBR=3,1,\"PWD\",\"");
+        command += profile->password;
+        command += '"';
+    }
 
-    simOperator.mode = intToSIMKAFIOperatorMode((uint8_t) response.substring(0, delim1).toInt());
-    simOperator.format = intToSIMKAFIOperatorFormat((uint8_t) response.substring(delim1 + 1, delim2).toInt());
-    simOperator.name = response.substring(delim2 + 2, response.length() - 2);
+    this->sendCommand(command);
+    if(!this->isSuccessCommand())
+        return false;
 
-    return simOperator;
+    this->sendCommand(F("AT+SAPBR=1,1"));
+    return this->isSuccessCommand();
 }
 
-bool SIMKAFI::connectAPN(SIMKAFIAPN apn) {
-    this->sendCommand(F("AT+CMGF=1"));
-    if(!this->isSuccessCommand())
+bool SIMKAFI::openFTPSession(const SIMKAFIFTPServer &server, bool upload, const char *path, const char *name) {
+    if(!this->openFTPBearer())
         return false;
 
-    this->sendCommand(F("AT+CGATT=1"));
-    if(!this->isSuccessCommand())
+    Command command = F("AT+FTPCID=1;+FTPTYPE=\"I\";+FTPPORT=");
+    command += server.port;
+    this->sendCommand(command);
+
+    return this->isSuccessCommand() &&
+        this->sendFTPText(F("AT+FTPSERV="), server.host.c_str()) &&
+        this->sendFTPText(F("AT+FTPUN="), server.username.c_str()) &&
+        this->sendFTPText(F("AT+FTPPW="), server.password.c_str()) &&
+        this->sendFTPText(upload ? F("AT+FTPPUTPATH=") : F("AT+FTPGETPATH="), path) &&
+        this->sendFTPText(upload ? F("AT+FTPPUTNAME=") : F("AT+FTPGETNAME="), name);
+}
+
+bool SIMKAFI::sendFTPText(const __FlashStringHelper *command, const char *value) {
+    Command line = command;
+    line += '"';
+    line += value;
+    line += '"';
+
+    this->sendCommand(line);
+    return this->isSuccessCommand();
+}
+
+bool SIMKAFI::takeFTPStatus(const char *line, size_t length) {
+    if(!lineStartsWith(line, length, "+FTPPUT: 1,") && !lineStartsWith(line, length, "+FTPGET: 1,"))
         return false;
-    
-    this->sendCommand(
-        "AT+CSTT=\"" + apn.apn +
-        "\",\"" + apn.username +
-        "\",\"" + apn.password + "\""
-    );
 
-    return (this->hasAPN = this->isSuccessCommand());
+    const char *limit = (const char*) memchr(line + 11, ',', length - 11);
+    this->ftpReported = (int16_t) atoi(line + 11);
+    this->ftpLimit = limit != nullptr ? (uint16_t) atol(limit + 1) : 0;
+
+    return true;
+}
+
+int16_t SIMKAFI::waitFTPStatus(const char *until) {
+    if(this->ftpReported < 0) {
+        Response response = this->readResponse(until);
+        int at = response.indexOf(until);
+
+        if(at != -1)
+            this->takeFTPStatus(response.c_str() + at, response.length() - at);
+    }
+
+    int16_t status = this->ftpReported;
+    this->ftpReported = -1;
+    return status;
+}
+
+bool SIMKAFI::readData(uint8_t *buffer, size_t length) {
+    unsigned long timeout = this->responseTimeout(this->pendingClass);
+    unsigned long lastByte = millis();
+    size_t received = 0;
+
+    while(received < length && millis() - lastByte < timeout) {
+        if(this->simKafi.available() <= 0) {
+            this->idle(timeout - (millis() - lastByte));
+            continue;
+        }
+
+        buffer[received++] = (uint8_t) this->simKafi.read();
+        lastByte = millis();
+    }
+
+#if SIMKAFI_ENABLE_STATS
+    this->statistics.bytesReceived += received;
+#endif
+
+    return received == length;
+}
+
+void SIMKAFI::reportFTPProgress(uint32_t position) {
+    if(this->ftpProgress != nullptr)
+        this->ftpProgress(this->ftpProgressContext, position);
 }
+#endif
 
-bool SIMKAFI::enableGPRS() {
-    if(!this->hasAPN)
-        return false;
+#if SIMKAFI_ENABLE_RTC
+static const uint16_t daysBeforeMonth[12] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
 
-    this->sendCommand(F("AT+CIICR"));
-    delay(1000);
+// Seconds since 2000-01-01 00:00:00 of a two-digit year date; 2000 to 2099 are leap every fourth year.
+static uint32_t clockSeconds(const SIMKAFIRTC &time) {
+    uint32_t days = (uint32_t) time.year * 365 + (time.year + 3) / 4 +
+        daysBeforeMonth[(time.month + 11) % 12] + time.day - 1;
+    if(time.month > 2 && time.year % 4 == 0)
+        days++;
 
-    return this->isSuccessCommand();
+    return ((days * 24 + time.hour) * 60 + time.minute) * 60 + time.second;
 }
 
-SIMKAFIHTTPResponse SIMKAFI::request(SIMKAFIHTTPRequest request) {
-    SIMKAFIHTTPResponse response;
-    response.status = -1;
+static void clockTime(uint32_t seconds, SIMKAFIRTC &time) {
+    time.second = seconds % 60;
+    seconds /= 60;
+    time.minute = seconds % 60;
+    seconds /= 60;
+    time.hour = seconds % 24;
 
-    if(!this->hasAPN)
-        return response;
+    uint32_t days = seconds / 24;
+    uint8_t year = 0, month = 1;
 
-    this->sendCommand(
-        "AT+CIPSTART=\"TCP\",\"" + request.domain +
-        "\"," + String(request.port)
-    );
-    
-    String resp = this->getResponse();
-    resp.trim();
+    while(days >= (year % 4 == 0 ? 366U : 365U))
+        days -= year++ % 4 == 0 ? 366 : 365;
 
-    delay(1500);
-    if(!resp.endsWith(F("CONNECT OK")))
-        return response;
+    for(;;) {
+        uint8_t length = month == 2 ? (year % 4 == 0 ? 29 : 28) : 30 + (month + month / 8) % 2;
+        if(days < length)
+            break;
+
+        days -= length;
+        month++;
+    }
 
-    String requestStr = request.method + " " +
-        request.resource + " HTTP/1.0\r\nHost: " +
-        request.domain + "\r\n";
+    time.year = year;
+    time.month = month;
+    time.day = (uint8_t) days + 1;
+}
 
-    for(int i = 0; i < request.header_count; i++)
-        requestStr += request.headers[i].key + ": " +
-            request.headers[i].value + "\r\n";
+// The numbers of "yy/MM/dd,hh:mm:ss±zz" (AT+CCLK?) or "yyyy,M,d,h,m,s,"±zz",dst" (*PSUTTZ) in order.
+static bool parseClock(const char *text, size_t length, SIMKAFIRTC &time) {
+    long values[7];
+    uint8_t count = 0;
 
-    if(request.data != "" || request.data != NULL)
-        requestStr += request.data + "\r\n";
+    for(size_t i = 0; i < length && count < 7; ) {
+        if(text[i] < '0' || text[i] > '9') {
+            i++;
+            continue;
+        }
 
-    requestStr += F("\r\n");
-    this->sendCommand(requestStr);
+        bool negative = count == 6 && i > 0 && text[i - 1] == '-';
+        long value = 0;
 
-    // TODO
-    return response;
+        while(i < length && text[i] >= '0' && text[i] <= '9')
+            value = value * 10 + (text[i++] - '0');
+        values[count++] = negative ? -value : value;
+    }
+
+    if(count < 6 || values[1] < 1 || values[1] > 12 || values[2] < 1 || values[2] > 31 ||
+        values[3] > 23 || values[4] > 59 || values[5] > 59)
+        return false;
+
+    time.year = (uint8_t) (values[0] % 100);
+    time.month = (uint8_t) values[1];
+    time.day = (uint8_t) values[2];
+    time.hour = (uint8_t) values[3];
+    time.minute = (uint8_t) values[4];
+    time.second = (uint8_t) values[5];
+    time.gmt = count == 7 ? (int8_t) values[6] : 0;
+
+    return true;
 }
 
 bool SIMKAFI::updateRtc(SIMKAFIRTC config) {
-    this->sendCommand(
-        "AT+CCLK=\"" + String(config.year <= 9 ? "0" : "") + String(config.year) +
-        "/" + String(config.month <= 9 ? "0" : "") + String(config.month) +
-        "/" + String(config.day <= 9 ? "0" : "") + String(config.day) +
-        "," + String(config.hour <= 9 ? "0" : "") + String(config.hour) +
-        ":" + String(config.minute <= 9 ? "0" : "") + String(config.minute) +
-        ":" + String(config.second <= 9 ? "0" : "") + String(config.second) +
-        "+" + String(config.gmt <= 9 ? "0" : "") + String(config.gmt) + "\""
-    );
+    char command[40];
+    snprintf(command, sizeof(command), "AT+CCLK=\"%02u/%02u/%02u,%02u:%02u:%02u%+03d\"",
+        config.year, config.month, config.day, config.hour, config.minute, config.second, config.gmt);
 
-    return this->isSuccessCommand();
+    this->sendCommand(command);
+    if(!this->isSuccessCommand())
+        return false;
+
+    // Set by hand, so it says nothing about how fast millis() runs.
+    this->anchorClock(clockSeconds(config), config.gmt, false);
+    return true;
 }
 
 SIMKAFIRTC SIMKAFI::rtc() {
@@ -314,53 +2886,99 @@ SIMKAFIRTC SIMKAFI::rtc() {
         rtc.hour = rtc.minute = rtc.second = 
         rtc.gmt = 0;
 
-    this->sendCommand(F("AT+CMGF=1"));
-    if(!this->isSuccessCommand())
+    // A failed resync keeps the local clock running; it is only useless before the first one.
+    bool due = !this->clockSynced || (SIMKAFI_RTC_RESYNC_INTERVAL > 0 &&
+        millis() - this->clockAnchor >= SIMKAFI_RTC_RESYNC_INTERVAL);
+    if(due && !this->syncRtc() && !this->clockSynced)
         return rtc;
 
-    this->sendCommand(F("AT+CENG=3"));
-    if(!this->isSuccessCommand())
-        return rtc;
-    this->sendCommand(F("AT+CCLK?"));
-    
-    String time = this->queryResult();
-    time = time.substring(1, time.length() - 2);
-
-    uint8_t delim1 = time.indexOf('/'),
-        delim2 = time.indexOf('/', delim1 + 1),
-        delim3 = time.indexOf(',', delim2),
-        delim4 = time.indexOf(':', delim3),
-        delim5 = time.indexOf(':', delim4 + 1),
-        delim6 = time.indexOf('+', delim5);
-
-    rtc.year =  (uint8_t) time.substring(0, delim1).toInt();
-    rtc.month = (uint8_t) time.substring(delim1 + 1, delim2).toInt();
-    rtc.day = (uint8_t) time.substring(delim2 + 1, delim3).toInt();
-    rtc.hour = (uint8_t) time.substring(delim3 + 1, delim4).toInt();
-    rtc.minute = (uint8_t) time.substring(delim4 + 1, delim5).toInt();
-    rtc.second = (uint8_t) time.substring(delim5 + 1, delim6).toInt();
-    rtc.gmt = (uint8_t) time.substring(delim6 + 1).toInt();
+    clockTime(this->clockNow(), rtc);
+    rtc.gmt = this->clockGmt;
 
     return rtc; 
 }
 
+bool SIMKAFI::syncRtc() {
+    this->sendCommand(F("AT+CCLK?"));
+
+    Response response = this->queryResult();
+    SIMKAFIRTC time;
+    if(!parseClock(response.c_str(), response.length(), time))
+        return false;
+
+    this->anchorClock(clockSeconds(time), time.gmt, true);
+    return true;
+}
+
+bool SIMKAFI::setNetworkTime(bool enable) {
+    if(this->knownConfig.networkTime != (int8_t) enable) {
+        this->sendCommand(enable ? F("AT+CLTS=1") : F("AT+CLTS=0"));
+        this->knownConfig.networkTime = -1;
+
+        if(!this->isSuccessCommand())
+            return false;
+        this->knownConfig.networkTime = (int8_t) enable;
+    }
+
+    this->desiredConfig.networkTime = (int8_t) enable;
+    return true;
+}
+
+int32_t SIMKAFI::rtcDrift() const {
+    return this->clockDrift;
+}
+
+void SIMKAFI::anchorClock(uint32_t seconds, int8_t gmt, bool measured) {
+    unsigned long now = millis();
+    unsigned long elapsed = now - this->clockAnchor;
+
+    // The residual error is what the current estimate missed; take half of it to ride out the
+    // one-second resolution of the readings. A zone change is not drift.
+    if(measured && this->clockSynced && gmt == this->clockGmt && elapsed >= SIMKAFI_RTC_DRIFT_WINDOW) {
+        int32_t error = (int32_t) (seconds - this->clockNow());
+        int32_t drift = this->clockDrift + (int32_t) ((int64_t) error * 1000000000LL / (int64_t) elapsed / 2);
+
+        // Even a ceramic resonator stays well inside 2%; anything beyond is a clock set by hand.
+        if(drift > -20000 && drift < 20000)
+            this->clockDrift = drift;
+    }
+
+    this->clockBase = seconds;
+    this->clockAnchor = now;
+    this->clockGmt = gmt;
+    this->clockSynced = true;
+}
+
+uint32_t SIMKAFI::clockNow() const {
+    unsigned long elapsed = millis() - this->clockAnchor;
+    int64_t corrected = (int64_t) elapsed + (int64_t) elapsed * this->clockDrift / 1000000;
+
+    return this->clockBase + (uint32_t) (corrected / 1000);
+}
+#endif
+
+#if SIMKAFI_ENABLE_PHONEBOOK
 bool SIMKAFI::savePhonebook(uint8_t index, SIMKAFICardAccount account) {
-    this->sendCommand(
-        "AT+CPBW=" + String(index) +
-        ",\"" + account.number +
-        "\"," + account.numberType +
-        ",\"" + account.name + "\""
-    );
+    Command command = "AT+CPBW=" + Command(index);
+    command += F(",\"");
+    command += account.number;
+    command += F("\",");
+    command += (int) account.numberType;
+    command += F(",\"");
+    command += account.name;
+    command += '"';
+
+    this->sendCommand(command);
     return this->isSuccessCommand();
 }
 
 SIMKAFICardAccount SIMKAFI::retrievePhonebook(uint8_t index) {
-    this->sendCommand("AT+CPBR=" + String(index));
+    this->sendCommand("AT+CPBR=" + Command(index));
 
     SIMKAFICardAccount accountInfo;
     accountInfo.numberType = static_cast<SIMKAFIPhonebookType>(0);
 
-    String response = this->queryResult();
+    Response response = this->queryResult();
     response = response.substring(response.indexOf(',') + 1);
 
     uint8_t delim1 = response.indexOf(','),
@@ -378,7 +2996,7 @@ SIMKAFICardAccount SIMKAFI::retrievePhonebook(uint8_t index) {
 }
 
 bool SIMKAFI::deletePhonebook(uint8_t index) {
-    this->sendCommand("AT+CPBW=" + String(index));
+    this->sendCommand("AT+CPBW=" + Command(index));
     return this->isSuccessCommand();
 }
 
@@ -389,7 +3007,7 @@ SIMKAFIPhonebookCapacity SIMKAFI::phonebookCapacity() {
 
     this->sendCommand("AT+CPBS?");
 
-    String response = this->queryResult();
+    Response response = this->queryResult();
     uint8_t delim1 = response.indexOf(','),
         delim2 = response.indexOf(',', delim1 + 1);
 
@@ -399,6 +3017,7 @@ SIMKAFIPhonebookCapacity SIMKAFI::phonebookCapacity() {
 
     return capacity;
 }
+#endif
 
 SIMKAFICardAccount SIMKAFI::cardNumber() {
     this->sendCommand(F("AT+CNUM"));
@@ -406,7 +3025,7 @@ SIMKAFICardAccount SIMKAFI::cardNumber() {
     SIMKAFICardAccount account;
     account.name = F("");
 
-    String response = this->queryResult();
+    Response response = this->queryResult();
     if(response == F(""))
         return account;
 
@@ -425,58 +3044,55 @@ SIMKAFICardAccount SIMKAFI::cardNumber() {
     return account;
 }
 
-String SIMKAFI::manufacturer() {
+SIMKAFIText SIMKAFI::manufacturer() {
     this->sendCommand(F("AT+GMI"));
     return this->rawQueryOnLine(2);
 }
 
-String SIMKAFI::softwareRelease() {
+SIMKAFIText SIMKAFI::softwareRelease() {
     this->sendCommand(F("AT+GMR"));
 
-    String result = this->rawQueryOnLine(2);
+    Response result = this->rawQueryOnLine(2);
     result = result.substring(result.lastIndexOf(F(":")) + 1);
 
     return result;
 }
 
-String SIMKAFI::imei() {
+SIMKAFIText SIMKAFI::imei() {
     this->sendCommand(F("AT+GSN"));
     return this->rawQueryOnLine(2);
 }
 
-String SIMKAFI::chipModel() {
+SIMKAFIText SIMKAFI::chipModel() {
     this->sendCommand(F("AT+GMM"));
     return this->rawQueryOnLine(2);
 }
 
-String SIMKAFI::chipName() {
+SIMKAFIText SIMKAFI::chipName() {
     this->sendCommand(F("AT+GOI"));
     return this->rawQueryOnLine(2);
 }
 
-String SIMKAFI::ipAddress() {
-    this->sendCommand(F("AT+CIFSR"));
-    return this->rawQueryOnLine(2);
+#if SIMKAFI_ENABLE_GPRS
+SIMKAFIText SIMKAFI::ipAddress() {
+    if(!this->isBearerUp())
+        this->readBearerAddress();
+    return this->bearerIP;
 }
+#endif
 
+#if SIMKAFI_ENABLE_SMS
 int SIMKAFI::getSMSCount() {
-    this->sendCommand(F("AT+CPMS?"));
-    String response = this->getResponse();
-    
-    if(response.indexOf("ERROR") != -1)
+    if(!this->smsMirrorValid && !this->syncSMSStorage())
         return -1;
 
-    // استخراج تعداد پیام‌ها از پاسخ
-    int startIndex = response.indexOf(",") + 1;
-    int endIndex = response.indexOf(",", startIndex);
-    return response.substring(startIndex, endIndex).toInt();
+    return countSlots(this->smsUsed);
 }
 
-bool SIMKAFI::readSMS(int index, String& sender, String& message) {
-    this->sendCommand("AT+CMGR=" + String(index));
-    String response = this->getResponseForSMS(5000);  // استفاده از getResponse سفارشی
-
-    if(response.indexOf("ERROR") != -1)
+template<class Sender, class Message, class Text>
+static bool parseReadSMS(const Text &response, Sender &sender, Message &message) {
+    // An empty slot answers a bare "OK".
+    if(!response.endsWith(F("OK")) || response.indexOf(F("+CMGR:")) == -1)
         return false;
 
     int senderStartIndex = response.indexOf("\"",response.indexOf(",")) + 1;
@@ -485,145 +3101,714 @@ bool SIMKAFI::readSMS(int index, String& sender, String& message) {
 
     int messageStartIndex = response.indexOf("\r\n", senderEndIndex) + 2;
     int messageEndIndex = response.lastIndexOf("\r\n");
+
+    // The body is followed by an empty line before the final "OK".
+    while(messageEndIndex > messageStartIndex &&
+        (response[messageEndIndex - 1] == '\r' || response[messageEndIndex - 1] == '\n'))
+        messageEndIndex--;
     message = response.substring(messageStartIndex, messageEndIndex);
 
     return true;
 }
 
+bool SIMKAFI::fetchSMS(int index, bool keepUnread, SIMKAFIText &sender, Response &message) {
+    Command command = "AT+CMGR=" + Command(index);
+    if(keepUnread)
+        command += F(",1");
+
+    this->sendCommand(command);
+    Response response = this->getResponse();
+
+    // Reading marks a received message as read unless told not to; a bare "OK" means the slot is empty.
+    bool read = parseReadSMS(response, sender, message);
+    if(read && !keepUnread)
+        this->mirrorSMS(index, true, false, response.indexOf(F("+CMGR: \"STO ")) != -1);
+    else if(!read && response.endsWith(F("OK")))
+        this->mirrorSMS(index, false, false, false);
+
+    return read;
+}
+
+#if SIMKAFI_ENABLE_TASKS
+SIMKAFITaskState SIMKAFI::scanSMS(SIMKAFITask &task, SIMKAFISMSCallback callback, void *context) {
+    SIMKAFI_TASK_BEGIN(task);
+    SIMKAFI_TASK_WAIT_UNTIL(task, this->lockLink(&task));
+
+    // The storage size comes from selectSMSStorage() or syncSMSStorage().
+    if(this->smsCapacity == 0)
+        return this->finishTask(task, SIMKAFI_TASK_FAILED);
+
+    if(this->knownConfig.messageFormat != 1) {
+        this->startCommand(F("AT+CMGF=1"));
+        SIMKAFI_TASK_WAIT_UNTIL(task, this->pollResponse() != SIMKAFI_POLL_WAITING);
+
+        this->knownConfig.messageFormat = this->polledSuccess() ? 1 : -1;
+        if(!this->polledSuccess())
+            return this->finishTask(task, SIMKAFI_TASK_FAILED);
+        this->desiredConfig.messageFormat = 1;
+    }
+
+    for(task.offset = 1; task.offset <= this->smsCapacity; task.offset++) {
+        if(this->smsMirrorValid && task.offset <= SIMKAFI_SMS_SLOTS && !slotSet(this->smsUsed, (int) task.offset))
+            continue;
+
+        {
+            Command command = "AT+CMGR=" + Command(task.offset);
+            command += F(",1");
+            this->startCommand(command.c_str());
+        }
+        SIMKAFI_TASK_WAIT_UNTIL(task, this->pollResponse() != SIMKAFI_POLL_WAITING);
+
+        if(!this->polledSuccess())
+            return this->finishTask(task, SIMKAFI_TASK_FAILED);
+
+        {
+            SIMKAFIText sender;
+            Response message;
+
+            if(parseReadSMS(this->polledLines, sender, message)) {
+                this->mirrorSMS((int) task.offset, true, this->polledLines.indexOf(F("REC UNREAD")) != -1,
+                    this->polledLines.indexOf(F("+CMGR: \"STO ")) != -1);
+
+                SIMKAFIStringView senderView = { sender.c_str(), sender.length() };
+                SIMKAFIStringView messageView = { message.c_str(), message.length() };
+                callback(context, senderView, messageView);
+            }
+            else this->mirrorSMS((int) task.offset, false, false, false);
+        }
+
+        // Nothing is outstanding between two messages, so a more urgent flow may go first; a
+        // scan already past its deadline gives up instead of running later still.
+        if(this->linkContended(&task)) {
+            if(task.deadline != 0 && millis() - task.submitted > task.deadline)
+                return this->finishTask(task, SIMKAFI_TASK_FAILED);
+
+            this->yieldLink(&task);
+            SIMKAFI_TASK_WAIT_UNTIL(task, this->lockLink(&task));
+        }
+    }
+
+    return this->finishTask(task, SIMKAFI_TASK_DONE);
+    SIMKAFI_TASK_END(task);
+}
+#endif
+
+bool SIMKAFI::readSMS(int index, char *sender, size_t senderSize, char *message, size_t messageSize) {
+    SIMKAFIText senderText;
+    Response messageText;
+
+    if(!this->fetchSMS(index, false, senderText, messageText))
+        return false;
+
+    senderText.toCharArray(sender, senderSize);
+    messageText.toCharArray(message, messageSize);
+    return true;
+}
+
+#if !SIMKAFI_NO_HEAP
+bool SIMKAFI::readSMS(int index, String& sender, String& message) {
+    return this->fetchSMS(index, false, sender, message);
+}
+#endif
+
 bool SIMKAFI::deleteSMS(int index) {
-    this->sendCommand("AT+CMGD=" + String(index));
-    return this->isSuccessCommand();
+    this->sendCommand("AT+CMGD=" + Command(index));
+    bool deleted = this->isSuccessCommand();
+
+    if(deleted)
+        this->mirrorSMS(index, false, false, false);
+    return deleted;
+}
+
+bool SIMKAFI::saveDraft(const char *number, const char *message) {
+    // A draft is stored with the parameters it will later be sent with.
+    if(!this->restoreCSMP())
+        return false;
+
+    Command command = F("AT+CMGW=\"");
+    command += number;
+    command += '"';
+
+    this->sendCommand(command);
+    if(!this->readResponse(">").endsWith(">")) {
+        this->simKafi.write(0x1b);
+        return false;
+    }
+
+    this->sendMessageText(message);  // ارسال Ctrl+Z برای ذخیره پیام
+    Response response = this->getResponse();
+    if(!response.endsWith(F("OK")))
+        return false;
+
+    int indexStart = response.indexOf(F("+CMGW:"));
+    if(indexStart != -1) {
+        this->mirrorSMS(atoi(response.c_str() + indexStart + 6), true, false, true);
+        this->purgeIfFull();
+    }
+
+    return true;
 }
 
+#if !SIMKAFI_NO_HEAP
 bool SIMKAFI::saveDraft(String number, String message) {
-    this->sendCommand(F("AT+CMGW=\"") + number + F("\""));
-    delay(500);
-    this->sendCommand(message);
-    delay(500);
-    this->simKafi.write(0x1a);  // ارسال Ctrl+Z برای ذخیره پیام
-    
-    return this->isSuccessCommand();
+    return this->saveDraft(number.c_str(), message.c_str());
 }
+#endif
+
+bool SIMKAFI::matchSearchTerm(const char *line, size_t length) {
+    size_t termLength = strlen(this->searchTerm);
+
+    for(size_t at = 0; !this->searchFound && at + termLength <= length; at++)
+        if(!strncmp(line + at, this->searchTerm, termLength)) {
+            *this->searchMatch = "";
+            for(size_t i = at; i < length; i++)
+                *this->searchMatch += line[i];
+            this->searchFound = true;
+        }
+
+    return true;
+}
+
+bool SIMKAFI::findSMS(const char *term, Response &result) {
+    // The listing is matched line by line as it arrives, so it never has to fit in memory.
+    this->searchTerm = term;
+    this->searchMatch = &result;
+    this->searchFound = false;
+    this->lineHandler = &SIMKAFI::matchSearchTerm;
 
-bool SIMKAFI::searchSMS(String searchTerm, String& result) {
     this->sendCommand(F("AT+CMGL=\"ALL\""));
-    String response = this->getResponseForSMS(10000);
+    Response response = this->getResponse();
+    this->lineHandler = nullptr;
 
-    int startIndex = response.indexOf(searchTerm);
-    if(startIndex != -1) {
-        result = response.substring(startIndex, response.indexOf("\r\n", startIndex));
-        return true;
-    }
+    // Listing in mode 0 marks every received message as read.
+    if(response.endsWith(F("OK")))
+        memset(this->smsUnread, 0, sizeof(this->smsUnread));
 
-    return false;
+    return this->searchFound;
+}
+
+bool SIMKAFI::searchSMS(const char *searchTerm, char *result, size_t resultSize) {
+    Response match;
+    if(!this->findSMS(searchTerm, match))
+        return false;
+
+    match.toCharArray(result, resultSize);
+    return true;
+}
+
+#if !SIMKAFI_NO_HEAP
+bool SIMKAFI::searchSMS(String searchTerm, String& result) {
+    return this->findSMS(searchTerm.c_str(), result);
 }
+#endif
 
 bool SIMKAFI::deleteAllSMS() {
-	int count=this->getSMSCount();
-	for(int index=count;index>0;index--)
-		this->sendCommand("AT+CMGD=" + String(index));
-    return this->isSuccessCommand();
+    return this->purgeSMS(SIMKAFI_PURGE_ALL);
 }
 
 bool SIMKAFI::deleteAllReadSMS() {
-    this->sendCommand(F("AT+CMGDA=\"DEL READ\""));
-    return this->isSuccessCommand();
+    return this->purgeSMS(SIMKAFI_PURGE_READ);
+}
+
+bool SIMKAFI::sendFlashSMS(const char *number, const char *message) {
+    // تنظیم برای ارسال فلش پیامک
+    // The flash class stays set, so a burst of flash messages costs no extra round trips;
+    // the next sendSMS() or saveDraft() restores the regular parameters.
+    if(!this->ensureMessageFormat(1) || !this->ensureCSMP(flashCSMP, false))
+        return false;
+
+    return this->submitSMS(number, message);
 }
 
+#if !SIMKAFI_NO_HEAP
 bool SIMKAFI::sendFlashSMS(String number, String message) {
-    this->sendCommand(F("AT+CSMP=49,167,0,240"));  // تنظیم برای ارسال فلش پیامک
-    return this->sendSMS(number, message);
-	//this->sendCommand(F("AT+CSMP"));
-	this->sendCommand(F("AT+CSMP=49,167,0,0"));
+    return this->sendFlashSMS(number.c_str(), message.c_str());
 }
+#endif
 
 bool SIMKAFI::enableDeliveryReports() {
-    this->sendCommand(F("AT+CSMP=49,167,0,1"));  // فعالسازی گزارش تحویل
-    return this->isSuccessCommand();
+    const uint8_t csmp[4] = { 49, 167, 0, 1 };  // فعالسازی گزارش تحویل
+    return this->ensureCSMP(csmp, true);
 }
 
 int SIMKAFI::getUnreadSMSCount() {
-    this->sendCommand(F("AT+CPMS?"));
-    String response = this->getResponse();
-    
-    if(response.indexOf("ERROR") != -1)
+    if(!this->smsMirrorValid && !this->syncSMSStorage())
         return -1;
 
-    int startIndex = response.indexOf(",") + 1;
-    int endIndex = response.indexOf(",", startIndex);
-    return response.substring(startIndex, endIndex).toInt();
+    return countSlots(this->smsUnread);
+}
+
+bool SIMKAFI::readUnreadSMS(int index, char *sender, size_t senderSize, char *message, size_t messageSize) {
+    SIMKAFIText senderText;
+    Response messageText;
+
+    if(!this->fetchSMS(index, true, senderText, messageText))
+        return false;
+
+    senderText.toCharArray(sender, senderSize);
+    messageText.toCharArray(message, messageSize);
+    return true;
 }
 
+#if !SIMKAFI_NO_HEAP
 bool SIMKAFI::readUnreadSMS(int index, String& sender, String& message) {
-    this->sendCommand("AT+CMGR=" + String(index) + ",1");
-    return this->readSMS(index, sender, message);
+    return this->fetchSMS(index, true, sender, message);
+}
+#endif
+
+bool SIMKAFI::selectSMSStorage(SIMKAFISMSStorage storage) {
+    Command command = F("AT+CPMS=");
+    appendStorage(command, storage);
+
+    this->sendCommand(command);
+    if(!this->isSuccessCommand())
+        return false;
+
+    this->desiredConfig.smsStorage = this->knownConfig.smsStorage = (int8_t) storage;
+    return this->syncSMSStorage();
+}
+
+bool SIMKAFI::syncSMSStorage() {
+    this->smsMirrorValid = false;
+
+    // +CPMS: "SM",3,30,"SM",3,30,"SM",3,30 - the first storage is the one read and deleted from.
+    this->sendCommand(F("AT+CPMS?"));
+    Response response = this->getResponse();
+    if(!response.endsWith(F("OK")))
+        return false;
+
+    int nameStart = response.indexOf('"') + 1;
+    if(nameStart == 0 || response.length() < (unsigned int) nameStart + 5)
+        return false;
+
+    const char *fields = response.c_str() + nameStart;
+    uint8_t storage = 0;
+    while(storage <= SIMKAFI_SMS_STORAGE_MT && strncmp(fields, storageName((SIMKAFISMSStorage) storage), 2))
+        storage++;
+
+    const char *capacity = strchr(fields + 4, ',');
+    if(storage > SIMKAFI_SMS_STORAGE_MT || fields[2] != '"' || capacity == nullptr)
+        return false;
+
+    int slots = atoi(capacity + 1);
+    this->smsStorageArea = (SIMKAFISMSStorage) storage;
+    this->smsCapacity = slots > 0xFFFF ? 0xFFFF : (uint16_t) slots;
+
+    // Mode 1 lists the messages without marking the unread ones as read.
+    if(!this->ensureMessageFormat(1))
+        return false;
+
+    memset(this->smsUsed, 0, sizeof(this->smsUsed));
+    memset(this->smsUnread, 0, sizeof(this->smsUnread));
+    memset(this->smsOutgoing, 0, sizeof(this->smsOutgoing));
+    this->smsOverflow = false;
+
+    // The listing is mirrored line by line as it arrives, so it never has to fit in memory.
+    this->lineHandler = &SIMKAFI::mirrorListedSMS;
+    this->sendCommand(F("AT+CMGL=\"ALL\",1"));
+    response = this->getResponse();
+    this->lineHandler = nullptr;
+
+    if(!response.endsWith(F("OK")))
+        return false;
+
+    // With messages above the mirrored slots the counts would be short, so they are not offered.
+    this->smsMirrorValid = !this->smsOverflow;
+    this->purgeIfFull();
+    return this->smsMirrorValid;
+}
+
+SIMKAFISMSStorageStatus SIMKAFI::smsStorage() const {
+    SIMKAFISMSStorageStatus status;
+
+    status.storage = this->smsStorageArea;
+    status.used = countSlots(this->smsUsed);
+    status.unread = countSlots(this->smsUnread);
+    status.capacity = this->smsCapacity;
+    status.valid = this->smsMirrorValid;
+
+    return status;
+}
+
+int SIMKAFI::nextUnreadSMS() const {
+    if(!this->smsMirrorValid)
+        return 0;
+
+    for(int index = 1; index <= SIMKAFI_SMS_SLOTS; index++)
+        if(this->smsUnread[(index - 1) >> 3] & (1 << ((index - 1) & 7)))
+            return index;
+    return 0;
+}
+
+void SIMKAFI::setSMSPurgePolicy(const SIMKAFIPurgePolicy &policy) {
+    this->purgePolicy = policy;
+}
+
+bool SIMKAFI::purgeSMS(SIMKAFIPurgeMode mode) {
+    // The index is ignored once a delete flag is given.
+    this->sendCommand("AT+CMGD=1," + Command((int) mode));
+    if(!this->isSuccessCommand())
+        return false;
+
+    bool draftsLeft = false;
+    for(size_t i = 0; i < sizeof(this->smsUsed); i++) {
+        if(mode == SIMKAFI_PURGE_ALL)
+            this->smsUsed[i] = this->smsUnread[i] = 0;
+        else if(mode == SIMKAFI_PURGE_READ)
+            this->smsUsed[i] &= this->smsUnread[i] | this->smsOutgoing[i];
+        else if(mode == SIMKAFI_PURGE_READ_SENT) {
+            this->smsUsed[i] &= this->smsUnread[i] | this->smsOutgoing[i];
+            draftsLeft = draftsLeft || this->smsOutgoing[i] != 0;
+        }
+        else this->smsUsed[i] &= this->smsUnread[i];
+
+        this->smsOutgoing[i] &= this->smsUsed[i];
+    }
+
+    // Sent and unsent drafts are not told apart locally, so count them again when asked.
+    if(draftsLeft)
+        this->smsMirrorValid = false;
+    return true;
+}
+
+bool SIMKAFI::mirrorListedSMS(const char *line, size_t length) {
+    // +CMGL: <index>,"<stat>",... heads each message; the text lines that follow are skipped.
+    if(!lineStartsWith(line, length, "+CMGL: "))
+        return true;
+
+    const char *status = (const char*) memchr(line, ',', length);
+    if(status != nullptr)
+        this->mirrorSMS(atoi(line + 7), true,
+            lineStartsWith(status, length - (status - line), ",\"REC UNREAD\""),
+            lineStartsWith(status, length - (status - line), ",\"STO "));
+
+    return true;
+}
+
+void SIMKAFI::mirrorSMS(int index, bool used, bool unread, bool outgoing) {
+    // Above the mirrored slots nothing is counted right anymore; the next sync finds out again.
+    if(index > SIMKAFI_SMS_SLOTS) {
+        this->smsOverflow = this->smsOverflow || used;
+        this->smsMirrorValid = false;
+    }
+    if(index < 1 || index > SIMKAFI_SMS_SLOTS)
+        return;
+
+    setSlot(this->smsUsed, index, used);
+    setSlot(this->smsUnread, index, used && unread);
+    setSlot(this->smsOutgoing, index, used && outgoing);
+}
+
+void SIMKAFI::purgeIfFull() {
+    const SIMKAFIPurgePolicy &policy = this->purgePolicy;
+
+    // A message above the mirrored slots means the storage is fuller than the mirror can tell.
+    if(policy.highWaterPercent == 0 || (!this->smsOverflow && (!this->smsMirrorValid || this->smsCapacity == 0 ||
+        (uint32_t) countSlots(this->smsUsed) * 100 < (uint32_t) this->smsCapacity * policy.highWaterPercent)))
+        return;
+
+    // A storage full of unread messages stays full until one of them is read.
+    uint8_t used = countSlots(this->smsUsed), read = used - countSlots(this->smsUnread);
+    if(this->purgeFutile && read == this->purgeFutileRead)
+        return;
+
+    if(!this->purgeSMS(policy.mode))
+        return;
+
+    this->purgeFutile = countSlots(this->smsUsed) >= used;
+    this->purgeFutileRead = countSlots(this->smsUsed) - countSlots(this->smsUnread);
 }
 
 bool SIMKAFI::sendCNMICommand(int mode, int mt, int bm, int ds, int bfr) {
-    String command = "AT+CNMI=" + String(mode) + "," + String(mt) + "," + String(bm) + "," + String(ds) + "," + String(bfr);
-    
-	this->sendCommand(command);
-    
-    return this->isSuccessCommand();
+    const uint8_t cnmi[5] = { (uint8_t) mode, (uint8_t) mt, (uint8_t) bm, (uint8_t) ds, (uint8_t) bfr };
+    return this->ensureCNMI(cnmi);
+}
+#endif
+
+bool SIMKAFI::setCharacterSet(const char *charset) {
+    size_t length = strlen(charset);
+    if(length >= sizeof(this->knownConfig.characterSet))
+        return false;
+
+    if(strcmp(this->knownConfig.characterSet, charset) != 0) {
+        Command command = F("AT+CSCS=\"");
+        command += charset;
+        command += '"';
+
+        this->sendCommand(command);
+        this->knownConfig.characterSet[0] = '\0';
+
+        if(!this->isSuccessCommand())
+            return false;
+        memcpy(this->knownConfig.characterSet, charset, length + 1);
+    }
+
+    memcpy(this->desiredConfig.characterSet, charset, length + 1);
+    return true;
 }
 
+#if SIMKAFI_ENABLE_SMS && !SIMKAFI_NO_HEAP
 void SIMKAFI::setSMSReceivedCallback(void (*callback)(String, String)) {
     onSMSReceived = callback;
 }
+#endif
 
+#if SIMKAFI_ENABLE_CALL
 void SIMKAFI::setCallReceivedCallback(void (*callback)()) {
     onCallReceived = callback;
 }
+#endif
 
+#if SIMKAFI_ENABLE_SMS
 void SIMKAFI::setSMSDeliveredCallback(void (*callback)()) {
     onSMSDelivered = callback;
 }
+#endif
 
-int SIMKAFI::parseIndexFromResponse(String response) {
-    int indexStart = response.indexOf(',') + 1;
-    return response.substring(indexStart).toInt();
+void SIMKAFI::setResetCallback(SIMKAFIResetCallback callback, void *context) {
+    this->resetCallback = callback;
+    this->resetCallbackContext = context;
 }
 
-void SIMKAFI::handleSerialEvent() {
-    if (simKafi.available()) {
-        String response = getResponse();  // دریافت پاسخ از ماژول
-
-        if (response.indexOf("+CMTI:") != -1) {
-            int index = parseIndexFromResponse(response);
-            String sender, message;
-            if (readSMS(index, sender, message)) {
-                 if (onSMSReceived != nullptr) {
-					onSMSReceived(sender, message);
-				}
-            }
-        } 
-        else if (response.indexOf("RING") != -1) {
-            if (onCallReceived != nullptr) {
-                onCallReceived();
-            }
+void SIMKAFI::setWatchdog(bool enabled) {
+    this->watchdogEnabled = enabled;
+}
+
+#if SIMKAFI_ENABLE_SMS
+void SIMKAFI::setSMSReceivedCallback(SIMKAFISMSCallback callback, void *context) {
+    this->smsCallback = callback;
+    this->smsCallbackContext = context;
+}
+#endif
+
+void SIMKAFI::setEventCallback(SIMKAFIEventCallback callback, void *context) {
+    this->eventCallback = callback;
+    this->eventCallbackContext = context;
+}
+
+void SIMKAFI::dispatchEvent(SIMKAFIEventType type, const char *line, size_t length) {
+#if SIMKAFI_ENABLE_STATS
+    // The events from LINK_RESTORED on are raised by the library, not by a URC.
+    if(type < SIMKAFI_EVENT_LINK_RESTORED)
+        this->statistics.urcs++;
+#endif
+
+#if SIMKAFI_ENABLE_CALL
+    if(type == SIMKAFI_EVENT_CALL_RECEIVED && onCallReceived != nullptr)
+        onCallReceived();
+#endif
+#if SIMKAFI_ENABLE_SMS
+    if(type == SIMKAFI_EVENT_SMS_DELIVERED && onSMSDelivered != nullptr)
+        onSMSDelivered();
+#endif
+
+    if(this->eventCallback == nullptr)
+        return;
+
+    SIMKAFIEvent event;
+    event.type = type;
+    event.line.data = line;
+    event.line.length = length;
+#if SIMKAFI_ENABLE_CALL
+    event.call = type == SIMKAFI_EVENT_CALL_STATE ? &this->currentCall : nullptr;
+#endif
+
+    this->eventCallback(this->eventCallbackContext, event);
+}
+
+void SIMKAFI::handleUnsolicited(const char *line, size_t length) {
+    if(length == 3 && !strncmp(line, "RDY", 3)) {
+        // The module restarted on its own.
+        this->invalidateConfigCache();
+#if SIMKAFI_ENABLE_SMS
+        this->smsMirrorValid = false;
+#endif
+#if SIMKAFI_ENABLE_GPRS
+        this->hasAPN = false;
+        this->setBearer(SIMKAFI_BEARER_IP_INITIAL);
+        this->bearerDue = millis();
+#endif
+#if SIMKAFI_ENABLE_CALL
+        if(this->callInProgress()) {
+            this->callEnding = SIMKAFI_CALL_END_NO_CARRIER;
+            this->callReleasing = true;
         }
-        else if (response.indexOf("+CSQ:") != -1) {
-            // وضعیت شبکه یا سیگنال
-            SIMKAFISignal sig = signal();
-            // پردازش وضعیت سیگنال
+#endif
+    }
+#if SIMKAFI_ENABLE_SMS
+    else if(lineStartsWith(line, length, "+CMTI:")) {
+        const char *comma = (const char*) memchr(line, ',', length);
+        if(comma == nullptr)
+            return;
+
+#if SIMKAFI_ENABLE_STATS
+        this->statistics.urcs++;
+#endif
+
+        // +CMTI: "SM",3 - the mirror only follows the selected storage.
+        int index = atoi(comma + 1);
+        const char *name = (const char*) memchr(line, '"', length);
+        if(this->smsStorageArea == SIMKAFI_SMS_STORAGE_MT ||
+            (name != nullptr && !strncmp(name + 1, storageName(this->smsStorageArea), 2)))
+            this->mirrorSMS(index, true, true, false);
+
+        // Nobody to hand the message to, so leave it unread for nextUnreadSMS().
+        bool consumed = this->smsCallback != nullptr;
+#if !SIMKAFI_NO_HEAP
+        consumed = consumed || onSMSReceived != nullptr;
+#endif
+
+        if(!consumed) {
+            this->purgeIfFull();
+            return;
         }
-        else if (response.indexOf("+CDS:") != -1) {
-            if (onSMSDelivered != nullptr) {
-                onSMSDelivered();
-            }
+
+        SIMKAFIText sender;
+        Response message;
+        if(!this->fetchSMS(index, false, sender, message))
+            return;
+
+        if(this->smsCallback != nullptr) {
+            SIMKAFIStringView senderView = { sender.c_str(), sender.length() };
+            SIMKAFIStringView messageView = { message.c_str(), message.length() };
+
+            this->smsCallback(this->smsCallbackContext, senderView, messageView);
         }
-        else if (response.indexOf("OK") != -1) {
-            // پاسخ مثبت به AT Command
-            // اقدامات لازم
+
+#if !SIMKAFI_NO_HEAP
+        if(onSMSReceived != nullptr)
+            onSMSReceived(sender, message);
+#endif
+
+        this->purgeIfFull();
+    }
+    else if(lineStartsWith(line, length, "+CDS:"))
+        this->dispatchEvent(SIMKAFI_EVENT_SMS_DELIVERED, line, length);
+#endif
+#if SIMKAFI_ENABLE_CALL
+    else if(lineStartsWith(line, length, "RING")) {
+        // Without the +CLCC reports RING is all there is; the number stays unknown.
+        if(!this->callInProgress()) {
+            this->beginCall(true, "", 0);
+            this->setCallState(SIMKAFI_CALL_INCOMING, line, length);
         }
-        else if (response.indexOf("ERROR") != -1) {
-            // پاسخ خطا به AT Command
-            // اقدامات لازم
+
+        this->dispatchEvent(SIMKAFI_EVENT_CALL_RECEIVED, line, length);
+    }
+    else if(lineStartsWith(line, length, "+CLCC:")) {
+        this->trackCall(line, length);
+
+#if SIMKAFI_ENABLE_STATS
+        this->statistics.urcs++;
+#endif
+    }
+    else if(lineStartsWith(line, length, "NO CARRIER") || lineStartsWith(line, length, "BUSY") ||
+        lineStartsWith(line, length, "NO ANSWER") || lineStartsWith(line, length, "NO DIALTONE")) {
+        // The result code names the cause; the release itself may be reported by +CLCC next.
+        if(this->callInProgress()) {
+            this->callEnding = line[0] == 'B' ? SIMKAFI_CALL_END_BUSY :
+                line[3] == 'A' ? SIMKAFI_CALL_END_NO_ANSWER :
+                line[3] == 'D' ? SIMKAFI_CALL_END_NO_DIALTONE : SIMKAFI_CALL_END_NO_CARRIER;
+            this->callReleasing = true;
         }
-        else if (response.indexOf("+CGATT:") != -1) {
-            // وضعیت GPRS
-            // پردازش وضعیت GPRS
+
+        if(line[0] == 'N' && line[3] == 'C')
+            this->dispatchEvent(SIMKAFI_EVENT_CALL_ENDED, line, length);
+    }
+#endif
+#if SIMKAFI_ENABLE_GPRS
+    else if(lineStartsWith(line, length, "+PDP: DEACT") ||
+        lineStartsWith(line, length, "+CGATT: 0")) {
+        this->dispatchEvent(SIMKAFI_EVENT_GPRS_DETACHED, line, length);
+
+        // Not a failed attempt of ours, so reconnect without backing off.
+        this->hasAPN = false;
+        this->setBearer(SIMKAFI_BEARER_PDP_DEACT);
+        this->bearerDue = millis();
+    }
+    else if(lineEndsWith(line, length, "CLOSED"))
+        this->dispatchEvent(SIMKAFI_EVENT_SOCKET_CLOSED, line, length);
+#endif
+#if SIMKAFI_ENABLE_RTC
+    else if(lineStartsWith(line, length, "*PSUTTZ:")) {
+        // *PSUTTZ: 2023,10,1,12,0,0,"+32",0 - UTC and the zone in quarter hours; the clock keeps local time.
+        SIMKAFIRTC time;
+        if(parseClock(line + 8, length - 8, time))
+            this->anchorClock(clockSeconds(time) + (int32_t) time.gmt * 900, time.gmt, true);
+
+#if SIMKAFI_ENABLE_STATS
+        this->statistics.urcs++;
+#endif
+    }
+    else if(lineStartsWith(line, length, "+CTZV:")) {
+        // +CTZV: +32,0 - the zone alone moves the local time with it.
+        int8_t gmt = (int8_t) atoi(line + 6);
+        if(this->clockSynced && gmt != this->clockGmt) {
+            this->clockBase += ((int32_t) gmt - this->clockGmt) * 900;
+            this->clockGmt = gmt;
         }
-        // دیگر رویدادهای احتمالی
+
+#if SIMKAFI_ENABLE_STATS
+        this->statistics.urcs++;
+#endif
     }
+#endif
+}
+
+// Whether handling the URC sends commands of its own, which must not cut into a flow.
+static bool issuesCommands(const char *line, size_t length) {
+#if SIMKAFI_ENABLE_SMS
+    if(lineStartsWith(line, length, "+CMTI:"))
+        return true;
+#endif
+    (void) line;
+    (void) length;
+    return false;
 }
+
+void SIMKAFI::handleSerialEvent() {
+#if SIMKAFI_ENABLE_TASKS
+    // The input belongs to the response a flow is reading; pollResponse() defers the URCs in it.
+    bool listen = !this->polling;
+    // Between its steps the link is still the flow's, so nothing may send a command of its own.
+    bool linkFree = listen && this->linkOwner == nullptr;
+#else
+    bool listen = true, linkFree = true;
+#endif
+
+    if(linkFree)
+        this->checkHealth();
+    if(this->deferredLines.length() == 0 && (!listen || !simKafi.available()))
+        return;
+
+    // A single read may carry several URCs, so each line is dispatched on its own.
+    Response response;
+    if(listen)
+        response = this->readUnsolicited();
+    else {
+        response = this->deferredLines;
+        this->deferredLines = "";
+    }
+    const char *data = response.c_str();
+    size_t total = response.length(), start = 0;
+
+    while(start < total) {
+        const char *newline = (const char*) memchr(data + start, '\n', total - start);
+        size_t end = newline != nullptr ? (size_t) (newline - data) : total;
+        size_t length = end - start;
+
+        while(length > 0 && data[start + length - 1] == '\r')
+            length--;
+
+        if(length > 0 && !linkFree && issuesCommands(data + start, length))
+            this->deferLine(data + start, length);
+        else if(length > 0)
+            this->handleUnsolicited(data + start, length);
+        start = end + 1;
+    }
+
+#if SIMKAFI_ENABLE_CALL
+    if(this->callReleasing)
+        this->releaseCall(SIMKAFI_CALL_END_NONE);
+#endif
+}
\ No newline at end of file
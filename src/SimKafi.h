@@ -26,7 +26,11 @@
 
 #include <Arduino.h>
 
-#include "simKafi_defs.h"
+#include "SimKafi_config.h"
+#include "SimKafi_defs.h"
+#include "SimKafiTask.h"
+
+class SIMKAFIBufferedStream;
 
 /**
  * 
@@ -40,39 +44,450 @@
  */
 class SIMKAFI {
 private:
+    /// A response read from the module, and a command line sent to it.
+    typedef SIMKAFIString<SIMKAFI_RESPONSE_SIZE> Response;
+    typedef SIMKAFIString<SIMKAFI_COMMAND_SIZE> Command;
+
     /// The SoftwareSerial object used for communication with the SIMKAFI module.
     Stream& simKafi;
 
 	// اشارهگرهای تابع برای کالبکها
+#if SIMKAFI_ENABLE_SMS && !SIMKAFI_NO_HEAP
     void (*onSMSReceived)(String sender, String message) = nullptr;
+#endif
+#if SIMKAFI_ENABLE_CALL
     void (*onCallReceived)() = nullptr;
+#endif
+#if SIMKAFI_ENABLE_SMS
 	void (*onSMSDelivered)() = nullptr;
+
+    /// Context-carrying callback for received SMS, and the context handed back to it.
+    SIMKAFISMSCallback smsCallback = nullptr;
+    void *smsCallbackContext = nullptr;
+#endif
+
+    /// Context-carrying callback for all other unsolicited events, and the context handed back to it.
+    SIMKAFIEventCallback eventCallback = nullptr;
+    void *eventCallbackContext = nullptr;
 	
+#if SIMKAFI_ENABLE_GPRS
     /// A flag indicating whether Access Point Name (APN) configuration is set.
     bool hasAPN = false;
 
+    /// The APN given to connectAPN(), applied again after a resync.
+    SIMKAFIAPN apn;
+
+    /// APN profiles the bearer manager tries in order, owned by the caller, see setAPNProfiles().
+    const SIMKAFIAPN *apnProfiles = nullptr;
+    uint8_t apnProfileCount = 0;
+    uint8_t apnProfile = 0;
+
+    /// Bearer manager state, see serviceBearer(). bearerManaged is set once bearerUp() or
+    /// bearerDown() was called; bearerShut is set when a failed attempt may have left the
+    /// module somewhere only AT+CIPSHUT gets it out of.
+    SIMKAFIBearerState bearer = SIMKAFI_BEARER_UNKNOWN;
+    bool bearerManaged = false;
+    bool bearerWanted = false;
+    bool bearerShut = false;
+    uint8_t bearerFailures = 0;
+    uint8_t profileFailures = 0;
+    unsigned long bearerDue = 0;
+
+    /// The address read with AT+CIFSR while the bearer is up, "" otherwise.
+    char bearerIP[16] = "";
+
+#if SIMKAFI_DNS_CACHE_SIZE > 0
+    /// Names resolved by resolve(), see SIMKAFI_DNS_TTL.
+    SIMKAFIDNSEntry dnsCache[SIMKAFI_DNS_CACHE_SIZE] = {};
+#endif
+    SIMKAFIDNSStats dnsCounters = {};
+#endif
+
+#if SIMKAFI_ENABLE_CALL
+    /// The call the call manager tracks, see call() and serviceCall().
+    SIMKAFICall currentCall = {};
+
+    /// Why the tracked call is ending, from a result code seen before its release is reported.
+    /// callReleasing is set once the module reported the release; handleSerialEvent() raises
+    /// the event after the whole batch of URCs, so a result code after +CLCC still counts.
+    SIMKAFICallEnd callEnding = SIMKAFI_CALL_END_NONE;
+    bool callReleasing = false;
+
+    /// How long an outgoing call may ring before serviceCall() hangs it up (0 = no limit), when
+    /// serviceCall() last asked AT+CLCC or sent ATH, and how many times it sent ATH for the call.
+    uint32_t callAnswerTimeout = 0;
+    unsigned long callPolled = 0;
+    uint8_t callHangUps = 0;
+#endif
+
+#if SIMKAFI_ENABLE_RTC
+    /// Local clock: clockBase seconds since 2000-01-01 (module local time, offset clockGmt
+    /// quarter hours) at millis() == clockAnchor, running clockDrift ppm fast against millis().
+    uint32_t clockBase = 0;
+    unsigned long clockAnchor = 0;
+    int32_t clockDrift = 0;
+    int8_t clockGmt = 0;
+    bool clockSynced = false;
+#endif
+
+#if SIMKAFI_ENABLE_FTP
+    /// Progress callback for FTP transfers and its context, see setFTPProgressCallback().
+    SIMKAFIFTPProgress ftpProgress = nullptr;
+    void *ftpProgressContext = nullptr;
+
+    /// The last "+FTPPUT: 1,..." or "+FTPGET: 1,..." status not yet taken (-1 = none), and the
+    /// chunk limit that came with it.
+    int16_t ftpReported = -1;
+    uint16_t ftpLimit = 0;
+#endif
+
+    /// Settings made through the library, applied again after a resync.
+    SIMKAFIModemConfig desiredConfig;
+
+    /// Settings the module is known to have, so unchanged ones are not sent again.
+    SIMKAFIModemConfig knownConfig;
+
+    /// Called while the library waits for the module, its context and its budget per call, see setIdleCallback().
+    SIMKAFIIdleCallback idleCallback = nullptr;
+    void *idleCallbackContext = nullptr;
+    uint16_t idleBudget = SIMKAFI_IDLE_BUDGET;
+    bool idling = false;
+
+    /// The receive buffer whose overflows rxOverflows() reports, see watchOverflows().
+    const SIMKAFIBufferedStream *rxStream = nullptr;
+
+    /// Called by resync() when the module does not answer, and the context handed back to it.
+    SIMKAFIResetCallback resetCallback = nullptr;
+    void *resetCallbackContext = nullptr;
+
+    /// Link health as tracked by the watchdog.
+    bool watchdogEnabled = true;
+    bool recovering = false;
+    uint8_t consecutiveTimeouts = 0;
+    uint16_t garbageBytes = 0;
+
+    /// Timeout bounds per command class, see setTimeoutPolicy().
+    SIMKAFITimeoutPolicy timeoutPolicies[SIMKAFI_COMMAND_CLASS_COUNT];
+
+    /// Running latency estimate per command class, see responseTimeout().
+    SIMKAFILatencyEstimate latencyEstimates[SIMKAFI_COMMAND_CLASS_COUNT];
+
+    /// The last command line sent, kept to repeat it after a timeout.
+    Command lastCommand;
+
+    /// Unsolicited lines that arrived while a command was in progress, for handleSerialEvent().
+    SIMKAFIString<SIMKAFI_DEFERRED_URC_SIZE> deferredLines;
+
+#if SIMKAFI_ENABLE_SMS
+    /// Occupied, unread and outgoing (draft) SMS storage slots, bit i - 1 for index i, see smsStorage().
+    uint8_t smsUsed[(SIMKAFI_SMS_SLOTS + 7) / 8] = {};
+    uint8_t smsUnread[(SIMKAFI_SMS_SLOTS + 7) / 8] = {};
+    uint8_t smsOutgoing[(SIMKAFI_SMS_SLOTS + 7) / 8] = {};
+    SIMKAFISMSStorage smsStorageArea = SIMKAFI_SMS_STORAGE_SM;
+    uint16_t smsCapacity = 0;
+    bool smsMirrorValid = false;
+    /// A message sits above index SIMKAFI_SMS_SLOTS, so the mirror undercounts until the next sync.
+    bool smsOverflow = false;
+
+    /// When the library purges the SMS storage on its own, see setSMSPurgePolicy().
+    SIMKAFIPurgePolicy purgePolicy = { 0, SIMKAFI_PURGE_READ };
+    /// The last purge freed nothing; it is not tried again until the read message count changes.
+    bool purgeFutile = false;
+    uint8_t purgeFutileRead = 0;
+#endif
+
+    /// Called by collectResponse() with every line that is neither final nor unsolicited;
+    /// a line it returns true for is not kept in the response.
+    bool (SIMKAFI::*lineHandler)(const char *line, size_t length) = nullptr;
+
+#if SIMKAFI_ENABLE_SMS
+    /// State of a searchSMS() in progress, see matchSearchTerm().
+    const char *searchTerm = nullptr;
+    Response *searchMatch = nullptr;
+    bool searchFound = false;
+#endif
+
+    /// The snapshot a diagnostics() in progress fills in, see takeDiagnosticsLine().
+    SIMKAFIDiagnostics *diagnosticsTarget = nullptr;
+
+    /// Class and send time of the command whose response has not been read yet.
+    SIMKAFICommandClass pendingClass = SIMKAFI_COMMAND_CLASS_GENERAL;
+    unsigned long pendingSince = 0;
+    bool pendingCommand = false;
+
+#if SIMKAFI_ENABLE_TASKS
+    /// The task holding the link between the commands of its flow, see lockLink().
+    const void *linkOwner = nullptr;
+
+    /// The tasks waiting for the link, linked through SIMKAFITask::next in no particular order.
+    SIMKAFITask *linkQueue = nullptr;
+
+    /// The response pollResponse() is reading: the lines so far, where the current one starts,
+    /// what ends it, when the last byte came and how many more times the command may be sent.
+    Response polledLines;
+    size_t polledLineStart = 0;
+    const char *polledUntil = nullptr;
+    unsigned long polledByte = 0;
+    uint8_t polledAttempts = 0;
+    bool polling = false;
+#if SIMKAFI_ENABLE_STATS
+    unsigned long polledSince = 0;
+#endif
+#endif
+
+#if SIMKAFI_ENABLE_STATS
+    /// Serial and latency counters, see stats().
+    SIMKAFIStats statistics;
+
+    /// Account for a response read from the module.
+    void recordResponse(const Response &response, unsigned long waitStart);
+#endif
+
     /// Send a command to the SIMKAFI module.
-    void sendCommand(String message);
+    void sendCommand(const char *message);
+    void sendCommand(const __FlashStringHelper *message);
+
+#if SIMKAFI_NO_HEAP
+    void sendCommand(const SIMKAFITextBuffer &message) { this->sendCommand(message.c_str()); }
+#else
+    void sendCommand(const String &message) { this->sendCommand(message.c_str()); }
+#endif
+
+    /// Type the text of a message after a "> " prompt and terminate it with Ctrl-Z.
+    void sendMessageText(const char *text);
+
+    /// Wait a fixed time between the steps of a multi-command exchange.
+    void pause(unsigned long ms);
+
+    /// Hand a wait with left milliseconds to go to the idle callback, or to yield() without one.
+    void idle(unsigned long left);
 
     /// Check if the last command was successful.
     bool isSuccessCommand();
 
     /// Get the response from the SIMKAFI module.
-    String getResponse();
+    Response getResponse();
+
+    /// Read the response to the pending command up to its final result code, repeating the
+    /// command after a timeout when that is safe. A non-null until also ends the response at a
+    /// line starting with it; "" ends it at the first information line and ">" at the "> " prompt.
+    Response readResponse(const char *until);
+
+    /// Read one attempt's worth of response; true if it ended before the timeout.
+    bool collectResponse(Response &response, const char *until, unsigned long timeout);
+
+    /// Add a received byte to a response whose current line starts at lineStart; true if it ended the response.
+    bool takeResponseByte(Response &response, size_t &lineStart, char c, const char *until);
+
+#if SIMKAFI_ENABLE_TASKS
+    /// Have pollResponse() read the response to what was just sent, see readResponse() for until.
+    void armPoll(const char *until);
+
+    /// True if the response pollResponse() read last ended in "OK".
+    bool polledSuccess() const;
+
+    /// Release the link if the task holds it and leave its flow with state.
+    SIMKAFITaskState finishTask(SIMKAFITask &task, SIMKAFITaskState state);
+
+    /// The waiting task that gets the link next, dropping tasks that stopped asking; nullptr if none.
+    SIMKAFITask *nextInLine();
+
+    /// Take a task out of the line for the link, if it is in it.
+    void dequeueTask(const void *task);
+#endif
+
+    /// Close the pending command, feeding its latency or its timeout into the estimate.
+    void settleCommand(bool answered);
+
+    /// Move unsolicited lines waiting in the input to deferredLines and drop anything else.
+    void deferUnsolicited();
+
+    /// Keep a line for handleSerialEvent() if it is an unsolicited result code.
+    bool deferLine(const char *line, size_t length);
+
+    /// Read deferred and newly arrived unsolicited lines until the line goes quiet.
+    Response readUnsolicited();
+
+    /// Send "AT" until the module answers "OK" at the current host rate.
+    bool probeLink(uint8_t attempts);
+
+    /// Count a received byte that cannot be part of a valid response.
+    void countGarbage(char c);
+
+    /// Check whether the watchdog thresholds have been crossed.
+    bool isLinkSuspect() const;
+
+    /// Resynchronize the link if the watchdog thresholds have been crossed.
+    void checkHealth();
+
+    /// Send desiredConfig and the APN to the module in as few command lines as possible.
+    bool applyConfig();
+
+    /// Set the message format unless the module is known to use it already.
+    bool ensureMessageFormat(uint8_t format);
+
+    /// Line handler parsing the answers of diagnostics() into diagnosticsTarget.
+    bool takeDiagnosticsLine(const char *line, size_t length);
+
+#if SIMKAFI_ENABLE_SMS
+    /// Set the SMS parameters unless the module is known to use them already; remember makes them the default.
+    bool ensureCSMP(const uint8_t csmp[4], bool remember);
+
+    /// Undo the flash class left behind by sendFlashSMS(), if any, before a regular message goes out.
+    bool restoreCSMP();
+
+    /// Set the new message indications unless the module is known to use them already.
+    bool ensureCNMI(const uint8_t cnmi[5]);
+#endif
+
+#if SIMKAFI_ENABLE_RTC
+    /// Restart the local clock at a time just learned; measured readings also correct the drift.
+    void anchorClock(uint32_t seconds, int8_t gmt, bool measured);
+
+    /// The local clock's time in seconds since 2000-01-01.
+    uint32_t clockNow() const;
+#endif
+
+#if SIMKAFI_ENABLE_GPRS
+    /// The APN profile the bearer manager is using, or nullptr if there is none.
+    const SIMKAFIAPN *bearerProfile() const;
+
+    /// Read the bearer state with AT+CIPSTATUS.
+    bool queryBearer();
+
+    /// Tear the bearer down with AT+CIPSHUT, which works from every state.
+    bool shutBearer();
+
+    /// Read the bearer address with AT+CIFSR and keep it.
+    bool readBearerAddress();
+
+    /// Change the bearer state, raising SIMKAFI_EVENT_BEARER_DOWN if that takes the bearer down.
+    void setBearer(SIMKAFIBearerState state);
+
+    /// Count a failed bearer step, move on to the next profile if this one keeps failing, and back off.
+    void failBearer();
+
+    /// Look a name up with AT+CDNSGIP; address is 0 if it failed, false if +CDNSGIP never came.
+    bool lookupHost(const char *host, uint32_t &address);
+
+#if SIMKAFI_DNS_CACHE_SIZE > 0
+    /// The live cache entry for a host name, or nullptr.
+    SIMKAFIDNSEntry *findDNSEntry(const char *host);
+
+    /// Remember the result of a lookup in a free, expired or the oldest entry, unless the name is too long to keep.
+    void storeDNSEntry(const char *host, uint32_t address);
+#endif
+#endif
+
+#if SIMKAFI_ENABLE_HTTP
+    /// Open the TCP connection for a request, by address if the host resolves.
+    bool openConnection(const SIMKAFIHTTPRequest &request);
+
+    /// Send length bytes over the open connection as one AT+CIPSEND.
+    bool sendChunk(const uint8_t *data, size_t length);
 
-	///Get the response from the sim900 module in specific timeout (for read message)
-	String getResponseForSMS(long timeout);
+    /// Write the data of an AT+CIPSEND after its prompt.
+    void writeChunk(const uint8_t *data, size_t length);
+
+    /// Append text to the pending CIPSEND chunk, sending the chunk each time it fills up.
+    bool stageChunk(uint8_t *chunk, size_t &used, const char *text, size_t length);
+#endif
+
+#if SIMKAFI_ENABLE_FTP
+    /// Open bearer profile 1 of AT+SAPBR, which the FTP client runs on, with the current APN.
+    bool openFTPBearer();
+
+    /// Open the bearer and set the server, login, transfer type and remote file.
+    bool openFTPSession(const SIMKAFIFTPServer &server, bool upload, const char *path, const char *name);
+
+    /// Send an FTP parameter command with a quoted value and check the answer.
+    bool sendFTPText(const __FlashStringHelper *command, const char *value);
+
+    /// Keep a transfer status line, wherever it turned up; false if the line is something else.
+    bool takeFTPStatus(const char *line, size_t length);
+
+    /// Take the pending transfer status, reading up to the line starting with until if none is pending.
+    int16_t waitFTPStatus(const char *until);
+
+    /// Read exactly length raw bytes, binary data included.
+    bool readData(uint8_t *buffer, size_t length);
+
+    /// Report the file position to the progress callback, if any.
+    void reportFTPProgress(uint32_t position);
+#endif
+
+#if SIMKAFI_ENABLE_CALL
+    /// Read the answer to a dial command and start tracking the call; number may be nullptr for ATDL.
+    SIMKAFIDialResult startCall(const char *number, uint32_t answerTimeout);
+
+    /// Track a new call from its first report.
+    void beginCall(bool incoming, const char *number, size_t length);
+
+    /// Apply one "+CLCC: ..." line to the tracked call; false if it is about another call.
+    bool trackCall(const char *line, size_t length);
+
+    /// Change the state of the tracked call, raising SIMKAFI_EVENT_CALL_STATE.
+    void setCallState(SIMKAFICallState state, const char *line, size_t length);
+
+    /// Release the tracked call; SIMKAFI_CALL_END_NONE works the cause out from what was seen.
+    void releaseCall(SIMKAFICallEnd cause);
+
+    /// True from dialing or ringing until the call is released.
+    bool callInProgress() const;
+
+    /// Release the tracked call after the module accepted ATH.
+    void callHungUp();
+#endif
+
+#if SIMKAFI_ENABLE_SMS
+    /// Submit a text message with the current message format and parameters.
+    bool submitSMS(const char *number, const char *message);
+
+    /// Read a stored message; keepUnread leaves its status alone (AT+CMGR=<index>,1).
+    bool fetchSMS(int index, bool keepUnread, SIMKAFIText &sender, Response &message);
+
+    /// Find the first listed message line containing term.
+    bool findSMS(const char *term, Response &result);
+
+    /// Line handler mirroring the +CMGL headers of a listing.
+    bool mirrorListedSMS(const char *line, size_t length);
+
+    /// Line handler keeping the first listed line that contains searchTerm.
+    bool matchSearchTerm(const char *line, size_t length);
+
+    /// Record the state of one SMS storage slot in the local mirror.
+    void mirrorSMS(int index, bool used, bool unread, bool outgoing);
+
+    /// Purge the SMS storage if the purge policy's high-water mark has been reached.
+    void purgeIfFull();
+#endif
 	
     /// Get the returned operational mode from the SIMKAFI module.
-    String getReturnedMode();
+    Response getReturnedMode();
 
     /// Perform a raw query operation on a specified line.
-    String rawQueryOnLine(uint16_t line);
+    Response rawQueryOnLine(uint16_t line, const char *until = nullptr);
 
     /// Retrieve the result of a query operation.
-    String queryResult();
+    Response queryResult();
 	
-	int parseIndexFromResponse(String response);
+    /// Dispatch a single unsolicited result code line to the registered callbacks.
+    void handleUnsolicited(const char *line, size_t length);
+
+    /// Raise an event on the context-carrying event callback and the matching legacy callback.
+    void dispatchEvent(SIMKAFIEventType type, const char *line, size_t length);
+
+#if SIMKAFI_ENABLE_SMS
+    template<class T, void (T::*Method)(SIMKAFIStringView, SIMKAFIStringView)>
+    static void smsDelegate(void *context, SIMKAFIStringView sender, SIMKAFIStringView message) {
+        (static_cast<T*>(context)->*Method)(sender, message);
+    }
+#endif
+
+    template<class T, void (T::*Method)(const SIMKAFIEvent&)>
+    static void eventDelegate(void *context, const SIMKAFIEvent &event) {
+        (static_cast<T*>(context)->*Method)(event);
+    }
 
 public:
     /**
@@ -85,13 +500,327 @@ public:
     SIMKAFI(Stream& _simKafi);
 	
 	// متدها برای تنظیم کالبکها
+#if SIMKAFI_ENABLE_SMS && !SIMKAFI_NO_HEAP
     void setSMSReceivedCallback(void (*callback)(String, String));
+#endif
+#if SIMKAFI_ENABLE_CALL
     void setCallReceivedCallback(void (*callback)());
+#endif
+#if SIMKAFI_ENABLE_SMS
 	void setSMSDeliveredCallback(void (*callback)());
 
+    /**
+     * 
+     * @brief Register a context-carrying callback for received SMS.
+     *
+     * The sender and message views point into buffers owned by the library and stay valid only
+     * until the callback returns, so no String copies are made to deliver them.
+     *
+     * @param callback The function to call, or nullptr to unregister.
+     * @param context An arbitrary pointer handed back to the callback unchanged.
+     * 
+     */
+    void setSMSReceivedCallback(SIMKAFISMSCallback callback, void *context);
+
+    /**
+     * 
+     * @brief Register a member function of an object as the received SMS callback.
+     *
+     * Usage: `simKafi.setSMSReceivedCallback<Modem, &Modem::onSMS>(&modem);`
+     *
+     * @param object The object whose member function is called.
+     * 
+     */
+    template<class T, void (T::*Method)(SIMKAFIStringView, SIMKAFIStringView)>
+    void setSMSReceivedCallback(T *object) {
+        this->setSMSReceivedCallback(&SIMKAFI::smsDelegate<T, Method>, object);
+    }
+#endif
+
+    /**
+     * 
+     * @brief Register a context-carrying callback for unsolicited events.
+     *
+     * The callback receives every SIMKAFIEventType, including the ones that have no
+     * legacy callback (call ended, GPRS detach, socket closed).
+     *
+     * @param callback The function to call, or nullptr to unregister.
+     * @param context An arbitrary pointer handed back to the callback unchanged.
+     * 
+     */
+    void setEventCallback(SIMKAFIEventCallback callback, void *context);
+
+    /**
+     * 
+     * @brief Register a member function of an object as the event callback.
+     *
+     * Usage: `simKafi.setEventCallback<Modem, &Modem::onEvent>(&modem);`
+     *
+     * @param object The object whose member function is called.
+     * 
+     */
+    template<class T, void (T::*Method)(const SIMKAFIEvent&)>
+    void setEventCallback(T *object) {
+        this->setEventCallback(&SIMKAFI::eventDelegate<T, Method>, object);
+    }
+
     // متد برای پردازش رویدادها
     void handleSerialEvent();
+
+#if SIMKAFI_ENABLE_TASKS
+    /**
+     * 
+     * @brief Reserve the link to the module for the commands of one flow.
+     *
+     * A flow holds the link from its first command to its last, so another flow's command
+     * cannot land between a "> " prompt and the text it waits for. The blocking methods do
+     * not check the link; call them only while no flow holds it, or from the flow holding it.
+     *
+     * @param owner Any pointer identifying the flow; a SIMKAFITask takes its turn by priority
+     * through the overload below, other owners get the link whenever it is free.
+     * @return True if the link was free or already held by owner.
+     * 
+     */
+    bool lockLink(const void *owner);
+
+    /**
+     * 
+     * @brief Reserve the link for a flow, in order of priority when several flows wait for it.
+     *
+     * A task asking while the link is busy waits in line: the link goes to the highest
+     * SIMKAFITask::priority first, then to the earliest deadline, then to the task that asked
+     * first. A task that has not asked again for SIMKAFI_LINK_QUEUE_TIMEOUT loses its place, and
+     * a waiting task must stay alive until it gets the link or unlockLink() is called for it.
+     *
+     * @param task The flow's task.
+     * @return True if the link was given to the task or already held by it.
+     * 
+     */
+    bool lockLink(SIMKAFITask *task);
+
+    /**
+     * 
+     * @brief Release the link reserved with lockLink().
+     *
+     * @param owner The pointer the link was locked with; other pointers are ignored.
+     * 
+     */
+    void unlockLink(const void *owner);
+
+    /**
+     * 
+     * @brief Release the link of a flow, or take it out of line, and close its deadline.
+     *
+     * @param task The flow's task.
+     * 
+     */
+    void unlockLink(SIMKAFITask *task);
+
+    /**
+     * 
+     * @brief Check, at a safe boundary of a flow, whether a more urgent flow waits for the link.
+     *
+     * A safe boundary is a point between two commands where the flow could stop and go on
+     * later, such as between two messages of a listing.
+     *
+     * @param task The flow's task.
+     * @return True if a waiting task has a higher priority than this one.
+     * 
+     */
+    bool linkContended(SIMKAFITask *task);
+
+    /**
+     * 
+     * @brief Give the link up at a safe boundary, keeping the flow's deadline running.
+     *
+     * The flow then waits for lockLink() again, behind the flows more urgent than itself.
+     *
+     * @param task The flow's task, which must hold the link.
+     * 
+     */
+    void yieldLink(SIMKAFITask *task);
+
+    /**
+     * 
+     * @brief Send one command as a resumable flow, so it takes its turn by the task's priority.
+     *
+     * @param task The flow's state, zeroed before the first call apart from priority and deadline.
+     * @param command The command line; must stay valid until the flow has finished.
+     * @return SIMKAFI_TASK_DONE if the command ended in "OK", SIMKAFI_TASK_FAILED otherwise;
+     * polledResponse() holds the response until the next flow sends a command.
+     * 
+     */
+    SIMKAFITaskState runCommand(SIMKAFITask &task, const char *command);
+
+    /**
+     * 
+     * @brief Send a command without waiting for its response; pollResponse() reads it.
+     *
+     * @param command The command line, without the line ending.
+     * @param until As for the blocking methods: nullptr reads up to the final result code, a
+     * prefix also ends the response at a line starting with it and ">" at the "> " prompt.
+     * Must stay valid until the response has been read.
+     * 
+     */
+    void startCommand(const char *command, const char *until = nullptr);
+    void startCommand(const __FlashStringHelper *command, const char *until = nullptr);
+
+    /**
+     * 
+     * @brief Read whatever part of the response to startCommand() has arrived, without waiting.
+     *
+     * Unsolicited lines among it are kept for handleSerialEvent(), and a command that is safe
+     * to repeat is sent again after a timeout, as the blocking methods do.
+     *
+     * @return SIMKAFI_POLL_WAITING until the response has ended or timed out.
+     * 
+     */
+    SIMKAFIPoll pollResponse();
+
+    /**
+     * 
+     * @brief The response pollResponse() has read, trimmed once it has ended.
+     * 
+     */
+    const char *polledResponse() const;
+#endif
+
+    /**
+     * 
+     * @brief Register a callback the library runs whenever it waits for the module.
+     *
+     * Every wait for a response, a prompt, data or a fixed pause calls it while nothing has
+     * arrived, so watchdog feeding, button scanning or display multiplexing go on during modem
+     * latency. Each call gets a budget, the lesser of budgetMs and the time left in the wait, and
+     * should return within it: bytes arriving meanwhile pile up in the Stream's receive buffer.
+     * The callback should not call SIMKAFI methods; waits inside it only yield().
+     *
+     * Without a callback the wait loops call yield(), which keeps WiFi and the watchdog of ESP
+     * boards serviced.
+     *
+     * @param callback The function to call, or nullptr to unregister.
+     * @param context An arbitrary pointer handed back to the callback unchanged.
+     * @param budgetMs The longest time a single call may take, in milliseconds.
+     * 
+     */
+    void setIdleCallback(SIMKAFIIdleCallback callback, void *context, uint16_t budgetMs = SIMKAFI_IDLE_BUDGET);
+
+    /**
+     * 
+     * @brief Register a callback that power-cycles or resets the module.
+     *
+     * resync() calls it when the module does not answer "AT" any more, then waits for the
+     * module to boot.
+     *
+     * @param callback The function to call, or nullptr to unregister.
+     * @param context An arbitrary pointer handed back to the callback unchanged.
+     * 
+     */
+    void setResetCallback(SIMKAFIResetCallback callback, void *context);
+
+    /**
+     * 
+     * @brief Turn the link watchdog on or off (on by default).
+     *
+     * The watchdog calls resync() from inside a library call once SIMKAFI_WATCHDOG_TIMEOUTS
+     * responses in a row have timed out, or SIMKAFI_WATCHDOG_GARBAGE bytes of line noise have
+     * arrived since the last good response. The call that tripped it still fails.
+     * 
+     */
+    void setWatchdog(bool enabled);
+
+    /**
+     * 
+     * @brief Forget what the library knows about the module's settings.
+     *
+     * The library skips set commands (AT+CMGF, AT+CSMP, AT+CNMI, AT+CSCS, AT+CENG) whose value
+     * the module is known to have. Call this after resetting or power-cycling the module
+     * outside the library; resync() and an "RDY" from the module do it automatically.
+     * 
+     */
+    void invalidateConfigCache();
+
+    /**
+     * 
+     * @brief Bring a desynchronized or restarted module back into a known state.
+     *
+     * Cancels any pending text input, flushes the input, and sends "AT" until the module
+     * answers, resetting it through the reset callback if it stays silent. Then the message
+     * format, CNMI, CSMP and APN set through the library are applied again, chained into one
+     * command line for the SMS settings and one for the APN. On success the event callback
+     * receives a single SIMKAFI_EVENT_LINK_RESTORED.
+     *
+     * @return True if the module answers again, false otherwise.
+     * 
+     */
+    bool resync();
+
+    /**
+     * 
+     * @brief Change how long the library waits for responses to one class of commands.
+     *
+     * The running latency estimate of the class is kept; only its bounds change.
+     *
+     * @param commandClass The command class to configure.
+     * @param policy The floor, initial value, ceiling and attempt count to use.
+     * 
+     */
+    void setTimeoutPolicy(SIMKAFICommandClass commandClass, const SIMKAFITimeoutPolicy &policy);
+
+    /**
+     * 
+     * @brief Get the timeout policy of a command class.
+     * 
+     */
+    const SIMKAFITimeoutPolicy &timeoutPolicy(SIMKAFICommandClass commandClass) const;
+
+    /**
+     * 
+     * @brief Get the response timeout currently in effect for a command class.
+     *
+     * @param commandClass The command class to query.
+     * @return The longest silence tolerated while waiting for a response, in milliseconds.
+     * 
+     */
+    uint32_t responseTimeout(SIMKAFICommandClass commandClass) const;
+
+    /**
+     * 
+     * @brief Forget the observed latencies, e.g. after moving the device to another cell.
+     * 
+     */
+    void resetLatencyEstimates();
+
+#if SIMKAFI_ENABLE_STATS
+    /**
+     * 
+     * @brief Get the serial and latency statistics gathered so far.
+     *
+     * Only available when the library is built with SIMKAFI_ENABLE_STATS set to 1.
+     *
+     * @return A reference to the live counters.
+     * 
+     */
+    const SIMKAFIStats &stats() const;
+
+    /**
+     * 
+     * @brief Reset all statistics to zero.
+     * 
+     */
+    void resetStats();
+
+    /**
+     * 
+     * @brief Print the statistics in a compact text form, one line per active command class.
+     *
+     * @param out Where to print, e.g. Serial.
+     * 
+     */
+    void dumpStats(Print &out) const;
+#endif
 	
+#if SIMKAFI_ENABLE_SMS
 	/**
 	 * @brief Sends the AT+CNMI command to configure the SMS message indications.
 	 * 
@@ -120,17 +849,102 @@ public:
 	 *         Returns false if there was an error or no response was received within the timeout period.
 	 */
 	bool sendCNMICommand(int mode, int mt, int bm, int ds, int bfr);
+#endif
+
+    /**
+     * 
+     * @brief Select the character set used for text exchanged with the module (AT+CSCS).
+     *
+     * @param charset The character set name, e.g. "GSM", "IRA" or "UCS2" (at most 7 characters).
+     * @return True if the module accepted the character set, false otherwise.
+     * 
+     */
+    bool setCharacterSet(const char *charset);
+
+
+
+    /**
+     * 
+     * @brief Initialize communication with the SIMKAFI module and perform a handshake.
+     *
+     * @return True if the handshake is successful, false otherwise.
+     * 
+     */
+    bool handshake();
+
+    /**
+     * 
+     * @brief Find the baud rate the module currently runs at.
+     *
+     * Each candidate is applied to the host Stream through the callback and probed with "AT",
+     * which also locks a module in autobaud mode (AT+IPR=0) to that rate. Candidates are tried
+     * in the order given, so put the most likely rate first.
+     *
+     * @param rates The candidate baud rates.
+     * @param count The number of entries in rates.
+     * @param reconfigure Switches the host Stream to a rate.
+     * @param context An arbitrary pointer handed back to reconfigure unchanged.
+     * @return The rate the module answered at, or 0 if it answered at none of them.
+     * 
+     */
+    uint32_t detectBaudRate(const uint32_t *rates, uint8_t count, SIMKAFIBaudCallback reconfigure, void *context);
+
+    /**
+     * 
+     * @brief Move the serial link to the fastest baud rate both sides support.
+     *
+     * The current rate is detected first. The faster candidates are then tried from the fastest
+     * down: AT+IPR switches the module, the callback switches the host Stream and "AT" verifies
+     * the link. A rate the module rejects or that fails verification is rolled back and the next
+     * slower one is tried, so the link is always left working.
+     *
+     * Usage: `simKafi.upgradeBaudRate(rates, 4, reconfigureSerial, &SIM900Serial);`
+     *
+     * @param rates The baud rates the host Stream supports, in any order.
+     * @param count The number of entries in rates.
+     * @param reconfigure Switches the host Stream to a rate.
+     * @param context An arbitrary pointer handed back to reconfigure unchanged.
+     * @param persist Store the rate in the module's profile with AT&W so it survives a power cycle.
+     * @return The rate the link runs at afterwards, or 0 if the module could not be found.
+     * 
+     */
+    uint32_t upgradeBaudRate(const uint32_t *rates, uint8_t count, SIMKAFIBaudCallback reconfigure,
+        void *context, bool persist = false);
 
+    /**
+     * 
+     * @brief Turn the module's RTS/CTS hardware flow control (AT+IFC) on or off.
+     *
+     * With it on, the module stops sending while the host holds RTS high and the host should
+     * stop writing while the module holds CTS high; SIMKAFIBufferedStream::setFlowControl()
+     * drives the host side. The setting is applied again after a resync.
+     *
+     * @param enabled True for RTS/CTS in both directions, false for none.
+     * @return True if the module accepted the setting, false otherwise.
+     * 
+     */
+    bool setFlowControl(bool enabled);
 
+    /**
+     * 
+     * @brief Report the overflows of a receive buffer through rxOverflows() and the statistics.
+     *
+     * Usually the SIMKAFIBufferedStream this object was constructed with.
+     * 
+     */
+    void watchOverflows(const SIMKAFIBufferedStream &stream);
 
     /**
      * 
-     * @brief Initialize communication with the SIMKAFI module and perform a handshake.
+     * @brief Get the number of received bytes the watched receive buffer has dropped.
      *
-     * @return True if the handshake is successful, false otherwise.
+     * A response read while this grows is missing bytes; with SIMKAFI_ENABLE_STATS those
+     * responses are counted in SIMKAFIStats::overflowedResponses.
+     *
+     * @return The count from SIMKAFIBufferedStream::overflows(), or 0 if no buffer is watched.
      * 
      */
-    bool handshake();
+    uint32_t rxOverflows() const;
 
     /**
      * 
@@ -167,15 +981,42 @@ public:
      */
     SIMKAFISignal signal();
 
+    /**
+     * 
+     * @brief Take a snapshot of signal, registration, operator and cells in one round trip.
+     *
+     * AT+CSQ, AT+CREG?, AT+CGREG?, AT+COPS? and AT+CENG? go out as one chained command, so all
+     * values describe the same moment. Lines are parsed as they arrive, straight into the
+     * structure, without a heap allocation or a buffer for the whole answer. The first snapshot
+     * also switches the module to engineering mode 1 with neighbor reporting (AT+CENG=1,1).
+     *
+     * @param snapshot The structure to fill in; fields the module did not answer stay zero.
+     * @return True if the module answered the whole chain, false otherwise.
+     * 
+     */
+    bool diagnostics(SIMKAFIDiagnostics &snapshot);
+
+#if SIMKAFI_ENABLE_CALL
     /**
      * 
      * @brief Initiate an outgoing call to a phone number.
      *
+     * Returns as soon as the module accepted the dial; SIMKAFI_DIAL_RESULT_OK means the call is
+     * being set up, not that anyone answered. call() and SIMKAFI_EVENT_CALL_STATE follow it from
+     * there as the module reports it (see setCallReports() and serviceCall()). A refused dial only
+     * returns its result; call() keeps the previous call and no event is raised.
+     *
      * @param number The phone number to call.
+     * @param answerTimeout Milliseconds the call may ring before serviceCall() hangs it up with
+     *        SIMKAFI_CALL_END_NO_ANSWER, 0 to leave that to the network.
      * @return The result of the dialing operation, as a SIMKAFIDialResult.
      * 
      */
-    SIMKAFIDialResult dialUp(String number);
+    SIMKAFIDialResult dialUp(const char *number, uint32_t answerTimeout = 0);
+
+#if !SIMKAFI_NO_HEAP
+    SIMKAFIDialResult dialUp(String number, uint32_t answerTimeout = 0);
+#endif
 
     /**
      * 
@@ -203,13 +1044,80 @@ public:
      * 
      * @brief Hang up an active call.
      *
-     * This function terminates an ongoing call.
+     * This function terminates an ongoing call. A tracked call is released with
+     * SIMKAFI_CALL_END_LOCAL.
      *
      * @return True if the call is successfully terminated, false otherwise.
      * 
      */
     bool hangUp();
 
+#if SIMKAFI_ENABLE_TASKS
+    /**
+     * 
+     * @brief Hang up as a resumable flow; with SIMKAFI_PRIORITY_URGENT it goes before bulk work.
+     *
+     * @param task The flow's state, zeroed before the first call apart from priority and deadline.
+     * @return SIMKAFI_TASK_RUNNING until the module answered.
+     * 
+     */
+    SIMKAFITaskState hangUp(SIMKAFITask &task);
+#endif
+
+    /**
+     * 
+     * @brief Turn the module's call state reports (AT+CLCC=1) on or off.
+     *
+     * With them on, the module sends a +CLCC line on every change of a call, which
+     * handleSerialEvent() feeds to call(); with them off, serviceCall() asks AT+CLCC every
+     * SIMKAFI_CALL_POLL_INTERVAL while a call is in progress. The setting is applied again
+     * after a resync.
+     *
+     * @param enabled True to have call changes reported.
+     * @return True if the module accepted the setting, false otherwise.
+     * 
+     */
+    bool setCallReports(bool enabled);
+
+    /**
+     * 
+     * @brief Get the call the library is tracking, or the last one once it is released.
+     *
+     * The state moves through dialing, alerting or incoming, active and released; a released
+     * call keeps its duration and cause until the next call starts.
+     *
+     * @return The tracked call; its duration is brought up to date first.
+     * 
+     */
+    const SIMKAFICall &call();
+
+    /**
+     * 
+     * @brief Keep the tracked call up to date; call it from loop().
+     *
+     * Hangs up an outgoing call that rang longer than the answer timeout given to dialUp(), and
+     * asks AT+CLCC while the call state reports are off. A refused ATH is sent again every
+     * SIMKAFI_CALL_POLL_INTERVAL, at most SIMKAFI_CALL_HANGUP_ATTEMPTS times. Does nothing while
+     * no call is in progress. URCs still go through handleSerialEvent().
+     *
+     * @return The state of the tracked call.
+     * 
+     */
+    SIMKAFICallState serviceCall();
+
+    /**
+     * 
+     * @brief Read the module's list of calls (AT+CLCC) and update the tracked call from it.
+     *
+     * A tracked call missing from the list is released.
+     *
+     * @return True if the module answered the list, false otherwise.
+     * 
+     */
+    bool refreshCall();
+#endif
+
+#if SIMKAFI_ENABLE_SMS
     /**
      * 
      * @brief Send an SMS (Short Message Service).
@@ -221,8 +1129,49 @@ public:
      * @return True if the SMS is successfully sent, false otherwise.
      * 
      */
+    bool sendSMS(const char *number, const char *message);
+
+#if !SIMKAFI_NO_HEAP
     bool sendSMS(String number, String message);
+#endif
+
+#if SIMKAFI_ENABLE_TASKS
+    /**
+     * 
+     * @brief Send an SMS as a resumable flow, see SimKafiTask.h.
+     *
+     * Sets the text format if the module is not known to use it, then waits for the link,
+     * the "> " prompt and the +CMGS result without blocking.
+     *
+     * @param task The flow's state, zeroed before the first call.
+     * @param number The recipient's phone number; must stay valid until the flow has finished.
+     * @param message The SMS message content; must stay valid until the flow has finished.
+     * @return SIMKAFI_TASK_RUNNING until the message was accepted or the send failed.
+     * 
+     */
+    SIMKAFITaskState sendSMS(SIMKAFITask &task, const char *number, const char *message);
+
+    /**
+     * 
+     * @brief Hand every stored SMS to a callback as a resumable flow, one AT+CMGR per message.
+     *
+     * Needs the storage size from selectSMSStorage() or syncSMSStorage(). Messages stay unread. Between two messages the flow gives the link up to any more urgent
+     * flow waiting for it and carries on afterwards, so run it with SIMKAFI_PRIORITY_BULK to keep
+     * alarm traffic from waiting behind a whole listing. If the task's deadline has already
+     * passed when that happens, the scan stops there and fails instead. Slots the storage mirror
+     * knows to be empty are skipped.
+     *
+     * @param task The flow's state; task.offset is the slot of the message handed to the callback.
+     * @param callback The function called for each message; the views last until it returns.
+     * @param context An arbitrary pointer handed back to the callback unchanged.
+     * @return SIMKAFI_TASK_RUNNING until every slot has been read or a read failed.
+     * 
+     */
+    SIMKAFITaskState scanSMS(SIMKAFITask &task, SIMKAFISMSCallback callback, void *context);
+#endif
+#endif
 
+#if SIMKAFI_ENABLE_GPRS
     /**
      * 
      * @brief Connect to an Access Point Name (APN) for mobile data.
@@ -246,6 +1195,140 @@ public:
      */
     bool enableGPRS();
 
+#if SIMKAFI_ENABLE_TASKS
+    /**
+     * 
+     * @brief connectAPN() followed by enableGPRS() as a resumable flow, see SimKafiTask.h.
+     *
+     * @param task The flow's state, zeroed before the first call.
+     * @param apn The APN to connect with; must stay valid until the flow has finished.
+     * @return SIMKAFI_TASK_RUNNING until GPRS is up or a step failed.
+     * 
+     */
+    SIMKAFITaskState connectGPRS(SIMKAFITask &task, const SIMKAFIAPN &apn);
+#endif
+
+    /**
+     * 
+     * @brief Set the APN profiles the bearer manager tries, in order.
+     *
+     * A profile that fails SIMKAFI_BEARER_PROFILE_ATTEMPTS times in a row is dropped for the
+     * next one, wrapping around after the last. Without profiles the manager uses the APN
+     * last given to connectAPN().
+     *
+     * @param profiles The profiles; the array is not copied and must stay valid.
+     * @param count The number of profiles.
+     * 
+     */
+    void setAPNProfiles(const SIMKAFIAPN *profiles, uint8_t count);
+
+    /**
+     * 
+     * @brief Ask the bearer manager to bring the GPRS bearer up and keep it up.
+     *
+     * Returns at once; serviceBearer() does the work. A bearer the network drops
+     * ("+PDP: DEACT") is reconnected right away, failed attempts are retried with a
+     * backoff that doubles from SIMKAFI_BEARER_BACKOFF_MIN to SIMKAFI_BEARER_BACKOFF_MAX.
+     * 
+     */
+    void bearerUp();
+
+    /**
+     * 
+     * @brief Ask the bearer manager to take the GPRS bearer down (AT+CIPSHUT).
+     *
+     * Returns at once; serviceBearer() does the work.
+     * 
+     */
+    void bearerDown();
+
+    /**
+     * 
+     * @brief Advance the bearer manager by at most one step.
+     *
+     * Call it from loop(), next to handleSerialEvent(). Each call sends at most one command
+     * (AT+CIPSTATUS, AT+CGATT=1;+CSTT, AT+CIICR, AT+CIFSR or AT+CIPSHUT) and returns while a
+     * backoff is running, so it never waits longer than that command's response. The
+     * states follow IP INITIAL, IP START, IP CONFIG, IP GPRSACT and IP STATUS as the
+     * module reports them.
+     *
+     * @return The bearer state after the step.
+     * 
+     */
+    SIMKAFIBearerState serviceBearer();
+
+    /**
+     * 
+     * @brief Get the bearer state as last seen, without talking to the module.
+     *
+     * @return The bearer state.
+     * 
+     */
+    SIMKAFIBearerState bearerState() const;
+
+    /**
+     * 
+     * @brief Check whether the bearer is up and its address known.
+     *
+     * @return True if the bearer is up, false otherwise.
+     * 
+     */
+    bool isBearerUp() const;
+
+    /**
+     * 
+     * @brief Get the bearer address read when the bearer came up, without talking to the module.
+     *
+     * @return The address, or "" while the bearer is not up.
+     * 
+     */
+    const char *bearerAddress() const;
+
+    /**
+     * 
+     * @brief Get the index of the APN profile the bearer manager is using.
+     *
+     * @return The index into the array given to setAPNProfiles().
+     * 
+     */
+    uint8_t activeAPNProfile() const;
+
+    /**
+     * 
+     * @brief Resolve a host name to an IPv4 address (AT+CDNSGIP), through the DNS cache.
+     *
+     * A cached address is used for SIMKAFI_DNS_TTL and a name the network reported as
+     * unresolvable is remembered for SIMKAFI_DNS_FAILURE_TTL, so neither costs a round trip
+     * over the cellular link until it expires; a lookup that timed out is not remembered.
+     * The answer is awaited with the DATA_CONNECT timeout. An address given as the host is returned as it is. The bearer must be up
+     * for a lookup. request() connects by the resolved address when there is one.
+     *
+     * @param host The host name.
+     * @param address The dotted address (output); at least 16 characters make room for any.
+     * @param addressSize The size of the address buffer.
+     * @return True if the name resolved, false otherwise.
+     * 
+     */
+    bool resolve(const char *host, char *address, size_t addressSize);
+
+    /**
+     * 
+     * @brief Forget every name in the DNS cache.
+     * 
+     */
+    void flushDNSCache();
+
+    /**
+     * 
+     * @brief Get the DNS cache counters.
+     *
+     * @return The hits, misses and failed lookups since start-up.
+     * 
+     */
+    const SIMKAFIDNSStats &dnsStats() const;
+#endif
+
+#if SIMKAFI_ENABLE_HTTP
     /**
      * 
      * @brief Send an HTTP request to a remote server.
@@ -253,11 +1336,115 @@ public:
      * This function sends an HTTP request to a specified server with the provided request parameters.
      *
      * @param request An instance of the SIMKAFIHTTPRequest structure representing the HTTP request.
-     * @return A SIMKAFIHTTPResponse structure containing the HTTP response from the server.
+     * @return A SIMKAFIHTTPResponse whose status is SIMKAFI_HTTP_STATUS_SENT once the whole request
+     *         went out, or SIMKAFI_HTTP_STATUS_FAILED.
      * 
      */
     SIMKAFIHTTPResponse request(SIMKAFIHTTPRequest request);
 
+    /**
+     * 
+     * @brief Send an HTTP request whose body is pulled from a callback.
+     *
+     * The request line, the headers and the body go out in AT+CIPSEND chunks of
+     * SIMKAFI_CIPSEND_CHUNK bytes, staged in one buffer on the stack, so the size of the
+     * upload does not depend on free RAM. request.data is ignored; a Content-Length
+     * header is added for the body.
+     *
+     * @param request The method, host, resource and headers of the request.
+     * @param source Called until contentLength bytes were read; returning 0 earlier aborts the request.
+     * @param context Passed to source unchanged.
+     * @param contentLength The number of body bytes source will produce.
+     * @return The response, with status SIMKAFI_HTTP_STATUS_SENT or SIMKAFI_HTTP_STATUS_FAILED.
+     * 
+     */
+    SIMKAFIHTTPResponse request(const SIMKAFIHTTPRequest &request, SIMKAFIHTTPBodySource source,
+        void *context, uint32_t contentLength);
+
+    /**
+     * 
+     * @brief Send an HTTP request whose body is read from a Stream, e.g. a file on an SD card.
+     *
+     * @param request The method, host, resource and headers of the request.
+     * @param body The stream to read contentLength bytes from; its timeout applies to every read.
+     * @param contentLength The number of body bytes to send.
+     * @return The response, with status SIMKAFI_HTTP_STATUS_SENT or SIMKAFI_HTTP_STATUS_FAILED.
+     * 
+     */
+    SIMKAFIHTTPResponse request(const SIMKAFIHTTPRequest &request, Stream &body, uint32_t contentLength);
+
+#if SIMKAFI_ENABLE_TASKS
+    /**
+     * 
+     * @brief Open the connection for a request and send it, with request.data as its body, as a
+     * resumable flow, see SimKafiTask.h.
+     *
+     * The host is connected to by address if the DNS cache has one and by name otherwise; the
+     * request goes out in AT+CIPSEND chunks of SIMKAFI_CIPSEND_CHUNK bytes, each rendered from
+     * request at the moment it is sent.
+     *
+     * @param task The flow's state, zeroed before the first call.
+     * @param request The request; must stay valid and unchanged until the flow has finished.
+     * @return SIMKAFI_TASK_RUNNING until the request was sent or a step failed.
+     * 
+     */
+    SIMKAFITaskState request(SIMKAFITask &task, const SIMKAFIHTTPRequest &request);
+#endif
+#endif
+
+#if SIMKAFI_ENABLE_FTP
+    /**
+     * 
+     * @brief Upload a file with the module's FTP client.
+     *
+     * The file goes out in AT+FTPPUT=2 chunks of at most SIMKAFI_FTP_CHUNK bytes, as large as
+     * the module accepts, pulled from source as they are sent. The FTP client uses bearer
+     * profile 1 of AT+SAPBR, which is opened with the APN of connectAPN() or setAPNProfiles()
+     * if it is not open yet.
+     *
+     * @param server The server and login.
+     * @param path The remote directory, e.g. "/logs/".
+     * @param name The remote file name.
+     * @param source Called for each chunk until it returns 0.
+     * @param context Passed to source unchanged.
+     * @param offset To resume, the number of bytes the server already has; the file is appended
+     *               to (APPE) and source must start at that offset.
+     * @return Whether the file was stored, the module's error code and the bytes sent.
+     * 
+     */
+    SIMKAFIFTPResult ftpUpload(const SIMKAFIFTPServer &server, const char *path, const char *name,
+        SIMKAFIFTPSource source, void *context, uint32_t offset = 0);
+
+    /**
+     * 
+     * @brief Download a file with the module's FTP client.
+     *
+     * The file arrives in AT+FTPGET=2 chunks of at most SIMKAFI_FTP_CHUNK bytes, each handed to
+     * sink before the next is requested.
+     *
+     * @param server The server and login.
+     * @param path The remote directory, e.g. "/config/".
+     * @param name The remote file name.
+     * @param sink Called for each chunk; returning false aborts the transfer.
+     * @param context Passed to sink unchanged.
+     * @param offset To resume, the position to start at (AT+FTPREST).
+     * @return Whether the whole file arrived, the module's error code and the bytes received.
+     * 
+     */
+    SIMKAFIFTPResult ftpDownload(const SIMKAFIFTPServer &server, const char *path, const char *name,
+        SIMKAFIFTPSink sink, void *context, uint32_t offset = 0);
+
+    /**
+     * 
+     * @brief Register a callback invoked after every chunk of an FTP transfer.
+     *
+     * @param callback The function to call with the position reached in the file, or nullptr to unregister.
+     * @param context An arbitrary pointer handed back to the callback unchanged.
+     * 
+     */
+    void setFTPProgressCallback(SIMKAFIFTPProgress callback, void *context);
+#endif
+
     /**
      * 
      * @brief Get information about the current network operator.
@@ -281,6 +1468,7 @@ public:
      */
     SIMKAFICardAccount cardNumber();
 
+#if SIMKAFI_ENABLE_RTC
     /**
      * 
      * @brief Get the real-time clock (RTC) information.
@@ -288,11 +1476,48 @@ public:
      * This function retrieves the current date and time from the SIMKAFI module, including day, month, year, hour,
      * minute, second, and the GMT offset.
      *
-     * @return A SIMKAFIRTC structure containing RTC information.
+     * The time is kept by a local clock on millis(), so most calls cost no serial traffic. The
+     * clock is set from AT+CCLK? on first use and every SIMKAFI_RTC_RESYNC_INTERVAL, and from the
+     * network's time reports once setNetworkTime() is on; each reading also corrects the
+     * estimated drift of the board's oscillator.
+     *
+     * @return A SIMKAFIRTC structure containing RTC information, all zero if the module could not be read.
      * 
      */
     SIMKAFIRTC rtc();
 
+    /**
+     * 
+     * @brief Read the module's clock now and set the local clock from it.
+     *
+     * @return True if the module answered with a valid time, false otherwise.
+     * 
+     */
+    bool syncRtc();
+
+    /**
+     * 
+     * @brief Turn the module's network time updates (AT+CLTS) on or off.
+     *
+     * When on, the module sets its clock from the network on registration and reports the time
+     * with *PSUTTZ and the zone with +CTZV; handleSerialEvent() feeds both to the local clock.
+     * The setting is applied again after a resync.
+     *
+     * @param enable True to follow the network time.
+     * @return True if the module accepted the setting, false otherwise.
+     * 
+     */
+    bool setNetworkTime(bool enable);
+
+    /**
+     * 
+     * @brief Get the estimated drift of millis() against the module's clock.
+     *
+     * @return Parts per million the board runs slow (positive) or fast (negative).
+     * 
+     */
+    int32_t rtcDrift() const;
+
     /**
      * 
      * @brief Update the SIMKAFI module's real-time clock (RTC).
@@ -304,7 +1529,9 @@ public:
      * 
      */
     bool updateRtc(SIMKAFIRTC config);
+#endif
 
+#if SIMKAFI_ENABLE_PHONEBOOK
     /**
      * 
      * @brief Save a contact in the SIM card's phonebook.
@@ -353,64 +1580,74 @@ public:
      * 
      */
     SIMKAFIPhonebookCapacity phonebookCapacity();
+#endif
 
     /**
      * 
      * @brief Get the manufacturer name of the SIMKAFI module.
      *
-     * @return The manufacturer name as a String.
+     * @return The manufacturer name as text.
      * 
      */
-    String manufacturer();
+    SIMKAFIText manufacturer();
 
     /**
      * 
      * @brief Get the software release version of the SIMKAFI module.
      *
-     * @return The software release version as a String.
+     * @return The software release version as text.
      * 
      */
-    String softwareRelease();
+    SIMKAFIText softwareRelease();
 
     /**
      * 
      * @brief Get the International Mobile Equipment Identity (IMEI) number of the SIMKAFI module.
      *
-     * @return The IMEI number as a String.
+     * @return The IMEI number as text.
      * 
      */
-    String imei();
+    SIMKAFIText imei();
 
     /**
      * 
      * @brief Get the chip model of the SIMKAFI module.
      *
-     * @return The chip model as a String.
+     * @return The chip model as text.
      * 
      */
-    String chipModel();
+    SIMKAFIText chipModel();
 
     /**
      * 
      * @brief Get the chip name of the SIMKAFI module.
      *
-     * @return The chip name as a String.
+     * @return The chip name as text.
      * 
      */
-    String chipName();
+    SIMKAFIText chipName();
 
+#if SIMKAFI_ENABLE_GPRS
     /**
      * 
      * @brief Get the IP address assigned to the SIMKAFI module.
      *
-     * @return The assigned IP address as a String.
+     * Answered from the address kept by the bearer manager while the bearer is up;
+     * otherwise read with AT+CIFSR and kept.
+     *
+     * @return The assigned IP address as text, or "" if there is none.
      * 
      */
-    String ipAddress();
+    SIMKAFIText ipAddress();
+#endif
 	
+#if SIMKAFI_ENABLE_SMS
 	/**
 	 * @brief Get the number of SMS messages stored in the SIM card's memory.
 	 *
+	 * Answered from the local mirror without talking to the module once it has been
+	 * synchronized; the first call synchronizes it, see syncSMSStorage().
+	 *
 	 * @return The number of SMS messages stored, or -1 if the command fails.
 	 */
 	int getSMSCount();
@@ -420,10 +1657,16 @@ public:
 	 *
 	 * @param index The index of the SMS to read (starting from 1).
 	 * @param sender The phone number of the SMS sender (output).
+	 * @param senderSize The size of the sender buffer; longer numbers are cut short.
 	 * @param message The content of the SMS (output).
+	 * @param messageSize The size of the message buffer; longer messages are cut short.
 	 * @return True if the SMS is read successfully, false otherwise.
 	 */
+	bool readSMS(int index, char *sender, size_t senderSize, char *message, size_t messageSize);
+
+#if !SIMKAFI_NO_HEAP
 	bool readSMS(int index, String& sender, String& message);
+#endif
 
 	/**
 	 * @brief Delete a specific SMS from the SIM card's memory.
@@ -440,16 +1683,25 @@ public:
 	 * @param message The content of the SMS to save as a draft.
 	 * @return True if the draft is saved successfully, false otherwise.
 	 */
+	bool saveDraft(const char *number, const char *message);
+
+#if !SIMKAFI_NO_HEAP
 	bool saveDraft(String number, String message);
+#endif
 
 	/**
 	 * @brief Search for an SMS containing a specific term.
 	 *
 	 * @param searchTerm The term to search for in the SMS messages.
 	 * @param result The content of the SMS message found.
+	 * @param resultSize The size of the result buffer; a longer line is cut short.
 	 * @return True if an SMS containing the search term is found, false otherwise.
 	 */
+	bool searchSMS(const char *searchTerm, char *result, size_t resultSize);
+
+#if !SIMKAFI_NO_HEAP
 	bool searchSMS(String searchTerm, String& result);
+#endif
 
 	/**
 	 * @brief Delete all read SMS messages from the SIM card's memory.
@@ -473,7 +1725,11 @@ public:
 	 * @param message The content of the SMS message to send.
 	 * @return True if the flash SMS is sent successfully, false otherwise.
 	 */
+	bool sendFlashSMS(const char *number, const char *message);
+
+#if !SIMKAFI_NO_HEAP
 	bool sendFlashSMS(String number, String message);
+#endif
 
 	/**
 	 * @brief Enable the delivery reports for sent SMS messages.
@@ -485,7 +1741,9 @@ public:
 	/**
 	 * @brief Retrieve the count of unread SMS messages stored in the SIM card.
 	 *
-	 * @return The number of unread SMS messages stored in the SIM card.
+	 * Answered from the local mirror like getSMSCount().
+	 *
+	 * @return The number of unread SMS messages stored in the SIM card, or -1 if the command fails.
 	 */
 	int getUnreadSMSCount();
 
@@ -494,10 +1752,88 @@ public:
 	 *
 	 * @param index The index of the unread SMS to read (starting from 1).
 	 * @param sender The phone number of the sender.
+	 * @param senderSize The size of the sender buffer; longer numbers are cut short.
 	 * @param message The content of the SMS message.
+	 * @param messageSize The size of the message buffer; longer messages are cut short.
 	 * @return True if the unread SMS is read successfully, false otherwise.
 	 */
+	bool readUnreadSMS(int index, char *sender, size_t senderSize, char *message, size_t messageSize);
+
+#if !SIMKAFI_NO_HEAP
 	bool readUnreadSMS(int index, String& sender, String& message);
+#endif
+
+    /**
+     * 
+     * @brief Select the storage messages are read from, written to and received into (AT+CPMS).
+     *
+     * The selection is applied again after a resync, and the local count mirror is
+     * synchronized with the new storage.
+     *
+     * @param storage The storage to use.
+     * @return True if the storage was selected and its contents listed, false otherwise.
+     * 
+     */
+    bool selectSMSStorage(SIMKAFISMSStorage storage);
+
+    /**
+     * 
+     * @brief Rebuild the local count mirror from the module (AT+CPMS? and AT+CMGL).
+     *
+     * From then on the mirror follows +CMTI indications seen by handleSerialEvent() and
+     * the reads, drafts and deletes made through the library, so new message indications
+     * must be enabled with sendCNMICommand() (<mt> = 1). A resync or a module restart
+     * marks the mirror stale and the next count synchronizes it again. Messages are not
+     * marked as read by the listing.
+     *
+     * @return True if the mirror was rebuilt, false otherwise.
+     * 
+     */
+    bool syncSMSStorage();
+
+    /**
+     * 
+     * @brief Get the mirrored message counts of the selected storage without talking to the module.
+     *
+     * Only indices 1 to SIMKAFI_SMS_SLOTS are mirrored; a message above them leaves the mirror invalid.
+     *
+     * @return The storage status; its valid flag is false until the mirror has been synchronized.
+     * 
+     */
+    SIMKAFISMSStorageStatus smsStorage() const;
+
+    /**
+     * 
+     * @brief Get the lowest storage index holding an unread message, from the local mirror.
+     *
+     * @return The index (starting from 1), or 0 if there is no unread message or the mirror is stale.
+     * 
+     */
+    int nextUnreadSMS() const;
+
+    /**
+     * 
+     * @brief Set when the library purges the SMS storage on its own.
+     *
+     * Once a received message or a saved draft fills the storage to the high-water mark,
+     * the messages selected by the policy's mode are deleted in one command. The mark
+     * is checked after the received message callbacks ran. Purging is off by default.
+     *
+     * @param policy The high-water mark in percent of the capacity (0 = off) and what to delete.
+     * 
+     */
+    void setSMSPurgePolicy(const SIMKAFIPurgePolicy &policy);
+
+    /**
+     * 
+     * @brief Delete messages in bulk with a single AT+CMGD=1,<flag>.
+     *
+     * @param mode Which messages to delete.
+     * @return True if the messages were deleted, false otherwise.
+     * 
+     */
+    bool purgeSMS(SIMKAFIPurgeMode mode);
+#endif
 
 
 };
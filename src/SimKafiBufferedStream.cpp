@@ -0,0 +1,181 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "SimKafiBufferedStream.h"
+
+SIMKAFIBufferedStream::SIMKAFIBufferedStream(Stream &inner, uint8_t *buffer, size_t capacity) :
+    inner(inner), buffer(buffer), capacity(capacity), head(0), tail(0), draining(false),
+    overflowCount(0), highWaterMark(0), readyCallback(nullptr), clearCallback(nullptr),
+    flowContext(nullptr), pauseLevel(0), resumeLevel(0), paused(false) {}
+
+size_t SIMKAFIBufferedStream::fill() const {
+    // head belongs to drain(), which may run in an interrupt; a multi-byte index is read atomically.
+    noInterrupts();
+    size_t written = this->head;
+    interrupts();
+
+    return (written + this->capacity - this->tail) % this->capacity;
+}
+
+size_t SIMKAFIBufferedStream::drain() {
+    // An interrupt that lands inside a drain() of the sketch leaves the bytes to that one.
+    if(this->draining || this->capacity < 2)
+        return 0;
+    this->draining = true;
+
+    size_t moved = 0, at = this->head;
+    while(this->inner.available() > 0) {
+        size_t next = (at + 1) % this->capacity;
+
+        if(next == this->tail) {
+            // With RTS the module has been stopped; what is still in flight waits in the port.
+            if(this->readyCallback != nullptr)
+                break;
+
+            this->inner.read();
+            this->overflowCount++;
+        }
+        else {
+            this->buffer[at] = (uint8_t) this->inner.read();
+            this->head = at = next;
+        }
+        moved++;
+    }
+
+    size_t level = (at + this->capacity - this->tail) % this->capacity;
+    if(level > this->highWaterMark)
+        this->highWaterMark = level;
+
+    if(this->readyCallback != nullptr && !this->paused && level >= this->pauseLevel) {
+        this->paused = true;
+        this->readyCallback(this->flowContext, false);
+    }
+
+    this->draining = false;
+    return moved;
+}
+
+void SIMKAFIBufferedStream::updateReady() {
+    if(!this->paused || this->fill() > this->resumeLevel)
+        return;
+
+    this->paused = false;
+    this->readyCallback(this->flowContext, true);
+}
+
+void SIMKAFIBufferedStream::setFlowControl(SIMKAFIReadyCallback ready, SIMKAFIClearCallback clear,
+    void *context, size_t pauseAt, size_t resumeAt) {
+    size_t usable = this->capacity > 0 ? this->capacity - 1 : 0;
+
+    this->pauseLevel = pauseAt != 0 && pauseAt <= usable ? pauseAt : usable - usable / 4;
+    this->resumeLevel = resumeAt != 0 && resumeAt < this->pauseLevel ? resumeAt : this->pauseLevel / 3;
+    this->flowContext = context;
+    this->clearCallback = clear;
+    this->paused = false;
+    this->readyCallback = ready;
+
+    if(ready != nullptr)
+        ready(context, true);
+}
+
+uint32_t SIMKAFIBufferedStream::overflows() const {
+    noInterrupts();
+    uint32_t count = this->overflowCount;
+    interrupts();
+
+    return count;
+}
+
+size_t SIMKAFIBufferedStream::highWater() const {
+    noInterrupts();
+    size_t level = this->highWaterMark;
+    interrupts();
+
+    return level;
+}
+
+void SIMKAFIBufferedStream::clearOverflows() {
+    noInterrupts();
+    this->overflowCount = 0;
+    this->highWaterMark = 0;
+    interrupts();
+}
+
+int SIMKAFIBufferedStream::available() {
+    this->drain();
+    return (int) this->fill();
+}
+
+int SIMKAFIBufferedStream::read() {
+    this->drain();
+    if(this->fill() == 0)
+        return -1;
+
+    uint8_t value = this->buffer[this->tail];
+    size_t next = (this->tail + 1) % this->capacity;
+
+    noInterrupts();
+    this->tail = next;
+    interrupts();
+
+    if(this->readyCallback != nullptr)
+        this->updateReady();
+    return value;
+}
+
+int SIMKAFIBufferedStream::peek() {
+    this->drain();
+    return this->fill() == 0 ? -1 : this->buffer[this->tail];
+}
+
+size_t SIMKAFIBufferedStream::write(uint8_t value) {
+    return this->write(&value, 1);
+}
+
+size_t SIMKAFIBufferedStream::write(const uint8_t *buffer, size_t size) {
+    if(this->clearCallback == nullptr)
+        return this->inner.write(buffer, size);
+
+    size_t written = 0;
+    while(written < size) {
+        // Keep receiving while the module holds CTS, so neither side waits on the other.
+        unsigned long start = millis();
+        while(!this->clearCallback(this->flowContext)) {
+            if(millis() - start >= this->_timeout)
+                return written;
+
+            this->drain();
+            yield();
+        }
+
+        if(this->inner.write(buffer[written]) != 1)
+            break;
+        written++;
+    }
+
+    return written;
+}
+
+void SIMKAFIBufferedStream::flush() {
+    this->inner.flush();
+}
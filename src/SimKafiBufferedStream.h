@@ -0,0 +1,175 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * 
+ * @file SimKafiBufferedStream.h
+ * @brief A receive ring buffer in front of a small-buffered serial port, with overflow counters and RTS/CTS.
+ * 
+ */
+
+#ifndef SIMKAFI_BUFFERED_STREAM_H
+#define SIMKAFI_BUFFERED_STREAM_H
+
+#include <Arduino.h>
+
+/**
+ * 
+ * @brief Callback that drives the RTS line towards the module: true lets the module send, false stops it.
+ * 
+ */
+typedef void (*SIMKAFIReadyCallback)(void *context, bool ready);
+
+/**
+ * 
+ * @brief Callback that reads the CTS line from the module: true while the module accepts data.
+ * 
+ */
+typedef bool (*SIMKAFIClearCallback)(void *context);
+
+/**
+ * 
+ * @class SIMKAFIBufferedStream
+ * @brief A Stream that moves received bytes from another Stream into a larger ring buffer.
+ *
+ * SoftwareSerial keeps 64 received bytes; a multi-line answer such as AT+CMGL outruns that
+ * whenever the sketch is busy for a few milliseconds, and the excess is lost without a trace.
+ * This wrapper pulls bytes out of the port into a caller-provided ring buffer every time it is
+ * read, and drain() does the same from a timer or pin-change interrupt, so the port's own buffer
+ * only has to cover the time between two drains:
+ *
+ *     static uint8_t rxRing[512];
+ *     SIMKAFIBufferedStream modemLink(SIM900Serial, rxRing, sizeof(rxRing));
+ *     SIMKAFI simKafi(modemLink);
+ *
+ *     ISR(TIMER2_COMPA_vect) { modemLink.drain(); }
+ *
+ * Bytes that arrive while the ring is full are dropped and counted by overflows(). With
+ * setFlowControl() the wrapper stops the module through RTS before that happens and holds
+ * writes while the module deasserts CTS; SIMKAFI::setFlowControl() switches the module side.
+ * 
+ */
+class SIMKAFIBufferedStream : public Stream {
+private:
+    /// The Stream connected to the module.
+    Stream &inner;
+
+    /// Ring buffer storage; it holds capacity - 1 bytes so that head == tail means empty.
+    uint8_t *buffer;
+    size_t capacity;
+
+    /// Written only by drain() and only by read() respectively, so one side may run in an interrupt.
+    volatile size_t head, tail;
+
+    /// Set while a drain() runs, so one started from an interrupt does not cut into another.
+    volatile bool draining;
+
+    /// Bytes dropped because the ring was full, and the highest fill level seen.
+    volatile uint32_t overflowCount;
+    volatile size_t highWaterMark;
+
+    /// RTS and CTS callbacks, their context, and the fill levels at which RTS drops and rises again.
+    SIMKAFIReadyCallback readyCallback;
+    SIMKAFIClearCallback clearCallback;
+    void *flowContext;
+    size_t pauseLevel, resumeLevel;
+    volatile bool paused;
+
+    size_t fill() const;
+    void updateReady();
+
+public:
+    /**
+     * 
+     * @brief Wrap a Stream and buffer what it receives.
+     *
+     * @param inner The Stream connected to the module.
+     * @param buffer Storage for the ring buffer.
+     * @param capacity The size of the storage in bytes; capacity - 1 bytes are buffered.
+     * 
+     */
+    SIMKAFIBufferedStream(Stream &inner, uint8_t *buffer, size_t capacity);
+
+    /**
+     * 
+     * @brief Move everything the wrapped Stream has received into the ring buffer.
+     *
+     * Safe to call from an interrupt handler while the sketch reads the stream, provided the
+     * wrapped Stream's read() is. Every read, peek and available() call drains as well.
+     *
+     * @return The number of bytes moved or dropped.
+     * 
+     */
+    size_t drain();
+
+    /**
+     * 
+     * @brief Turn hardware flow control on the host side on.
+     *
+     * Once the ring holds pauseAt bytes the ready callback is called with false, which should
+     * drive RTS high so the module stops sending; bytes still in flight stay in the wrapped
+     * Stream instead of being dropped. Once reads bring the fill level down to resumeAt, the
+     * callback is called with true. Writes wait, up to the Stream timeout, while the clear
+     * callback returns false.
+     *
+     * @param ready Drives RTS, or nullptr to leave it alone.
+     * @param clear Reads CTS, or nullptr to write without waiting.
+     * @param context An arbitrary pointer handed back to both callbacks unchanged.
+     * @param pauseAt The fill level at which the module is stopped; 0 means three quarters of the ring.
+     * @param resumeAt The fill level at which it may send again; 0 means a quarter of the ring.
+     * 
+     */
+    void setFlowControl(SIMKAFIReadyCallback ready, SIMKAFIClearCallback clear, void *context,
+        size_t pauseAt = 0, size_t resumeAt = 0);
+
+    /**
+     * 
+     * @brief Get the number of received bytes dropped because the ring buffer was full.
+     * 
+     */
+    uint32_t overflows() const;
+
+    /**
+     * 
+     * @brief Get the highest number of bytes the ring buffer held, to size it.
+     * 
+     */
+    size_t highWater() const;
+
+    /**
+     * 
+     * @brief Reset the overflow counter and the high-water mark.
+     * 
+     */
+    void clearOverflows();
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t value) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    void flush() override;
+    using Print::write;
+};
+
+#endif
@@ -0,0 +1,242 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "SimKafiFixedString.h"
+
+// F() strings live in program memory on AVR and need their own accessor there.
+static char flashChar(const char *p) {
+#ifdef pgm_read_byte
+    return (char) pgm_read_byte(p);
+#else
+    return *p;
+#endif
+}
+
+static unsigned int flashLength(const char *p) {
+    unsigned int length = 0;
+    while(flashChar(p + length) != '\0')
+        length++;
+    return length;
+}
+
+void SIMKAFITextBuffer::assign(const char *cstr, unsigned int length) {
+    this->len = 0;
+    this->overflow = false;
+    this->buffer[0] = '\0';
+    this->concat(cstr, length);
+}
+
+bool SIMKAFITextBuffer::concat(const char *cstr, unsigned int length) {
+    bool fits = this->len + length <= this->cap;
+    if(!fits) {
+        length = this->cap - this->len;
+        this->overflow = true;
+    }
+
+    memmove(this->buffer + this->len, cstr, length);
+    this->len += length;
+    this->buffer[this->len] = '\0';
+
+    return fits;
+}
+
+bool SIMKAFITextBuffer::concat(const char *cstr) {
+    return cstr == nullptr || this->concat(cstr, strlen(cstr));
+}
+
+bool SIMKAFITextBuffer::concat(const __FlashStringHelper *str) {
+    const char *p = reinterpret_cast<const char*>(str);
+    bool fits = true;
+
+    for(char c; p != nullptr && (c = flashChar(p)) != '\0'; p++)
+        fits = this->concat(c) && fits;
+    return fits;
+}
+
+bool SIMKAFITextBuffer::concat(const SIMKAFITextBuffer &str) {
+    return this->concat(str.buffer, str.len);
+}
+
+bool SIMKAFITextBuffer::concat(char c) {
+    return this->concat(&c, 1);
+}
+
+bool SIMKAFITextBuffer::concat(unsigned char value) {
+    return this->concat((unsigned long) value);
+}
+
+bool SIMKAFITextBuffer::concat(int value) {
+    return this->concat((long) value);
+}
+
+bool SIMKAFITextBuffer::concat(unsigned int value) {
+    return this->concat((unsigned long) value);
+}
+
+bool SIMKAFITextBuffer::concat(long value) {
+    if(value >= 0)
+        return this->concat((unsigned long) value);
+
+    bool fits = this->concat('-');
+    return this->concat((unsigned long) -(value + 1) + 1) && fits;
+}
+
+bool SIMKAFITextBuffer::concat(unsigned long value) {
+    char digits[10];
+    uint8_t count = 0;
+
+    do {
+        digits[count++] = (char) ('0' + value % 10);
+        value /= 10;
+    } while(value != 0);
+
+    bool fits = true;
+    while(count > 0)
+        fits = this->concat(digits[--count]) && fits;
+    return fits;
+}
+
+bool SIMKAFITextBuffer::equals(const char *cstr) const {
+    return strcmp(this->buffer, cstr != nullptr ? cstr : "") == 0;
+}
+
+bool SIMKAFITextBuffer::equals(const __FlashStringHelper *str) const {
+    const char *p = reinterpret_cast<const char*>(str);
+    return flashLength(p) == this->len && this->find(p, this->len, true, 0, false) == 0;
+}
+
+bool SIMKAFITextBuffer::startsWith(const char *prefix, unsigned int offset) const {
+    unsigned int length = strlen(prefix);
+    return offset <= this->len && this->len - offset >= length &&
+        strncmp(this->buffer + offset, prefix, length) == 0;
+}
+
+bool SIMKAFITextBuffer::endsWith(const char *suffix) const {
+    unsigned int length = strlen(suffix);
+    return this->len >= length && strcmp(this->buffer + this->len - length, suffix) == 0;
+}
+
+bool SIMKAFITextBuffer::endsWith(const __FlashStringHelper *suffix) const {
+    const char *p = reinterpret_cast<const char*>(suffix);
+    unsigned int length = flashLength(p);
+
+    return this->len >= length && this->find(p, length, true, this->len - length, false) != -1;
+}
+
+int SIMKAFITextBuffer::find(const char *str, unsigned int length, bool flash, unsigned int fromIndex, bool last) const {
+    if(length > this->len || fromIndex > this->len - length)
+        return -1;
+
+    int found = -1;
+    for(unsigned int at = fromIndex; at <= this->len - length; at++) {
+        unsigned int i = 0;
+        while(i < length && this->buffer[at + i] == (flash ? flashChar(str + i) : str[i]))
+            i++;
+
+        if(i == length) {
+            found = (int) at;
+            if(!last)
+                break;
+        }
+    }
+
+    return found;
+}
+
+int SIMKAFITextBuffer::indexOf(char ch, unsigned int fromIndex) const {
+    return this->find(&ch, 1, false, fromIndex, false);
+}
+
+int SIMKAFITextBuffer::indexOf(const char *str, unsigned int fromIndex) const {
+    return this->find(str, strlen(str), false, fromIndex, false);
+}
+
+int SIMKAFITextBuffer::indexOf(const __FlashStringHelper *str, unsigned int fromIndex) const {
+    const char *p = reinterpret_cast<const char*>(str);
+    return this->find(p, flashLength(p), true, fromIndex, false);
+}
+
+int SIMKAFITextBuffer::indexOf(const SIMKAFITextBuffer &str, unsigned int fromIndex) const {
+    return this->find(str.buffer, str.len, false, fromIndex, false);
+}
+
+int SIMKAFITextBuffer::lastIndexOf(char ch) const {
+    return this->find(&ch, 1, false, 0, true);
+}
+
+int SIMKAFITextBuffer::lastIndexOf(const char *str) const {
+    return this->find(str, strlen(str), false, 0, true);
+}
+
+int SIMKAFITextBuffer::lastIndexOf(const __FlashStringHelper *str) const {
+    const char *p = reinterpret_cast<const char*>(str);
+    return this->find(p, flashLength(p), true, 0, true);
+}
+
+void SIMKAFITextBuffer::remove(unsigned int index) {
+    if(index < this->len)
+        this->remove(index, this->len - index);
+}
+
+void SIMKAFITextBuffer::remove(unsigned int index, unsigned int count) {
+    if(index >= this->len)
+        return;
+    if(count > this->len - index)
+        count = this->len - index;
+
+    memmove(this->buffer + index, this->buffer + index + count, this->len - index - count + 1);
+    this->len -= count;
+}
+
+void SIMKAFITextBuffer::trim() {
+    unsigned int begin = 0, end = this->len;
+
+    while(begin < end && isspace((unsigned char) this->buffer[begin]))
+        begin++;
+    while(end > begin && isspace((unsigned char) this->buffer[end - 1]))
+        end--;
+
+    this->buffer[end] = '\0';
+    this->len = end;
+    this->remove(0, begin);
+}
+
+long SIMKAFITextBuffer::toInt() const {
+    return atol(this->buffer);
+}
+
+void SIMKAFITextBuffer::toCharArray(char *buf, unsigned int bufsize, unsigned int index) const {
+    if(bufsize == 0 || buf == nullptr)
+        return;
+    if(index >= this->len) {
+        buf[0] = '\0';
+        return;
+    }
+
+    unsigned int length = this->len - index;
+    if(length > bufsize - 1)
+        length = bufsize - 1;
+
+    memcpy(buf, this->buffer + index, length);
+    buf[length] = '\0';
+}
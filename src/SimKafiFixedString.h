@@ -0,0 +1,239 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ *
+ * @file SimKafiFixedString.h
+ * @brief A fixed-capacity replacement for the Arduino String, used by SIMKAFI_NO_HEAP builds.
+ *
+ */
+
+#ifndef SIMKAFI_FIXED_STRING_H
+#define SIMKAFI_FIXED_STRING_H
+
+#include <Arduino.h>
+
+/**
+ *
+ * @class SIMKAFITextBuffer
+ * @brief The storage-independent part of SIMKAFIFixedString.
+ *
+ * Implements the subset of the Arduino String interface the library uses on a buffer
+ * owned by the derived class, so the code is shared by every capacity. Text that does
+ * not fit is dropped and remembered in truncated().
+ *
+ */
+class SIMKAFITextBuffer {
+public:
+    /// The number of characters held.
+    unsigned int length() const { return this->len; }
+
+    /// The number of characters that fit.
+    unsigned int capacity() const { return this->cap; }
+
+    /// The text, always NUL-terminated.
+    const char *c_str() const { return this->buffer; }
+
+    /// True if text was dropped because it did not fit.
+    bool truncated() const { return this->overflow; }
+
+    /// The character at index, or 0 past the end.
+    char operator[](unsigned int index) const { return index < this->len ? this->buffer[index] : '\0'; }
+
+    bool concat(const char *cstr);
+    bool concat(const char *cstr, unsigned int length);
+    bool concat(const __FlashStringHelper *str);
+    bool concat(const SIMKAFITextBuffer &str);
+    bool concat(char c);
+    bool concat(unsigned char value);
+    bool concat(int value);
+    bool concat(unsigned int value);
+    bool concat(long value);
+    bool concat(unsigned long value);
+
+    template<class T>
+    SIMKAFITextBuffer &operator+=(const T &rhs) {
+        this->concat(rhs);
+        return *this;
+    }
+
+    bool equals(const char *cstr) const;
+    bool equals(const __FlashStringHelper *str) const;
+    bool equals(const SIMKAFITextBuffer &str) const { return this->equals(str.c_str()); }
+
+    bool operator==(const char *cstr) const { return this->equals(cstr); }
+    bool operator==(const __FlashStringHelper *str) const { return this->equals(str); }
+    bool operator==(const SIMKAFITextBuffer &str) const { return this->equals(str); }
+    bool operator!=(const char *cstr) const { return !this->equals(cstr); }
+    bool operator!=(const __FlashStringHelper *str) const { return !this->equals(str); }
+    bool operator!=(const SIMKAFITextBuffer &str) const { return !this->equals(str); }
+
+    bool startsWith(const char *prefix, unsigned int offset = 0) const;
+    bool endsWith(const char *suffix) const;
+    bool endsWith(const __FlashStringHelper *suffix) const;
+
+    int indexOf(char ch, unsigned int fromIndex = 0) const;
+    int indexOf(const char *str, unsigned int fromIndex = 0) const;
+    int indexOf(const __FlashStringHelper *str, unsigned int fromIndex = 0) const;
+    int indexOf(const SIMKAFITextBuffer &str, unsigned int fromIndex = 0) const;
+    int lastIndexOf(char ch) const;
+    int lastIndexOf(const char *str) const;
+    int lastIndexOf(const __FlashStringHelper *str) const;
+
+    void remove(unsigned int index);
+    void remove(unsigned int index, unsigned int count);
+    void trim();
+
+    long toInt() const;
+
+    /// Copy the text into buf, cut to bufsize - 1 characters and NUL-terminated.
+    void toCharArray(char *buf, unsigned int bufsize, unsigned int index = 0) const;
+
+protected:
+    SIMKAFITextBuffer(char *storage, unsigned int capacity) :
+        buffer(storage), cap((uint16_t) capacity), len(0), overflow(false) {}
+
+    /// The buffer belongs to the derived object, so a copy must bring its own.
+    SIMKAFITextBuffer(const SIMKAFITextBuffer&) = delete;
+    SIMKAFITextBuffer &operator=(const SIMKAFITextBuffer&) = delete;
+
+    /// Replace the text with length characters of cstr.
+    void assign(const char *cstr, unsigned int length);
+
+    /// Find length characters of str, in flash if flash is set, at or after fromIndex.
+    int find(const char *str, unsigned int length, bool flash, unsigned int fromIndex, bool last) const;
+
+    char *buffer;
+    uint16_t cap;
+    uint16_t len;
+    bool overflow;
+};
+
+/**
+ *
+ * @class SIMKAFIFixedString
+ * @brief A String-like text of at most Capacity characters stored inline, without the heap.
+ *
+ * Copies copy the characters. Concatenation with + keeps the capacity of the fixed-string
+ * operand, so start a chain with the widest string.
+ *
+ */
+template<size_t Capacity>
+class SIMKAFIFixedString : public SIMKAFITextBuffer {
+public:
+    SIMKAFIFixedString() : SIMKAFITextBuffer(this->storage, Capacity) {
+        this->storage[0] = '\0';
+    }
+
+    SIMKAFIFixedString(const char *cstr) : SIMKAFIFixedString() {
+        this->concat(cstr);
+    }
+
+    SIMKAFIFixedString(const __FlashStringHelper *str) : SIMKAFIFixedString() {
+        this->concat(str);
+    }
+
+    SIMKAFIFixedString(const SIMKAFIFixedString &str) : SIMKAFIFixedString() {
+        this->assign(str.c_str(), str.length());
+    }
+
+    SIMKAFIFixedString(const SIMKAFITextBuffer &str) : SIMKAFIFixedString() {
+        this->assign(str.c_str(), str.length());
+    }
+
+    explicit SIMKAFIFixedString(char c) : SIMKAFIFixedString() { this->concat(c); }
+    explicit SIMKAFIFixedString(unsigned char value) : SIMKAFIFixedString() { this->concat(value); }
+    explicit SIMKAFIFixedString(int value) : SIMKAFIFixedString() { this->concat(value); }
+    explicit SIMKAFIFixedString(unsigned int value) : SIMKAFIFixedString() { this->concat(value); }
+    explicit SIMKAFIFixedString(long value) : SIMKAFIFixedString() { this->concat(value); }
+    explicit SIMKAFIFixedString(unsigned long value) : SIMKAFIFixedString() { this->concat(value); }
+
+    SIMKAFIFixedString &operator=(const SIMKAFIFixedString &str) {
+        if(this != &str)
+            this->assign(str.c_str(), str.length());
+        return *this;
+    }
+
+    SIMKAFIFixedString &operator=(const SIMKAFITextBuffer &str) {
+        this->assign(str.c_str(), str.length());
+        return *this;
+    }
+
+    SIMKAFIFixedString &operator=(const char *cstr) {
+        this->assign("", 0);
+        this->concat(cstr);
+        return *this;
+    }
+
+    SIMKAFIFixedString &operator=(const __FlashStringHelper *str) {
+        this->assign("", 0);
+        this->concat(str);
+        return *this;
+    }
+
+    SIMKAFIFixedString substring(unsigned int beginIndex) const {
+        return this->substring(beginIndex, this->len);
+    }
+
+    SIMKAFIFixedString substring(unsigned int beginIndex, unsigned int endIndex) const {
+        SIMKAFIFixedString result;
+
+        if(beginIndex > endIndex) {
+            unsigned int swap = beginIndex;
+            beginIndex = endIndex;
+            endIndex = swap;
+        }
+
+        if(endIndex > this->len)
+            endIndex = this->len;
+        if(beginIndex < endIndex)
+            result.assign(this->buffer + beginIndex, endIndex - beginIndex);
+
+        return result;
+    }
+
+private:
+    char storage[Capacity + 1];
+};
+
+template<size_t Capacity, class T>
+SIMKAFIFixedString<Capacity> operator+(SIMKAFIFixedString<Capacity> lhs, const T &rhs) {
+    lhs.concat(rhs);
+    return lhs;
+}
+
+template<size_t Capacity>
+SIMKAFIFixedString<Capacity> operator+(const char *lhs, const SIMKAFIFixedString<Capacity> &rhs) {
+    SIMKAFIFixedString<Capacity> result(lhs);
+    result.concat(rhs);
+    return result;
+}
+
+template<size_t Capacity>
+SIMKAFIFixedString<Capacity> operator+(const __FlashStringHelper *lhs, const SIMKAFIFixedString<Capacity> &rhs) {
+    SIMKAFIFixedString<Capacity> result(lhs);
+    result.concat(rhs);
+    return result;
+}
+
+#endif
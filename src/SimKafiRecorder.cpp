@@ -0,0 +1,289 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "SimKafiRecorder.h"
+
+/// Bytes printed per line of a dump before a new line is started.
+#define SIMKAFI_DUMP_LINE_BYTES 32
+
+SIMKAFIRecorder::SIMKAFIRecorder(Stream &inner, SIMKAFIWireRecord *buffer, size_t capacity) :
+    inner(inner), records(buffer), capacity(capacity), head(0), count(0),
+    droppedCount(0), startMs(millis()), recording(true) {}
+
+void SIMKAFIRecorder::setRecording(bool enabled) {
+    this->recording = enabled;
+}
+
+void SIMKAFIRecorder::clear() {
+    this->head = this->count = 0;
+    this->droppedCount = 0;
+    this->startMs = millis();
+}
+
+size_t SIMKAFIRecorder::size() const {
+    return this->count;
+}
+
+uint32_t SIMKAFIRecorder::dropped() const {
+    return this->droppedCount;
+}
+
+SIMKAFIWireRecord SIMKAFIRecorder::at(size_t index) const {
+    return this->records[(this->head + index) % this->capacity];
+}
+
+void SIMKAFIRecorder::record(uint8_t direction, uint8_t value) {
+    if(!this->recording || this->capacity == 0)
+        return;
+
+    SIMKAFIWireRecord entry;
+    entry.ms = (uint32_t) (millis() - this->startMs);
+    entry.direction = direction;
+    entry.value = value;
+
+    if(this->count < this->capacity)
+        this->records[(this->head + this->count++) % this->capacity] = entry;
+    else {
+        this->records[this->head] = entry;
+        this->head = (this->head + 1) % this->capacity;
+        this->droppedCount++;
+    }
+}
+
+void SIMKAFIRecorder::dump(Print &out) const {
+    static const char digits[] = "0123456789abcdef";
+    size_t inLine = 0;
+    SIMKAFIWireRecord previous = { 0, 0, 0 };
+
+    out.println(F("# simkafi-wire 1"));
+    for(size_t i = 0; i < this->count; i++) {
+        SIMKAFIWireRecord entry = this->at(i);
+
+        if(inLine == 0 || entry.ms != previous.ms || entry.direction != previous.direction ||
+            inLine == SIMKAFI_DUMP_LINE_BYTES) {
+            if(inLine != 0)
+                out.println();
+
+            out.print((unsigned long) entry.ms);
+            out.print(entry.direction == SIMKAFI_WIRE_TX ? F(" > ") : F(" < "));
+            inLine = 0;
+        }
+
+        out.write((uint8_t) digits[entry.value >> 4]);
+        out.write((uint8_t) digits[entry.value & 0x0f]);
+
+        previous = entry;
+        inLine++;
+    }
+
+    if(inLine != 0)
+        out.println();
+}
+
+static int hexValue(char c) {
+    if(c >= '0' && c <= '9')
+        return c - '0';
+    if(c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+size_t SIMKAFIRecorder::parse(const char *text, SIMKAFIWireRecord *records, size_t capacity) {
+    size_t stored = 0;
+
+    while(*text != '\0' && stored < capacity) {
+        while(*text == ' ' || *text == '\t' || *text == '\r' || *text == '\n')
+            text++;
+
+        if(*text == '#' || *text < '0' || *text > '9') {
+            while(*text != '\0' && *text != '\n')
+                text++;
+            continue;
+        }
+
+        char *end;
+        uint32_t ms = (uint32_t) strtoul(text, &end, 10);
+        text = end;
+
+        while(*text == ' ')
+            text++;
+
+        uint8_t direction = *text == '>' ? SIMKAFI_WIRE_TX : SIMKAFI_WIRE_RX;
+        if(*text == '>' || *text == '<')
+            text++;
+
+        while(*text == ' ')
+            text++;
+
+        while(hexValue(text[0]) >= 0 && hexValue(text[1]) >= 0 && stored < capacity) {
+            records[stored].ms = ms;
+            records[stored].direction = direction;
+            records[stored].value = (uint8_t) (hexValue(text[0]) << 4 | hexValue(text[1]));
+
+            stored++;
+            text += 2;
+        }
+    }
+
+    return stored;
+}
+
+int SIMKAFIRecorder::available() {
+    return this->inner.available();
+}
+
+int SIMKAFIRecorder::read() {
+    int c = this->inner.read();
+    if(c >= 0)
+        this->record(SIMKAFI_WIRE_RX, (uint8_t) c);
+
+    return c;
+}
+
+int SIMKAFIRecorder::peek() {
+    return this->inner.peek();
+}
+
+size_t SIMKAFIRecorder::write(uint8_t value) {
+    this->record(SIMKAFI_WIRE_TX, value);
+    return this->inner.write(value);
+}
+
+size_t SIMKAFIRecorder::write(const uint8_t *buffer, size_t size) {
+    for(size_t i = 0; i < size; i++)
+        this->record(SIMKAFI_WIRE_TX, buffer[i]);
+
+    return this->inner.write(buffer, size);
+}
+
+void SIMKAFIRecorder::flush() {
+    this->inner.flush();
+}
+
+SIMKAFIReplay::SIMKAFIReplay(const SIMKAFIWireRecord *records, size_t count, uint16_t timeScalePercent) :
+    records(records), count(count), timeScale(timeScalePercent) {
+    this->rewind();
+}
+
+void SIMKAFIReplay::rewind() {
+    this->rxCursor = this->txCursor = 0;
+    this->skipToNext(this->rxCursor, SIMKAFI_WIRE_RX);
+    this->skipToNext(this->txCursor, SIMKAFI_WIRE_TX);
+
+    this->anchorMs = millis();
+    this->anchorRecordMs = 0;
+    this->mismatchCount = this->extraCount = 0;
+}
+
+void SIMKAFIReplay::skipToNext(size_t &cursor, uint8_t direction) {
+    while(cursor < this->count && this->records[cursor].direction != direction)
+        cursor++;
+}
+
+bool SIMKAFIReplay::isReady(size_t index) const {
+    // Every byte sent before this one in the recording must have been sent again.
+    if(index >= this->count || this->txCursor < index)
+        return false;
+
+    int32_t recorded = (int32_t) (this->records[index].ms - this->anchorRecordMs);
+    if(recorded <= 0 || this->timeScale == 0)
+        return true;
+
+    uint32_t due = (uint32_t) recorded * this->timeScale / 100;
+    return millis() - this->anchorMs >= due;
+}
+
+bool SIMKAFIReplay::finished() const {
+    return this->rxCursor >= this->count && this->txCursor >= this->count;
+}
+
+uint32_t SIMKAFIReplay::mismatches() const {
+    return this->mismatchCount;
+}
+
+uint32_t SIMKAFIReplay::extraWrites() const {
+    return this->extraCount;
+}
+
+int SIMKAFIReplay::available() {
+    int ready = 0;
+
+    for(size_t i = this->rxCursor; i < this->count && ready < 256; i++) {
+        if(this->records[i].direction == SIMKAFI_WIRE_TX) {
+            if(i >= this->txCursor)
+                break;
+            continue;
+        }
+
+        if(!this->isReady(i))
+            break;
+        ready++;
+    }
+
+    return ready;
+}
+
+int SIMKAFIReplay::read() {
+    if(!this->isReady(this->rxCursor))
+        return -1;
+
+    uint8_t value = this->records[this->rxCursor++].value;
+    this->skipToNext(this->rxCursor, SIMKAFI_WIRE_RX);
+
+    return value;
+}
+
+int SIMKAFIReplay::peek() {
+    if(!this->isReady(this->rxCursor))
+        return -1;
+
+    return this->records[this->rxCursor].value;
+}
+
+size_t SIMKAFIReplay::write(uint8_t value) {
+    if(this->txCursor >= this->count) {
+        this->extraCount++;
+        return 1;
+    }
+
+    const SIMKAFIWireRecord &expected = this->records[this->txCursor];
+    if(expected.value != value)
+        this->mismatchCount++;
+
+    this->anchorMs = millis();
+    this->anchorRecordMs = expected.ms;
+
+    this->txCursor++;
+    this->skipToNext(this->txCursor, SIMKAFI_WIRE_TX);
+
+    return 1;
+}
+
+size_t SIMKAFIReplay::write(const uint8_t *buffer, size_t size) {
+    for(size_t i = 0; i < size; i++)
+        this->write(buffer[i]);
+
+    return size;
+}
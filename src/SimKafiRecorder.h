@@ -0,0 +1,259 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * 
+ * @file SimKafiRecorder.h
+ * @brief Stream wrappers that record the serial traffic to a SIMKAFI module and replay it later.
+ * 
+ */
+
+#ifndef SIMKAFI_RECORDER_H
+#define SIMKAFI_RECORDER_H
+
+#include <Arduino.h>
+
+/**
+ * 
+ * @enum SIMKAFIWireDirection
+ * @brief The direction of a recorded byte.
+ * 
+ */
+typedef enum _SIMKAFIWireDirection {
+    /// A byte written to the module.
+    SIMKAFI_WIRE_TX,
+
+    /// A byte read from the module.
+    SIMKAFI_WIRE_RX
+} SIMKAFIWireDirection;
+
+/**
+ * 
+ * @struct SIMKAFIWireRecord
+ * @brief A single byte of serial traffic with the time it crossed the wire.
+ * 
+ */
+typedef struct _SIMKAFIWireRecord {
+    /// Milliseconds since the recording started.
+    uint32_t ms;
+
+    /// Whether the byte was sent or received, as a SIMKAFIWireDirection.
+    uint8_t direction;
+
+    /// The byte itself.
+    uint8_t value;
+} SIMKAFIWireRecord;
+
+/**
+ * 
+ * @class SIMKAFIRecorder
+ * @brief A Stream that forwards to another Stream and logs every byte in both directions.
+ *
+ * Records go into a caller-provided ring buffer; once it is full the oldest records are
+ * overwritten and counted by dropped(). dump() prints the log in a line-oriented text form
+ * (one line per burst of same-direction bytes with the same timestamp) that parse() reads back:
+ *
+ *     # simkafi-wire 1
+ *     120 > 41540d0a
+ *     131 < 41540d0a0d0a4f4b0d0a
+ * 
+ */
+class SIMKAFIRecorder : public Stream {
+private:
+    /// The Stream connected to the module.
+    Stream &inner;
+
+    /// Ring buffer storage and its state.
+    SIMKAFIWireRecord *records;
+    size_t capacity, head, count;
+
+    /// Records overwritten because the buffer was full.
+    uint32_t droppedCount;
+
+    /// millis() when recording started.
+    unsigned long startMs;
+
+    /// Whether new traffic is being logged.
+    bool recording;
+
+    void record(uint8_t direction, uint8_t value);
+
+public:
+    /**
+     * 
+     * @brief Wrap a Stream and start recording into a ring buffer.
+     *
+     * @param inner The Stream connected to the module.
+     * @param buffer Storage for the records.
+     * @param capacity The number of records the buffer holds.
+     * 
+     */
+    SIMKAFIRecorder(Stream &inner, SIMKAFIWireRecord *buffer, size_t capacity);
+
+    /**
+     * 
+     * @brief Pause or resume logging; traffic is forwarded either way.
+     * 
+     */
+    void setRecording(bool enabled);
+
+    /**
+     * 
+     * @brief Discard all records and restart the clock.
+     * 
+     */
+    void clear();
+
+    /**
+     * 
+     * @brief Get the number of records currently held.
+     * 
+     */
+    size_t size() const;
+
+    /**
+     * 
+     * @brief Get the number of records lost to buffer overflow since the last clear().
+     * 
+     */
+    uint32_t dropped() const;
+
+    /**
+     * 
+     * @brief Get a record by age, 0 being the oldest one held.
+     *
+     * @param index The record index, below size().
+     * @return The record.
+     * 
+     */
+    SIMKAFIWireRecord at(size_t index) const;
+
+    /**
+     * 
+     * @brief Print the log in the text form described above, e.g. to Serial.
+     * 
+     */
+    void dump(Print &out) const;
+
+    /**
+     * 
+     * @brief Parse a log printed by dump() back into records.
+     *
+     * @param text The NUL-terminated log text.
+     * @param records Where to store the records.
+     * @param capacity The number of records that fit.
+     * @return The number of records stored.
+     * 
+     */
+    static size_t parse(const char *text, SIMKAFIWireRecord *records, size_t capacity);
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t value) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    void flush() override;
+    using Print::write;
+};
+
+/**
+ * 
+ * @class SIMKAFIReplay
+ * @brief A Stream that plays a recorded session back in place of the module.
+ *
+ * Received bytes are released in their recorded order, and never before every byte the
+ * library sent ahead of them in the recording has been written again, so a session replays
+ * deterministically. Their timing follows the recording relative to the last matched write,
+ * scaled by a percentage: 100 keeps the original timing, 0 releases bytes as soon as allowed.
+ * Written bytes are compared with the recording; differences are counted by mismatches().
+ * Compressing the timing below the library's own read timeouts can merge bursts that were
+ * read separately in the recording.
+ * 
+ */
+class SIMKAFIReplay : public Stream {
+private:
+    const SIMKAFIWireRecord *records;
+    size_t count;
+
+    /// Next received-byte record to hand out, and next sent-byte record to match.
+    size_t rxCursor, txCursor;
+
+    /// Local time and recorded time of the last matched write.
+    unsigned long anchorMs;
+    uint32_t anchorRecordMs;
+
+    uint16_t timeScale;
+    uint32_t mismatchCount, extraCount;
+
+    void skipToNext(size_t &cursor, uint8_t direction);
+    bool isReady(size_t index) const;
+
+public:
+    /**
+     * 
+     * @brief Prepare a replay of a recorded session.
+     *
+     * @param records The recorded session; must outlive the replay.
+     * @param count The number of records.
+     * @param timeScalePercent Timing scale in percent (100 = original, 0 = as fast as possible).
+     * 
+     */
+    SIMKAFIReplay(const SIMKAFIWireRecord *records, size_t count, uint16_t timeScalePercent = 100);
+
+    /**
+     * 
+     * @brief Restart the replay from the first record.
+     * 
+     */
+    void rewind();
+
+    /**
+     * 
+     * @brief Check whether every recorded byte has been read and written.
+     * 
+     */
+    bool finished() const;
+
+    /**
+     * 
+     * @brief Get the number of written bytes that differed from the recording.
+     * 
+     */
+    uint32_t mismatches() const;
+
+    /**
+     * 
+     * @brief Get the number of bytes written after the recording ran out of sent bytes.
+     * 
+     */
+    uint32_t extraWrites() const;
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t value) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+};
+
+#endif
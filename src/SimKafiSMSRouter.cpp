@@ -0,0 +1,204 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "SimKafiSMSRouter.h"
+
+#if SIMKAFI_ENABLE_SMS
+
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static char upper(char c) {
+    return c >= 'a' && c <= 'z' ? (char) (c - 'a' + 'A') : c;
+}
+
+// The digits of a phone number in international form, without the "+". A national number that starts
+// with the trunk prefix has it replaced by the country code, if one is given. 0 if it does not fit.
+static uint8_t internationalDigits(const char *number, size_t length, const char *country, const char *trunk,
+    char *digits, uint8_t capacity) {
+    size_t at = 0;
+    while(at < length && isBlank(number[at]))
+        at++;
+
+    bool international = at < length && number[at] == '+';
+    uint8_t count = 0;
+
+    for(; at < length; at++) {
+        if(number[at] < '0' || number[at] > '9')
+            continue;
+        if(count == capacity)
+            return 0;
+        digits[count++] = number[at];
+    }
+
+    size_t trunkLength = trunk != nullptr ? strlen(trunk) : 0;
+    if(international || country == nullptr || trunkLength == 0 || count < trunkLength ||
+        memcmp(digits, trunk, trunkLength) != 0)
+        return count;
+
+    size_t countryLength = strlen(country);
+    if(count - trunkLength + countryLength > capacity)
+        return 0;
+
+    memmove(digits + countryLength, digits + trunkLength, count - trunkLength);
+    memcpy(digits, country, countryLength);
+    return (uint8_t) (count - trunkLength + countryLength);
+}
+
+SIMKAFISMSRouter::SIMKAFISMSRouter(const SIMKAFISMSRoute *routes, uint8_t count, void *context) :
+    routes(routes), routeCount(0), context(context), senders(nullptr), senderCount(0),
+    country(nullptr), trunk("0"), fallback(nullptr), rejectedCount(0), unknownCount(0) {
+    memset(this->slots, 0, sizeof(this->slots));
+
+    // One slot always stays free, so a lookup of an unknown keyword ends.
+    for(uint8_t i = 0; i < count && this->routeCount + 1 < SIMKAFI_SMS_ROUTER_SLOTS; i++) {
+        uint16_t slot = routes[i].hash % SIMKAFI_SMS_ROUTER_SLOTS;
+
+        while(this->slots[slot] != 0)
+            slot = (slot + 1) % SIMKAFI_SMS_ROUTER_SLOTS;
+
+        this->slots[slot] = i + 1;
+        this->routeCount++;
+    }
+}
+
+void SIMKAFISMSRouter::setAllowedSenders(const char *const *numbers, uint8_t count) {
+    this->senders = numbers;
+    this->senderCount = count;
+}
+
+void SIMKAFISMSRouter::setHomeCountry(const char *countryCode, const char *trunkPrefix) {
+    this->country = countryCode;
+    this->trunk = trunkPrefix;
+}
+
+void SIMKAFISMSRouter::setFallback(SIMKAFISMSHandler handler) {
+    this->fallback = handler;
+}
+
+bool SIMKAFISMSRouter::isAllowed(SIMKAFIStringView sender) const {
+    if(this->senderCount == 0)
+        return true;
+
+    char received[SIMKAFI_SMS_SENDER_DIGITS], allowed[SIMKAFI_SMS_SENDER_DIGITS];
+    uint8_t count = internationalDigits(sender.data, sender.length, this->country, this->trunk,
+        received, SIMKAFI_SMS_SENDER_DIGITS);
+    if(count == 0)
+        return false;
+
+    // The whole number has to match, country code included.
+    for(uint8_t i = 0; i < this->senderCount; i++) {
+        const char *number = this->senders[i];
+
+        if(internationalDigits(number, strlen(number), this->country, this->trunk,
+            allowed, SIMKAFI_SMS_SENDER_DIGITS) == count && memcmp(received, allowed, count) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+const SIMKAFISMSRoute *SIMKAFISMSRouter::find(const char *keyword, size_t length) const {
+    uint32_t hash = simkafiKeywordHash(keyword, length);
+
+    for(uint16_t slot = hash % SIMKAFI_SMS_ROUTER_SLOTS; this->slots[slot] != 0;
+        slot = (slot + 1) % SIMKAFI_SMS_ROUTER_SLOTS) {
+        const SIMKAFISMSRoute &route = this->routes[this->slots[slot] - 1];
+        if(route.hash != hash || strlen(route.keyword) != length)
+            continue;
+
+        size_t i = 0;
+        while(i < length && upper(keyword[i]) == upper(route.keyword[i]))
+            i++;
+
+        if(i == length)
+            return &route;
+    }
+
+    return nullptr;
+}
+
+SIMKAFISMSRouteResult SIMKAFISMSRouter::dispatch(SIMKAFIStringView sender, SIMKAFIStringView message) {
+    if(!this->isAllowed(sender)) {
+        this->rejectedCount++;
+        return SIMKAFI_ROUTE_REJECTED;
+    }
+
+    SIMKAFISMSCommand command;
+    const char *at = message.data, *end = message.data + message.length;
+
+    while(end > at && isBlank(end[-1]))
+        end--;
+    while(at < end && isBlank(*at))
+        at++;
+
+    command.sender = sender;
+    command.keyword.data = at;
+    while(at < end && !isBlank(*at))
+        at++;
+    command.keyword.length = at - command.keyword.data;
+
+    while(at < end && isBlank(*at))
+        at++;
+    command.rest.data = at;
+    command.rest.length = end - at;
+
+    command.argCount = 0;
+    while(at < end && command.argCount < SIMKAFI_SMS_ROUTER_ARGS) {
+        SIMKAFIStringView &arg = command.args[command.argCount++];
+
+        arg.data = at;
+        while(at < end && !isBlank(*at))
+            at++;
+        arg.length = at - arg.data;
+
+        while(at < end && isBlank(*at))
+            at++;
+    }
+
+    const SIMKAFISMSRoute *route = this->find(command.keyword.data, command.keyword.length);
+    if(route != nullptr) {
+        route->handler(this->context, command);
+        return SIMKAFI_ROUTE_HANDLED;
+    }
+
+    this->unknownCount++;
+    if(this->fallback != nullptr)
+        this->fallback(this->context, command);
+    return SIMKAFI_ROUTE_UNKNOWN;
+}
+
+void SIMKAFISMSRouter::receive(void *router, SIMKAFIStringView sender, SIMKAFIStringView message) {
+    static_cast<SIMKAFISMSRouter*>(router)->dispatch(sender, message);
+}
+
+uint16_t SIMKAFISMSRouter::rejected() const {
+    return this->rejectedCount;
+}
+
+uint16_t SIMKAFISMSRouter::unknown() const {
+    return this->unknownCount;
+}
+
+#endif
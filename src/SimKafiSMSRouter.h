@@ -0,0 +1,264 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * 
+ * @file SimKafiSMSRouter.h
+ * @brief Dispatches commands received by SMS ("STATUS", "RELAY1 ON") to handlers by their first word.
+ * 
+ */
+
+#ifndef SIMKAFI_SMS_ROUTER_H
+#define SIMKAFI_SMS_ROUTER_H
+
+#include "SimKafi_defs.h"
+
+#if SIMKAFI_ENABLE_SMS
+
+/**
+ * 
+ * @brief Hash a keyword the way SIMKAFISMSRouter looks it up: FNV-1a over its upper-cased characters.
+ *
+ * A constant expression for a literal, so SIMKAFI_SMS_ROUTE hashes the keywords at compile time.
+ * 
+ */
+constexpr uint32_t simkafiKeywordHash(const char *keyword, size_t length, uint32_t hash = 2166136261UL) {
+    return length == 0 ? hash : simkafiKeywordHash(keyword + 1, length - 1,
+        (hash ^ (uint8_t) (*keyword >= 'a' && *keyword <= 'z' ? *keyword - 'a' + 'A' : *keyword)) * 16777619UL);
+}
+
+/**
+ * 
+ * @struct SIMKAFISMSCommand
+ * @brief A command received by SMS, as handed to its handler.
+ *
+ * All views point into the message the library delivered and are only valid during the call.
+ * 
+ */
+typedef struct _SIMKAFISMSCommand {
+    /// The sender's phone number.
+    SIMKAFIStringView sender;
+
+    /// The keyword as it was typed.
+    SIMKAFIStringView keyword;
+
+    /// Everything after the keyword, without the surrounding blanks, e.g. for free text.
+    SIMKAFIStringView rest;
+
+    /// The blank-separated words after the keyword; words past SIMKAFI_SMS_ROUTER_ARGS stay in rest only.
+    SIMKAFIStringView args[SIMKAFI_SMS_ROUTER_ARGS];
+
+    /// The number of entries in args.
+    uint8_t argCount;
+} SIMKAFISMSCommand;
+
+/**
+ * 
+ * @brief Handler of one SMS command.
+ *
+ * @param context The context pointer given to the router.
+ * @param command The command and its arguments.
+ * 
+ */
+typedef void (*SIMKAFISMSHandler)(void *context, const SIMKAFISMSCommand &command);
+
+/**
+ * 
+ * @struct SIMKAFISMSRoute
+ * @brief A keyword and the handler it runs; declare them with SIMKAFI_SMS_ROUTE.
+ * 
+ */
+typedef struct _SIMKAFISMSRoute {
+    /// The keyword, matched against the first word of a message regardless of case.
+    const char *keyword;
+
+    /// simkafiKeywordHash() of the keyword.
+    uint32_t hash;
+
+    /// The function to run.
+    SIMKAFISMSHandler handler;
+} SIMKAFISMSRoute;
+
+/// A SIMKAFISMSRoute for a string literal keyword, hashed at compile time.
+#define SIMKAFI_SMS_ROUTE(keyword, handler) \
+    { keyword, simkafiKeywordHash(keyword, sizeof(keyword) - 1), handler }
+
+/**
+ * 
+ * @enum SIMKAFISMSRouteResult
+ * @brief What SIMKAFISMSRouter::dispatch() did with a message.
+ * 
+ */
+typedef enum _SIMKAFISMSRouteResult {
+    /// A handler ran.
+    SIMKAFI_ROUTE_HANDLED,
+
+    /// The sender is not on the allowed list; nothing ran.
+    SIMKAFI_ROUTE_REJECTED,
+
+    /// No route has the message's first word; the fallback handler ran if there is one.
+    SIMKAFI_ROUTE_UNKNOWN
+} SIMKAFISMSRouteResult;
+
+/**
+ * 
+ * @class SIMKAFISMSRouter
+ * @brief Matches received SMS against a table of keywords and runs the handler of the one found.
+ *
+ * The table is declared once, with the keyword hashes computed by the compiler, and indexed into
+ * a fixed hash table of SIMKAFI_SMS_ROUTER_SLOTS entries by the constructor. A message then costs
+ * one pass over its text and, on average, one comparison, however many commands there are; nothing
+ * is allocated. The sender is checked against the allowed numbers before anything else:
+ *
+ *     static const SIMKAFISMSRoute routes[] = {
+ *         SIMKAFI_SMS_ROUTE("STATUS", onStatus),
+ *         SIMKAFI_SMS_ROUTE("RELAY1", onRelay),
+ *         SIMKAFI_SMS_ROUTE("APN", onAPN)
+ *     };
+ *     static const char *const owners[] = { "+989121234567" };
+ *
+ *     SIMKAFISMSRouter router(routes, 3, &board);
+ *     router.setAllowedSenders(owners, 1);
+ *     router.setHomeCountry("98");
+ *     simKafi.setSMSReceivedCallback(&SIMKAFISMSRouter::receive, &router);
+ *
+ * "relay1 on" then runs onRelay with args[0] = "on".
+ * 
+ */
+class SIMKAFISMSRouter {
+private:
+    /// The routes, their number, and the context handed to their handlers.
+    const SIMKAFISMSRoute *routes;
+    uint8_t routeCount;
+    void *context;
+
+    /// Open-addressed index over routes: 1 + route index, or 0 for a free slot.
+    uint8_t slots[SIMKAFI_SMS_ROUTER_SLOTS];
+
+    /// The numbers allowed to send commands; with none, every sender is.
+    const char *const *senders;
+    uint8_t senderCount;
+
+    /// Country code and trunk prefix that turn a national number into its international form.
+    const char *country, *trunk;
+
+    /// Run for messages from allowed senders that match no route.
+    SIMKAFISMSHandler fallback;
+
+    /// Messages turned away by the sender check, and messages that matched no route.
+    uint16_t rejectedCount, unknownCount;
+
+    bool isAllowed(SIMKAFIStringView sender) const;
+    const SIMKAFISMSRoute *find(const char *keyword, size_t length) const;
+
+public:
+    /**
+     * 
+     * @brief Index a table of routes.
+     *
+     * The table is not copied and must outlive the router. At most SIMKAFI_SMS_ROUTER_SLOTS - 1
+     * routes are indexed; keep the table well below that so lookups stay one probe long.
+     *
+     * @param routes The routes, declared with SIMKAFI_SMS_ROUTE.
+     * @param count The number of routes.
+     * @param context An arbitrary pointer handed to every handler unchanged.
+     * 
+     */
+    SIMKAFISMSRouter(const SIMKAFISMSRoute *routes, uint8_t count, void *context = nullptr);
+
+    /**
+     * 
+     * @brief Only accept commands from these phone numbers.
+     *
+     * Numbers are compared on their digits in full international form, so "+989121234567" matches
+     * "+98 912 123 4567" but not "+19121234567". A national "09121234567" only matches once
+     * setHomeCountry() says how to complete it. The list is not copied. With a count of 0, every
+     * sender is accepted.
+     *
+     * @param numbers The allowed numbers.
+     * @param count The number of entries in numbers.
+     * 
+     */
+    void setAllowedSenders(const char *const *numbers, uint8_t count);
+
+    /**
+     * 
+     * @brief Read national numbers, of senders and allowed numbers alike, as numbers of this country.
+     *
+     * A number without a "+" that starts with the trunk prefix gets the country code in its place,
+     * so with setHomeCountry("98") "09121234567" is compared as "+989121234567".
+     *
+     * @param countryCode The country calling code without "+", e.g. "98", or nullptr to leave
+     *     national numbers as they are.
+     * @param trunkPrefix The national trunk prefix, e.g. "0".
+     * 
+     */
+    void setHomeCountry(const char *countryCode, const char *trunkPrefix = "0");
+
+    /**
+     * 
+     * @brief Set the handler for messages from allowed senders that match no route, e.g. to answer with help.
+     *
+     * @param handler The function to run, or nullptr to ignore such messages.
+     * 
+     */
+    void setFallback(SIMKAFISMSHandler handler);
+
+    /**
+     * 
+     * @brief Check the sender, split the message into keyword and arguments and run the matching handler.
+     *
+     * @param sender The sender's phone number.
+     * @param message The message body.
+     * @return What was done with the message.
+     * 
+     */
+    SIMKAFISMSRouteResult dispatch(SIMKAFIStringView sender, SIMKAFIStringView message);
+
+    /**
+     * 
+     * @brief SIMKAFISMSCallback that dispatches to the router given as its context.
+     *
+     * Usage: `simKafi.setSMSReceivedCallback(&SIMKAFISMSRouter::receive, &router);`
+     * 
+     */
+    static void receive(void *router, SIMKAFIStringView sender, SIMKAFIStringView message);
+
+    /**
+     * 
+     * @brief Get the number of messages turned away because of their sender.
+     * 
+     */
+    uint16_t rejected() const;
+
+    /**
+     * 
+     * @brief Get the number of messages from allowed senders that matched no route.
+     * 
+     */
+    uint16_t unknown() const;
+};
+
+#endif
+
+#endif
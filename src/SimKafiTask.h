@@ -0,0 +1,221 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ *
+ * @file SimKafiTask.h
+ * @brief Stackless resumable flows, and a C++20 coroutine wrapper where the compiler has one.
+ *
+ * A flow is a function returning SIMKAFITaskState that takes a SIMKAFITask. Between
+ * SIMKAFI_TASK_BEGIN and SIMKAFI_TASK_END it reads like straight-line code, but every wait
+ * returns SIMKAFI_TASK_RUNNING to the caller and the next call picks up at the same wait, so
+ * several flows interleave on one core from loop():
+ *
+ *     SIMKAFITaskState monitor(SIMKAFITask &task) {
+ *         SIMKAFI_TASK_BEGIN(task);
+ *         for(;;) {
+ *             task.since = millis();
+ *             SIMKAFI_TASK_WAIT_UNTIL(task, millis() - task.since >= 10000);
+ *             SIMKAFI_TASK_WAIT_UNTIL(task, simKafi.lockLink(&task));
+ *             simKafi.startCommand("AT+CSQ");
+ *             SIMKAFI_TASK_WAIT_UNTIL(task, simKafi.pollResponse() != SIMKAFI_POLL_WAITING);
+ *             simKafi.unlockLink(&task);
+ *         }
+ *         SIMKAFI_TASK_END(task);
+ *     }
+ *
+ * Local variables do not survive a wait; keep what a flow needs across waits in the task or
+ * in the object the flow belongs to. Only one wait may stand on a source line.
+ *
+ * Flows waiting for the link get it by SIMKAFITask::priority and deadline, and bulk flows hand
+ * it over at their safe boundaries (SIMKAFI::linkContended(), SIMKAFI::yieldLink()), so an
+ * urgent flow waits for one command of a long scan rather than for all of it.
+ *
+ */
+
+#ifndef SIMKAFI_TASK_H
+#define SIMKAFI_TASK_H
+
+#include "SimKafi_defs.h"
+
+#if SIMKAFI_ENABLE_TASKS
+
+// Waits fall through into their own case label on purpose.
+#if defined(__has_cpp_attribute)
+#if __has_cpp_attribute(fallthrough)
+#define SIMKAFI_TASK_FALLTHROUGH [[fallthrough]]
+#endif
+#endif
+#ifndef SIMKAFI_TASK_FALLTHROUGH
+#define SIMKAFI_TASK_FALLTHROUGH
+#endif
+
+/// Open the body of a flow; the next call resumes at the wait the last one stopped at.
+#define SIMKAFI_TASK_BEGIN(task) switch((task).resume) { case 0:
+
+/// Return SIMKAFI_TASK_RUNNING until condition holds, checking it again on every call.
+#define SIMKAFI_TASK_WAIT_UNTIL(task, condition) \
+    do { \
+        (task).resume = __LINE__; SIMKAFI_TASK_FALLTHROUGH; \
+        case __LINE__: if(!(condition)) return SIMKAFI_TASK_RUNNING; \
+    } while(0)
+
+/// Run another flow to its end, storing its final SIMKAFITaskState in state.
+#define SIMKAFI_TASK_AWAIT(task, state, flow) \
+    SIMKAFI_TASK_WAIT_UNTIL(task, ((state) = (flow)) != SIMKAFI_TASK_RUNNING)
+
+/// Return SIMKAFI_TASK_RUNNING once and resume right here on the next call.
+#define SIMKAFI_TASK_YIELD(task) \
+    do { (task).resume = __LINE__; return SIMKAFI_TASK_RUNNING; case __LINE__:; } while(0)
+
+/// Leave the flow with a final state, ready to start over.
+#define SIMKAFI_TASK_EXIT(task, state) do { (task).resume = 0; return (state); } while(0)
+
+/// Close the body of a flow; reaching it finishes the flow with SIMKAFI_TASK_DONE.
+#define SIMKAFI_TASK_END(task) } (task).resume = 0; return SIMKAFI_TASK_DONE
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define SIMKAFI_COROUTINES 1
+
+/**
+ *
+ * @class SIMKAFICoroutine
+ * @brief A C++20 coroutine driven from a poll loop, for compilers that have coroutines.
+ *
+ * A function returning SIMKAFICoroutine may `co_await SIMKAFIAwait(...)` any callable that
+ * returns SIMKAFITaskState, typically a lambda calling one of the library's flows. The coroutine
+ * does nothing until poll() is called and never runs past an unfinished flow, so poll() returns
+ * quickly and several coroutines interleave on one core:
+ *
+ *     SIMKAFICoroutine notify(SIMKAFI &simKafi) {
+ *         SIMKAFITask task = {};
+ *         co_await SIMKAFIAwait([&] { return simKafi.sendSMS(task, "+15551234567", "Door open"); });
+ *     }
+ *
+ * The coroutine frame comes from operator new, so on AVR use the SIMKAFI_TASK_ macros instead.
+ *
+ */
+class SIMKAFICoroutine {
+public:
+    struct promise_type {
+        /// The flow the coroutine is suspended on, and the function that runs it one step.
+        void *awaiter = nullptr;
+        bool (*ready)(void *awaiter) = nullptr;
+
+        SIMKAFICoroutine get_return_object() {
+            return SIMKAFICoroutine(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() {}
+    };
+
+    explicit SIMKAFICoroutine(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    SIMKAFICoroutine(SIMKAFICoroutine &&other) noexcept : handle(other.handle) {
+        other.handle = nullptr;
+    }
+
+    SIMKAFICoroutine(const SIMKAFICoroutine&) = delete;
+    SIMKAFICoroutine &operator=(const SIMKAFICoroutine&) = delete;
+
+    ~SIMKAFICoroutine() {
+        if(this->handle)
+            this->handle.destroy();
+    }
+
+    /**
+     *
+     * @brief Run the coroutine up to its next unfinished flow.
+     *
+     * @return True while the coroutine has not returned.
+     *
+     */
+    bool poll() {
+        if(!this->handle || this->handle.done())
+            return false;
+
+        promise_type &promise = this->handle.promise();
+        if(promise.ready != nullptr && !promise.ready(promise.awaiter))
+            return true;
+
+        promise.ready = nullptr;
+        this->handle.resume();
+        return !this->handle.done();
+    }
+
+    /// True once the coroutine has returned.
+    bool done() const {
+        return !this->handle || this->handle.done();
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+/**
+ *
+ * @class SIMKAFIAwait
+ * @brief Suspends a SIMKAFICoroutine until a flow stops reporting SIMKAFI_TASK_RUNNING.
+ *
+ * The flow is called once when awaited and once per SIMKAFICoroutine::poll() after that;
+ * `co_await` yields its final SIMKAFITaskState.
+ *
+ */
+template<class Flow>
+class SIMKAFIAwait {
+public:
+    explicit SIMKAFIAwait(Flow flow) : flow(flow) {}
+
+    bool await_ready() {
+        return step(this);
+    }
+
+    void await_suspend(std::coroutine_handle<SIMKAFICoroutine::promise_type> handle) {
+        handle.promise().awaiter = this;
+        handle.promise().ready = &SIMKAFIAwait::step;
+    }
+
+    SIMKAFITaskState await_resume() const {
+        return this->state;
+    }
+
+private:
+    static bool step(void *awaiter) {
+        SIMKAFIAwait *self = static_cast<SIMKAFIAwait*>(awaiter);
+        return (self->state = self->flow()) != SIMKAFI_TASK_RUNNING;
+    }
+
+    Flow flow;
+    SIMKAFITaskState state = SIMKAFI_TASK_RUNNING;
+};
+#endif
+#endif
+
+#endif
+
+#endif
@@ -0,0 +1,292 @@
+/*
+ * This file is part of the SIMKAFI Arduino Shield library.
+ * Copyright (c) 2023 Nathanne Isip
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * 
+ * @file SimKafi_config.h
+ * @brief Compile-time options for the SIMKAFI library.
+ *
+ * Every option can be overridden from the build (e.g. PlatformIO build_flags or CMake
+ * definitions) or by editing the defaults below.
+ * 
+ */
+
+#ifndef SIMKAFI_CONFIG_H
+#define SIMKAFI_CONFIG_H
+
+/**
+ * 
+ * @brief Record per-command latency histograms and serial counters (see SIMKAFI::stats()).
+ *
+ * Off by default. When 0, the statistics storage and every recording site compile out.
+ * 
+ */
+#ifndef SIMKAFI_ENABLE_STATS
+#define SIMKAFI_ENABLE_STATS 0
+#endif
+
+/**
+ * 
+ * @brief Subsystems compiled into the library, 1 to include and 0 to leave out.
+ *
+ * All on by default. A subsystem left out takes its methods, types, state and command
+ * strings with it, so a sketch that only sends SMS does not pay flash and RAM for HTTP,
+ * calls, the phonebook or the clock. `extras/size_report.sh` shows what each one costs.
+ *
+ * SIMKAFI_ENABLE_SMS covers sending, reading and storing messages, the storage mirror and
+ * the received and delivered SMS callbacks.
+ * 
+ */
+#ifndef SIMKAFI_ENABLE_SMS
+#define SIMKAFI_ENABLE_SMS 1
+#endif
+
+/// Voice calls: dialUp(), redialUp(), acceptIncomingCall(), hangUp() and the RING callback.
+#ifndef SIMKAFI_ENABLE_CALL
+#define SIMKAFI_ENABLE_CALL 1
+#endif
+
+/// GPRS bearer: connectAPN(), enableGPRS() and ipAddress().
+#ifndef SIMKAFI_ENABLE_GPRS
+#define SIMKAFI_ENABLE_GPRS 1
+#endif
+
+/// HTTP requests over the GPRS bearer: request() and the SIMKAFIHTTP* types. Needs SIMKAFI_ENABLE_GPRS.
+#ifndef SIMKAFI_ENABLE_HTTP
+#define SIMKAFI_ENABLE_HTTP 1
+#endif
+
+/// File transfers over the module's FTP client: ftpUpload() and ftpDownload(). Needs SIMKAFI_ENABLE_GPRS.
+#ifndef SIMKAFI_ENABLE_FTP
+#define SIMKAFI_ENABLE_FTP 1
+#endif
+
+/// SIM phonebook entries: savePhonebook(), retrievePhonebook(), deletePhonebook() and phonebookCapacity().
+#ifndef SIMKAFI_ENABLE_PHONEBOOK
+#define SIMKAFI_ENABLE_PHONEBOOK 1
+#endif
+
+/// The module's real-time clock: rtc() and updateRtc().
+#ifndef SIMKAFI_ENABLE_RTC
+#define SIMKAFI_ENABLE_RTC 1
+#endif
+
+/// Resumable flows: pollResponse(), the SIMKAFITask overloads of sendSMS(), connectGPRS() and request(), and SimKafiTask.h.
+#ifndef SIMKAFI_ENABLE_TASKS
+#define SIMKAFI_ENABLE_TASKS 1
+#endif
+
+#if SIMKAFI_ENABLE_HTTP && !SIMKAFI_ENABLE_GPRS
+#error "SIMKAFI_ENABLE_HTTP needs SIMKAFI_ENABLE_GPRS"
+#endif
+
+#if SIMKAFI_ENABLE_FTP && !SIMKAFI_ENABLE_GPRS
+#error "SIMKAFI_ENABLE_FTP needs SIMKAFI_ENABLE_GPRS"
+#endif
+
+/**
+ * 
+ * @brief Build the library without dynamic memory.
+ *
+ * Off by default. When 1, every text field and return value is a fixed-capacity
+ * SIMKAFIFixedString instead of an Arduino String, the String overloads of the API are
+ * compiled out in favour of their `const char*` and `char*`+capacity variants, and the
+ * library never calls malloc. Text longer than the capacities below is cut short.
+ * 
+ */
+#ifndef SIMKAFI_NO_HEAP
+#define SIMKAFI_NO_HEAP 0
+#endif
+
+/// Capacity of a response read from the module in SIMKAFI_NO_HEAP builds; lines past it are dropped.
+#ifndef SIMKAFI_RESPONSE_SIZE
+#define SIMKAFI_RESPONSE_SIZE 256
+#endif
+
+/// Capacity of a command line in SIMKAFI_NO_HEAP builds.
+#ifndef SIMKAFI_COMMAND_SIZE
+#define SIMKAFI_COMMAND_SIZE 128
+#endif
+
+/// Capacity of names, numbers, APN credentials and single-line answers in SIMKAFI_NO_HEAP builds.
+#ifndef SIMKAFI_TEXT_SIZE
+#define SIMKAFI_TEXT_SIZE 32
+#endif
+
+/// Capacity of HTTP domains, resources and bodies in SIMKAFI_NO_HEAP builds.
+#ifndef SIMKAFI_HTTP_TEXT_SIZE
+#define SIMKAFI_HTTP_TEXT_SIZE 96
+#endif
+
+/// Number of log2 latency buckets per command class; the last bucket is open-ended.
+#ifndef SIMKAFI_STATS_BUCKETS
+#define SIMKAFI_STATS_BUCKETS 16
+#endif
+
+/// How long handleSerialEvent() waits for more unsolicited lines after the last byte, in milliseconds.
+#ifndef SIMKAFI_URC_IDLE_TIMEOUT
+#define SIMKAFI_URC_IDLE_TIMEOUT 50
+#endif
+
+/// How long a flow that stopped asking for the link keeps its place in line, in milliseconds.
+#ifndef SIMKAFI_LINK_QUEUE_TIMEOUT
+#define SIMKAFI_LINK_QUEUE_TIMEOUT 1000
+#endif
+
+/// Room for unsolicited lines that arrive while a command is in progress, in characters.
+#ifndef SIMKAFI_DEFERRED_URC_SIZE
+#define SIMKAFI_DEFERRED_URC_SIZE 128
+#endif
+
+/// Consecutive response timeouts after which the watchdog resynchronizes the link (0 = never).
+#ifndef SIMKAFI_WATCHDOG_TIMEOUTS
+#define SIMKAFI_WATCHDOG_TIMEOUTS 3
+#endif
+
+/// Garbage bytes (framing noise) since the last good response after which the watchdog resynchronizes (0 = never).
+#ifndef SIMKAFI_WATCHDOG_GARBAGE
+#define SIMKAFI_WATCHDOG_GARBAGE 16
+#endif
+
+/// How many "AT" a resync sends before it resets the module, and again while the module boots afterwards.
+#ifndef SIMKAFI_RESYNC_ATTEMPTS
+#define SIMKAFI_RESYNC_ATTEMPTS 4
+#endif
+
+#ifndef SIMKAFI_RESYNC_BOOT_ATTEMPTS
+#define SIMKAFI_RESYNC_BOOT_ATTEMPTS 40
+#endif
+
+/// SMS storage slots mirrored by the library (indices 1 to N); a message above N invalidates the mirror.
+#ifndef SIMKAFI_SMS_SLOTS
+#define SIMKAFI_SMS_SLOTS 64
+#endif
+
+/// Wait before the first retry of a failed GPRS bearer attempt, in milliseconds; it doubles with every further failure.
+#ifndef SIMKAFI_BEARER_BACKOFF_MIN
+#define SIMKAFI_BEARER_BACKOFF_MIN 1000
+#endif
+
+/// Longest wait between GPRS bearer attempts, in milliseconds.
+#ifndef SIMKAFI_BEARER_BACKOFF_MAX
+#define SIMKAFI_BEARER_BACKOFF_MAX 60000
+#endif
+
+/// Failed attempts with one APN profile before the bearer manager moves on to the next.
+#ifndef SIMKAFI_BEARER_PROFILE_ATTEMPTS
+#define SIMKAFI_BEARER_PROFILE_ATTEMPTS 2
+#endif
+
+/// How long the bearer manager leaves a module in "IP CONFIG" alone before asking again, in milliseconds.
+#ifndef SIMKAFI_BEARER_CONFIG_WAIT
+#define SIMKAFI_BEARER_CONFIG_WAIT 2000
+#endif
+
+/// How often serviceCall() asks AT+CLCC about a call in progress while the +CLCC reports are off, in milliseconds.
+#ifndef SIMKAFI_CALL_POLL_INTERVAL
+#define SIMKAFI_CALL_POLL_INTERVAL 2000
+#endif
+
+/// How many times serviceCall() sends ATH to a call that rang too long before it leaves the call be.
+#ifndef SIMKAFI_CALL_HANGUP_ATTEMPTS
+#define SIMKAFI_CALL_HANGUP_ATTEMPTS 3
+#endif
+
+/// Names kept by the DNS cache of resolve() (0 = no cache, every lookup goes to the module).
+#ifndef SIMKAFI_DNS_CACHE_SIZE
+#define SIMKAFI_DNS_CACHE_SIZE 4
+#endif
+
+/// Capacity of a name kept by the DNS cache, terminator included; longer names are looked up every time.
+#ifndef SIMKAFI_DNS_NAME_SIZE
+#define SIMKAFI_DNS_NAME_SIZE 48
+#endif
+
+/// How long a resolved address is used, in milliseconds; AT+CDNSGIP does not report the record's own TTL.
+#ifndef SIMKAFI_DNS_TTL
+#define SIMKAFI_DNS_TTL 300000UL
+#endif
+
+/// How long a name the network could not resolve is remembered before it is looked up again, in milliseconds.
+#ifndef SIMKAFI_DNS_FAILURE_TTL
+#define SIMKAFI_DNS_FAILURE_TTL 10000UL
+#endif
+
+/// Bytes per AT+CIPSEND when sending an HTTP request; the staging buffer of that size lives on the stack.
+#ifndef SIMKAFI_CIPSEND_CHUNK
+#define SIMKAFI_CIPSEND_CHUNK 128
+#endif
+
+/// Bytes per AT+FTPPUT=2 and AT+FTPGET=2; the transfer buffer of that size lives on the stack.
+#ifndef SIMKAFI_FTP_CHUNK
+#define SIMKAFI_FTP_CHUNK 256
+#endif
+
+/// How long rtc() answers from the local clock before it reads AT+CCLK? again, in milliseconds (0 = never).
+#ifndef SIMKAFI_RTC_RESYNC_INTERVAL
+#define SIMKAFI_RTC_RESYNC_INTERVAL 3600000UL
+#endif
+
+/// Shortest time between two clock readings that feeds the drift estimate, in milliseconds;
+/// AT+CCLK? counts whole seconds, so over shorter spans the estimate would mostly be rounding.
+#ifndef SIMKAFI_RTC_DRIFT_WINDOW
+#define SIMKAFI_RTC_DRIFT_WINDOW 1800000UL
+#endif
+
+/// Neighbor cells kept by SIMKAFI::diagnostics(); the SIM800 and SIM900 report up to six.
+#ifndef SIMKAFI_NEIGHBOR_CELLS
+#define SIMKAFI_NEIGHBOR_CELLS 6
+#endif
+
+/// Hash table slots of a SIMKAFISMSRouter, one byte each; it indexes one route fewer, at most 254.
+#ifndef SIMKAFI_SMS_ROUTER_SLOTS
+#define SIMKAFI_SMS_ROUTER_SLOTS 32
+#endif
+
+/// Words after the keyword that a SIMKAFISMSRouter splits into arguments; the rest stays in one view.
+#ifndef SIMKAFI_SMS_ROUTER_ARGS
+#define SIMKAFI_SMS_ROUTER_ARGS 4
+#endif
+
+/// Longest phone number, in digits, a SIMKAFISMSRouter compares; E.164 numbers have at most 15.
+#ifndef SIMKAFI_SMS_SENDER_DIGITS
+#define SIMKAFI_SMS_SENDER_DIGITS 15
+#endif
+
+/// Default budget of the idle callback per call, in milliseconds; a 64-byte receive buffer fills in
+/// about 5.5 ms at 115200 baud and 66 ms at 9600 baud, and bytes past it are lost.
+#ifndef SIMKAFI_IDLE_BUDGET
+#define SIMKAFI_IDLE_BUDGET 5
+#endif
+
+/// How long a baud rate probe waits for "OK" after each "AT", in milliseconds.
+#ifndef SIMKAFI_BAUD_PROBE_TIMEOUT
+#define SIMKAFI_BAUD_PROBE_TIMEOUT 250
+#endif
+
+/// How many "AT" a baud rate probe sends before giving up on a rate; autobauding modules need more than one.
+#ifndef SIMKAFI_BAUD_PROBE_ATTEMPTS
+#define SIMKAFI_BAUD_PROBE_ATTEMPTS 3
+#endif
+
+#endif
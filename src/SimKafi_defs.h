@@ -32,6 +32,28 @@
 #ifndef SIMKAFI_DEFS_H
 #define SIMKAFI_DEFS_H
 
+#include "SimKafi_config.h"
+#include "SimKafiFixedString.h"
+
+/**
+ * 
+ * @brief The text type of the library's fields and return values.
+ *
+ * An Arduino String, or a SIMKAFIFixedString of the given capacity in SIMKAFI_NO_HEAP builds.
+ * 
+ */
+#if SIMKAFI_NO_HEAP
+template<size_t Capacity>
+using SIMKAFIString = SIMKAFIFixedString<Capacity>;
+#else
+template<size_t Capacity>
+using SIMKAFIString = String;
+#endif
+
+/// Names, numbers and single-line answers such as imei().
+typedef SIMKAFIString<SIMKAFI_TEXT_SIZE> SIMKAFIText;
+
+#if SIMKAFI_ENABLE_CALL
 /**
  * 
  * @enum SIMKAFIDialResult
@@ -57,10 +79,111 @@ typedef enum _SIMKAFIDialResult {
     /// An error occurred during the dialing process, causing the call to fail.
     SIMKAFI_DIAL_RESULT_ERROR,
 
-    /// The dialing operation was successful, and a call has been established.
+    /// The module accepted the dial and is calling; SIMKAFI::call() follows the call from there.
     SIMKAFI_DIAL_RESULT_OK
 } SIMKAFIDialResult;
 
+/**
+ * 
+ * @enum SIMKAFICallState
+ * @brief The states of a voice call, as the module reports them with +CLCC.
+ * 
+ */
+typedef enum _SIMKAFICallState {
+    /// No call was made or received yet.
+    SIMKAFI_CALL_IDLE,
+
+    /// An outgoing call is being set up.
+    SIMKAFI_CALL_DIALING,
+
+    /// The callee's phone is ringing.
+    SIMKAFI_CALL_ALERTING,
+
+    /// An incoming call is ringing.
+    SIMKAFI_CALL_INCOMING,
+
+    /// An incoming call is waiting behind another call.
+    SIMKAFI_CALL_WAITING,
+
+    /// The call was answered and is connected.
+    SIMKAFI_CALL_ACTIVE,
+
+    /// The call is on hold.
+    SIMKAFI_CALL_HELD,
+
+    /// The call is over; SIMKAFICall::cause says why.
+    SIMKAFI_CALL_RELEASED
+} SIMKAFICallState;
+
+/**
+ * 
+ * @enum SIMKAFICallEnd
+ * @brief Why a voice call was released.
+ * 
+ */
+typedef enum _SIMKAFICallEnd {
+    /// The call has not ended.
+    SIMKAFI_CALL_END_NONE,
+
+    /// The other side hung up a connected call.
+    SIMKAFI_CALL_END_NORMAL,
+
+    /// The call was hung up with SIMKAFI::hangUp().
+    SIMKAFI_CALL_END_LOCAL,
+
+    /// The callee was busy or rejected the call.
+    SIMKAFI_CALL_END_BUSY,
+
+    /// The callee did not answer in time.
+    SIMKAFI_CALL_END_NO_ANSWER,
+
+    /// The call could not be connected, or the connection was lost.
+    SIMKAFI_CALL_END_NO_CARRIER,
+
+    /// The module had no dial tone.
+    SIMKAFI_CALL_END_NO_DIALTONE,
+
+    /// An incoming call ended without being answered.
+    SIMKAFI_CALL_END_MISSED,
+
+    /// The module refused the dial command.
+    SIMKAFI_CALL_END_ERROR
+} SIMKAFICallEnd;
+
+/**
+ * 
+ * @struct SIMKAFICall
+ * @brief The voice call the library tracks, see SIMKAFI::call().
+ * 
+ */
+typedef struct _SIMKAFICall {
+    /// Where the call stands.
+    SIMKAFICallState state;
+
+    /// True for a call that came in, false for one placed with SIMKAFI::dialUp().
+    bool incoming;
+
+    /// The call's index in the module's +CLCC list, or 0 while it is not known.
+    uint8_t id;
+
+    /// The other side's number, "" while it is not known.
+    SIMKAFIText number;
+
+    /// millis() when the call was dialed or first rang.
+    unsigned long startedAt;
+
+    /// millis() when the call was answered, valid if answered is set.
+    unsigned long answeredAt;
+    bool answered;
+
+    /// Milliseconds the call was connected, final once it is released.
+    uint32_t duration;
+
+    /// Why the call was released, SIMKAFI_CALL_END_NONE before that.
+    SIMKAFICallEnd cause;
+} SIMKAFICall;
+#endif
+
 /**
  * 
  * @enum SIMKAFIOperatorFormat
@@ -240,9 +363,10 @@ typedef struct _SIMKAFIOperator {
     SIMKAFIOperatorFormat format;
 
     /// The name of the mobile network operator.
-    String name;
+    SIMKAFIText name;
 } SIMKAFIOperator;
 
+#if SIMKAFI_ENABLE_RTC
 /**
  * 
  * @struct SIMKAFIRTC
@@ -273,7 +397,9 @@ typedef struct _SIMKAFIRTC {
     /// GMT (Greenwich Mean Time) offset in hours.
     int8_t gmt;
 } SIMKAFIRTC;
+#endif
 
+#if SIMKAFI_ENABLE_GPRS
 /**
  * 
  * @struct SIMKAFIAPN
@@ -284,15 +410,83 @@ typedef struct _SIMKAFIRTC {
  */
 typedef struct _SIMKAFIAPN {
     /// The Access Point Name (APN) for data connectivity.
-    String apn;
+    SIMKAFIText apn;
 
     /// The username for APN authentication.
-    String username;
+    SIMKAFIText username;
 
     /// The password for APN authentication.
-    String password;
+    SIMKAFIText password;
 } SIMKAFIAPN;
 
+/**
+ * 
+ * @enum SIMKAFIBearerState
+ * @brief An enumeration representing the GPRS bearer states reported by AT+CIPSTATUS.
+ * 
+ */
+typedef enum _SIMKAFIBearerState {
+    /// Not known, e.g. after a resync; the bearer manager asks the module.
+    SIMKAFI_BEARER_UNKNOWN,
+
+    /// "IP INITIAL": no APN set.
+    SIMKAFI_BEARER_IP_INITIAL,
+
+    /// "IP START": attached and the APN set with AT+CSTT.
+    SIMKAFI_BEARER_IP_START,
+
+    /// "IP CONFIG": the PDP context is being activated.
+    SIMKAFI_BEARER_IP_CONFIG,
+
+    /// "IP GPRSACT": the PDP context is active but its address has not been read.
+    SIMKAFI_BEARER_IP_GPRSACT,
+
+    /// "IP STATUS" or any connection state: the bearer is up.
+    SIMKAFI_BEARER_IP_STATUS,
+
+    /// "PDP DEACT": the network dropped the context; only AT+CIPSHUT gets out of it.
+    SIMKAFI_BEARER_PDP_DEACT
+} SIMKAFIBearerState;
+
+/**
+ * 
+ * @struct SIMKAFIDNSEntry
+ * @brief One name resolved with AT+CDNSGIP, kept by the DNS cache.
+ * 
+ */
+typedef struct _SIMKAFIDNSEntry {
+    /// FNV-1a hash of the host name, never 0; 0 marks a free entry.
+    uint32_t hostHash;
+
+    /// The host name as it was looked up; the hash only narrows the search.
+    char host[SIMKAFI_DNS_NAME_SIZE];
+
+    /// The IPv4 address, most significant byte first, or 0 if the lookup failed.
+    uint32_t address;
+
+    /// millis() at which the entry expires.
+    unsigned long expires;
+} SIMKAFIDNSEntry;
+
+/**
+ * 
+ * @struct SIMKAFIDNSStats
+ * @brief Counters of the DNS cache, see SIMKAFI::dnsStats().
+ * 
+ */
+typedef struct _SIMKAFIDNSStats {
+    /// Names answered from the cache, including remembered failures.
+    uint16_t hits;
+
+    /// Names looked up with AT+CDNSGIP.
+    uint16_t misses;
+
+    /// Lookups the module or the network could not answer.
+    uint16_t failures;
+} SIMKAFIDNSStats;
+#endif
+
+#if SIMKAFI_ENABLE_HTTP
 /**
  * 
  * @struct SIMKAFIHTTPHeader
@@ -303,10 +497,10 @@ typedef struct _SIMKAFIAPN {
  */
 typedef struct _SIMKAFIHTTPHeader {
     /// The header field key.
-    String key;
+    SIMKAFIText key;
 
     /// The header field value.
-    String value;
+    SIMKAFIString<SIMKAFI_HTTP_TEXT_SIZE> value;
 } SIMKAFIHTTPHeader;
 
 /**
@@ -320,16 +514,16 @@ typedef struct _SIMKAFIHTTPHeader {
  */
 typedef struct _SIMKAFIHTTPRequest {
     /// The HTTP method for the request (e.g., GET, POST).
-    String method;
+    SIMKAFIText method;
 
     /// The data to be included in the request (e.g., POST data).
-    String data;
+    SIMKAFIString<SIMKAFI_HTTP_TEXT_SIZE> data;
 
     /// The domain or server to which the request is sent.
-    String domain;
+    SIMKAFIString<SIMKAFI_HTTP_TEXT_SIZE> domain;
 
     /// The resource or URL path to access on the server.
-    String resource;
+    SIMKAFIString<SIMKAFI_HTTP_TEXT_SIZE> resource;
 
     /// The status of the HTTP request.
     uint8_t status;
@@ -344,6 +538,20 @@ typedef struct _SIMKAFIHTTPRequest {
     uint16_t header_count;
 } SIMKAFIHTTPRequest;
 
+/**
+ * 
+ * @enum SIMKAFIHTTPStatus
+ * @brief Values of SIMKAFIHTTPResponse::status that say how far a request got when no server status was read.
+ * 
+ */
+typedef enum _SIMKAFIHTTPStatus {
+    /// The whole request went out, every chunk acknowledged with SEND OK; the server's answer is not read.
+    SIMKAFI_HTTP_STATUS_SENT = 0,
+
+    /// The request did not go out: no bearer, no connection, or the body ended early.
+    SIMKAFI_HTTP_STATUS_FAILED = 0xFFFF
+} SIMKAFIHTTPStatus;
+
 /**
  * 
  * @struct SIMKAFIHTTPResponse
@@ -354,7 +562,7 @@ typedef struct _SIMKAFIHTTPRequest {
  * 
  */
 typedef struct _SIMKAFIHTTPResponse {
-    /// The HTTP status code of the response.
+    /// The HTTP status code of the response, or a SIMKAFIHTTPStatus.
     uint16_t status;
 
     /// An array of HTTP headers included in the response.
@@ -364,9 +572,84 @@ typedef struct _SIMKAFIHTTPResponse {
     uint16_t header_count;
 
     /// The data received in the HTTP response, such as HTML content or JSON data.
-    String data;
+    SIMKAFIString<SIMKAFI_HTTP_TEXT_SIZE> data;
 } SIMKAFIHTTPResponse;
 
+/**
+ * 
+ * @brief Callback that produces the body of a streamed HTTP request.
+ *
+ * Fills buffer with up to size bytes and returns how many it wrote; 0 means the body
+ * ended early and aborts the request.
+ * 
+ */
+typedef size_t (*SIMKAFIHTTPBodySource)(void *context, uint8_t *buffer, size_t size);
+#endif
+
+#if SIMKAFI_ENABLE_FTP
+/**
+ * 
+ * @struct SIMKAFIFTPServer
+ * @brief A structure representing the FTP server and login used by a transfer.
+ * 
+ */
+typedef struct _SIMKAFIFTPServer {
+    /// The server's host name or address.
+    SIMKAFIString<SIMKAFI_HTTP_TEXT_SIZE> host;
+
+    /// The control connection port, usually 21.
+    uint16_t port;
+
+    /// The user name to log in with.
+    SIMKAFIText username;
+
+    /// The password to log in with.
+    SIMKAFIText password;
+} SIMKAFIFTPServer;
+
+/**
+ * 
+ * @struct SIMKAFIFTPResult
+ * @brief A structure representing the outcome of an FTP transfer.
+ * 
+ */
+typedef struct _SIMKAFIFTPResult {
+    /// True if the whole file was transferred and the server confirmed it.
+    bool complete;
+
+    /// The module's FTP error code (e.g. 61 network error, 66 file not found), 0 if it reported none.
+    uint8_t error;
+
+    /// Bytes moved by this call; after a failure, resume at the old offset plus this.
+    uint32_t transferred;
+} SIMKAFIFTPResult;
+
+/**
+ * 
+ * @brief Callback that produces the next part of a file being uploaded.
+ *
+ * Fills buffer with up to size bytes and returns how many it wrote; 0 marks the end of the file.
+ * 
+ */
+typedef size_t (*SIMKAFIFTPSource)(void *context, uint8_t *buffer, size_t size);
+
+/**
+ * 
+ * @brief Callback that takes the next part of a file being downloaded.
+ *
+ * Returns false to abort the transfer, e.g. when the card being written to is full.
+ * 
+ */
+typedef bool (*SIMKAFIFTPSink)(void *context, const uint8_t *data, size_t length);
+
+/**
+ * 
+ * @brief Callback invoked after every FTP chunk with the position reached in the file.
+ * 
+ */
+typedef void (*SIMKAFIFTPProgress)(void *context, uint32_t position);
+#endif
+
 /**
  * 
  * @struct SIMKAFICardAccount
@@ -378,10 +661,10 @@ typedef struct _SIMKAFIHTTPResponse {
  */
 typedef struct _SIMKAFICardAccount {
     /// The name associated with the card account.
-    String name;
+    SIMKAFIText name;
     
     /// The card's phone number.
-    String number;
+    SIMKAFIText number;
 
     /// The card's type (e.g., SIM card).
     uint8_t type;
@@ -396,6 +679,7 @@ typedef struct _SIMKAFICardAccount {
     SIMKAFICardService service;
 } SIMKAFICardAccount;
 
+#if SIMKAFI_ENABLE_PHONEBOOK
 /**
  * 
  * @struct SIMKAFIPhonebookCapacity
@@ -407,7 +691,7 @@ typedef struct _SIMKAFICardAccount {
  */
 typedef struct _SIMKAFIPhonebookCapacity {
     /// The type of phonebook memory (e.g., "SM" for SIM memory).
-    String memoryType;
+    SIMKAFIText memoryType;
 
     /// The number of entries used in the phonebook memory.
     uint8_t used;
@@ -415,6 +699,7 @@ typedef struct _SIMKAFIPhonebookCapacity {
     /// The maximum number of entries that can be stored in the phonebook memory.
     uint8_t max;
 } SIMKAFIPhonebookCapacity;
+#endif
 
 /**
  * 
@@ -433,4 +718,570 @@ typedef struct _SIMKAFISignal {
     uint8_t bit_error_rate;
 } SIMKAFISignal;
 
-#endif
\ No newline at end of file
+/**
+ * 
+ * @struct SIMKAFICell
+ * @brief A structure representing a GSM cell as reported by AT+CENG? in engineering mode 1.
+ * 
+ */
+typedef struct _SIMKAFICell {
+    /// The absolute radio frequency channel number.
+    uint16_t arfcn;
+
+    /// The received level, 0 (-110 dBm or less) to 63 (-48 dBm or more).
+    uint8_t rxLevel;
+
+    /// The base station identity code.
+    uint8_t bsic;
+
+    /// The mobile country code.
+    uint16_t mcc;
+
+    /// The mobile network code.
+    uint16_t mnc;
+
+    /// The location area code.
+    uint16_t lac;
+
+    /// The cell identity.
+    uint16_t cellId;
+} SIMKAFICell;
+
+/**
+ * 
+ * @struct SIMKAFIDiagnostics
+ * @brief A structure holding one consistent snapshot of the radio and network state, see SIMKAFI::diagnostics().
+ * 
+ */
+typedef struct _SIMKAFIDiagnostics {
+    /// Signal strength and bit error rate (AT+CSQ).
+    SIMKAFISignal signal;
+
+    /// Circuit-switched registration status (AT+CREG?): 1 home, 2 searching, 3 denied, 5 roaming.
+    uint8_t registration;
+
+    /// Packet-switched registration status (AT+CGREG?), with the same values.
+    uint8_t gprsRegistration;
+
+    /// The operator name (AT+COPS?), "" when not registered.
+    char operatorName[24];
+
+    /// The serving cell (AT+CENG? cell 0).
+    SIMKAFICell serving;
+
+    /// The neighbor cells the module reported, in its order.
+    SIMKAFICell neighbors[SIMKAFI_NEIGHBOR_CELLS];
+
+    /// The number of valid entries in neighbors.
+    uint8_t neighborCount;
+} SIMKAFIDiagnostics;
+
+#if SIMKAFI_ENABLE_SMS
+/**
+ * 
+ * @enum SIMKAFISMSStorage
+ * @brief An enumeration representing the SMS storage areas selectable with AT+CPMS.
+ * 
+ */
+typedef enum _SIMKAFISMSStorage {
+    /// The SIM card ("SM").
+    SIMKAFI_SMS_STORAGE_SM,
+
+    /// The module's own memory ("ME").
+    SIMKAFI_SMS_STORAGE_ME,
+
+    /// SIM card and module memory combined ("MT").
+    SIMKAFI_SMS_STORAGE_MT
+} SIMKAFISMSStorage;
+
+/**
+ * 
+ * @enum SIMKAFIPurgeMode
+ * @brief An enumeration representing which messages a bulk delete removes (AT+CMGD=1,<flag>).
+ * 
+ */
+typedef enum _SIMKAFIPurgeMode {
+    /// Received messages that have been read.
+    SIMKAFI_PURGE_READ = 1,
+
+    /// Read messages and sent drafts.
+    SIMKAFI_PURGE_READ_SENT = 2,
+
+    /// Read messages and all drafts, sent or not.
+    SIMKAFI_PURGE_READ_SENT_UNSENT = 3,
+
+    /// Every message, including unread ones.
+    SIMKAFI_PURGE_ALL = 4
+} SIMKAFIPurgeMode;
+
+/**
+ * 
+ * @struct SIMKAFISMSStorageStatus
+ * @brief The message counts of the selected SMS storage, as mirrored by the library.
+ * 
+ */
+typedef struct _SIMKAFISMSStorageStatus {
+    /// The storage the counts refer to.
+    SIMKAFISMSStorage storage;
+
+    /// Messages stored.
+    uint8_t used;
+
+    /// Received messages not read yet.
+    uint8_t unread;
+
+    /// Messages the storage can hold.
+    uint16_t capacity;
+
+    /// False until the mirror has been synchronized with the module, and again after a resync.
+    bool valid;
+} SIMKAFISMSStorageStatus;
+
+/**
+ * 
+ * @struct SIMKAFIPurgePolicy
+ * @brief When and how the library makes room in the SMS storage on its own.
+ * 
+ */
+typedef struct _SIMKAFIPurgePolicy {
+    /// Fill level, in percent of the capacity, at which a purge runs; 0 never purges.
+    uint8_t highWaterPercent;
+
+    /// Which messages the purge deletes.
+    SIMKAFIPurgeMode mode;
+} SIMKAFIPurgePolicy;
+#endif
+
+/**
+ * 
+ * @struct SIMKAFIStringView
+ * @brief A non-owning view over a run of characters inside a buffer owned by the library.
+ *
+ * Views handed to callbacks are only valid for the duration of that call. Copy the characters
+ * out if they are needed afterwards. The data is not guaranteed to be NUL-terminated.
+ * 
+ */
+typedef struct _SIMKAFIStringView {
+    /// Pointer to the first character of the view.
+    const char *data;
+
+    /// The number of characters in the view.
+    size_t length;
+} SIMKAFIStringView;
+
+/**
+ * 
+ * @enum SIMKAFIEventType
+ * @brief An enumeration representing the unsolicited events reported by the SIMKAFI module.
+ *
+ * These events are raised from handleSerialEvent() when the module sends an unsolicited result code (URC).
+ * 
+ */
+typedef enum _SIMKAFIEventType {
+    /// An incoming call is ringing ("RING").
+    SIMKAFI_EVENT_CALL_RECEIVED,
+
+    /// A delivery report for a sent SMS has arrived ("+CDS:").
+    SIMKAFI_EVENT_SMS_DELIVERED,
+
+    /// The active or ringing call has ended ("NO CARRIER").
+    SIMKAFI_EVENT_CALL_ENDED,
+
+    /// The module has been detached from GPRS ("+PDP: DEACT", "+CGATT: 0").
+    SIMKAFI_EVENT_GPRS_DETACHED,
+
+    /// The remote side or the network has closed the TCP/UDP socket ("CLOSED").
+    SIMKAFI_EVENT_SOCKET_CLOSED,
+
+    /// The watchdog brought a lost link back and re-applied the configuration (no line).
+    SIMKAFI_EVENT_LINK_RESTORED,
+
+    /// The bearer manager has the GPRS bearer up and its address read (no line).
+    SIMKAFI_EVENT_BEARER_UP,
+
+    /// The GPRS bearer went down, on request or because the network dropped it (no line).
+    SIMKAFI_EVENT_BEARER_DOWN,
+
+    /// The tracked voice call changed state; SIMKAFIEvent::call has the details.
+    SIMKAFI_EVENT_CALL_STATE
+} SIMKAFIEventType;
+
+/**
+ * 
+ * @struct SIMKAFIEvent
+ * @brief A structure describing a single unsolicited event.
+ * 
+ */
+typedef struct _SIMKAFIEvent {
+    /// The kind of event that occurred.
+    SIMKAFIEventType type;
+
+    /// The unsolicited result code line that raised the event, without the line terminator.
+    SIMKAFIStringView line;
+
+#if SIMKAFI_ENABLE_CALL
+    /// The call for SIMKAFI_EVENT_CALL_STATE, nullptr for other events.
+    const SIMKAFICall *call;
+#endif
+} SIMKAFIEvent;
+
+#if SIMKAFI_ENABLE_SMS
+/**
+ * 
+ * @brief Callback invoked when an SMS is received.
+ *
+ * @param context The context pointer given when the callback was registered.
+ * @param sender View of the sender's phone number.
+ * @param message View of the message body.
+ * 
+ */
+typedef void (*SIMKAFISMSCallback)(void *context, SIMKAFIStringView sender, SIMKAFIStringView message);
+#endif
+
+/**
+ * 
+ * @brief Callback invoked for every unsolicited event other than a received SMS.
+ *
+ * @param context The context pointer given when the callback was registered.
+ * @param event The event that occurred.
+ * 
+ */
+typedef void (*SIMKAFIEventCallback)(void *context, const SIMKAFIEvent &event);
+
+/**
+ * 
+ * @enum SIMKAFICommandClass
+ * @brief An enumeration grouping AT commands by the subsystem they address.
+ *
+ * Response timeouts and latency statistics are kept per class, since commands in one class
+ * have similar response times (an SMS submission waits on the network, a signal query does not).
+ * 
+ */
+typedef enum _SIMKAFICommandClass {
+    /// Basic and identification commands (AT, ATE, AT+GSN, AT+CPIN, ...).
+    SIMKAFI_COMMAND_CLASS_GENERAL,
+
+    /// Network registration and radio queries (AT+CSQ, AT+COPS, AT+CREG, AT+CENG).
+    SIMKAFI_COMMAND_CLASS_NETWORK,
+
+    /// SMS configuration and storage (AT+CMGF, AT+CMGR, AT+CMGL, AT+CPMS, ...).
+    SIMKAFI_COMMAND_CLASS_SMS,
+
+    /// Voice call control (ATD, ATA, ATH, AT+CLCC).
+    SIMKAFI_COMMAND_CLASS_CALL,
+
+    /// GPRS configuration and socket I/O (AT+CSTT, AT+CIFSR, AT+CIPSEND, ...).
+    SIMKAFI_COMMAND_CLASS_DATA,
+
+    /// Phonebook and subscriber number (AT+CPBR, AT+CPBW, AT+CPBS, AT+CNUM).
+    SIMKAFI_COMMAND_CLASS_PHONEBOOK,
+
+    /// Real-time clock (AT+CCLK).
+    SIMKAFI_COMMAND_CLASS_CLOCK,
+
+    /// SMS submission, which waits for the network to accept the message (AT+CMGS, AT+CMSS).
+    SIMKAFI_COMMAND_CLASS_SMS_SEND,
+
+    /// GPRS attach, bearer activation and connection setup (AT+CGATT, AT+CIICR, AT+CIPSTART, ...).
+    SIMKAFI_COMMAND_CLASS_DATA_CONNECT,
+
+    /// The number of command classes.
+    SIMKAFI_COMMAND_CLASS_COUNT
+} SIMKAFICommandClass;
+
+/**
+ * 
+ * @struct SIMKAFITimeoutPolicy
+ * @brief How long the library waits for responses to one class of commands.
+ *
+ * The timeout bounds the silence on the line: it restarts with every byte received, so a long
+ * response that keeps arriving is never cut off. Within the bounds it follows the observed
+ * latency, as the smoothed mean plus four times the mean deviation.
+ * 
+ */
+typedef struct _SIMKAFITimeoutPolicy {
+    /// The shortest timeout the estimate may shrink to, in milliseconds.
+    uint32_t floorMs;
+
+    /// The timeout used until the first response of the class has been timed, in milliseconds.
+    uint32_t initialMs;
+
+    /// The longest timeout, also the limit for the backoff after timeouts, in milliseconds.
+    uint32_t ceilingMs;
+
+    /// How often a command that may safely be repeated is sent in total before giving up.
+    uint8_t attempts;
+} SIMKAFITimeoutPolicy;
+
+/**
+ * 
+ * @struct SIMKAFILatencyEstimate
+ * @brief The running latency estimate behind the timeout of one command class.
+ * 
+ */
+typedef struct _SIMKAFILatencyEstimate {
+    /// Smoothed latency, in 1/8 milliseconds; 0 until the first sample.
+    uint32_t smoothed;
+
+    /// Smoothed mean deviation, in 1/4 milliseconds.
+    uint32_t deviation;
+
+    /// How many times the timeout is doubled after consecutive timeouts.
+    uint8_t backoff;
+} SIMKAFILatencyEstimate;
+
+/**
+ * 
+ * @struct SIMKAFILatencyHistogram
+ * @brief A fixed-size, log2-bucketed histogram of command latencies in milliseconds.
+ *
+ * Bucket 0 counts latencies below 1 ms and bucket i counts latencies in [2^(i-1), 2^i) ms.
+ * The last bucket also takes everything above its lower bound.
+ * 
+ */
+typedef struct _SIMKAFILatencyHistogram {
+    /// Sample counts per bucket.
+    uint16_t buckets[SIMKAFI_STATS_BUCKETS];
+
+    /// The number of samples recorded.
+    uint16_t count;
+
+    /// The largest latency seen, in milliseconds.
+    uint16_t maxMs;
+
+    /// The sum of all latencies, in milliseconds.
+    uint32_t totalMs;
+} SIMKAFILatencyHistogram;
+
+/**
+ * 
+ * @struct SIMKAFIStats
+ * @brief Counters describing where time and bytes went on the serial link.
+ * 
+ */
+typedef struct _SIMKAFIStats {
+    /// Command-to-response latency per command class.
+    SIMKAFILatencyHistogram latency[SIMKAFI_COMMAND_CLASS_COUNT];
+
+    /// Bytes written to the module.
+    uint32_t bytesSent;
+
+    /// Bytes read from the module.
+    uint32_t bytesReceived;
+
+    /// Time spent in fixed delays between commands, in milliseconds.
+    uint32_t delayMs;
+
+    /// Time spent waiting for and reading responses, in milliseconds.
+    uint32_t waitMs;
+
+    /// Time spent in the idle callback, in milliseconds; part of delayMs and waitMs.
+    uint32_t idleMs;
+
+    /// Idle callback calls that ran past their budget.
+    uint16_t idleOverruns;
+
+    /// Commands that got no final result code before their timeout.
+    uint16_t timeouts;
+
+    /// Responses ending in a plain "ERROR".
+    uint16_t errors;
+
+    /// Responses ending in "+CME ERROR: <n>".
+    uint16_t cmeErrors;
+
+    /// Responses ending in "+CMS ERROR: <n>".
+    uint16_t cmsErrors;
+
+    /// The code of the most recent +CME/+CMS error, or -1 if there was none.
+    int16_t lastErrorCode;
+
+    /// Unsolicited result codes seen by handleSerialEvent().
+    uint16_t urcs;
+
+    /// Times the link was resynchronized by the watchdog or resync().
+    uint16_t resyncs;
+
+    /// Responses during which the receive buffer watched by SIMKAFI::watchOverflows() dropped bytes.
+    uint16_t overflowedResponses;
+
+#if SIMKAFI_ENABLE_TASKS
+    /// Flows that took longer than the deadline of their SIMKAFITask.
+    uint16_t deadlineMisses;
+
+    /// Times a bulk flow gave the link up to a more urgent one at a safe boundary.
+    uint16_t preemptions;
+
+    /// The longest an urgent flow waited for the link, in milliseconds.
+    uint32_t urgentWaitMaxMs;
+#endif
+} SIMKAFIStats;
+
+/**
+ * 
+ * @struct SIMKAFIModemConfig
+ * @brief Module settings made through the library.
+ *
+ * The library keeps two of these: the settings the application asked for, applied again after
+ * a resync, and the settings the module is known to have, so unchanged ones are not sent again.
+ * 
+ */
+typedef struct _SIMKAFIModemConfig {
+    /// The AT+CMGF message format (0 = PDU, 1 = text), or -1 if it was never set.
+    int8_t messageFormat;
+
+    /// The AT+CNMI parameters <mode>,<mt>,<bm>,<ds>,<bfr>, valid if hasCNMI is set.
+    uint8_t cnmi[5];
+    bool hasCNMI;
+
+    /// The AT+CSMP parameters <fo>,<vp>,<pid>,<dcs>, valid if hasCSMP is set.
+    uint8_t csmp[4];
+    bool hasCSMP;
+
+    /// The AT+CSCS character set, e.g. "GSM" or "UCS2", or "" if it was never set.
+    char characterSet[8];
+
+    /// The AT+CPMS storage as a SIMKAFISMSStorage, or -1 if it was never set.
+    int8_t smsStorage;
+
+    /// The AT+CENG engineering mode, or -1 if it was never set. Not applied again after a resync.
+    int8_t engineeringMode;
+
+    /// The AT+CLTS network time updates (0 or 1), or -1 if they were never set.
+    int8_t networkTime;
+
+    /// The AT+IFC flow control (0 = none, 1 = RTS/CTS), or -1 if it was never set.
+    int8_t flowControl;
+
+    /// The AT+CLCC call state reports (0 or 1), or -1 if they were never set.
+    int8_t callReports;
+} SIMKAFIModemConfig;
+
+#if SIMKAFI_ENABLE_TASKS
+/**
+ * 
+ * @enum SIMKAFITaskState
+ * @brief What a resumable flow such as SIMKAFI::sendSMS(SIMKAFITask&, ...) reports after each call.
+ * 
+ */
+typedef enum _SIMKAFITaskState {
+    /// The flow is waiting for the module; call it again with the same task and arguments.
+    SIMKAFI_TASK_RUNNING,
+
+    /// The flow finished successfully.
+    SIMKAFI_TASK_DONE,
+
+    /// The flow finished because a step failed or timed out.
+    SIMKAFI_TASK_FAILED
+} SIMKAFITaskState;
+
+/**
+ * 
+ * @enum SIMKAFIPriority
+ * @brief The order in which flows waiting for the link get it, see SIMKAFI::lockLink().
+ * 
+ */
+typedef enum _SIMKAFIPriority {
+    /// Background work such as SIMKAFI::scanSMS(), which gives the link up at its safe boundaries.
+    SIMKAFI_PRIORITY_BULK = -1,
+
+    /// The priority of a zeroed task.
+    SIMKAFI_PRIORITY_NORMAL = 0,
+
+    /// Alarm traffic, which gets the link before anything else.
+    SIMKAFI_PRIORITY_URGENT = 1
+} SIMKAFIPriority;
+
+/**
+ * 
+ * @struct SIMKAFITask
+ * @brief The state a resumable flow keeps between two calls, in place of a stack.
+ *
+ * Start every flow with a zeroed task (`SIMKAFITask task = {};`) and keep it, together with the
+ * arguments, until the flow reports SIMKAFI_TASK_DONE or SIMKAFI_TASK_FAILED; it can start the
+ * next flow then. One task runs one flow at a time. See SimKafiTask.h.
+ *
+ * Set priority and deadline before the first call; they are kept from one flow to the next.
+ * 
+ */
+typedef struct _SIMKAFITask {
+    /// Where the flow resumes; 0 before the first call and after the last.
+    uint16_t resume;
+
+    /// Scratch the flow keeps across its waits, free for a flow's own use.
+    uint8_t step;
+    uint32_t since;
+    uint32_t offset;
+    uint32_t length;
+
+    /// How soon the flow gets the link, a SIMKAFIPriority; zero is SIMKAFI_PRIORITY_NORMAL.
+    int8_t priority;
+
+    /// Milliseconds from the first lockLink() to unlockLink() the flow should take (0 = none);
+    /// flows finishing later are counted in SIMKAFIStats::deadlineMisses.
+    uint32_t deadline;
+
+    /// Kept by lockLink(): when the flow first and last asked for the link, whether it has asked
+    /// since its last unlockLink(), whether it is waiting in line, and the next task in line.
+    /// Kept as millis() returns them, so the differences wrap the same way on every board.
+    unsigned long submitted;
+    unsigned long asked;
+    bool scheduled;
+    bool queued;
+    struct _SIMKAFITask *next;
+} SIMKAFITask;
+
+/**
+ * 
+ * @enum SIMKAFIPoll
+ * @brief The progress of a response read with SIMKAFI::pollResponse().
+ * 
+ */
+typedef enum _SIMKAFIPoll {
+    /// No response is being read.
+    SIMKAFI_POLL_IDLE,
+
+    /// The response has not ended yet.
+    SIMKAFI_POLL_WAITING,
+
+    /// The response ended with a final result code or the line it was read up to.
+    SIMKAFI_POLL_ANSWERED,
+
+    /// The module went quiet before the response ended, after every repetition allowed.
+    SIMKAFI_POLL_TIMEOUT
+} SIMKAFIPoll;
+#endif
+
+/**
+ * 
+ * @brief Callback the library runs while it waits for the module, see SIMKAFI::setIdleCallback().
+ *
+ * @param context The context pointer given when the callback was registered.
+ * @param budgetMs How long the callback may take before the library needs the CPU back, in milliseconds.
+ * 
+ */
+typedef void (*SIMKAFIIdleCallback)(void *context, uint16_t budgetMs);
+
+/**
+ * 
+ * @brief Callback that power-cycles or resets the module, e.g. by pulsing PWRKEY or RESET.
+ *
+ * @param context The context pointer given when the callback was registered.
+ * 
+ */
+typedef void (*SIMKAFIResetCallback)(void *context);
+
+/**
+ * 
+ * @brief Callback that switches the host side of the serial link to another baud rate.
+ *
+ * For a SoftwareSerial or HardwareSerial this is typically `end()` followed by `begin(baud)`.
+ *
+ * @param context The context pointer given to the baud rate routine.
+ * @param baud The baud rate the Stream must run at from now on.
+ * @return True if the Stream was reconfigured, false if the rate is not possible.
+ * 
+ */
+typedef bool (*SIMKAFIBaudCallback)(void *context, uint32_t baud);
+
+#endif